@@ -0,0 +1,173 @@
+// host/fleet.h — pieces of the fleet simulator (fleet_sim.c, fleet_http.c,
+// fleet_server.c)
+//
+// Every node is a separately loaded copy of libaulasense_node.so (uploader.c,
+// sample_log.c and what they use), so each has its own statics, exactly one
+// firmware's worth. Nodes run as coroutines on one thread and one fleet-wide
+// clock; esp_timer_get_time() returns the running node's own drifting clock.
+// The esp_http_client calls of a node go either to the in-process server
+// model (virtual time, runs faster than real time) or, with --server, over
+// real sockets to host/ingest_server.py (real time).
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ucontext.h>
+#include "esp_err.h"
+#include "fleet_node.h"
+#include "upload_sched.h"
+#include "uploader.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct node node_t;
+
+struct node {
+    int         id;
+    char        number[16];           // room number; building stays the default
+    char        log_path[96];         // this node's flash file
+
+    // Its copy of the firmware
+    void       *lib;
+    void      (*uploader_init)(const char *url);
+    bool      (*uploader_add)(const sample_t *s);
+    esp_err_t (*uploader_send)(void);
+    int       (*uploader_count)(void);
+    void      (*uploader_get_stats)(uploader_stats_t *out);
+    void      (*uploader_get_flow)(flow_ctl_t *out);
+    void      (*uploader_drain_queue)(void);
+
+    // Its NVS: the one blob uploader.c keeps (server-set settings)
+    uint8_t     nvs[32];
+    uint32_t    nvs_len;
+
+    // Clocks
+    int64_t     boot_us;              // fleet time of power-on
+    double      drift;                // local clock rate error (e.g. 30e-6)
+    uint32_t    wall0;                // wall-clock seconds at the first sample
+    uint32_t    rtt_us;               // network round trip
+
+    // Coroutine
+    ucontext_t  ctx;
+    void       *stack;
+    uint32_t    token;                // bumped on every wake; stale wakes are ignored
+    int         wake_reason;
+    bool        blocked;
+    int         wait_fd;              // --server: socket being waited on, or -1
+    short       wait_events;
+
+    // Samples: index k has wall time wall0 + k seconds
+    upload_sched_t sched;
+    int64_t     pub_local_us;         // local time of the next window close
+    uint32_t    pub_ms;               // its wall time, ms after wall0
+    uint32_t    published;            // windows closed
+    uint32_t    refused;              // uploader_add() said the queue was full
+    uint8_t    *committed;            // bitmap by k: reached the server
+    uint32_t    committed_n;          // distinct samples committed
+
+    struct esp_http_client *client;   // the node's one client handle
+};
+
+// ===== Scheduler (fleet_sim.c) =====
+enum { FLEET_TIMEOUT = 0, FLEET_READY, FLEET_RESPONSE, FLEET_RESET };
+
+int64_t  fleet_now_us(void);          // fleet-wide clock
+node_t  *fleet_current(void);         // node whose code is running, or NULL
+node_t  *fleet_node(int id);
+void     fleet_at(int64_t t_us, void (*fn)(void *), void *arg);
+
+// Blocks the running node until fleet_wake_at() with the token fleet_token()
+// returned before blocking, or until deadline_us (FLEET_TIMEOUT).
+uint32_t fleet_token(void);
+int      fleet_block(int64_t deadline_us);
+void     fleet_wake_at(int64_t t_us, node_t *n, uint32_t token, int reason);
+void     fleet_sleep_us(int64_t us);
+// --server only: block until fd is ready for events (FLEET_READY) or deadline.
+int      fleet_wait_fd(int fd, short events, int64_t deadline_us);
+
+double   fleet_rand(void);            // uniform [0, 1)
+double   fleet_gauss(void);
+
+// ===== Latency record =====
+typedef struct {
+    uint32_t *v;                      // µs
+    size_t    n, cap;
+} lat_rec_t;
+
+void     lat_add(lat_rec_t *r, int64_t us);
+void     lat_print(const char *name, lat_rec_t *r);   // sorts r
+
+// ===== Samples (fleet_sim.c) =====
+// Sample indices (k, seconds after the node's wall0) of a JSON batch, gunzipped first if gz; -1 if the body
+// is not JSON or does not decode. k must hold max entries.
+int  fleet_decode(const node_t *n, const char *body, size_t len, const char *content_type,
+                  bool gz, uint32_t *k, int max);
+// Marks k[0..nk) of n as delivered; *dups counts the ones that already were.
+void fleet_commit(node_t *n, const uint32_t *k, int nk, uint32_t *dups);
+
+// ===== Server model (fleet_server.c) =====
+typedef struct {
+    int      workers;                 // requests served at once
+    int      queue_max;               // waiting beyond this get 503 at once
+    uint32_t service_us;              // median service time of one POST
+    uint32_t idle_s;                  // keep-alive idle timeout
+    uint32_t kbps;                    // node uplink
+    double   p_slow, p_fail, p_reset; // fault probabilities per request
+    uint32_t slow_us;                 // extra service time of a slow request
+    int64_t  outage_from_us, outage_to_us;   // refuses connections in between
+    // Directives (main/flow_ctl.h)
+    uint32_t retry_after_s;           // Retry-After on every 503; 0 = none
+    int      pace_depth;              // queue depth that turns pacing on...
+    uint32_t pace_interval_s;         // ...asking for this upload interval
+    const char *directive;            // body of every response when not pacing
+} fleet_server_cfg_t;
+
+typedef struct {
+    uint32_t requests, committed_posts, rejected_503, faults_5xx, resets;
+    uint32_t samples_in, duplicates, undecoded;
+    uint32_t paced, retry_after;      // responses asking to slow down
+    uint64_t bytes_in;
+    uint32_t queue_peak;
+    int64_t  busy_us;                 // summed over workers
+    lat_rec_t latency;                // arrival → response leaves the server
+} fleet_server_stats_t;
+
+void fleet_server_init(const fleet_server_cfg_t *cfg);
+fleet_server_cfg_t   *fleet_server_cfg(void);     // may be changed between runs
+fleet_server_stats_t *fleet_server_stats(void);
+bool fleet_server_up(void);
+typedef struct {
+    int         status;
+    uint32_t    retry_after_s;        // Retry-After header; 0 = none
+    const char *body;                 // static; NULL = empty
+} fleet_resp_t;
+
+// A request of len body bytes holding samples k[0..nk) (nk < 0: undecoded)
+// leaves node n now. n is woken with the given token: FLEET_RESPONSE with
+// *resp set, or FLEET_RESET.
+void fleet_server_submit(node_t *n, uint32_t token, size_t len,
+                         const uint32_t *k, int nk, fleet_resp_t *resp);
+
+// ===== HTTP client (fleet_http.c) =====
+typedef struct {
+    uint32_t attempts;                // POSTs started (open called)
+    uint32_t ok_2xx, status_5xx, status_other;
+    uint32_t resets, timeouts, refused, stale;   // failed before a status
+    uint32_t handshakes;
+    uint32_t samples_sent;            // summed over attempts that sent a body
+    uint64_t bytes_sent;
+    uint64_t bytes_acked;             // bodies of 2xx responses
+    lat_rec_t latency;                // request sent → status line, 2xx and 5xx
+} fleet_http_stats_t;
+
+void fleet_http_set_server(const char *host, int port);   // NULL = server model
+bool fleet_http_real(void);
+fleet_http_stats_t *fleet_http_stats(void);
+// GET /stats from --server into buf; false if it could not be fetched.
+bool fleet_http_fetch_stats(char *buf, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,492 @@
+// host/fleet_http.c — esp_http_client for fleet_sim nodes
+//
+// The subset uploader.c uses, with the same events, bound to the node that
+// created the handle. A blocking call parks only that node's coroutine.
+// Against the server model a connection is a flag: the handshake costs
+// 3 RTTs (TCP + full TLS) or 2 with a saved TLS session, and a connection
+// idle longer than the server's idle_s is found dead on the next request.
+// A model response brings its Retry-After as a header event and its
+// directive as the body, for uploader.c to read like a real one.
+// With --server the requests go over non-blocking sockets to a real server
+// (plain HTTP; the node's RTT is still added per exchange).
+#include "fleet.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MAX_HEADERS 8
+
+typedef struct {
+    char key[32];
+    char value[160];
+} header_t;
+
+struct esp_http_client {
+    node_t              *node;
+    char                 path[128];
+    int                  timeout_ms;
+    http_event_handle_cb handler;
+    void                *user_data;
+    header_t             hdr[MAX_HEADERS];
+    int                  status;
+    int64_t              content_length;
+    int64_t              remaining;
+    bool                 resp_close;
+    char                *body;
+    size_t               body_len, body_cap;
+    uint32_t             k[UPLOADER_MAX_SAMPLES];   // samples in the body
+    int                  nk;
+    // Server model
+    bool                 connected;
+    bool                 session;         // TLS session saved by a handshake
+    bool                 reused;          // this request rides an older connection
+    int64_t              idle_since;
+    fleet_resp_t         resp;
+    const char          *resp_body;       // unread rest of resp.body
+    // --server
+    int                  fd;
+    char                 rbuf[2048];
+    size_t               rlen, rpos;
+    int64_t              deadline;
+};
+
+static fleet_http_stats_t s_stats;
+static bool     s_real;
+static char     s_host[64];
+static int      s_port;
+static struct sockaddr_storage s_addr;
+static socklen_t s_addrlen;
+
+void fleet_http_set_server(const char *host, int port)
+{
+    s_real = host != NULL;
+    if (!s_real) return;
+    snprintf(s_host, sizeof(s_host), "%s", host);
+    s_port = port;
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM }, *ai;
+    char p[8];
+    snprintf(p, sizeof(p), "%d", port);
+    if (getaddrinfo(host, p, &hints, &ai) == 0) {
+        memcpy(&s_addr, ai->ai_addr, ai->ai_addrlen);
+        s_addrlen = ai->ai_addrlen;
+        freeaddrinfo(ai);
+    }
+}
+
+bool fleet_http_real(void) { return s_real; }
+fleet_http_stats_t *fleet_http_stats(void) { return &s_stats; }
+
+esp_err_t esp_crt_bundle_attach(void *conf)
+{
+    (void)conf;
+    return ESP_OK;
+}
+
+static void emit(esp_http_client_handle_t h, esp_http_client_event_id_t id,
+                 char *key, char *value)
+{
+    if (!h->handler) return;
+    esp_http_client_event_t evt = {
+        .event_id = id, .client = h, .user_data = h->user_data,
+        .header_key = key, .header_value = value,
+    };
+    h->handler(&evt);
+}
+
+static void disconnect(esp_http_client_handle_t h)
+{
+    if (s_real) {
+        if (h->fd < 0) return;
+        close(h->fd);
+        h->fd = -1;
+        h->rlen = h->rpos = 0;
+    } else {
+        if (!h->connected) return;
+        h->connected = false;
+    }
+    emit(h, HTTP_EVENT_DISCONNECTED, NULL, NULL);
+}
+
+static const char *header(esp_http_client_handle_t h, const char *key)
+{
+    for (int i = 0; i < MAX_HEADERS; ++i) {
+        if (h->hdr[i].key[0] && strcasecmp(h->hdr[i].key, key) == 0) return h->hdr[i].value;
+    }
+    return NULL;
+}
+
+// ===== Real sockets =====
+static esp_err_t sock_connect(esp_http_client_handle_t h)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return ESP_FAIL;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (struct sockaddr *)&s_addr, s_addrlen) != 0 && errno != EINPROGRESS) {
+        close(fd);
+        return ESP_FAIL;
+    }
+    int64_t deadline = fleet_now_us() + (int64_t)h->timeout_ms * 1000;
+    int err = 0;
+    socklen_t el = sizeof(err);
+    if (fleet_wait_fd(fd, POLLOUT, deadline) != FLEET_READY ||
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &el) != 0 || err != 0) {
+        close(fd);
+        return ESP_FAIL;
+    }
+    fleet_sleep_us(h->node->rtt_us);   // the handshake's round trip
+    h->fd = fd;
+    h->rlen = h->rpos = 0;
+    return ESP_OK;
+}
+
+static bool sock_send(esp_http_client_handle_t h, const char *p, size_t len)
+{
+    int64_t deadline = fleet_now_us() + (int64_t)h->timeout_ms * 1000;
+    while (len > 0) {
+        ssize_t n = send(h->fd, p, len, MSG_NOSIGNAL);
+        if (n > 0) {
+            p += n;
+            len -= (size_t)n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (fleet_wait_fd(h->fd, POLLOUT, deadline) != FLEET_READY) return false;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Next response byte: -1 on EOF/reset, -2 on timeout.
+static int sock_byte(esp_http_client_handle_t h)
+{
+    while (h->rpos == h->rlen) {
+        ssize_t n = recv(h->fd, h->rbuf, sizeof(h->rbuf), 0);
+        if (n > 0) {
+            h->rlen = (size_t)n;
+            h->rpos = 0;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (fleet_wait_fd(h->fd, POLLIN, h->deadline) != FLEET_READY) return -2;
+        } else {
+            return -1;
+        }
+    }
+    return (unsigned char)h->rbuf[h->rpos++];
+}
+
+static int sock_line(esp_http_client_handle_t h, char *out, size_t cap)
+{
+    size_t n = 0;
+    for (;;) {
+        int c = sock_byte(h);
+        if (c < 0) return c;
+        if (c == '\n') break;
+        if (c != '\r' && n + 1 < cap) out[n++] = (char)c;
+    }
+    out[n] = '\0';
+    return (int)n;
+}
+
+// Status line and headers; <0 as sock_byte().
+static int sock_response(esp_http_client_handle_t h)
+{
+    char line[512];
+    int r = sock_line(h, line, sizeof(line));
+    if (r < 0) return r;
+    if (sscanf(line, "HTTP/%*d.%*d %d", &h->status) != 1) return -1;
+    for (;;) {
+        r = sock_line(h, line, sizeof(line));
+        if (r < 0) return r;
+        if (r == 0) break;
+        char *colon = strchr(line, ':');
+        if (!colon) continue;
+        *colon = '\0';
+        char *value = colon + 1;
+        while (*value == ' ') ++value;
+        if (strcasecmp(line, "Content-Length") == 0) h->content_length = atoll(value);
+        if (strcasecmp(line, "Connection") == 0 && strcasecmp(value, "close") == 0) h->resp_close = true;
+        emit(h, HTTP_EVENT_ON_HEADER, line, value);
+    }
+    return 0;
+}
+
+// ===== esp_http_client =====
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *cfg)
+{
+    esp_http_client_handle_t h = calloc(1, sizeof(*h));
+    if (!h) return NULL;
+    h->node = fleet_current();
+    h->node->client = h;
+    h->fd = -1;
+    h->timeout_ms = cfg->timeout_ms > 0 ? cfg->timeout_ms : 5000;
+    h->handler = cfg->event_handler;
+    h->user_data = cfg->user_data;
+
+    const char *p = cfg->url ? strstr(cfg->url, "://") : NULL;
+    p = p ? strchr(p + 3, '/') : NULL;
+    snprintf(h->path, sizeof(h->path), "%s", p ? p : "/");
+    return h;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t h, const char *key, const char *value)
+{
+    header_t *free_slot = NULL;
+    for (int i = 0; i < MAX_HEADERS; ++i) {
+        if (h->hdr[i].key[0] == '\0') {
+            if (!free_slot) free_slot = &h->hdr[i];
+        } else if (strcasecmp(h->hdr[i].key, key) == 0) {
+            free_slot = &h->hdr[i];
+            break;
+        }
+    }
+    if (!free_slot) return ESP_ERR_NO_MEM;
+    snprintf(free_slot->key, sizeof(free_slot->key), "%s", key);
+    snprintf(free_slot->value, sizeof(free_slot->value), "%s", value);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t h, const char *key)
+{
+    for (int i = 0; i < MAX_HEADERS; ++i) {
+        if (strcasecmp(h->hdr[i].key, key) == 0) h->hdr[i].key[0] = '\0';
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t h, int write_len)
+{
+    node_t *n = h->node;
+    s_stats.attempts++;
+    h->body_len = 0;
+    h->status = 0;
+    h->content_length = 0;
+    h->resp_close = false;
+
+    if (s_real) {
+        h->reused = h->fd >= 0;
+        if (h->fd < 0) {
+            if (sock_connect(h) != ESP_OK) {
+                s_stats.refused++;
+                return ESP_FAIL;
+            }
+            s_stats.handshakes++;
+            emit(h, HTTP_EVENT_ON_CONNECTED, NULL, NULL);
+        }
+        char req[1024];
+        int len = snprintf(req, sizeof(req),
+                           "POST %s HTTP/1.1\r\nHost: %s:%d\r\nUser-Agent: ESP32 HTTP Client/1.0\r\n"
+                           "Content-Length: %d\r\n", h->path, s_host, s_port, write_len);
+        for (int i = 0; i < MAX_HEADERS; ++i) {
+            if (h->hdr[i].key[0]) {
+                len += snprintf(req + len, sizeof(req) - (size_t)len, "%s: %s\r\n",
+                                h->hdr[i].key, h->hdr[i].value);
+            }
+        }
+        len += snprintf(req + len, sizeof(req) - (size_t)len, "\r\n");
+        if (!sock_send(h, req, (size_t)len)) {
+            s_stats.stale += h->reused;
+            s_stats.resets += !h->reused;
+            disconnect(h);
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
+
+    h->reused = h->connected;
+    if (h->connected) return ESP_OK;   // may be dead; fetch_headers finds out
+    if (!fleet_server_up()) {
+        fleet_sleep_us(n->rtt_us);     // SYN, RST
+        s_stats.refused++;
+        return ESP_FAIL;
+    }
+    fleet_sleep_us((int64_t)n->rtt_us * (h->session ? 2 : 3));
+    h->connected = true;
+    h->session = true;
+    s_stats.handshakes++;
+    emit(h, HTTP_EVENT_ON_CONNECTED, NULL, NULL);
+    return ESP_OK;
+}
+
+int esp_http_client_write(esp_http_client_handle_t h, const char *buf, int len)
+{
+    if (s_real ? h->fd < 0 : !h->connected) return -1;
+    if (s_real && !sock_send(h, buf, (size_t)len)) return -1;
+    if (h->body_len + (size_t)len > h->body_cap) {
+        size_t cap = h->body_cap ? h->body_cap : 4096;
+        while (cap < h->body_len + (size_t)len) cap *= 2;
+        char *nb = realloc(h->body, cap);
+        if (!nb) return -1;
+        h->body = nb;
+        h->body_cap = cap;
+    }
+    memcpy(h->body + h->body_len, buf, (size_t)len);
+    h->body_len += (size_t)len;
+    return len;
+}
+
+// Sorts the outcome of a request into the stats; true if it got a status.
+static bool account(esp_http_client_handle_t h, int r, int64_t sent_us)
+{
+    if (r == FLEET_RESPONSE) {
+        lat_add(&s_stats.latency, fleet_now_us() - sent_us);
+        if (h->status >= 200 && h->status < 300) {
+            s_stats.ok_2xx++;
+            s_stats.bytes_acked += h->body_len;
+        } else if (h->status >= 500) {
+            s_stats.status_5xx++;
+        } else {
+            s_stats.status_other++;
+        }
+        return true;
+    }
+    if (r == FLEET_TIMEOUT)   s_stats.timeouts++;
+    else if (h->reused)       s_stats.stale++;
+    else                      s_stats.resets++;
+    return false;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t h)
+{
+    node_t *n = h->node;
+    if (s_real ? h->fd < 0 : !h->connected) return -1;
+
+    const char *ct = header(h, "Content-Type");
+    const char *ce = header(h, "Content-Encoding");
+    h->nk = fleet_decode(n, h->body, h->body_len, ct ? ct : "",
+                         ce && strcasecmp(ce, "gzip") == 0, h->k, UPLOADER_MAX_SAMPLES);
+    s_stats.bytes_sent += h->body_len;
+    if (h->nk > 0) s_stats.samples_sent += (uint32_t)h->nk;
+
+    int64_t sent = fleet_now_us();
+    int r;
+    if (s_real) {
+        fleet_sleep_us(n->rtt_us);   // request out, response back
+        h->deadline = fleet_now_us() + (int64_t)h->timeout_ms * 1000;
+        int s = sock_response(h);
+        r = s == 0 ? FLEET_RESPONSE : s == -2 ? FLEET_TIMEOUT : FLEET_RESET;
+        if (r == FLEET_RESPONSE && h->status >= 200 && h->status < 300) {
+            uint32_t dups = 0;
+            fleet_commit(n, h->k, h->nk, &dups);   // acknowledged = delivered
+        }
+    } else if (!fleet_server_up() ||
+               (h->reused && sent - h->idle_since >= (int64_t)fleet_server_cfg()->idle_s * 1000000)) {
+        fleet_sleep_us(n->rtt_us);   // the server is gone or closed it long ago: RST
+        r = FLEET_RESET;
+    } else {
+        h->resp = (fleet_resp_t){ 0 };
+        fleet_server_submit(n, fleet_token(), h->body_len, h->k, h->nk, &h->resp);
+        r = fleet_block(sent + (int64_t)h->timeout_ms * 1000);
+        if (r == FLEET_RESPONSE) {
+            h->status = h->resp.status;
+            h->resp_body = h->resp.body;
+            h->content_length = h->resp_body ? (int64_t)strlen(h->resp_body) : 0;
+            if (h->resp.retry_after_s) {
+                char key[] = "Retry-After", value[16];
+                snprintf(value, sizeof(value), "%u", (unsigned)h->resp.retry_after_s);
+                emit(h, HTTP_EVENT_ON_HEADER, key, value);
+            }
+        }
+    }
+
+    if (!account(h, r, sent)) {
+        disconnect(h);
+        return -1;
+    }
+    h->idle_since = fleet_now_us();
+    h->remaining = h->content_length;
+    return h->content_length;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t h)
+{
+    return h->status;
+}
+
+int64_t esp_http_client_get_content_length(esp_http_client_handle_t h)
+{
+    return h->content_length;
+}
+
+int esp_http_client_read(esp_http_client_handle_t h, char *buf, int len)
+{
+    int n = 0;
+    if (!s_real) {
+        while (n < len && h->remaining > 0) {
+            buf[n++] = *h->resp_body++;
+            h->remaining--;
+        }
+        return n;
+    }
+    while (n < len && h->remaining > 0) {
+        int c = sock_byte(h);
+        if (c < 0) break;
+        buf[n++] = (char)c;
+        h->remaining--;
+    }
+    return n;
+}
+
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t h, int *len)
+{
+    char sink[256];
+    int total = 0, n;
+    while ((n = esp_http_client_read(h, sink, sizeof(sink))) > 0) total += n;
+    if (len) *len = total;
+    emit(h, HTTP_EVENT_ON_FINISH, NULL, NULL);
+    if (h->resp_close) disconnect(h);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t h)
+{
+    disconnect(h);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t h)
+{
+    if (!h) return ESP_OK;
+    disconnect(h);
+    if (h->node->client == h) h->node->client = NULL;
+    free(h->body);
+    free(h);
+    return ESP_OK;
+}
+
+// Blocking, outside any node: GET /stats for the report.
+bool fleet_http_fetch_stats(char *buf, size_t cap)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    if (connect(fd, (struct sockaddr *)&s_addr, s_addrlen) != 0) {
+        close(fd);
+        return false;
+    }
+    char req[128];
+    int len = snprintf(req, sizeof(req), "GET /stats HTTP/1.1\r\nHost: %s:%d\r\nConnection: close\r\n\r\n",
+                       s_host, s_port);
+    size_t got = 0;
+    if (send(fd, req, (size_t)len, MSG_NOSIGNAL) == len) {
+        ssize_t r;
+        while (got + 1 < cap && (r = recv(fd, buf + got, cap - 1 - got, 0)) > 0) got += (size_t)r;
+    }
+    close(fd);
+    buf[got] = '\0';
+    char *body = strstr(buf, "\r\n\r\n");
+    if (!body) return false;
+    memmove(buf, body + 4, strlen(body + 4) + 1);
+    char *nl = strchr(buf, '\n');
+    if (nl) *nl = '\0';
+    return buf[0] != '\0';
+}
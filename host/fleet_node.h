@@ -0,0 +1,21 @@
+// host/fleet_node.h — per-node hooks of the fleet simulator's node library
+//
+// host/CMakeLists.txt force-includes this into every file of aulasense_node
+// and points DEVICE_NUMBER_DEFAULT, SAMPLE_LOG_HOST_FILE and
+// SAMPLE_LOG_HOST_SIZE at these calls, so each loaded copy of the library
+// gets its own room number and flash file. fleet_sim answers them for
+// whichever node is running.
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const char *fleet_node_number(void);
+const char *fleet_node_log_path(void);
+uint32_t    fleet_node_log_size(void);   // bytes
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,195 @@
+// host/fleet_server.c — in-process ingest server model for fleet_sim
+//
+// `workers` requests are served at once; the rest wait in arrival order, and
+// a request finding queue_max already waiting is answered 503 at once.
+// Service time is log-normal around service_us. Faults are drawn per request:
+//   slow   service takes slow_us longer; past the client's timeout the server
+//          still commits, so the retry is a duplicate
+//   fail   503 after the service time, nothing committed
+//   reset  the connection is reset, half the time before the request is
+//          processed and half after it was committed (lost ack: duplicate)
+// The request travels for half an RTT plus its body at the node's uplink
+// rate, the response for half an RTT.
+//
+// Directives: every 503 carries Retry-After when retry_after_s is set. With
+// pace_depth, pacing turns on once that many requests wait and off again
+// below a quarter of it; every response then says
+// {"upload_interval_s":pace_interval_s} or {"upload_interval_s":0}.
+// Otherwise every response carries the fixed directive body, if any.
+#include "fleet.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { F_NONE, F_SLOW, F_FAIL, F_RESET_BEFORE, F_RESET_AFTER };
+
+typedef struct req {
+    node_t     *node;
+    uint32_t    token;
+    fleet_resp_t *resp;
+    size_t      len;
+    uint32_t   *k;
+    int         nk;
+    int         fault;
+    int         result;            // HTTP status, or -1 for a reset
+    fleet_resp_t out;
+    int64_t     arrive_us, service_us;
+    struct req *next;
+} req_t;
+
+static fleet_server_cfg_t   s_cfg;
+static fleet_server_stats_t s_stats;
+static int    s_busy;
+static req_t *s_head, *s_tail;
+static uint32_t s_queued;
+static bool   s_pacing;
+static char   s_pace_on[48], s_pace_off[48];
+
+void fleet_server_init(const fleet_server_cfg_t *cfg)
+{
+    s_cfg = *cfg;
+    snprintf(s_pace_on, sizeof(s_pace_on), "{\"upload_interval_s\":%u}", (unsigned)cfg->pace_interval_s);
+    snprintf(s_pace_off, sizeof(s_pace_off), "{\"upload_interval_s\":0}");
+}
+
+fleet_server_cfg_t   *fleet_server_cfg(void)   { return &s_cfg; }
+fleet_server_stats_t *fleet_server_stats(void) { return &s_stats; }
+
+bool fleet_server_up(void)
+{
+    int64_t now = fleet_now_us();
+    return !(now >= s_cfg.outage_from_us && now < s_cfg.outage_to_us);
+}
+
+// The response (or RST) reaches the node; it may have given up meanwhile.
+static void deliver(void *arg)
+{
+    req_t *r = arg;
+    node_t *n = r->node;
+    if (n->blocked && n->token == r->token) {
+        if (r->result > 0) *r->resp = r->out;
+        fleet_wake_at(fleet_now_us(), n, r->token, r->result > 0 ? FLEET_RESPONSE : FLEET_RESET);
+    }
+    free(r->k);
+    free(r);
+}
+
+static void respond(req_t *r, int result)
+{
+    r->result = result;
+    r->out = (fleet_resp_t){ .status = result, .body = s_cfg.directive };
+    if (result == 503 && s_cfg.retry_after_s) {
+        r->out.retry_after_s = s_cfg.retry_after_s;
+        s_stats.retry_after++;
+    }
+    if (result > 0 && s_cfg.pace_depth > 0) {
+        if (s_queued >= (uint32_t)s_cfg.pace_depth) s_pacing = true;
+        else if (s_queued <= (uint32_t)s_cfg.pace_depth / 4) s_pacing = false;
+        r->out.body = s_pacing ? s_pace_on : s_pace_off;
+        s_stats.paced += s_pacing;
+    }
+    fleet_at(fleet_now_us() + r->node->rtt_us / 2, deliver, r);
+}
+
+static void done(void *arg);
+
+static void start(req_t *r)
+{
+    s_busy++;
+    r->service_us = (int64_t)(s_cfg.service_us * exp(0.5 * fleet_gauss() - 0.125));
+    if (r->fault == F_SLOW) r->service_us += s_cfg.slow_us;
+    fleet_at(fleet_now_us() + r->service_us, done, r);
+}
+
+static void commit(req_t *r)
+{
+    if (r->nk < 0) {
+        s_stats.undecoded++;
+        return;
+    }
+    uint32_t dups = 0;
+    fleet_commit(r->node, r->k, r->nk, &dups);
+    s_stats.samples_in += (uint32_t)r->nk;
+    s_stats.duplicates += dups;
+    s_stats.committed_posts++;
+}
+
+static void done(void *arg)
+{
+    req_t *r = arg;
+    s_busy--;
+    s_stats.busy_us += r->service_us;
+    lat_add(&s_stats.latency, fleet_now_us() - r->arrive_us);
+
+    if (r->fault == F_FAIL) {
+        s_stats.faults_5xx++;
+        respond(r, 503);
+    } else {
+        commit(r);
+        if (r->fault == F_RESET_AFTER) {
+            s_stats.resets++;
+            respond(r, -1);
+        } else {
+            respond(r, 200);
+        }
+    }
+
+    if (s_head) {
+        req_t *next = s_head;
+        s_head = next->next;
+        if (!s_head) s_tail = NULL;
+        s_queued--;
+        start(next);
+    }
+}
+
+static void arrive(void *arg)
+{
+    req_t *r = arg;
+    r->arrive_us = fleet_now_us();
+    s_stats.requests++;
+    s_stats.bytes_in += r->len;
+
+    if (r->fault == F_RESET_BEFORE) {
+        s_stats.resets++;
+        respond(r, -1);
+    } else if (s_busy < s_cfg.workers) {
+        start(r);
+    } else if (s_queued >= (uint32_t)s_cfg.queue_max) {
+        s_stats.rejected_503++;
+        lat_add(&s_stats.latency, 0);
+        respond(r, 503);
+    } else {
+        r->next = NULL;
+        if (s_tail) s_tail->next = r; else s_head = r;
+        s_tail = r;
+        if (++s_queued > s_stats.queue_peak) s_stats.queue_peak = s_queued;
+    }
+}
+
+void fleet_server_submit(node_t *n, uint32_t token, size_t len,
+                         const uint32_t *k, int nk, fleet_resp_t *resp)
+{
+    req_t *r = calloc(1, sizeof(*r));
+    if (!r) abort();
+    r->node = n;
+    r->token = token;
+    r->resp = resp;
+    r->len = len;
+    r->nk = nk;
+    if (nk > 0) {
+        r->k = malloc((size_t)nk * sizeof(*k));
+        if (!r->k) abort();
+        memcpy(r->k, k, (size_t)nk * sizeof(*k));
+    }
+
+    double u = fleet_rand();
+    if ((u -= s_cfg.p_slow) < 0)       r->fault = F_SLOW;
+    else if ((u -= s_cfg.p_fail) < 0)  r->fault = F_FAIL;
+    else if ((u -= s_cfg.p_reset) < 0) r->fault = fleet_rand() < 0.5 ? F_RESET_BEFORE : F_RESET_AFTER;
+
+    int64_t xfer_us = s_cfg.kbps ? (int64_t)len * 8000 / s_cfg.kbps : 0;
+    fleet_at(fleet_now_us() + n->rtt_us / 2 + xfer_us, arrive, r);
+}
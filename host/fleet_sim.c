@@ -0,0 +1,913 @@
+// host/fleet_sim.c — N copies of the uploader against one ingest server
+//
+//   ./fleet_sim [--nodes N] [--hours H] [--seed N] [--publish-s S]
+//               [--rtt-ms N] [--kbps N] [--flash-sectors N]
+//               [--workers N] [--service-ms N] [--queue N] [--idle-s N]
+//               [--slow P] [--slow-ms N] [--fail P] [--reset P]
+//               [--outage FROM_S:SECONDS] [--retry-after S]
+//               [--pace DEPTH:INTERVAL_S] [--directive JSON]
+//               [--server HOST:PORT] [--lib PATH] [--log-node N]
+//
+// Nodes power up spread over the first minute, each with its own wall-clock
+// offset, crystal drift and network RTT. Every node closes a window each
+// --publish-s (or the period the server set) on its own clock, queues it with
+// uploader_add() and runs the sender_task loop of app_main.c (upload_sched +
+// uploader_send, paced by the server's directives). After --hours
+// publishing stops and the faults are lifted so every backlog can drain; then
+// the fleet report: server throughput, client and server latency
+// percentiles, retry amplification and sample loss.
+//
+// The default server is an in-process model on the virtual clock (see
+// fleet_server.c), so a day of a thousand rooms takes minutes. --server sends
+// the same traffic over real sockets to host/ingest_server.py in real time;
+// faults are then the ingest server's.
+#include "fleet.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "metrics.h"
+#include "nvs.h"
+#include "sample.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define EPOCH        1757304000          // 2025-09-08 04:00, wall clock at t = 0
+#define TICK_US      10000               // vTaskDelay(pdMS_TO_TICKS(wait) + 1)
+#define QUEUE_DRAIN_MS 60000             // APP_QUEUE_DRAIN_MS
+#define STACK_BYTES  (128 * 1024)
+#define BOOT_SPREAD_US 60000000LL        // nodes power up over the first minute
+#define DRAIN_MAX_US (6 * 3600 * 1000000LL)
+
+static struct {
+    int      nodes;
+    double   hours;
+    uint32_t seed;
+    uint32_t publish_s;
+    uint32_t rtt_ms;
+    uint32_t flash_sectors;
+    int      log_node;
+    const char *lib;
+} s_opt = {
+    .nodes = 1000, .hours = 6, .seed = 1, .publish_s = 10, .rtt_ms = 60,
+    .flash_sectors = 32, .log_node = -1,
+};
+
+static node_t    *s_nodes;
+static node_t    *s_cur;
+static ucontext_t s_sched_ctx;
+static bool       s_real;                // --server: fleet clock is real time
+static struct timespec s_t0;
+static int64_t    s_now;
+static bool       s_stop, s_publishing = true;
+static uint32_t   s_k_cap;               // committed bitmap size, seconds
+static char       s_tmpdir[64];
+
+// ===== Event queue: binary heap on (t, seq) =====
+typedef struct {
+    int64_t  t;
+    uint64_t seq;
+    void   (*fn)(void *);
+    void    *arg;
+    node_t  *wake;                       // or: wake this node...
+    uint32_t token;                      // ...if it still waits on this token
+    int      reason;
+} ev_t;
+
+static ev_t    *s_heap;
+static size_t   s_nev, s_evcap;
+static uint64_t s_seq;
+
+static bool ev_less(const ev_t *a, const ev_t *b)
+{
+    return a->t != b->t ? a->t < b->t : a->seq < b->seq;
+}
+
+static void ev_push(ev_t e)
+{
+    if (s_nev == s_evcap) {
+        s_evcap = s_evcap ? s_evcap * 2 : 1024;
+        s_heap = realloc(s_heap, s_evcap * sizeof(*s_heap));
+        if (!s_heap) abort();
+    }
+    e.seq = s_seq++;
+    size_t i = s_nev++;
+    while (i > 0 && ev_less(&e, &s_heap[(i - 1) / 2])) {
+        s_heap[i] = s_heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    s_heap[i] = e;
+}
+
+static ev_t ev_pop(void)
+{
+    ev_t top = s_heap[0], last = s_heap[--s_nev];
+    size_t i = 0;
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= s_nev) break;
+        if (c + 1 < s_nev && ev_less(&s_heap[c + 1], &s_heap[c])) c++;
+        if (!ev_less(&s_heap[c], &last)) break;
+        s_heap[i] = s_heap[c];
+        i = c;
+    }
+    if (s_nev > 0) s_heap[i] = last;
+    return top;
+}
+
+// ===== Scheduler =====
+int64_t fleet_now_us(void)
+{
+    if (!s_real) return s_now;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)(ts.tv_sec - s_t0.tv_sec) * 1000000 + (ts.tv_nsec - s_t0.tv_nsec) / 1000;
+}
+
+node_t *fleet_current(void) { return s_cur; }
+node_t *fleet_node(int id) { return &s_nodes[id]; }
+
+void fleet_at(int64_t t_us, void (*fn)(void *), void *arg)
+{
+    ev_push((ev_t){ .t = t_us, .fn = fn, .arg = arg });
+}
+
+void fleet_wake_at(int64_t t_us, node_t *n, uint32_t token, int reason)
+{
+    ev_push((ev_t){ .t = t_us, .wake = n, .token = token, .reason = reason });
+}
+
+uint32_t fleet_token(void) { return s_cur->token; }
+
+static void resume(node_t *n)
+{
+    s_cur = n;
+    swapcontext(&s_sched_ctx, &n->ctx);
+    s_cur = NULL;
+}
+
+int fleet_block(int64_t deadline_us)
+{
+    node_t *n = s_cur;
+    n->blocked = true;
+    if (deadline_us != INT64_MAX) fleet_wake_at(deadline_us, n, n->token, FLEET_TIMEOUT);
+    swapcontext(&n->ctx, &s_sched_ctx);
+    n->blocked = false;
+    n->token++;
+    return n->wake_reason;
+}
+
+void fleet_sleep_us(int64_t us)
+{
+    fleet_block(fleet_now_us() + us);
+}
+
+int fleet_wait_fd(int fd, short events, int64_t deadline_us)
+{
+    node_t *n = s_cur;
+    n->wait_fd = fd;
+    n->wait_events = events;
+    int r = fleet_block(deadline_us);
+    n->wait_fd = -1;
+    return r;
+}
+
+static void dispatch(const ev_t *e)
+{
+    if (e->wake) {
+        node_t *n = e->wake;
+        if (n->blocked && n->token == e->token) {
+            n->wake_reason = e->reason;
+            resume(n);
+        }
+    } else {
+        e->fn(e->arg);
+    }
+}
+
+// Real time only: sleep in poll() on the sockets nodes are blocked on.
+static void poll_nodes(int64_t timeout_us)
+{
+    static struct pollfd *fds;
+    static node_t **who;
+    static int cap;
+    if (cap < s_opt.nodes) {
+        cap = s_opt.nodes;
+        fds = realloc(fds, (size_t)cap * sizeof(*fds));
+        who = realloc(who, (size_t)cap * sizeof(*who));
+    }
+    int n = 0;
+    for (int i = 0; i < s_opt.nodes; ++i) {
+        node_t *nd = &s_nodes[i];
+        if (nd->blocked && nd->wait_fd >= 0) {
+            fds[n] = (struct pollfd){ .fd = nd->wait_fd, .events = nd->wait_events };
+            who[n++] = nd;
+        }
+    }
+    int ms = (int)((timeout_us + 999) / 1000);
+    if (poll(fds, (nfds_t)n, ms) <= 0) return;
+    for (int i = 0; i < n; ++i) {
+        if (fds[i].revents && who[i]->blocked) {
+            who[i]->wake_reason = FLEET_READY;
+            resume(who[i]);
+        }
+    }
+}
+
+static void run(int64_t end_us)
+{
+    s_stop = false;
+    while (!s_stop) {
+        if (s_real) {
+            int64_t now = fleet_now_us();
+            if (now >= end_us) break;
+            if (s_nev == 0 || s_heap[0].t > now) {
+                int64_t next = s_nev && s_heap[0].t < end_us ? s_heap[0].t : end_us;
+                poll_nodes(next - now);
+                continue;
+            }
+        } else if (s_nev == 0 || s_heap[0].t >= end_us) {
+            s_now = end_us;
+            break;
+        }
+        ev_t e = ev_pop();
+        if (!s_real) s_now = e.t;
+        dispatch(&e);
+    }
+}
+
+// ===== Randomness: xorshift64*, repeatable per --seed =====
+static uint64_t s_rng = 88172645463325252ull;
+
+double fleet_rand(void)
+{
+    s_rng ^= s_rng >> 12;
+    s_rng ^= s_rng << 25;
+    s_rng ^= s_rng >> 27;
+    return (double)((s_rng * 2685821657736338717ull) >> 11) / 9007199254740992.0;
+}
+
+double fleet_gauss(void)
+{
+    double u = fleet_rand(), v = fleet_rand();
+    return sqrt(-2.0 * log(u + 1e-300)) * cos(2 * M_PI * v);
+}
+
+// ===== Latency records =====
+void lat_add(lat_rec_t *r, int64_t us)
+{
+    if (r->n == r->cap) {
+        r->cap = r->cap ? r->cap * 2 : 4096;
+        r->v = realloc(r->v, r->cap * sizeof(*r->v));
+        if (!r->v) abort();
+    }
+    r->v[r->n++] = us < 0 ? 0 : us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+void lat_print(const char *name, lat_rec_t *r)
+{
+    if (r->n == 0) {
+        printf("%-13s: none\n", name);
+        return;
+    }
+    qsort(r->v, r->n, sizeof(r->v[0]), cmp_u32);
+#define Q(p) (r->v[(size_t)((r->n - 1) * (p))] / 1000.0)
+    printf("%-13s: %zu, p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, p99.9 %.1f ms, max %.1f ms\n",
+           name, r->n, Q(0.5), Q(0.9), Q(0.99), Q(0.999), r->v[r->n - 1] / 1000.0);
+#undef Q
+}
+
+// ===== What the node library calls =====
+const char *fleet_node_number(void)   { return s_cur ? s_cur->number : "0"; }
+const char *fleet_node_log_path(void) { return s_cur ? s_cur->log_path : "/dev/null"; }
+uint32_t    fleet_node_log_size(void) { return s_opt.flash_sectors * 4096u; }
+
+int64_t esp_timer_get_time(void)
+{
+    int64_t now = fleet_now_us();
+    if (!s_cur) return now;
+    int64_t up = now - s_cur->boot_us;
+    return up + (int64_t)((double)up * s_cur->drift);
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;
+    (void)level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *fmt, ...)
+{
+    (void)tag;
+    if (!s_cur || s_cur->id != s_opt.log_node || level > ESP_LOG_INFO) return;
+    printf("[%8.3f node %d] ", fleet_now_us() / 1e6, s_cur->id);
+    va_list ap;
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK:                   return "ESP_OK";
+    case ESP_FAIL:                 return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:           return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:      return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:    return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:     return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_TIMEOUT:          return "ESP_ERR_TIMEOUT";
+    default:                       return "UNKNOWN ERROR";
+    }
+}
+
+// The health record reads these; the fleet does not model heap or stacks.
+uint32_t esp_get_free_heap_size(void)         { return HOST_HEAP_BYTES; }
+uint32_t esp_get_minimum_free_heap_size(void) { return HOST_HEAP_BYTES; }
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) { (void)task; return 0; }
+
+// NVS: one blob per node, whatever the key (uploader.c keeps only one).
+esp_err_t nvs_open(const char *name_space, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    (void)name_space;
+    (void)mode;
+    *out = 1;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len)
+{
+    (void)h;
+    (void)key;
+    node_t *n = fleet_current();
+    if (!n || n->nvs_len == 0) return ESP_ERR_NVS_NOT_FOUND;
+    if (out) {
+        if (*len < n->nvs_len) return ESP_ERR_INVALID_SIZE;
+        memcpy(out, n->nvs, n->nvs_len);
+    }
+    *len = n->nvs_len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *value, size_t len)
+{
+    (void)h;
+    (void)key;
+    node_t *n = fleet_current();
+    if (!n || len > sizeof(n->nvs)) return ESP_ERR_INVALID_SIZE;
+    memcpy(n->nvs, value, len);
+    n->nvs_len = (uint32_t)len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t h) { (void)h; return ESP_OK; }
+void      nvs_close(nvs_handle_t h)  { (void)h; }
+
+// ===== Nodes =====
+static int64_t local_to_fleet(const node_t *n, int64_t local_us)
+{
+    return n->boot_us + (int64_t)((double)local_us / (1.0 + n->drift));
+}
+
+static uint32_t node_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+// The period the node's firmware publishes with.
+static uint32_t publish_ms(node_t *n)
+{
+    flow_ctl_t f;
+    s_cur = n;
+    n->uploader_get_flow(&f);
+    s_cur = NULL;
+    return f.publish_ms ? f.publish_ms : s_opt.publish_s * 1000;
+}
+
+// One closed window of period_ms: a plausible room, warmer and lit in the
+// daytime.
+static void make_sample(const node_t *n, uint32_t period_ms, sample_t *s)
+{
+    uint32_t t = n->wall0 + n->pub_ms / 1000;
+    float period_s = (float)period_ms / 1000.0f;
+    double hour = fmod(t / 3600.0, 24.0);
+    bool day = hour >= 8 && hour < 20;
+    bool motion = day && fleet_rand() < 0.4;
+    float temp = 20.5f + 0.1f * (float)(n->id % 20) + (day ? 1.5f : 0.0f)
+               + 0.05f * (float)fleet_gauss();
+    float lux = day ? 320.0f + 40.0f * (float)fleet_gauss() : 2.0f;
+    if (lux < 0) lux = 0;
+    int64_t end = n->pub_local_us;
+    sensors_window_t w = {
+        .temp_n = 20, .temp_min = temp - 0.02f, .temp_max = temp + 0.02f,
+        .temp_mean = temp, .temp_var = 0.0002f,
+        .lux_n = 83, .lux_min = lux * 0.97f, .lux_max = lux * 1.03f,
+        .lux_mean = lux, .lux_var = lux * 0.01f,
+        .end_us = end, .motion = motion,
+        .motion_s = motion ? 4.2f : 0.0f,
+        .motion_duty = motion ? 4.2f / period_s : 0.0f,
+        .motion_first_us = motion ? end - 8000000 : -1,
+        .motion_last_us = motion ? end - 1500000 : -1,
+        .motion_edges = motion ? 2 : 0,
+    };
+    sample_pack(s, t, &w);
+}
+
+static char *gunzip(const char *in, size_t len, size_t *out_len)
+{
+    size_t cap = len * 8 + 1024;
+    char *out = malloc(cap);
+    if (!out) return NULL;
+    z_stream z = { 0 };
+    if (inflateInit2(&z, 16 + MAX_WBITS) != Z_OK) { free(out); return NULL; }
+    z.next_in = (Bytef *)in;
+    z.avail_in = (uInt)len;
+    int rc;
+    do {
+        if (z.total_out == cap) {
+            cap *= 2;
+            char *n = realloc(out, cap);
+            if (!n) { inflateEnd(&z); free(out); return NULL; }
+            out = n;
+        }
+        z.next_out = (Bytef *)out + z.total_out;
+        z.avail_out = (uInt)(cap - z.total_out);
+        rc = inflate(&z, Z_NO_FLUSH);
+    } while (rc == Z_OK);
+    *out_len = z.total_out;
+    inflateEnd(&z);
+    if (rc != Z_STREAM_END) { free(out); return NULL; }
+    return out;
+}
+
+// The batch must name this node's room; every {"date":..,"time":..} maps
+// back to its window, by seconds after wall0.
+int fleet_decode(const node_t *n, const char *body, size_t len, const char *content_type,
+                 bool gz, uint32_t *k, int max)
+{
+    if (strcasecmp(content_type, "application/json") != 0) return -1;
+    char *raw = NULL;
+    if (gz) {
+        raw = gunzip(body, len, &len);
+        if (!raw) return -1;
+        body = raw;
+    }
+    const char *end = body + len;
+    char want[32];
+    int wn = snprintf(want, sizeof(want), "\"number\":\"%s\"", n->number);
+    if (len > 0 && !memmem(body, len, want, (size_t)wn)) {
+        free(raw);
+        return -1;
+    }
+
+    int nk = 0;
+    const char *p = body;
+    while (p < end && nk < max) {
+        const char *d = memmem(p, (size_t)(end - p), "\"date\":\"", 8);
+        if (!d) break;
+        struct tm tm = { 0 };
+        if (sscanf(d + 8, "%4d-%2d-%2d\",\"time\":\"%2d:%2d:%2d",
+                   &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                   &tm.tm_hour, &tm.tm_min, &tm.tm_sec) == 6) {
+            tm.tm_year -= 1900;
+            tm.tm_mon  -= 1;
+            uint32_t t = (uint32_t)timegm(&tm);   // sample time is local-as-UTC
+            if (t >= n->wall0) k[nk++] = t - n->wall0;
+        }
+        p = d + 8;
+    }
+    free(raw);
+    return nk;
+}
+
+void fleet_commit(node_t *n, const uint32_t *k, int nk, uint32_t *dups)
+{
+    for (int i = 0; i < nk; ++i) {
+        if (k[i] >= s_k_cap) continue;
+        uint8_t bit = (uint8_t)(1u << (k[i] & 7));
+        if (n->committed[k[i] >> 3] & bit) {
+            (*dups)++;
+        } else {
+            n->committed[k[i] >> 3] |= bit;
+            n->committed_n++;
+        }
+    }
+}
+
+// publisher_task: the period is read after each window, as app_main.c does.
+static void publish(void *arg)
+{
+    node_t *n = arg;
+    if (!s_publishing) return;
+    uint32_t period = publish_ms(n);
+    sample_t s;
+    make_sample(n, period, &s);
+    s_cur = n;
+    if (!n->uploader_add(&s)) n->refused++;
+    s_cur = NULL;
+    n->published++;
+    n->pub_ms += period;
+    n->pub_local_us += (int64_t)period * 1000;
+    fleet_at(local_to_fleet(n, n->pub_local_us), publish, n);
+}
+
+static char s_url[96] = "https://ingest.invalid/sensors/upload";
+
+// sender_task from app_main.c
+static void node_main(void)
+{
+    node_t *n = s_cur;
+    n->uploader_init(s_url);
+    upload_sched_init(&n->sched, NULL, (uint32_t)(fleet_rand() * UINT32_MAX) | 1);
+
+    for (;;) {
+        flow_ctl_t flow;
+        n->uploader_get_flow(&flow);
+        n->sched.cfg.batch_max = flow.batch_max ? flow.batch_max : UPLOADER_MAX_SAMPLES;
+        n->sched.cfg.interval_ms = flow.upload_interval_ms;
+
+        n->uploader_drain_queue();
+        uint32_t wait = upload_sched_due(&n->sched, (uint32_t)n->uploader_count(), node_ms());
+        if (wait > 0) {
+            if (wait > QUEUE_DRAIN_MS) wait = QUEUE_DRAIN_MS;
+            fleet_block(local_to_fleet(n, esp_timer_get_time() + (int64_t)wait * 1000 + TICK_US));
+            continue;
+        }
+        esp_err_t err = n->uploader_send();
+        upload_sched_report(&n->sched, err == ESP_OK, node_ms());
+
+        uploader_stats_t st;
+        n->uploader_get_stats(&st);
+        if (st.retry_after_ms) upload_sched_defer(&n->sched, st.retry_after_ms, node_ms());
+    }
+}
+
+static void boot(void *arg)
+{
+    node_t *n = arg;
+    n->pub_local_us = (int64_t)s_opt.publish_s * 1000000;
+    fleet_at(local_to_fleet(n, n->pub_local_us), publish, n);
+    resume(n);
+}
+
+// A private copy of the library per node. dlopen() shares one load per path
+// and per inode, so each node gets its own memfd with the same bytes; the
+// fds stay open until every copy is loaded, or a reused fd number would
+// name an already loaded copy.
+static void *load_copy(const void *image, size_t len, int *fd_out)
+{
+    int fd = memfd_create("aulasense_node", MFD_CLOEXEC);
+    if (fd < 0) return NULL;
+    const char *p = image;
+    size_t left = len;
+    while (left > 0) {
+        ssize_t w = write(fd, p, left);
+        if (w <= 0) { close(fd); return NULL; }
+        p += w;
+        left -= (size_t)w;
+    }
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    void *h = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!h) {
+        fprintf(stderr, "dlopen: %s\n", dlerror());
+        close(fd);
+        return NULL;
+    }
+    *fd_out = fd;
+    return h;
+}
+
+static void *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    void *buf = n > 0 ? malloc((size_t)n) : NULL;
+    if (buf && fread(buf, 1, (size_t)n, f) != (size_t)n) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    *len = (size_t)n;
+    return buf;
+}
+
+static bool nodes_init(void)
+{
+    size_t len;
+    void *image = read_file(s_opt.lib, &len);
+    if (!image) {
+        fprintf(stderr, "%s: %s\n", s_opt.lib, strerror(errno));
+        return false;
+    }
+    snprintf(s_tmpdir, sizeof(s_tmpdir), "/tmp/fleet_sim.XXXXXX");
+    if (!mkdtemp(s_tmpdir)) return false;
+
+    // Each node keeps its flash file open.
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    s_k_cap = (uint32_t)(s_opt.hours * 3600) + 3600;
+    s_nodes = calloc((size_t)s_opt.nodes, sizeof(*s_nodes));
+    int *fds = calloc((size_t)s_opt.nodes, sizeof(*fds));
+    for (int i = 0; i < s_opt.nodes; ++i) {
+        node_t *n = &s_nodes[i];
+        n->id = i;
+        snprintf(n->number, sizeof(n->number), "%d", 1000 + i);
+        snprintf(n->log_path, sizeof(n->log_path), "%s/%05d.bin", s_tmpdir, i);
+        n->wait_fd = -1;
+
+        n->lib = load_copy(image, len, &fds[i]);
+        if (!n->lib) return false;
+        n->uploader_init      = (void (*)(const char *))dlsym(n->lib, "uploader_init");
+        n->uploader_add       = (bool (*)(const sample_t *))dlsym(n->lib, "uploader_add");
+        n->uploader_send      = (esp_err_t (*)(void))dlsym(n->lib, "uploader_send");
+        n->uploader_count     = (int (*)(void))dlsym(n->lib, "uploader_count");
+        n->uploader_get_stats = (void (*)(uploader_stats_t *))dlsym(n->lib, "uploader_get_stats");
+        n->uploader_get_flow  = (void (*)(flow_ctl_t *))dlsym(n->lib, "uploader_get_flow");
+        n->uploader_drain_queue = (void (*)(void))dlsym(n->lib, "uploader_drain_queue");
+        if (!n->uploader_init || !n->uploader_add || !n->uploader_send ||
+            !n->uploader_count || !n->uploader_get_stats || !n->uploader_get_flow ||
+            !n->uploader_drain_queue) {
+            fprintf(stderr, "%s: missing uploader symbols\n", s_opt.lib);
+            return false;
+        }
+
+        n->boot_us = (int64_t)(fleet_rand() * BOOT_SPREAD_US);
+        n->drift = 40e-6 * fleet_gauss();                       // crystal, ±40 ppm rms
+        n->wall0 = EPOCH + (uint32_t)(n->boot_us / 1000000) + s_opt.publish_s
+                 + (uint32_t)(fleet_rand() * 5);                // SNTP residue, whole seconds
+        n->rtt_us = (uint32_t)(s_opt.rtt_ms * 1000.0 * exp(0.4 * fleet_gauss() - 0.08));
+        n->committed = calloc(s_k_cap / 8 + 1, 1);
+
+        n->stack = mmap(NULL, STACK_BYTES, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if (n->stack == MAP_FAILED) return false;
+        getcontext(&n->ctx);
+        n->ctx.uc_stack.ss_sp = n->stack;
+        n->ctx.uc_stack.ss_size = STACK_BYTES;
+        n->ctx.uc_link = NULL;
+        makecontext(&n->ctx, node_main, 0);
+        fleet_at(n->boot_us, boot, n);
+    }
+    for (int i = 0; i < s_opt.nodes; ++i) close(fds[i]);
+    free(fds);
+    free(image);
+    return true;
+}
+
+static void nodes_cleanup(void)
+{
+    for (int i = 0; i < s_opt.nodes; ++i) unlink(s_nodes[i].log_path);
+    rmdir(s_tmpdir);
+}
+
+// Drain phase: stop once every node's backlog is empty.
+static void drain_check(void *arg)
+{
+    (void)arg;
+    for (int i = 0; i < s_opt.nodes; ++i) {
+        s_cur = &s_nodes[i];
+        int n = s_nodes[i].uploader_count();
+        s_cur = NULL;
+        if (n > 0) {
+            fleet_at(fleet_now_us() + 10000000, drain_check, NULL);
+            return;
+        }
+    }
+    s_stop = true;
+}
+
+// ===== Report =====
+static uint32_t lib_counter(node_t *n, metric_counter_t c)
+{
+    uint32_t (*fn)(metric_counter_t) = (uint32_t (*)(metric_counter_t))dlsym(n->lib, "metrics_counter");
+    return fn ? fn(c) : 0;
+}
+
+static void report(double run_s, double drain_s, double wall_s)
+{
+    fleet_http_stats_t *hs = fleet_http_stats();
+    uint64_t published = 0, committed = 0, pending = 0, refused = 0, wrapped = 0;
+    uint32_t connects = 0, flow_set = 0, paced = 0;
+    for (int i = 0; i < s_opt.nodes; ++i) {
+        node_t *n = &s_nodes[i];
+        flow_ctl_t f;
+        published += n->published;
+        committed += n->committed_n;
+        refused += n->refused;
+        s_cur = n;
+        pending += (uint64_t)n->uploader_count();
+        uploader_stats_t us;
+        n->uploader_get_stats(&us);
+        n->uploader_get_flow(&f);
+        s_cur = NULL;
+        flow_set += f.upload_interval_ms || f.publish_ms || f.batch_max || f.encoding;
+        paced += f.upload_interval_ms != 0;
+        connects += us.connects;
+        wrapped += lib_counter(n, METRIC_C_LOG_DROPPED);
+    }
+    double total_s = run_s + drain_s;
+
+    printf("\n===== fleet: %d nodes, %.1f h + %.1f min drain, %s in %.1f s (%.0fx real time) =====\n",
+           s_opt.nodes, run_s / 3600, drain_s / 60,
+           s_real ? "real sockets" : "server model", wall_s, wall_s > 0 ? total_s / wall_s : 0.0);
+
+    if (!s_real) {
+        fleet_server_stats_t *ss = fleet_server_stats();
+        const fleet_server_cfg_t *c = fleet_server_cfg();
+        printf("server       : %u requests (%.2f/s), %u committed, %u 503 queue full, "
+               "%u 5xx injected, %u resets injected\n",
+               (unsigned)ss->requests, ss->requests / total_s, (unsigned)ss->committed_posts,
+               (unsigned)ss->rejected_503, (unsigned)ss->faults_5xx, (unsigned)ss->resets);
+        printf("throughput   : %.1f samples/s, %.1f kB/s in; %d workers %.0f%% busy, queue peak %u\n",
+               ss->samples_in / total_s, ss->bytes_in / total_s / 1000, c->workers,
+               100.0 * ss->busy_us / (total_s * 1e6 * c->workers), (unsigned)ss->queue_peak);
+        printf("duplicates   : %u samples committed more than once\n", (unsigned)ss->duplicates);
+        if (c->retry_after_s || c->pace_depth || c->directive) {
+            printf("directives   : %u responses with Retry-After, %u asking for a %u s interval\n",
+                   (unsigned)ss->retry_after, (unsigned)ss->paced, (unsigned)c->pace_interval_s);
+        }
+        if (ss->undecoded) printf("               (%u bodies not decoded)\n", (unsigned)ss->undecoded);
+        lat_print("server lat", &ss->latency);
+    }
+    printf("client       : %u POST attempts: %u 2xx, %u 5xx, %u other; %u resets, %u timeouts, "
+           "%u refused, %u stale keep-alive\n",
+           (unsigned)hs->attempts, (unsigned)hs->ok_2xx, (unsigned)hs->status_5xx,
+           (unsigned)hs->status_other, (unsigned)hs->resets, (unsigned)hs->timeouts,
+           (unsigned)hs->refused, (unsigned)hs->stale);
+    printf("connections  : %u handshakes (%.2f per node-hour)\n",
+           (unsigned)connects, connects / (s_opt.nodes * total_s / 3600));
+    printf("node settings: %u nodes hold server-set settings, %u an upload interval\n",
+           (unsigned)flow_set, (unsigned)paced);
+    lat_print("client lat", &hs->latency);
+    printf("amplification: %.3f POSTs per acknowledged batch, %.3f samples sent per sample "
+           "delivered, %.3f bytes sent per byte acknowledged\n",
+           hs->ok_2xx ? (double)hs->attempts / hs->ok_2xx : 0.0,
+           committed ? (double)hs->samples_sent / committed : 0.0,
+           hs->bytes_acked ? (double)hs->bytes_sent / hs->bytes_acked : 0.0);
+    uint64_t missing = published - committed;
+    printf("samples      : %llu published, %llu delivered, %llu missing (%.4f%%): "
+           "%llu still queued, %llu queue full, %llu backlog wrapped\n",
+           (unsigned long long)published, (unsigned long long)committed,
+           (unsigned long long)missing, published ? 100.0 * missing / published : 0.0,
+           (unsigned long long)pending, (unsigned long long)refused, (unsigned long long)wrapped);
+
+    if (s_real) {
+        char buf[2048];
+        if (fleet_http_fetch_stats(buf, sizeof(buf))) printf("ingest stats : %s\n", buf);
+    }
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [--nodes N] [--hours H] [--seed N] [--publish-s S]\n"
+            "          [--rtt-ms N] [--kbps N] [--flash-sectors N]\n"
+            "          [--workers N] [--service-ms N] [--queue N] [--idle-s N]\n"
+            "          [--slow P] [--slow-ms N] [--fail P] [--reset P]\n"
+            "          [--outage FROM_S:SECONDS] [--retry-after S]\n"
+            "          [--pace DEPTH:INTERVAL_S] [--directive JSON]\n"
+            "          [--server HOST:PORT] [--lib PATH] [--log-node N]\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    fleet_server_cfg_t sc = {
+        .workers = 4, .queue_max = 512, .service_us = 25000, .idle_s = 60,
+        .kbps = 2000, .slow_us = 15000000,
+    };
+    char host[64] = "";
+    int port = 0;
+    static char lib[4096];
+
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!v) usage(argv[0]);
+        ++i;
+        if (!strcmp(a, "--nodes"))              s_opt.nodes = atoi(v);
+        else if (!strcmp(a, "--hours"))         s_opt.hours = atof(v);
+        else if (!strcmp(a, "--seed"))          s_opt.seed = (uint32_t)strtoul(v, NULL, 0);
+        else if (!strcmp(a, "--publish-s"))     s_opt.publish_s = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--rtt-ms"))        s_opt.rtt_ms = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--flash-sectors")) s_opt.flash_sectors = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--log-node"))      s_opt.log_node = atoi(v);
+        else if (!strcmp(a, "--lib"))           s_opt.lib = v;
+        else if (!strcmp(a, "--kbps"))          sc.kbps = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--workers"))       sc.workers = atoi(v);
+        else if (!strcmp(a, "--service-ms"))    sc.service_us = (uint32_t)(atof(v) * 1000);
+        else if (!strcmp(a, "--queue"))         sc.queue_max = atoi(v);
+        else if (!strcmp(a, "--idle-s"))        sc.idle_s = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--slow"))          sc.p_slow = atof(v);
+        else if (!strcmp(a, "--slow-ms"))       sc.slow_us = (uint32_t)(atof(v) * 1000);
+        else if (!strcmp(a, "--fail"))          sc.p_fail = atof(v);
+        else if (!strcmp(a, "--reset"))         sc.p_reset = atof(v);
+        else if (!strcmp(a, "--retry-after"))   sc.retry_after_s = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--directive"))     sc.directive = v;
+        else if (!strcmp(a, "--pace")) {
+            if (sscanf(v, "%d:%u", &sc.pace_depth, &sc.pace_interval_s) != 2) usage(argv[0]);
+        }
+        else if (!strcmp(a, "--outage")) {
+            double from, len;
+            if (sscanf(v, "%lf:%lf", &from, &len) != 2) usage(argv[0]);
+            sc.outage_from_us = (int64_t)(from * 1e6);
+            sc.outage_to_us = (int64_t)((from + len) * 1e6);
+        } else if (!strcmp(a, "--server")) {
+            if (sscanf(v, "%63[^:]:%d", host, &port) != 2) usage(argv[0]);
+        } else usage(argv[0]);
+    }
+    if (s_opt.nodes < 1 || s_opt.publish_s < 1 || s_opt.flash_sectors < 2 || sc.workers < 1) {
+        usage(argv[0]);
+    }
+    if (!s_opt.lib) {
+        // Next to this executable
+        ssize_t n = readlink("/proc/self/exe", lib, sizeof(lib) - 32);
+        if (n <= 0) return 1;
+        lib[n] = '\0';
+        char *slash = strrchr(lib, '/');
+        strcpy(slash ? slash + 1 : lib, "libaulasense_node.so");
+        s_opt.lib = lib;
+    }
+
+    s_rng ^= (uint64_t)s_opt.seed * 0x9E3779B97F4A7C15ull;
+    fleet_server_init(&sc);
+    if (host[0]) {
+        s_real = true;
+        fleet_http_set_server(host, port);
+        snprintf(s_url, sizeof(s_url), "http://%s:%d/sensors/upload", host, port);
+    }
+    if (!nodes_init()) return 1;
+
+    printf("fleet: %d nodes x %s, publish %u s, rtt %u ms, flash %u sectors\n",
+           s_opt.nodes, s_opt.lib, (unsigned)s_opt.publish_s, (unsigned)s_opt.rtt_ms,
+           (unsigned)s_opt.flash_sectors);
+    if (!s_real) {
+        printf("server model: %d workers x %.0f ms, queue %d, idle %u s, uplink %u kbit/s; "
+               "faults slow %.3f (+%.0f s), 5xx %.3f, reset %.3f\n",
+               sc.workers, sc.service_us / 1000.0, sc.queue_max, (unsigned)sc.idle_s,
+               (unsigned)sc.kbps, sc.p_slow, sc.slow_us / 1e6, sc.p_fail, sc.p_reset);
+        if (sc.retry_after_s || sc.pace_depth || sc.directive) {
+            printf("directives  : Retry-After %u s on 503; pacing %u s interval from queue %d; body %s\n",
+                   (unsigned)sc.retry_after_s, (unsigned)sc.pace_interval_s, sc.pace_depth,
+                   sc.directive ? sc.directive : "-");
+        }
+    }
+    fflush(stdout);
+
+    struct timespec w0, w1;
+    clock_gettime(CLOCK_MONOTONIC, &w0);
+    s_t0 = w0;
+
+    int64_t end_us = (int64_t)(s_opt.hours * 3600e6);
+    run(end_us);
+
+    // Drain: no new samples, no more faults.
+    s_publishing = false;
+    fleet_server_cfg_t *live = fleet_server_cfg();
+    live->p_slow = live->p_fail = live->p_reset = 0;
+    live->outage_from_us = live->outage_to_us = 0;
+    int64_t drain_from = fleet_now_us();
+    fleet_at(drain_from, drain_check, NULL);
+    run(drain_from + (s_real ? 120000000LL : DRAIN_MAX_US));
+    double drain_s = (fleet_now_us() - drain_from) / 1e6;
+
+    clock_gettime(CLOCK_MONOTONIC, &w1);
+    report(end_us / 1e6, drain_s, (double)(w1.tv_sec - w0.tv_sec) + (w1.tv_nsec - w0.tv_nsec) / 1e9);
+    nodes_cleanup();
+    fflush(stdout);
+    _exit(0);   // nodes are parked mid-loop on their own stacks
+}
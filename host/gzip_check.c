@@ -0,0 +1,243 @@
+// host/gzip_check.c — gzip_stream: ratio, cost, memory, and a zlib round trip
+//
+//   ./gzip_check
+//
+// Compresses the bodies the uploader gzips (JSON and CBOR batches of a
+// synthetic but plausible classroom: 10 s windows, slowly drifting temperature
+// and light, motion in bursts) plus incompressible bytes, and checks that
+// zlib's gzip decoder (what Python's gzip.decompress uses) gives every input
+// back. Reports the ratio against zlib -9, the CPU time per KB of input, and
+// the memory a compression takes: the state struct plus the peak stack of a
+// thread whose painted stack runs one. Exit status is the number of failures.
+#include "gzip_stream.h"
+#include "payload_cbor.h"
+#include "payload_json.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+
+#ifndef PAYLOAD_JSON_CHUNK
+#define PAYLOAD_JSON_CHUNK 1024
+#endif
+
+#define BODY_MAX  (256 * 1024)
+#define STACK_LEN (64 * 1024)
+#define PAINT     0xA5
+
+static int s_fail;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL     : %s\n", what);
+        s_fail++;
+    }
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    char   buf[BODY_MAX];
+    size_t len;
+} body_t;
+
+static esp_err_t collect(void *ctx, const char *data, size_t len)
+{
+    body_t *b = ctx;
+    if (b->len + len > sizeof(b->buf)) return ESP_ERR_NO_MEM;
+    memcpy(b->buf + b->len, data, len);
+    b->len += len;
+    return ESP_OK;
+}
+
+// n windows from 09:00 on a school day; every 40th record a room state event.
+static void classroom(sample_t *s, int n)
+{
+    struct tm tm = { .tm_year = 124, .tm_mon = 2, .tm_mday = 12, .tm_hour = 9 };
+    uint32_t t = sample_wall_seconds(&tm);
+    int temp = 2180, lux = 4300;
+    srand(7);
+    for (int i = 0; i < n; ++i, t += 10) {
+        memset(&s[i], 0, sizeof(s[i]));
+        s[i].t = t;
+        if (i % 40 == 39) {
+            s[i].flags = SAMPLE_F_EVENT;
+            s[i].ev_state = (uint8_t)(i / 40 % 3);
+            s[i].ev_prev = (uint8_t)((i / 40 + 2) % 3);
+            s[i].ev_prev_s = 400;
+            continue;
+        }
+        temp += rand() % 5 - 2;
+        lux += rand() % 41 - 20;
+        bool busy = (i / 12) % 3 != 2;
+        s[i].temp = (int16_t)temp;
+        s[i].temp_min = (int16_t)(temp - rand() % 4);
+        s[i].temp_max = (int16_t)(temp + rand() % 4);
+        s[i].temp_var = (uint16_t)(rand() % 6);
+        s[i].lux = (uint32_t)lux;
+        s[i].lux_min = (uint32_t)(lux - rand() % 30);
+        s[i].lux_max = (uint32_t)(lux + rand() % 30);
+        s[i].lux_var = (uint32_t)(rand() % 200);
+        if (busy) {
+            s[i].flags = SAMPLE_F_MOTION;
+            s[i].motion_edges = (uint8_t)(1 + rand() % 4);
+            s[i].motion_ds = (uint16_t)(20 + rand() % 80);
+            s[i].motion_duty = (uint16_t)(s[i].motion_ds * 10);
+            s[i].motion_first = (uint16_t)(50 + rand() % 50);
+            s[i].motion_last = (uint16_t)(rand() % 50);
+        } else {
+            s[i].motion_first = s[i].motion_last = SAMPLE_MOTION_NONE;
+        }
+    }
+}
+
+// ----- compression of one body, on a painted stack -----
+typedef struct {
+    const body_t *in;
+    body_t       *out;
+    int           reps;
+    double        secs;
+} job_t;
+
+static gzip_stream_t s_gz;
+
+static void *compress_job(void *arg)
+{
+    job_t *j = arg;
+    double t0 = now_s();
+    for (int r = 0; r < j->reps; ++r) {
+        j->out->len = 0;
+        gzip_stream_begin(&s_gz, collect, j->out);
+        // In the uploader's pieces: the encoders write PAYLOAD_JSON_CHUNK at most.
+        for (size_t at = 0; at < j->in->len; at += PAYLOAD_JSON_CHUNK) {
+            size_t n = j->in->len - at < PAYLOAD_JSON_CHUNK ? j->in->len - at : PAYLOAD_JSON_CHUNK;
+            gzip_stream_sink(&s_gz, j->in->buf + at, n);
+        }
+        if (gzip_stream_finish(&s_gz) != ESP_OK) j->out->len = 0;
+    }
+    j->secs = now_s() - t0;
+    return NULL;
+}
+
+// Runs the job on a fresh painted stack; returns the bytes of it used.
+static size_t run_painted(job_t *j)
+{
+    static uint8_t stack[STACK_LEN] __attribute__((aligned(64)));
+    memset(stack, PAINT, sizeof(stack));
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, sizeof(stack));
+    pthread_t th;
+    if (pthread_create(&th, &attr, compress_job, j) != 0) return 0;
+    pthread_join(th, NULL);
+    pthread_attr_destroy(&attr);
+    size_t untouched = 0;
+    while (untouched < sizeof(stack) && stack[untouched] == PAINT) ++untouched;
+    return sizeof(stack) - untouched;
+}
+
+// The job's thread with an empty body: what pthread and the job itself take.
+static size_t stack_base(void)
+{
+    static body_t in, out;
+    job_t j = { &in, &out, 0, 0 };
+    return run_painted(&j);
+}
+
+static bool gunzip_equal(const body_t *gz, const body_t *want)
+{
+    static body_t got;
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) return false;
+    zs.next_in = (Bytef *)gz->buf;
+    zs.avail_in = (uInt)gz->len;
+    zs.next_out = (Bytef *)got.buf;
+    zs.avail_out = sizeof(got.buf);
+    int rc = inflate(&zs, Z_FINISH);
+    got.len = zs.total_out;
+    bool whole = zs.avail_in == 0;
+    inflateEnd(&zs);
+    return rc == Z_STREAM_END && whole && got.len == want->len &&
+           memcmp(got.buf, want->buf, got.len) == 0;
+}
+
+static size_t zlib9_size(const body_t *in)
+{
+    static body_t out;
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, 9, Z_DEFLATED, 16 + MAX_WBITS, 9, Z_DEFAULT_STRATEGY) != Z_OK) return 0;
+    zs.next_in = (Bytef *)in->buf;
+    zs.avail_in = (uInt)in->len;
+    zs.next_out = (Bytef *)out.buf;
+    zs.avail_out = sizeof(out.buf);
+    int rc = deflate(&zs, Z_FINISH);
+    size_t n = zs.total_out;
+    deflateEnd(&zs);
+    return rc == Z_STREAM_END ? n : 0;
+}
+
+// Compresses, round-trips and times one body; returns its ratio.
+static double measure(const char *name, const body_t *in, size_t base)
+{
+    static body_t out;
+    job_t j = { in, &out, 1, 0 };
+    size_t stack = run_painted(&j);
+    bool ok = out.len > 0 && gunzip_equal(&out, in);
+    char what[96];
+    snprintf(what, sizeof(what), "%s: zlib gives back the input", name);
+    check(ok, what);
+
+    j.reps = (int)(4000000 / (in->len + 1)) + 1;
+    run_painted(&j);
+    size_t z9 = zlib9_size(in);
+    double ratio = out.len ? (double)in->len / out.len : 0.0;
+    printf("%-9s: %6zu B -> %5zu B, ratio %.2f (zlib -9: %.2f), %5.1f us/KB, stack %zu B%s\n",
+           name, in->len, out.len, ratio, z9 ? (double)in->len / z9 : 0.0,
+           j.secs / j.reps / (in->len / 1024.0) * 1e6, stack > base ? stack - base : 0,
+           ok ? "" : " MISMATCH");
+    return ratio;
+}
+
+int main(void)
+{
+    static sample_t s[4 * UPLOADER_MAX_SAMPLES];
+    static body_t json50, json200, cbor50, noise;
+    device_id_t id;
+    device_id_get(&id);
+    classroom(s, 4 * UPLOADER_MAX_SAMPLES);
+
+    check(payload_json_write(&id, s, UPLOADER_MAX_SAMPLES, collect, &json50) == ESP_OK, "json 50");
+    check(payload_json_write(&id, s, 4 * UPLOADER_MAX_SAMPLES, collect, &json200) == ESP_OK,
+          "json 200");
+    check(payload_cbor_write(&id, s, UPLOADER_MAX_SAMPLES, collect, &cbor50) == ESP_OK, "cbor 50");
+    srand(3);
+    noise.len = 8192;
+    for (size_t i = 0; i < noise.len; ++i) noise.buf[i] = (char)rand();
+
+    size_t base = stack_base();
+    printf("state    : %zu B (gzip_stream_t, %d B window), no heap\n",
+           sizeof(gzip_stream_t), GZIP_STREAM_WINDOW);
+    double r50 = measure("json 50", &json50, base);
+    measure("json 200", &json200, base);
+    measure("cbor 50", &cbor50, base);
+    double rn = measure("random", &noise, base);
+
+    // What the uploader relies on: a big win on JSON, and noise not shrinking
+    // (it then sends the body raw).
+    check(r50 >= 4.0, "a 50-sample JSON batch compresses at least 4x");
+    check(rn < 1.0, "random bytes do not compress");
+
+    printf("%s\n", s_fail ? "FAIL" : "OK");
+    return s_fail;
+}
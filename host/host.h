@@ -0,0 +1,151 @@
+// host/host.h — hooks between the host build's mocks and its driver program
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ===== Virtual clock and scheduler (host_rtos.c) =====
+// Tasks are pthreads, but only one holds the CPU at a time. Virtual time
+// advances only when every task is blocked, so the firmware runs as fast as
+// the host can execute it and the run is repeatable.
+
+int64_t host_now_us(void);
+void    host_set_epoch(int64_t unix_s);   // wall clock at virtual time 0
+
+// Block the calling task for us of virtual time without holding the CPU
+// (bus transfers, network round trips). Other tasks run meanwhile.
+void    host_block_us(int64_t us);
+
+// Compute for us of virtual time (a TLS handshake): the calling task holds a
+// core, its own or a free one, and delays the tasks that need it by their
+// priority (see host_rtos.c).
+void    host_cpu_us(int64_t us);
+
+// One-shot callback at virtual time t_us, run between tasks like an ISR.
+void    host_at(int64_t t_us, void (*fn)(void *), void *arg);
+
+// Run the created tasks until virtual time reaches until_us.
+void    host_rtos_run(int64_t until_us);
+
+typedef struct {
+    const char *name;
+    uint64_t    cpu_ns;      // host thread CPU time spent in the task
+    uint32_t    switches;    // times the task was given the CPU
+    uint32_t    stack_depth; // bytes requested at creation
+    uint32_t    stack_used;  // peak bytes used (painted host stack)
+    unsigned    prio;
+    int         core;        // -1: any
+} host_task_info_t;
+
+int     host_rtos_tasks(host_task_info_t *out, int max);
+
+// ===== Scripted sensors (host_sensors.c) =====
+// Script: one "t_s temp_c lux pir" line per point, '#' comments. temp/lux are
+// interpolated linearly, pir holds its value until the next point. The last
+// point holds forever. NULL selects a built-in synthetic day, laid out on the
+// local wall clock that starts at epoch_s.
+esp_err_t host_sensors_load(const char *path, int64_t epoch_s);
+
+// Sampler loop jitter: BH1750 read-to-read interval minus its period, as
+// upper bounds of 100 µs bins.
+typedef struct {
+    uint32_t count;
+    uint32_t p50_us, p90_us, p99_us, p999_us, max_us;
+} host_jitter_t;
+
+void host_sensors_jitter(host_jitter_t *out);
+
+typedef struct {
+    uint32_t xfers;     // driver transactions
+    uint32_t nacks;     // transactions to an absent address
+    uint32_t timeouts;  // transactions that hit a hung bus
+    uint32_t resets;    // i2c_master_bus_reset calls
+    uint32_t bytes;     // bytes on the bus, address bytes included
+} host_i2c_stats_t;
+
+void host_i2c_get_stats(host_i2c_stats_t *out);
+
+// Probability that a transaction finds the bus hung (SDA held low); it stays
+// hung, and every transaction times out, until the next bus reset.
+void host_i2c_set_fault_rate(double p);
+
+// The next n i2c_new_master_bus() calls fail (ESP_FAIL), as a bus whose
+// pins are held low at power-up would.
+void host_i2c_fail_bus_init(int n);
+
+// ===== HTTP shim (host_http.c) =====
+// Every request goes to host:port regardless of the URL's scheme and host;
+// the URL path is kept. rtt_ms of virtual time is spent per request.
+void host_http_set_target(const char *host, int port, uint32_t rtt_ms);
+
+// CPU time the TLS handshake costs the connecting task on every new
+// connection (host_cpu_us()). 0, the default, leaves it out. With real TLS,
+// only full handshakes are charged.
+void host_http_set_tls_cpu(uint32_t ms);
+
+// Speak real TLS (OpenSSL) for https URLs, e.g. to host/ingest_server.py
+// --tls-port, with the TLS session kept across reconnects when the client
+// config asks for it (save_client_session). The certificate is not checked.
+// ESP_ERR_NOT_SUPPORTED if this host build has no OpenSSL.
+esp_err_t host_http_set_tls(bool on);
+
+// TLS handshakes so far, how many of them resumed a saved session, and how
+// many had only a session past its lifetime to offer.
+void host_http_tls_get(uint32_t *handshakes, uint32_t *resumed, uint32_t *expired);
+
+// Called by the shim after every complete response (and by the MQTT shim
+// for every acknowledged QoS1 publish, status 200).
+void host_on_upload(const char *body, size_t len, const char *content_type,
+                    bool gzip, int status);
+
+// ===== esp-mqtt shim (host_mqtt.c) =====
+// Every client connects to host:port, whatever the broker URI says. The
+// answer to every packet is delivered rtt_ms later; connecting takes two
+// round trips (TCP, then CONNECT/CONNACK).
+void host_mqtt_set_target(const char *host, int port, uint32_t rtt_ms);
+
+// ===== Misc (host_stubs.c) =====
+// NVS lives in this file, next to the flash backlog (SAMPLE_LOG_HOST_FILE);
+// host/CMakeLists.txt puts both in the build dir.
+#ifndef HOST_NVS_FILE
+#define HOST_NVS_FILE "/tmp/aulasense-nvs.bin"
+#endif
+
+void host_log_set_level(esp_log_level_t level);
+
+// Application bytes the network shims sent and received: HTTP requests and
+// responses or MQTT packets, headers and framing included; TCP/IP and TLS
+// overhead are not.
+void host_wire_count(size_t out, size_t in);
+void host_wire_get(uint64_t *out, uint64_t *in);
+
+// SNTP: the wall clock reads seconds since boot (unix 0 at virtual time 0)
+// until sync_s, when sntp_init() has been called; then it jumps to unix_s +
+// virtual time and the sync notification fires. sync_s 0: already set at boot.
+void host_sntp_set(int64_t unix_s, double sync_s);
+
+// Wi-Fi: the station gets its IP ip_s after wifi_init_*() (at boot).
+void host_wifi_set(double ip_s);
+
+// Console UART model: esp_log_write() lines at INFO and above block their
+// task for the transmit time at this rate (0 = free). host_uart_write() is
+// the same for raw bytes.
+void host_uart_set_baud(uint32_t baud);
+void host_uart_write(size_t len);
+void host_uart_get_stats(uint64_t *bytes, int64_t *busy_us);
+void host_random_seed(uint32_t seed);
+void host_heap_get(size_t *in_use, size_t *peak, uint32_t *allocs);
+// Allocations the host itself makes (scripts, checking uploads) between
+// host_heap_untracked(true) and (false) stay out of the heap figures and
+// alloc_trace. Per thread, nestable.
+void host_heap_untracked(bool on);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,519 @@
+// host/host_http.c — esp_http_client over plain HTTP/1.1 sockets
+//
+// Implements the streaming subset uploader.c uses (open/write/fetch_headers/
+// flush_response) with keep-alive and the same event callbacks, so the
+// uploader's connection reuse and retry paths run unmodified. TLS settings
+// are accepted and ignored, apart from the handshake's CPU time for https
+// URLs (host_http_set_tls_cpu()), unless host_http_set_tls() turns on real
+// TLS: then https goes through OpenSSL, and save_client_session keeps the
+// session in the handle for the next connection, as esp-tls does. Every
+// request goes to the host_http_set_target() server. The request body is
+// kept so host_on_upload() can inspect it.
+//
+// Headers are heap copies, as in esp_http_client's http_header.c: a new
+// header costs three allocations (item, key, value), a new value one, and
+// every request formats Content-Length into the list. The firmware's heap
+// figures and alloc_trace therefore see what the real client allocates.
+#include "host.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifdef HOST_HAVE_OPENSSL
+#include <openssl/ssl.h>
+#include <signal.h>
+#endif
+
+#define MAX_HEADERS 8
+
+typedef struct {
+    char *key;
+    char *value;
+} header_t;
+
+struct esp_http_client {
+    char                 path[256];
+    bool                 tls;          // https URL
+    bool                 save_session;
+#ifdef HOST_HAVE_OPENSSL
+    SSL                 *ssl;          // real TLS only
+    SSL_SESSION         *session;      // kept across connections
+#endif
+    int                  timeout_ms;
+    http_event_handle_cb handler;
+    void                *user_data;
+    header_t            *hdr[MAX_HEADERS];
+    int                  fd;
+    int                  status;
+    int64_t              content_length;
+    int64_t              remaining;
+    bool                 resp_close;
+    char                 rbuf[4096];
+    size_t               rlen, rpos;
+    char                *body;
+    size_t               body_len, body_cap;
+};
+
+static char     s_host[64] = "127.0.0.1";
+static int      s_port = 8080;
+static uint32_t s_rtt_ms = 0;
+static uint32_t s_tls_cpu_ms = 0;
+static bool     s_tls_real = false;
+static uint32_t s_tls_handshakes, s_tls_resumed, s_tls_expired;
+
+void host_http_set_target(const char *host, int port, uint32_t rtt_ms)
+{
+    snprintf(s_host, sizeof(s_host), "%s", host);
+    s_port = port;
+    s_rtt_ms = rtt_ms;
+}
+
+void host_http_set_tls_cpu(uint32_t ms)
+{
+    s_tls_cpu_ms = ms;
+}
+
+esp_err_t host_http_set_tls(bool on)
+{
+#ifdef HOST_HAVE_OPENSSL
+    s_tls_real = on;
+    if (on) signal(SIGPIPE, SIG_IGN);   // SSL_write() on a reset connection
+    return ESP_OK;
+#else
+    s_tls_real = false;
+    return on ? ESP_ERR_NOT_SUPPORTED : ESP_OK;
+#endif
+}
+
+void host_http_tls_get(uint32_t *handshakes, uint32_t *resumed, uint32_t *expired)
+{
+    *handshakes = s_tls_handshakes;
+    *resumed = s_tls_resumed;
+    *expired = s_tls_expired;
+}
+
+esp_err_t esp_crt_bundle_attach(void *conf)
+{
+    (void)conf;
+    return ESP_OK;
+}
+
+static void emit(esp_http_client_handle_t h, esp_http_client_event_id_t id,
+                 char *key, char *value)
+{
+    if (!h->handler) return;
+    esp_http_client_event_t evt = {
+        .event_id = id, .client = h, .user_data = h->user_data,
+        .header_key = key, .header_value = value,
+    };
+    h->handler(&evt);
+}
+
+// ----- real TLS (host_http_set_tls) -----
+// OpenSSL's allocations are the host's, not mbedTLS's: kept out of the
+// firmware's heap figures.
+#ifdef HOST_HAVE_OPENSSL
+static SSL_CTX *tls_ctx(void)
+{
+    static SSL_CTX *ctx;
+    if (!ctx) {
+        ctx = SSL_CTX_new(TLS_client_method());
+        if (ctx) SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, NULL);   // throwaway certs
+    }
+    return ctx;
+}
+
+// Keeps a copy of the latest resumable session after each response (TLS 1.3
+// tickets arrive after the handshake). A copy, because OpenSSL marks the
+// connection's own session unusable if the connection later fails; esp-tls
+// keeps what it saved.
+static void tls_save_session(esp_http_client_handle_t h)
+{
+    if (!h->ssl || !h->save_session) return;
+    SSL_SESSION *s = SSL_get1_session(h->ssl);
+    if (s && SSL_SESSION_is_resumable(s)) {
+        SSL_SESSION_free(h->session);
+        h->session = SSL_SESSION_dup(s);
+    }
+    SSL_SESSION_free(s);
+}
+
+static bool tls_connect(esp_http_client_handle_t h)
+{
+    host_heap_untracked(true);
+    SSL_CTX *ctx = tls_ctx();
+    h->ssl = ctx ? SSL_new(ctx) : NULL;
+    bool ok = h->ssl && SSL_set_fd(h->ssl, h->fd) == 1;
+    if (ok && h->save_session && h->session) {
+        // Past its lifetime (on the virtual clock, like time()), a ticket is
+        // not offered: that reconnect is a full handshake whatever the client.
+        SSL_SESSION *s = h->session;
+        if (time(NULL) >= SSL_SESSION_get_time(s) + SSL_SESSION_get_timeout(s)) s_tls_expired++;
+        SSL_set_session(h->ssl, s);
+    }
+    ok = ok && SSL_connect(h->ssl) == 1;
+    if (ok) {
+        s_tls_handshakes++;
+        if (SSL_session_reused(h->ssl)) s_tls_resumed++;
+        else if (s_tls_cpu_ms) host_cpu_us((int64_t)s_tls_cpu_ms * 1000);
+    } else {
+        SSL_free(h->ssl);
+        h->ssl = NULL;
+    }
+    host_heap_untracked(false);
+    return ok;
+}
+
+static void tls_close(esp_http_client_handle_t h)
+{
+    if (!h->ssl) return;
+    host_heap_untracked(true);
+    SSL_free(h->ssl);
+    h->ssl = NULL;
+    host_heap_untracked(false);
+}
+#endif
+
+static void disconnect(esp_http_client_handle_t h)
+{
+    if (h->fd < 0) return;
+#ifdef HOST_HAVE_OPENSSL
+    tls_close(h);
+#endif
+    close(h->fd);
+    h->fd = -1;
+    h->rlen = h->rpos = 0;
+    emit(h, HTTP_EVENT_DISCONNECTED, NULL, NULL);
+}
+
+static esp_err_t connect_target(esp_http_client_handle_t h)
+{
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM }, *ai;
+    char port[8];
+    snprintf(port, sizeof(port), "%d", s_port);
+    if (getaddrinfo(s_host, port, &hints, &ai) != 0) return ESP_FAIL;
+
+    int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) { freeaddrinfo(ai); return ESP_FAIL; }
+    struct timeval tv = { .tv_sec = h->timeout_ms / 1000, .tv_usec = (h->timeout_ms % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    int rc = connect(fd, ai->ai_addr, ai->ai_addrlen);
+    freeaddrinfo(ai);
+    if (rc != 0) { close(fd); return ESP_FAIL; }
+
+    h->fd = fd;
+    h->rlen = h->rpos = 0;
+    host_block_us((int64_t)s_rtt_ms * 1000);   // TCP handshake
+    bool real_tls = false;
+#ifdef HOST_HAVE_OPENSSL
+    real_tls = h->tls && s_tls_real;
+    if (real_tls) {
+        host_block_us((int64_t)s_rtt_ms * 1000);   // ClientHello .. Finished
+        if (!tls_connect(h)) {                     // charges a full handshake
+            close(fd);
+            h->fd = -1;
+            return ESP_FAIL;
+        }
+    }
+#endif
+    if (h->tls && !real_tls && s_tls_cpu_ms) host_cpu_us((int64_t)s_tls_cpu_ms * 1000);
+    emit(h, HTTP_EVENT_ON_CONNECTED, NULL, NULL);
+    return ESP_OK;
+}
+
+static ssize_t conn_send(esp_http_client_handle_t h, const char *p, size_t len)
+{
+#ifdef HOST_HAVE_OPENSSL
+    if (h->ssl) {
+        host_heap_untracked(true);
+        int n = SSL_write(h->ssl, p, (int)len);
+        host_heap_untracked(false);
+        return n;
+    }
+#endif
+    return send(h->fd, p, len, MSG_NOSIGNAL);
+}
+
+static ssize_t conn_recv(esp_http_client_handle_t h, char *p, size_t len)
+{
+#ifdef HOST_HAVE_OPENSSL
+    if (h->ssl) {
+        host_heap_untracked(true);
+        int n = SSL_read(h->ssl, p, (int)len);
+        host_heap_untracked(false);
+        return n;
+    }
+#endif
+    return recv(h->fd, p, len, 0);
+}
+
+static bool send_all(esp_http_client_handle_t h, const char *p, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = conn_send(h, p, len);
+        if (n <= 0) return false;
+        host_wire_count((size_t)n, 0);
+        p += n; len -= (size_t)n;
+    }
+    return true;
+}
+
+// Next byte of the response, or -1 on EOF/timeout.
+static int read_byte(esp_http_client_handle_t h)
+{
+    if (h->rpos == h->rlen) {
+        ssize_t n = conn_recv(h, h->rbuf, sizeof(h->rbuf));
+        if (n <= 0) return -1;
+        host_wire_count(0, (size_t)n);
+        h->rlen = (size_t)n;
+        h->rpos = 0;
+    }
+    return (unsigned char)h->rbuf[h->rpos++];
+}
+
+static int read_line(esp_http_client_handle_t h, char *out, size_t cap)
+{
+    size_t n = 0;
+    for (;;) {
+        int c = read_byte(h);
+        if (c < 0) return -1;
+        if (c == '\n') break;
+        if (c != '\r' && n + 1 < cap) out[n++] = (char)c;
+    }
+    out[n] = '\0';
+    return (int)n;
+}
+
+static char *copy_str(const char *s)
+{
+    size_t n = strlen(s) + 1;
+    char *p = malloc(n);
+    if (p) memcpy(p, s, n);
+    return p;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t h, const char *key, const char *value)
+{
+    header_t **slot = NULL;
+    for (int i = 0; i < MAX_HEADERS; ++i) {
+        if (!h->hdr[i]) {
+            if (!slot) slot = &h->hdr[i];
+        } else if (strcasecmp(h->hdr[i]->key, key) == 0) {
+            char *v = copy_str(value);
+            if (!v) return ESP_ERR_NO_MEM;
+            free(h->hdr[i]->value);
+            h->hdr[i]->value = v;
+            return ESP_OK;
+        }
+    }
+    if (!slot) return ESP_ERR_NO_MEM;
+    header_t *item = calloc(1, sizeof(*item));
+    if (!item) return ESP_ERR_NO_MEM;
+    item->key = copy_str(key);
+    item->value = copy_str(value);
+    *slot = item;
+    return item->key && item->value ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t h, const char *key)
+{
+    for (int i = 0; i < MAX_HEADERS; ++i) {
+        if (h->hdr[i] && strcasecmp(h->hdr[i]->key, key) == 0) {
+            free(h->hdr[i]->key);
+            free(h->hdr[i]->value);
+            free(h->hdr[i]);
+            h->hdr[i] = NULL;
+        }
+    }
+    return ESP_OK;
+}
+
+static const char *header(esp_http_client_handle_t h, const char *key)
+{
+    for (int i = 0; i < MAX_HEADERS; ++i) {
+        if (h->hdr[i] && strcasecmp(h->hdr[i]->key, key) == 0) return h->hdr[i]->value;
+    }
+    return NULL;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *cfg)
+{
+    esp_http_client_handle_t h = calloc(1, sizeof(*h));
+    if (!h) return NULL;
+    h->fd = -1;
+    h->timeout_ms = cfg->timeout_ms > 0 ? cfg->timeout_ms : 5000;
+    h->handler = cfg->event_handler;
+    h->user_data = cfg->user_data;
+
+    h->tls = cfg->url && !strncmp(cfg->url, "https:", 6);
+    h->save_session = cfg->save_client_session;
+    const char *p = cfg->url ? strstr(cfg->url, "://") : NULL;
+    p = p ? strchr(p + 3, '/') : NULL;
+    snprintf(h->path, sizeof(h->path), "%s", p ? p : "/");
+
+    char host[80];
+    snprintf(host, sizeof(host), "%s:%d", s_host, s_port);
+    esp_http_client_set_header(h, "User-Agent", "ESP32 HTTP Client/1.0");
+    esp_http_client_set_header(h, "Host", host);
+    return h;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t h, int write_len)
+{
+    if (h->fd < 0 && connect_target(h) != ESP_OK) return ESP_FAIL;
+
+    // As http_header_set_format() does: a formatted copy, then into the list.
+    char *len = malloc(12);
+    if (!len) return ESP_ERR_NO_MEM;
+    snprintf(len, 12, "%d", write_len);
+    esp_err_t err = esp_http_client_set_header(h, "Content-Length", len);
+    free(len);
+    if (err != ESP_OK) return err;
+
+    char req[1024];
+    int n = snprintf(req, sizeof(req), "POST %s HTTP/1.1\r\n", h->path);
+    for (int i = 0; i < MAX_HEADERS; ++i) {
+        if (h->hdr[i]) {
+            n += snprintf(req + n, sizeof(req) - (size_t)n, "%s: %s\r\n", h->hdr[i]->key, h->hdr[i]->value);
+        }
+    }
+    n += snprintf(req + n, sizeof(req) - (size_t)n, "\r\n");
+    if (!send_all(h, req, (size_t)n)) {
+        disconnect(h);
+        return ESP_FAIL;
+    }
+    h->body_len = 0;
+    h->status = 0;
+    return ESP_OK;
+}
+
+int esp_http_client_write(esp_http_client_handle_t h, const char *buf, int len)
+{
+    if (h->fd < 0 || !send_all(h, buf, (size_t)len)) return -1;
+    if (h->body_len + (size_t)len > h->body_cap) {
+        size_t cap = h->body_cap ? h->body_cap : 4096;
+        while (cap < h->body_len + (size_t)len) cap *= 2;
+        host_heap_untracked(true);   // the host's copy, not the client's
+        char *nb = realloc(h->body, cap);
+        host_heap_untracked(false);
+        if (!nb) return -1;
+        h->body = nb;
+        h->body_cap = cap;
+    }
+    memcpy(h->body + h->body_len, buf, (size_t)len);
+    h->body_len += (size_t)len;
+    return len;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t h)
+{
+    if (h->fd < 0) return -1;
+    host_block_us((int64_t)s_rtt_ms * 1000);   // request out, response back
+
+    char line[512];
+    if (read_line(h, line, sizeof(line)) < 0 || sscanf(line, "HTTP/%*d.%*d %d", &h->status) != 1) {
+        disconnect(h);
+        return -1;
+    }
+    h->content_length = 0;
+    h->resp_close = false;
+    for (;;) {
+        int n = read_line(h, line, sizeof(line));
+        if (n < 0) { disconnect(h); return -1; }
+        if (n == 0) break;
+        char *colon = strchr(line, ':');
+        if (!colon) continue;
+        *colon = '\0';
+        char *value = colon + 1;
+        while (*value == ' ') ++value;
+        if (strcasecmp(line, "Content-Length") == 0) h->content_length = atoll(value);
+        if (strcasecmp(line, "Connection") == 0 && strcasecmp(value, "close") == 0) h->resp_close = true;
+        emit(h, HTTP_EVENT_ON_HEADER, line, value);
+    }
+    h->remaining = h->content_length;
+    return h->content_length;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t h)
+{
+    return h->status;
+}
+
+int64_t esp_http_client_get_content_length(esp_http_client_handle_t h)
+{
+    return h->content_length;
+}
+
+int esp_http_client_read(esp_http_client_handle_t h, char *buf, int len)
+{
+    int n = 0;
+    while (n < len && h->remaining > 0) {
+        int c = read_byte(h);
+        if (c < 0) break;
+        buf[n++] = (char)c;
+        h->remaining--;
+    }
+    return n;
+}
+
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t h, int *len)
+{
+    char sink[256];
+    int total = 0, n;
+    while ((n = esp_http_client_read(h, sink, sizeof(sink))) > 0) total += n;
+    if (len) *len = total;
+
+    const char *ct = header(h, "Content-Type");
+    const char *ce = header(h, "Content-Encoding");
+    host_on_upload(h->body, h->body_len, ct ? ct : "",
+                   ce && strcasecmp(ce, "gzip") == 0, h->status);
+    emit(h, HTTP_EVENT_ON_FINISH, NULL, NULL);
+#ifdef HOST_HAVE_OPENSSL
+    host_heap_untracked(true);
+    tls_save_session(h);
+    host_heap_untracked(false);
+#endif
+    if (h->resp_close) disconnect(h);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t h)
+{
+    disconnect(h);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t h)
+{
+    if (!h) return ESP_OK;
+    disconnect(h);
+    for (int i = 0; i < MAX_HEADERS; ++i) {
+        if (!h->hdr[i]) continue;
+        free(h->hdr[i]->key);
+        free(h->hdr[i]->value);
+        free(h->hdr[i]);
+    }
+    host_heap_untracked(true);
+    free(h->body);
+#ifdef HOST_HAVE_OPENSSL
+    SSL_SESSION_free(h->session);
+#endif
+    host_heap_untracked(false);
+    free(h);
+    return ESP_OK;
+}
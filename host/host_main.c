@@ -0,0 +1,415 @@
+// host/host_main.c — runs the firmware's app_main() pipeline on Linux
+//
+//   ./aulasense_host [--seconds N] [--server HOST:PORT] [--rtt-ms N]
+//                    [--sensors FILE] [--epoch UNIX_S] [--seed N]
+//                    [--i2c-faults P] [--uart-baud N] [--sntp-s N]
+//                    [--wifi-s N] [--max-first-sample-s N] [--transport http|mqtt]
+//                    [--tls-cpu-ms N] [--max-jitter-ms N] [--alloc-budget]
+//                    [--tls] [--expect-tls-resume] [--keep-log] [--verbose]
+//
+// The tasks from app_main.c run against scripted sensors and post to a
+// local server (host/sink_server.py) on a virtual clock, then a report of
+// per-sample CPU cost, heap use, bytes on the wire and end-to-end latency is
+// printed. With --transport mqtt they publish to a broker at --server
+// instead (host/mqtt_broker.py). --alloc-budget makes the run exit with
+// status 1 if any module allocated more after boot than its budget allows
+// (main/alloc_trace.c). --tls-cpu-ms charges each new HTTPS connection that
+// much CPU on the sender's core, and --max-jitter-ms fails the run if any
+// BH1750 read came later than that behind the previous one plus its period.
+// --tls speaks real TLS to --server (host/ingest_server.py --tls-port);
+// --expect-tls-resume then fails the run unless batches shared connections
+// and every reconnect whose saved ticket was still valid resumed the session.
+#include "host.h"
+#include "binlog.h"
+#include "metrics.h"
+#include "alloc_trace.h"
+#include "sample_log.h"
+#include "sample_ring.h"
+#include "sensors.h"
+#include "uploader.h"
+#include "transport.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef HOST_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+void app_main(void);
+
+// ===== End-to-end latency: sample timestamp → acknowledged upload =====
+#define LAT_MAX 200000
+
+static uint32_t s_lat[LAT_MAX];     // seconds
+static size_t   s_nlat;
+static uint32_t s_posts, s_posts_2xx, s_unparsed;
+static uint64_t s_bytes;
+
+#ifdef HOST_HAVE_ZLIB
+static char *gunzip(const char *in, size_t len, size_t *out_len)
+{
+    size_t cap = len * 8 + 1024;
+    char *out = malloc(cap);
+    if (!out) return NULL;
+    z_stream z = { 0 };
+    if (inflateInit2(&z, 16 + MAX_WBITS) != Z_OK) { free(out); return NULL; }
+    z.next_in = (Bytef *)in;
+    z.avail_in = (uInt)len;
+    int rc;
+    do {
+        if (z.total_out == cap) {
+            cap *= 2;
+            char *n = realloc(out, cap);
+            if (!n) { inflateEnd(&z); free(out); return NULL; }
+            out = n;
+        }
+        z.next_out = (Bytef *)out + z.total_out;
+        z.avail_out = (uInt)(cap - z.total_out);
+        rc = inflate(&z, Z_NO_FLUSH);
+    } while (rc == Z_OK);
+    *out_len = z.total_out;
+    inflateEnd(&z);
+    if (rc != Z_STREAM_END) { free(out); return NULL; }
+    return out;
+}
+#endif
+
+// Latency of every {"date":..,"time":..} object in a JSON batch.
+static void scan_json(const char *p, size_t len, time_t now)
+{
+    const char *end = p + len;
+    while (p < end) {
+        const char *d = memmem(p, (size_t)(end - p), "\"date\":\"", 8);
+        if (!d) break;
+        struct tm tm = { 0 };
+        if (sscanf(d + 8, "%4d-%2d-%2d\",\"time\":\"%2d:%2d:%2d",
+                   &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                   &tm.tm_hour, &tm.tm_min, &tm.tm_sec) == 6) {
+            tm.tm_year -= 1900;
+            tm.tm_mon  -= 1;
+            tm.tm_isdst = -1;
+            time_t t = mktime(&tm);
+            if (s_nlat < LAT_MAX) s_lat[s_nlat++] = (uint32_t)(now > t ? now - t : 0);
+        }
+        p = d + 8;
+    }
+}
+
+void host_on_upload(const char *body, size_t len, const char *content_type,
+                    bool gzip, int status)
+{
+    s_posts++;
+    s_bytes += len;
+    if (status < 200 || status >= 300) return;
+    s_posts_2xx++;
+
+    if (strcasecmp(content_type, "application/json") != 0) {
+        s_unparsed++;
+        return;
+    }
+    if (!gzip) {
+        scan_json(body, len, time(NULL));
+        return;
+    }
+#ifdef HOST_HAVE_ZLIB
+    size_t n = 0;
+    host_heap_untracked(true);
+    char *raw = gunzip(body, len, &n);
+    if (raw) scan_json(raw, n, time(NULL));
+    free(raw);
+    host_heap_untracked(false);
+    if (raw) return;
+#endif
+    s_unparsed++;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// ===== Report =====
+static double ts_s(const struct timespec *a, const struct timespec *b)
+{
+    return (double)(b->tv_sec - a->tv_sec) + (double)(b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+static void report(double sim_s, double wall_s, double cpu_s)
+{
+    sample_log_stats_t ls;
+    sample_log_get_stats(&ls);
+    sensors_stats_t ss;
+    sensors_get_stats(&ss);
+    uploader_stats_t us;
+    uploader_get_stats(&us);
+    host_i2c_stats_t is;
+    host_i2c_get_stats(&is);
+    size_t heap_now, heap_peak;
+    uint32_t allocs;
+    host_heap_get(&heap_now, &heap_peak, &allocs);
+
+    printf("\n===== host run: %.0f s simulated in %.2f s (%.0fx real time) =====\n",
+           sim_s, wall_s, wall_s > 0 ? sim_s / wall_s : 0.0);
+    printf("samples      : %u published, %u uploaded, %u pending, %u dropped\n",
+           (unsigned)ls.appended, (unsigned)ls.consumed,
+           (unsigned)sample_log_count(), (unsigned)ls.dropped);
+    printf("uploads      : %u batches (%u 2xx), %u connects, %llu body bytes\n",
+           (unsigned)s_posts, (unsigned)s_posts_2xx, (unsigned)us.connects,
+           (unsigned long long)s_bytes);
+    uint64_t wire_out, wire_in;
+    host_wire_get(&wire_out, &wire_in);
+    uint32_t hs, resumed, expired;
+    host_http_tls_get(&hs, &resumed, &expired);
+    if (hs) {
+        printf("tls          : %u handshakes for %u batches, %u resumed a session, "
+               "%u had an expired one\n",
+               (unsigned)hs, (unsigned)s_posts, (unsigned)resumed, (unsigned)expired);
+    }
+    printf("wire         : %llu B out, %llu B in (%.1f B/sample uploaded), TCP/IP and TLS not counted\n",
+           (unsigned long long)wire_out, (unsigned long long)wire_in,
+           ls.consumed ? (double)(wire_out + wire_in) / ls.consumed : 0.0);
+    printf("flash        : %u writes, %u bytes, %u sector erases\n",
+           (unsigned)ls.flash_writes, (unsigned)ls.flash_bytes, (unsigned)ls.sector_erases);
+    printf("backlog      : %u B/sample in RAM, %u B in flash; ring %u B, batch %u B; "
+           "flash holds %u samples (%.1f h at 10 s)\n",
+           (unsigned)sizeof(sample_t), (unsigned)ls.record_bytes,
+           (unsigned)(SAMPLE_RING_CAPACITY * sizeof(sample_t)),
+           (unsigned)(UPLOADER_MAX_SAMPLES * sizeof(sample_t)),
+           (unsigned)ls.capacity, ls.capacity * 10.0 / 3600.0);
+    printf("i2c          : %u transactions (%.2f/s), %u NACKs, %u bytes; reads BH1750 %u, BME280 %u\n",
+           (unsigned)is.xfers, is.xfers / sim_s, (unsigned)is.nacks, (unsigned)is.bytes,
+           (unsigned)ss.bh1750_reads, (unsigned)ss.bme280_reads);
+    printf("i2c faults   : %u timeouts, %u bus clears (driver saw %u errors)\n",
+           (unsigned)is.timeouts, (unsigned)is.resets, (unsigned)ss.i2c_errors);
+    host_jitter_t j;
+    host_sensors_jitter(&j);
+    printf("sampler      : %u BH1750 reads late by p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, "
+           "p99.9 %.1f ms, max %.1f ms\n", (unsigned)j.count, j.p50_us / 1e3, j.p90_us / 1e3,
+           j.p99_us / 1e3, j.p999_us / 1e3, j.max_us / 1e3);
+    printf("pir          : %u edges via ISR queue, %u dropped (queue full)\n",
+           (unsigned)ss.pir_edges, (unsigned)ss.pir_overflows);
+
+    host_task_info_t tasks[16];
+    int n = host_rtos_tasks(tasks, 16);
+    uint64_t task_ns = 0;
+    for (int i = 0; i < n; ++i) {
+        task_ns += tasks[i].cpu_ns;
+        char core[12] = "any";   // fits any int
+        if (tasks[i].core >= 0) snprintf(core, sizeof(core), "%d", tasks[i].core);
+        printf("task %-15s: %8.3f ms CPU, %u wakeups, stack %u of %u B, prio %u, core %s\n",
+               tasks[i].name, tasks[i].cpu_ns / 1e6, (unsigned)tasks[i].switches,
+               (unsigned)tasks[i].stack_used, (unsigned)tasks[i].stack_depth,
+               tasks[i].prio, core);
+    }
+    printf("cpu/sample   : %.1f us in tasks (%.1f us process total)\n",
+           ls.appended ? task_ns / 1e3 / ls.appended : 0.0,
+           ls.appended ? cpu_s * 1e6 / ls.appended : 0.0);
+    uint64_t uart_bytes;
+    int64_t uart_busy_us;
+    host_uart_get_stats(&uart_bytes, &uart_busy_us);
+    printf("uart         : %llu bytes logged, transmitter busy %.2f%% of the time\n",
+           (unsigned long long)uart_bytes, uart_busy_us / 1e4 / sim_s);
+    binlog_stats_t bs;
+    binlog_get_stats(&bs);
+    printf("binlog       : %u records, %u printed (%u bytes), %u lost (ring full), "
+           "%u not printed (rate limit); ring peak %u/%u words\n",
+           (unsigned)bs.written, (unsigned)bs.printed, (unsigned)bs.bytes, (unsigned)bs.dropped,
+           (unsigned)bs.suppressed, (unsigned)bs.peak_words, (unsigned)BINLOG_RING_WORDS);
+    printf("heap         : %zu B in use, %zu B peak, %u allocations\n",
+           heap_now, heap_peak, (unsigned)allocs);
+    alloc_trace_stats_t as;
+    alloc_trace_get(&as);
+    printf("alloc        : %u at boot; after boot, over %u batches:",
+           (unsigned)as.boot_allocs, (unsigned)as.batches);
+    bool any = false;
+    for (int m = 0; m < ALLOC_MOD_COUNT; ++m) {
+        if (!as.allocs[m]) continue;
+        printf("%s %s %u (%u B, largest %u B)%s", any ? "," : "",
+               alloc_trace_name((alloc_mod_t)m), (unsigned)as.allocs[m],
+               (unsigned)as.bytes[m], (unsigned)as.largest[m],
+               as.over[m] ? " OVER BUDGET" : "");
+        any = true;
+    }
+    printf("%s\n", any ? "" : " none");
+
+    static const char *const hist_names[METRIC_H_COUNT] = {
+        "i2c xfer", "http connect", "http xfer", "upload total", "sample late",
+    };
+    for (int h = 0; h < METRIC_H_COUNT; ++h) {
+        metrics_summary_t m;
+        metrics_summary((metric_hist_t)h, &m);
+        printf("%-13s: %u, p50 <%u us, p90 <%u us, p99 <%u us, max <%u us\n",
+               hist_names[h], (unsigned)m.count, (unsigned)m.p50_us, (unsigned)m.p90_us,
+               (unsigned)m.p99_us, (unsigned)m.max_us);
+    }
+    static const char *const boot_names[METRIC_B_COUNT] = {
+        "first sample", "first IP", "first sync", "first upload",
+    };
+    printf("boot         :");
+    for (int b = 0; b < METRIC_B_COUNT; ++b) {
+        uint32_t ms = metrics_boot_ms((metric_boot_t)b);
+        if (ms) printf("%s %s %.3f s", b ? "," : "", boot_names[b], ms / 1e3);
+        else    printf("%s %s never", b ? "," : "", boot_names[b]);
+    }
+    printf("\n");
+    printf("drops        : %u queue full, %u backlog wrapped; %u upload failures\n",
+           (unsigned)metrics_counter(METRIC_C_SAMPLES_DROPPED),
+           (unsigned)metrics_counter(METRIC_C_LOG_DROPPED),
+           (unsigned)metrics_counter(METRIC_C_UPLOAD_FAILS));
+
+    if (s_nlat > 0) {
+        qsort(s_lat, s_nlat, sizeof(s_lat[0]), cmp_u32);
+        double sum = 0;
+        for (size_t i = 0; i < s_nlat; ++i) sum += s_lat[i];
+        printf("latency      : %zu samples, min %u s, mean %.1f s, p50 %u s, p95 %u s, max %u s\n",
+               s_nlat, s_lat[0], sum / s_nlat, s_lat[s_nlat / 2],
+               s_lat[(size_t)(s_nlat * 0.95)], s_lat[s_nlat - 1]);
+    } else {
+        printf("latency      : no JSON batches acknowledged\n");
+    }
+    if (s_unparsed) printf("               (%u batches not inspected)\n", (unsigned)s_unparsed);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [--seconds N] [--server HOST:PORT] [--rtt-ms N] [--sensors FILE]\n"
+            "          [--epoch UNIX_S] [--seed N] [--i2c-faults P] [--uart-baud N]\n"
+            "          [--sntp-s N] [--wifi-s N] [--max-first-sample-s N]\n"
+            "          [--transport http|mqtt] [--tls-cpu-ms N] [--max-jitter-ms N]\n"
+            "          [--alloc-budget] [--tls] [--expect-tls-resume] [--keep-log]\n"
+            "          [--verbose]\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    double   seconds = 3600;
+    char     host[64] = "127.0.0.1";
+    int      port = 8080;
+    uint32_t rtt_ms = 100, seed = 1;
+    double   i2c_faults = 0, sntp_s = 0, max_first_s = 0, max_jitter_ms = 0;
+    struct timespec rt;
+    clock_gettime(CLOCK_REALTIME, &rt);      // time() is the virtual clock
+    int64_t  epoch = (int64_t)rt.tv_sec;
+    const char *script = NULL;
+    bool keep_log = false, verbose = false, mqtt = false, alloc_budget = false;
+    bool tls = false, expect_resume = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(a, "--keep-log")) { keep_log = true; continue; }
+        if (!strcmp(a, "--verbose"))  { verbose = true; continue; }
+        if (!strcmp(a, "--alloc-budget")) { alloc_budget = true; continue; }
+        if (!strcmp(a, "--tls")) { tls = true; continue; }
+        if (!strcmp(a, "--expect-tls-resume")) { expect_resume = true; continue; }
+        if (!v) usage(argv[0]);
+        ++i;
+        if (!strcmp(a, "--seconds"))      seconds = atof(v);
+        else if (!strcmp(a, "--rtt-ms"))  rtt_ms = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--sensors")) script = v;
+        else if (!strcmp(a, "--epoch"))   epoch = atoll(v);
+        else if (!strcmp(a, "--seed"))    seed = (uint32_t)strtoul(v, NULL, 0);
+        else if (!strcmp(a, "--i2c-faults")) i2c_faults = atof(v);
+        else if (!strcmp(a, "--uart-baud"))  host_uart_set_baud((uint32_t)atoi(v));
+        else if (!strcmp(a, "--sntp-s"))     sntp_s = atof(v);
+        else if (!strcmp(a, "--wifi-s"))     host_wifi_set(atof(v));
+        else if (!strcmp(a, "--max-first-sample-s")) max_first_s = atof(v);
+        else if (!strcmp(a, "--max-jitter-ms")) max_jitter_ms = atof(v);
+        else if (!strcmp(a, "--tls-cpu-ms"))    host_http_set_tls_cpu((uint32_t)atoi(v));
+        else if (!strcmp(a, "--transport") && !strcmp(v, "mqtt")) mqtt = true;
+        else if (!strcmp(a, "--transport") && !strcmp(v, "http")) mqtt = false;
+        else if (!strcmp(a, "--server")) {
+            if (sscanf(v, "%63[^:]:%d", host, &port) != 2) usage(argv[0]);
+        } else usage(argv[0]);
+    }
+
+    // The built-in day follows local time in the zone time_sync.c sets. Set
+    // it here too: sensors start before time_sync_start() runs.
+    setenv("TZ", "IST-2IDT,M3.4.4/26,M10.5.0", 1);
+    tzset();
+    host_heap_untracked(true);
+    esp_err_t loaded = host_sensors_load(script, epoch);
+    host_heap_untracked(false);
+    if (loaded != ESP_OK) {
+        fprintf(stderr, "cannot load sensor script %s\n", script);
+        return 1;
+    }
+    if (!keep_log) {
+        unlink(SAMPLE_LOG_HOST_FILE);
+        unlink(HOST_NVS_FILE);
+    }
+    host_sntp_set(epoch, sntp_s);
+    host_random_seed(seed);
+    host_i2c_set_fault_rate(i2c_faults);
+    host_http_set_target(host, port, rtt_ms);
+    if (host_http_set_tls(tls) != ESP_OK) {
+        fprintf(stderr, "--tls: this host build has no OpenSSL\n");
+        return 1;
+    }
+    host_mqtt_set_target(host, port, rtt_ms);
+    if (mqtt) uploader_set_transport(&transport_mqtt);   // app_main keeps it
+    host_log_set_level(verbose ? ESP_LOG_INFO : ESP_LOG_WARN);
+
+    struct timespec w0, w1, c0, c1;
+    clock_gettime(CLOCK_MONOTONIC, &w0);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &c0);
+
+    app_main();
+    host_rtos_run((int64_t)(seconds * 1e6));
+
+    clock_gettime(CLOCK_MONOTONIC, &w1);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &c1);
+    report(seconds, ts_s(&w0, &w1), ts_s(&c0, &c1));
+    int rc = 0;
+    if (max_first_s > 0) {
+        uint32_t ms = metrics_boot_ms(METRIC_B_FIRST_SAMPLE);
+        bool ok = ms && ms <= max_first_s * 1000;
+        printf("first sample : %s (%.3f s, limit %.3f s)\n", ok ? "PASS" : "FAIL",
+               ms / 1e3, max_first_s);
+        rc = ok ? 0 : 1;
+    }
+    if (max_jitter_ms > 0) {
+        host_jitter_t j;
+        host_sensors_jitter(&j);
+        bool ok = j.count && j.max_us <= max_jitter_ms * 1000;
+        printf("jitter       : %s (max %.1f ms, limit %.1f ms)\n", ok ? "PASS" : "FAIL",
+               j.max_us / 1e3, max_jitter_ms);
+        if (!ok) rc = 1;
+    }
+    if (expect_resume) {
+        // Keep-alive: fewer handshakes than batches. Resumption: some
+        // reconnect resumed, and so did every one whose ticket was still valid.
+        uint32_t hs, resumed, expired;
+        host_http_tls_get(&hs, &resumed, &expired);
+        bool ok = hs < s_posts && resumed > 0 && resumed + expired == hs - 1;
+        printf("tls resume   : %s (%u of %u reconnects with a live ticket resumed, %u batches)\n",
+               ok ? "PASS" : "FAIL", (unsigned)resumed, hs ? (unsigned)(hs - 1 - expired) : 0u,
+               (unsigned)s_posts);
+        if (!ok) rc = 1;
+    }
+    if (alloc_budget) {
+        alloc_trace_stats_t as;
+        alloc_trace_get(&as);
+        bool ok = true;
+        for (int m = 0; m < ALLOC_MOD_COUNT; ++m) {
+            if (!as.over[m]) continue;
+            const alloc_budget_t *b = alloc_trace_budget((alloc_mod_t)m);
+            printf("heap budget  : %s made %u allocation(s) after boot, budget %u + %u per batch\n",
+                   alloc_trace_name((alloc_mod_t)m), (unsigned)as.allocs[m],
+                   (unsigned)b->once, (unsigned)b->per_batch);
+            ok = false;
+        }
+        printf("heap budget  : %s\n", ok ? "PASS" : "FAIL");
+        if (!ok) rc = 1;
+    }
+    fflush(stdout);
+    _exit(rc);   // the task threads are parked mid-loop; don't unwind them
+}
@@ -0,0 +1,536 @@
+// host/host_mqtt.c — esp-mqtt over plain MQTT 3.1.1 sockets
+//
+// Implements the part of esp-mqtt transport_mqtt.c uses: a client that
+// connects in the background, QoS0/1 publishes, one subscription and
+// keepalive pings, with the same events. Every connection goes to the
+// host_mqtt_set_target() broker (host/mqtt_broker.py or any MQTT 3.1.1
+// broker); TLS settings are accepted and ignored.
+//
+// The broker answers at once in real time; the shim reads its answer right
+// away but delivers the event rtt later on the virtual clock, from a
+// host_at() event, as esp-mqtt's own task would. The publishing task never
+// waits for a PUBACK, so several publishes can be in flight.
+//
+// Like esp-mqtt's outbox, each QoS1 publish is copied to the heap (item and
+// data, two allocations) until its PUBACK; everything else is static, so the
+// firmware's heap figures show only what the real client would add. The
+// outbox outlives a dropped connection: on reconnect, items older than
+// CONFIG_MQTT_OUTBOX_EXPIRED_TIMEOUT_MS are deleted (MQTT_EVENT_DELETED) and
+// the rest are published again with DUP set and their own msg_id, as
+// esp-mqtt does. Destroying the client frees it.
+#include "host.h"
+#include "mqtt_client.h"
+#include "esp_timer.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define MAX_PENDING   8        // QoS1 publishes awaiting their event
+#define MAX_BODY      16384
+#define MAX_EVENTS    12       // events queued on the virtual clock
+#define FRAME_MAX     (MAX_BODY + 256)
+#define RECONNECT_MS  10000    // esp-mqtt's default
+#define MAX_CLIENTS   4
+#ifndef CONFIG_MQTT_OUTBOX_EXPIRED_TIMEOUT_MS
+#define CONFIG_MQTT_OUTBOX_EXPIRED_TIMEOUT_MS 30000   // esp-mqtt's default
+#endif
+
+typedef struct {
+    int     msg_id;
+    int64_t queued_us;
+    char    topic[96];
+    char   *body;
+    size_t  len;
+} pending_t;
+
+struct esp_mqtt_client {
+    char                client_id[64];
+    bool                clean;
+    int                 keepalive_s;
+    int                 timeout_ms;
+    int                 reconnect_ms;
+    esp_event_handler_t handler;
+    void               *handler_arg;
+    int                 fd;
+    bool                connected;     // as far as the firmware has been told
+    bool                stopped;
+    uint16_t            next_id;
+    int64_t             last_tx_us;
+    bool                ping_armed;
+    pending_t          *pend[MAX_PENDING];   // the outbox
+    uint8_t             rbuf[FRAME_MAX];
+    size_t              rlen;
+};
+
+typedef struct {
+    bool                     used;
+    esp_mqtt_client_handle_t c;
+    esp_mqtt_event_t         e;
+    char                     topic[96];
+    char                     data[256];
+} event_t;
+
+static char     s_host[64] = "127.0.0.1";
+static int      s_port = 1883;
+static uint32_t s_rtt_ms = 0;
+// Static, so the firmware's heap figures show only its own allocations
+static struct esp_mqtt_client s_clients[MAX_CLIENTS];
+static int      s_nclients;
+static event_t  s_events[MAX_EVENTS];
+static uint8_t  s_frame[FRAME_MAX];
+
+void host_mqtt_set_target(const char *host, int port, uint32_t rtt_ms)
+{
+    snprintf(s_host, sizeof(s_host), "%s", host);
+    s_port = port;
+    s_rtt_ms = rtt_ms;
+}
+
+static int64_t rtt_us(void) { return (int64_t)s_rtt_ms * 1000; }
+
+static void outbox_delete(esp_mqtt_client_handle_t c, int i)
+{
+    if (!c->pend[i]) return;
+    free(c->pend[i]->body);
+    free(c->pend[i]);
+    c->pend[i] = NULL;
+}
+
+// ===== Events on the virtual clock =====
+static void fire(void *arg)
+{
+    event_t *ev = arg;
+    esp_mqtt_client_handle_t c = ev->c;
+    if (!c->stopped) {
+        if (ev->e.event_id == MQTT_EVENT_CONNECTED) c->connected = true;
+        if (ev->e.event_id == MQTT_EVENT_PUBLISHED) {
+            for (int i = 0; i < MAX_PENDING; ++i) {
+                pending_t *p = c->pend[i];
+                if (!p || p->msg_id != ev->e.msg_id) continue;
+                // Same view of an acknowledged batch as the HTTP shim gives
+                const char *fmt = strrchr(p->topic, '/');
+                fmt = fmt ? fmt + 1 : "";
+                host_on_upload(p->body, p->len,
+                               strncmp(fmt, "cbor", 4) == 0 ? "application/cbor" : "application/json",
+                               strstr(fmt, ".gz") != NULL, 200);
+                outbox_delete(c, i);
+            }
+        }
+        if (c->handler) c->handler(c->handler_arg, "MQTT_EVENTS", ev->e.event_id, &ev->e);
+    }
+    ev->used = false;
+}
+
+static event_t *post(esp_mqtt_client_handle_t c, esp_mqtt_event_id_t id, int64_t delay_us)
+{
+    for (int i = 0; i < MAX_EVENTS; ++i) {
+        event_t *ev = &s_events[i];
+        if (ev->used) continue;
+        memset(ev, 0, sizeof(*ev));
+        ev->used = true;
+        ev->c = c;
+        ev->e.event_id = id;
+        ev->e.client = c;
+        host_at(host_now_us() + delay_us, fire, ev);
+        return ev;
+    }
+    fprintf(stderr, "host_mqtt: event queue full\n");
+    abort();
+}
+
+// ===== Framing =====
+static size_t put_len(uint8_t *o, size_t n)
+{
+    size_t k = 0;
+    do {
+        uint8_t b = n % 128;
+        n /= 128;
+        o[k++] = (uint8_t)(b | (n ? 0x80 : 0));
+    } while (n);
+    return k;
+}
+
+static size_t put_str(uint8_t *o, const char *s, size_t n)
+{
+    o[0] = (uint8_t)(n >> 8);
+    o[1] = (uint8_t)n;
+    memcpy(o + 2, s, n);
+    return n + 2;
+}
+
+static void drop(esp_mqtt_client_handle_t c);
+
+static bool send_frame(esp_mqtt_client_handle_t c, uint8_t type, const uint8_t *var, size_t var_len,
+                       const char *payload, size_t payload_len)
+{
+    if (c->fd < 0) return false;
+    uint8_t hdr[5];
+    hdr[0] = type;
+    size_t h = 1 + put_len(hdr + 1, var_len + payload_len);
+    struct iovec iov[3] = {
+        { hdr, h }, { (void *)var, var_len }, { (void *)payload, payload_len },
+    };
+    struct msghdr m = { .msg_iov = iov, .msg_iovlen = 3 };
+    size_t total = h + var_len + payload_len;
+    ssize_t n = sendmsg(c->fd, &m, MSG_NOSIGNAL);
+    if (n != (ssize_t)total) return false;
+    host_wire_count(total, 0);
+    c->last_tx_us = host_now_us();
+    return true;
+}
+
+// Next frame from the broker into s_frame; its type byte, or -1 on error.
+// wait: block up to the client timeout, else only take what is there.
+static int read_frame(esp_mqtt_client_handle_t c, bool wait, size_t *len, size_t *off)
+{
+    for (;;) {
+        // A whole frame in rbuf?
+        if (c->rlen >= 2) {
+            size_t n = 0, mul = 1, i = 1;
+            bool done = false;
+            while (i < c->rlen && i < 5) {
+                n += (c->rbuf[i] & 0x7F) * mul;
+                mul *= 128;
+                if (!(c->rbuf[i++] & 0x80)) { done = true; break; }
+            }
+            if (done && n + i > sizeof(c->rbuf)) return -1;
+            if (done && c->rlen >= i + n) {
+                int type = c->rbuf[0];
+                memcpy(s_frame, c->rbuf + i, n);
+                memmove(c->rbuf, c->rbuf + i + n, c->rlen - i - n);
+                c->rlen -= i + n;
+                *len = n;
+                *off = 0;
+                return type;
+            }
+        }
+        ssize_t r = recv(c->fd, c->rbuf + c->rlen, sizeof(c->rbuf) - c->rlen, wait ? 0 : MSG_DONTWAIT);
+        if (r == 0) return -1;
+        if (r < 0) return !wait && (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        host_wire_count(0, (size_t)r);
+        c->rlen += (size_t)r;
+    }
+}
+
+// Act on one frame from the broker; its type (high nibble), or -1 when the
+// connection broke. *id gets the packet id of an acknowledgement.
+static int handle_frame(esp_mqtt_client_handle_t c, bool wait, int *id)
+{
+    size_t len, off;
+    int type = read_frame(c, wait, &len, &off);
+    if (type <= 0) return type;
+    switch (type >> 4) {
+    case 3: {   // PUBLISH from the broker (.../ctl)
+        int qos = (type >> 1) & 3;
+        size_t tl = (size_t)s_frame[0] << 8 | s_frame[1];
+        size_t p = 2 + tl;
+        uint16_t mid = 0;
+        if (qos) {
+            mid = (uint16_t)(s_frame[p] << 8 | s_frame[p + 1]);
+            p += 2;
+        }
+        event_t *ev = post(c, MQTT_EVENT_DATA, rtt_us() / 2);
+        size_t dl = len - p < sizeof(ev->data) ? len - p : sizeof(ev->data);
+        if (tl >= sizeof(ev->topic)) tl = sizeof(ev->topic) - 1;
+        memcpy(ev->topic, s_frame + 2, tl);
+        memcpy(ev->data, s_frame + p, dl);
+        ev->e.topic = ev->topic;
+        ev->e.topic_len = (int)tl;
+        ev->e.data = ev->data;
+        ev->e.data_len = ev->e.total_data_len = (int)dl;
+        ev->e.qos = qos;
+        ev->e.retain = type & 1;
+        if (qos == 1) {
+            uint8_t ack[2] = { (uint8_t)(mid >> 8), (uint8_t)mid };
+            if (!send_frame(c, 0x40, ack, 2, NULL, 0)) return -1;
+        }
+        break;
+    }
+    case 4:     // PUBACK
+    case 9:     // SUBACK
+        *id = s_frame[0] << 8 | s_frame[1];
+        break;
+    default:    // CONNACK, PINGRESP
+        break;
+    }
+    return type >> 4;
+}
+
+// Read until a frame of type (and packet id) comes; false if the
+// connection broke first.
+static bool await(esp_mqtt_client_handle_t c, int type, int id)
+{
+    for (;;) {
+        int got_id = -1;
+        int t = handle_frame(c, true, &got_id);
+        if (t < 0 || t == 0) return false;
+        if (t == type && (id < 0 || got_id == id)) return true;
+    }
+}
+
+// Whatever the broker sent meanwhile (pushed ctl messages).
+static bool drain(esp_mqtt_client_handle_t c)
+{
+    int id, t;
+    while ((t = handle_frame(c, false, &id)) > 0) {}
+    return t == 0;
+}
+
+// PUBLISH frame for a topic and body; a QoS1 one carries msg_id.
+static bool send_publish(esp_mqtt_client_handle_t c, const char *topic, const char *data,
+                         size_t len, int qos, int msg_id, bool retain, bool dup)
+{
+    uint8_t var[2 + 96 + 2];
+    size_t n = put_str(var, topic, strlen(topic));
+    if (qos > 0) {
+        var[n++] = (uint8_t)(msg_id >> 8);
+        var[n++] = (uint8_t)msg_id;
+    }
+    uint8_t type = (uint8_t)(0x30 | (dup ? 0x08 : 0) | (qos > 0 ? 0x02 : 0) | (retain ? 1 : 0));
+    return send_frame(c, type, var, n, data, len);
+}
+
+// ===== Connection =====
+static void do_connect(void *arg);
+static void ping_fire(void *arg);
+
+static void arm_ping(esp_mqtt_client_handle_t c)
+{
+    if (c->ping_armed || c->keepalive_s <= 0) return;
+    c->ping_armed = true;
+    host_at(c->last_tx_us + (int64_t)c->keepalive_s * 1000000, ping_fire, c);
+}
+
+// The connection broke: tell the firmware and reconnect later, as esp-mqtt
+// does. The outbox stays for the next connection.
+static void drop(esp_mqtt_client_handle_t c)
+{
+    if (c->fd >= 0) {
+        close(c->fd);
+        c->fd = -1;
+        c->rlen = 0;
+    }
+    c->connected = false;
+    post(c, MQTT_EVENT_DISCONNECTED, 0);
+    host_at(host_now_us() + (int64_t)c->reconnect_ms * 1000, do_connect, c);
+}
+
+static int tcp_connect(int timeout_ms)
+{
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM }, *ai;
+    char port[8];
+    snprintf(port, sizeof(port), "%d", s_port);
+    if (getaddrinfo(s_host, port, &hints, &ai) != 0) return -1;
+    int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) { freeaddrinfo(ai); return -1; }
+    struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    int rc = connect(fd, ai->ai_addr, ai->ai_addrlen);
+    freeaddrinfo(ai);
+    if (rc != 0) { close(fd); return -1; }
+    return fd;
+}
+
+static void do_connect(void *arg)
+{
+    esp_mqtt_client_handle_t c = arg;
+    if (c->stopped || c->fd >= 0) return;
+    if (c->handler) {
+        esp_mqtt_event_t e = { .event_id = MQTT_EVENT_BEFORE_CONNECT, .client = c };
+        c->handler(c->handler_arg, "MQTT_EVENTS", MQTT_EVENT_BEFORE_CONNECT, &e);
+    }
+    c->fd = tcp_connect(c->timeout_ms);
+    if (c->fd < 0) {
+        post(c, MQTT_EVENT_ERROR, rtt_us());
+        host_at(host_now_us() + (int64_t)c->reconnect_ms * 1000, do_connect, c);
+        return;
+    }
+
+    uint8_t var[10 + 2 + sizeof(c->client_id)];
+    size_t n = put_str(var, "MQTT", 4);
+    var[n++] = 4;                                    // protocol level 3.1.1
+    var[n++] = c->clean ? 0x02 : 0x00;
+    var[n++] = (uint8_t)(c->keepalive_s >> 8);
+    var[n++] = (uint8_t)c->keepalive_s;
+    n += put_str(var + n, c->client_id, strlen(c->client_id));
+    if (!send_frame(c, 0x10, var, n, NULL, 0) || !await(c, 2, -1) || s_frame[1] != 0) {
+        drop(c);
+        return;
+    }
+    // TCP handshake, then CONNECT/CONNACK
+    event_t *ev = post(c, MQTT_EVENT_CONNECTED, 2 * rtt_us());
+    ev->e.session_present = s_frame[0] & 1;
+
+    // The outbox: expired items go, the rest are sent again.
+    int64_t now = host_now_us();
+    for (int i = 0; i < MAX_PENDING; ++i) {
+        pending_t *p = c->pend[i];
+        if (!p) continue;
+        if (now - p->queued_us >= (int64_t)CONFIG_MQTT_OUTBOX_EXPIRED_TIMEOUT_MS * 1000) {
+            post(c, MQTT_EVENT_DELETED, 2 * rtt_us())->e.msg_id = p->msg_id;
+            outbox_delete(c, i);
+            continue;
+        }
+        if (!send_publish(c, p->topic, p->body, p->len, 1, p->msg_id, false, true) ||
+            !await(c, 4, p->msg_id)) {
+            drop(c);
+            return;
+        }
+        post(c, MQTT_EVENT_PUBLISHED, 3 * rtt_us())->e.msg_id = p->msg_id;
+    }
+    arm_ping(c);
+}
+
+static void ping_fire(void *arg)
+{
+    esp_mqtt_client_handle_t c = arg;
+    c->ping_armed = false;
+    if (c->stopped || c->fd < 0) return;
+    if (host_now_us() - c->last_tx_us >= (int64_t)c->keepalive_s * 1000000) {
+        if (!send_frame(c, 0xC0, NULL, 0, NULL, 0) || !await(c, 13, -1)) {
+            drop(c);
+            return;
+        }
+    }
+    if (!drain(c)) {
+        drop(c);
+        return;
+    }
+    arm_ping(c);
+}
+
+// ===== API =====
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *cfg)
+{
+    if (s_nclients == MAX_CLIENTS) return NULL;
+    esp_mqtt_client_handle_t c = &s_clients[s_nclients++];
+    c->fd = -1;
+    snprintf(c->client_id, sizeof(c->client_id), "%s",
+             cfg->credentials.client_id ? cfg->credentials.client_id : "esp32");
+    c->clean = !cfg->session.disable_clean_session;
+    c->keepalive_s = cfg->session.keepalive > 0 ? cfg->session.keepalive : 120;
+    c->timeout_ms = cfg->network.timeout_ms > 0 ? cfg->network.timeout_ms : 10000;
+    c->reconnect_ms = cfg->network.reconnect_timeout_ms > 0 ? cfg->network.reconnect_timeout_ms
+                                                            : RECONNECT_MS;
+    return c;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t c, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t handler, void *arg)
+{
+    (void)event;
+    c->handler = handler;
+    c->handler_arg = arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t c)
+{
+    c->stopped = false;
+    host_at(host_now_us(), do_connect, c);
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t c)
+{
+    c->stopped = true;
+    if (c->fd >= 0) {
+        send_frame(c, 0xE0, NULL, 0, NULL, 0);   // DISCONNECT
+        close(c->fd);
+        c->fd = -1;
+    }
+    c->connected = false;
+    return ESP_OK;
+}
+
+// Events may still be queued for it, so its slot is never reused.
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t c)
+{
+    if (!c) return ESP_OK;
+    esp_mqtt_client_stop(c);
+    for (int i = 0; i < MAX_PENDING; ++i) outbox_delete(c, i);
+    return ESP_OK;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t c, const char *topic,
+                            const char *data, int len, int qos, int retain)
+{
+    if (!c->connected || c->fd < 0) return -1;
+    if (len <= 0) len = (int)strlen(data);
+    size_t tl = strlen(topic);
+    if (tl >= sizeof(((pending_t *)0)->topic) || (size_t)len > MAX_BODY) return -1;
+
+    pending_t *p = NULL;
+    int msg_id = 0;
+    if (qos > 0) {
+        int slot = -1;
+        for (int i = 0; i < MAX_PENDING && slot < 0; ++i) {
+            if (!c->pend[i]) slot = i;
+        }
+        if (slot < 0) return -1;
+        p = calloc(1, sizeof(*p));
+        if (!p) return -1;
+        p->body = malloc((size_t)len);
+        if (!p->body) {
+            free(p);
+            return -1;
+        }
+        c->pend[slot] = p;
+        if (++c->next_id == 0) c->next_id = 1;
+        msg_id = c->next_id;
+        p->msg_id = msg_id;
+        p->queued_us = host_now_us();
+        memcpy(p->topic, topic, tl + 1);
+        memcpy(p->body, data, (size_t)len);
+        p->len = (size_t)len;
+    }
+    if (!send_publish(c, topic, data, (size_t)len, qos, msg_id, retain, false)) {
+        drop(c);
+        return qos > 0 ? msg_id : -1;   // queued: goes again on reconnect
+    }
+    if (qos > 0) {
+        // The PUBACK is read now but reported one round trip later.
+        if (!await(c, 4, msg_id)) {
+            drop(c);
+            return msg_id;
+        }
+        post(c, MQTT_EVENT_PUBLISHED, rtt_us())->e.msg_id = msg_id;
+    } else if (!drain(c)) {
+        drop(c);
+        return -1;
+    }
+    arm_ping(c);
+    return msg_id;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t c, const char *topic, int qos)
+{
+    if (c->fd < 0) return -1;
+    if (++c->next_id == 0) c->next_id = 1;
+    int msg_id = c->next_id;
+    uint8_t var[2 + 2 + 96 + 1];
+    size_t tl = strlen(topic);
+    if (tl > 96) return -1;
+    size_t n = 0;
+    var[n++] = (uint8_t)(msg_id >> 8);
+    var[n++] = (uint8_t)msg_id;
+    n += put_str(var + n, topic, tl);
+    var[n++] = (uint8_t)qos;
+    if (!send_frame(c, 0x82, var, n, NULL, 0) || !await(c, 9, msg_id) || !drain(c)) {
+        drop(c);
+        return -1;
+    }
+    post(c, MQTT_EVENT_SUBSCRIBED, rtt_us())->e.msg_id = msg_id;
+    return msg_id;
+}
@@ -0,0 +1,574 @@
+// host/host_rtos.c — FreeRTOS task API on pthreads with a virtual clock
+//
+// Exactly one thread runs at a time: either a task that holds the CPU or the
+// scheduler loop in host_rtos_run(). A task gives the CPU back only when it
+// blocks (vTaskDelay, host_block_us). The scheduler then hands it to the
+// task with the earliest wake time, firing any host_at() events on the way,
+// and jumps the clock forward when nothing is runnable. No real time is
+// ever waited for.
+//
+// Running code takes no virtual time, except in host_cpu_us(): the task then
+// holds one of two cores, as on the ESP32, for that long. A task that wakes
+// meanwhile and may only run on that core waits by FreeRTOS rules: not at all
+// if its priority is higher, until the next tick (time slicing) if it is the
+// same, and until the core is free if it is lower. esp_timer one-shots fire
+// between tasks at their due time, like host_at() events.
+//
+// Each task gets a large stack painted with a fill pattern, so its peak use
+// can be read back like FreeRTOS's high-water mark. The numbers are x86-64
+// frames through glibc, a rough guide to the ESP32's.
+#include "host.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#define HOST_MAX_TASKS   16
+#define HOST_MAX_EVENTS  16
+#define HOST_MAX_TIMERS  8
+#define HOST_CORES       2
+#define HOST_TICK_US     (1000000 / configTICK_RATE_HZ)
+#define HOST_TASK_STACK  (256 * 1024)
+#define HOST_STACK_FILL  0xA5         // FreeRTOS's tskSTACK_FILL_BYTE
+
+struct host_task {
+    pthread_t      th;
+    pthread_cond_t cv;
+    char           name[16];
+    TaskFunction_t fn;
+    void          *arg;
+    uint32_t       stack_depth;
+    UBaseType_t    prio;
+    int            core;       // -1: any
+    uint8_t       *stack_lo;   // painted pthread stack
+    uint8_t       *stack_top;  // frame address on entry: use is measured from here
+    int64_t        wake_us;
+    uint64_t       seq;        // FIFO order among equal wake times
+    bool           deleted;
+    uint32_t       notify;     // task notification value
+    bool           notify_wait;   // blocked in ulTaskNotifyTake
+    uint64_t       cpu_ns;
+    uint64_t       cpu_mark;
+    uint32_t       switches;
+};
+
+typedef struct {
+    int64_t t_us;
+    void  (*fn)(void *);
+    void   *arg;
+} host_event_t;
+
+struct esp_timer {
+    esp_timer_cb_t cb;
+    void          *arg;
+    int64_t        due_us;   // INT64_MAX: not armed
+};
+
+// A core some task is computing on (host_cpu_us()), until until_us.
+typedef struct {
+    struct host_task *task;
+    int64_t           until_us;
+} host_core_t;
+
+static pthread_mutex_t   s_mu      = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t    s_idle_cv = PTHREAD_COND_INITIALIZER;
+static struct host_task *s_tasks[HOST_MAX_TASKS];
+static int               s_ntasks;
+static struct host_task *s_running;          // NULL: the scheduler loop runs
+static int64_t           s_now_us;
+static uint64_t          s_seq;
+static int64_t           s_epoch_s;
+static host_event_t      s_events[HOST_MAX_EVENTS];
+static int               s_nevents;
+static struct esp_timer *s_timers[HOST_MAX_TIMERS];
+static int               s_ntimers;
+static host_core_t       s_cores[HOST_CORES];
+
+static __thread struct host_task *t_self;
+
+_Static_assert(sizeof(struct host_task) <= sizeof(StaticTask_t), "StaticTask_t too small");
+
+static uint64_t thread_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Called with s_mu held by the task that owns the CPU; returns once the
+// scheduler has handed the CPU back to it.
+static void yield_locked(struct host_task *self)
+{
+    self->cpu_ns += thread_cpu_ns() - self->cpu_mark;
+    self->seq = ++s_seq;
+    s_running = NULL;
+    pthread_cond_signal(&s_idle_cv);
+    while (s_running != self) pthread_cond_wait(&self->cv, &s_mu);
+    self->cpu_mark = thread_cpu_ns();
+}
+
+static void *task_entry(void *p)
+{
+    struct host_task *self = p;
+    t_self = self;
+    self->stack_top = __builtin_frame_address(0);
+
+    pthread_mutex_lock(&s_mu);
+    while (s_running != self) pthread_cond_wait(&self->cv, &s_mu);
+    self->cpu_mark = thread_cpu_ns();
+    pthread_mutex_unlock(&s_mu);
+
+    self->fn(self->arg);
+
+    // Returning from a task function is a bug on FreeRTOS; treat it as a
+    // self-delete so one broken task does not stall the simulation.
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+// ===== FreeRTOS API =====
+static bool task_start(struct host_task *t, TaskFunction_t fn, const char *name,
+                       uint32_t stack_depth, void *arg, UBaseType_t prio, BaseType_t core)
+{
+    if (s_ntasks == HOST_MAX_TASKS) return false;
+    snprintf(t->name, sizeof(t->name), "%s", name ? name : "task");
+    t->fn = fn;
+    t->arg = arg;
+    t->stack_depth = stack_depth;
+    t->prio = prio;
+    t->core = core == tskNO_AFFINITY ? -1 : (int)(core % HOST_CORES);
+    pthread_cond_init(&t->cv, NULL);
+
+    // mmap, not malloc: the stack is the host's, not part of the heap figures.
+    t->stack_lo = mmap(NULL, HOST_TASK_STACK, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (t->stack_lo == MAP_FAILED) {
+        fprintf(stderr, "host_rtos: no stack for %s\n", t->name);
+        abort();
+    }
+    memset(t->stack_lo, HOST_STACK_FILL, HOST_TASK_STACK);
+
+    pthread_mutex_lock(&s_mu);
+    t->wake_us = s_now_us;
+    t->seq = ++s_seq;
+    s_tasks[s_ntasks++] = t;
+    pthread_mutex_unlock(&s_mu);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, t->stack_lo, HOST_TASK_STACK);
+    int rc = pthread_create(&t->th, &attr, task_entry, t);
+    pthread_attr_destroy(&attr);
+    if (rc != 0) {
+        fprintf(stderr, "host_rtos: pthread_create failed for %s\n", t->name);
+        abort();
+    }
+    pthread_detach(t->th);
+    return true;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                                   void *arg, UBaseType_t prio, TaskHandle_t *out, BaseType_t core)
+{
+    struct host_task *t = calloc(1, sizeof(*t));
+    if (!t) return pdFAIL;
+    if (!task_start(t, fn, name, stack_depth, arg, prio, core)) {
+        free(t);
+        return pdFAIL;
+    }
+    if (out) *out = t;
+    return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name,
+                                           uint32_t stack_depth, void *arg, UBaseType_t prio,
+                                           StackType_t *stack, StaticTask_t *tcb, BaseType_t core)
+{
+    (void)stack;
+    struct host_task *t = (struct host_task *)tcb;
+    memset(t, 0, sizeof(*t));
+    return task_start(t, fn, name, stack_depth, arg, prio, core) ? t : NULL;
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                               void *arg, UBaseType_t prio, StackType_t *stack,
+                               StaticTask_t *tcb)
+{
+    return xTaskCreateStaticPinnedToCore(fn, name, stack_depth, arg, prio, stack, tcb,
+                                         tskNO_AFFINITY);
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                       void *arg, UBaseType_t prio, TaskHandle_t *out)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack_depth, arg, prio, out, tskNO_AFFINITY);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    const int64_t tick_us = HOST_TICK_US;
+
+    pthread_mutex_lock(&s_mu);
+    struct host_task *self = t_self;
+    if (!self) {
+        // app_main() before the scheduler starts: nothing else can run yet.
+        s_now_us = (s_now_us / tick_us + ticks) * tick_us;
+        pthread_mutex_unlock(&s_mu);
+        return;
+    }
+    // Like the tick interrupt: wake on the tick boundary ticks from now. A
+    // plain yield costs 1 µs so a task polling with vTaskDelay(0) still lets
+    // the clock move instead of livelocking the simulation.
+    self->wake_us = ticks ? (s_now_us / tick_us + ticks) * tick_us : s_now_us + 1;
+    yield_locked(self);
+    pthread_mutex_unlock(&s_mu);
+}
+
+BaseType_t xTaskDelayUntil(TickType_t *prev_wake, TickType_t increment)
+{
+    TickType_t due = *prev_wake + increment;
+    TickType_t now = xTaskGetTickCount();
+    *prev_wake = due;
+    if ((int32_t)(due - now) <= 0) return pdFALSE;
+    vTaskDelay(due - now);
+    return pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    const int64_t tick_us = HOST_TICK_US;
+
+    pthread_mutex_lock(&s_mu);
+    struct host_task *self = t_self;
+    if (self && self->notify == 0 && ticks > 0) {
+        self->wake_us = ticks == portMAX_DELAY ? INT64_MAX
+                                               : (s_now_us / tick_us + ticks) * tick_us;
+        self->notify_wait = true;
+        yield_locked(self);
+        self->notify_wait = false;
+    }
+    uint32_t v = self ? self->notify : 0;
+    if (self && v) self->notify = clear ? 0 : v - 1;
+    pthread_mutex_unlock(&s_mu);
+    return v;
+}
+
+// Called from host_at() events (the "ISR") or another task: a task blocked
+// in ulTaskNotifyTake becomes runnable now.
+static void notify_locked(struct host_task *t)
+{
+    t->notify++;
+    if (t->notify_wait && t->wake_us > s_now_us) {
+        t->wake_us = s_now_us;
+        t->seq = ++s_seq;
+    }
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken)
+{
+    pthread_mutex_lock(&s_mu);
+    notify_locked(task);
+    pthread_mutex_unlock(&s_mu);
+    if (woken) *woken = pdTRUE;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&s_mu);
+    notify_locked(task);
+    pthread_mutex_unlock(&s_mu);
+    return pdPASS;
+}
+
+// Deepest the task has reached below its entry frame: the lowest byte that
+// no longer holds the fill pattern.
+static uint32_t stack_used(const struct host_task *t)
+{
+    if (!t->stack_top) return 0;
+    const uint8_t *p = t->stack_lo;
+    while (p < t->stack_top && *p == HOST_STACK_FILL) ++p;
+    return (uint32_t)(t->stack_top - p);
+}
+
+// What is left of the requested depth at the deepest point so far.
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    struct host_task *t = task ? task : t_self;
+    if (!t) return 0;
+    uint32_t used = stack_used(t);
+    return used < t->stack_depth ? t->stack_depth - used : 0;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(host_now_us() / HOST_TICK_US);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return t_self;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    pthread_mutex_lock(&s_mu);
+    struct host_task *t = task ? task : t_self;
+    if (!t) {
+        pthread_mutex_unlock(&s_mu);
+        return;
+    }
+    t->deleted = true;
+    if (t == t_self) {
+        t->cpu_ns += thread_cpu_ns() - t->cpu_mark;
+        s_running = NULL;
+        pthread_cond_signal(&s_idle_cv);
+        pthread_mutex_unlock(&s_mu);
+        pthread_exit(NULL);
+    }
+    pthread_mutex_unlock(&s_mu);
+}
+
+// ===== Clock =====
+int64_t esp_timer_get_time(void)
+{
+    pthread_mutex_lock(&s_mu);
+    int64_t now = s_now_us;
+    pthread_mutex_unlock(&s_mu);
+    return now;
+}
+
+int64_t host_now_us(void)
+{
+    return esp_timer_get_time();
+}
+
+void host_set_epoch(int64_t unix_s)
+{
+    s_epoch_s = unix_s;
+}
+
+// The firmware reads the wall clock through time() only; this definition
+// takes precedence over libc's for every caller in the executable.
+time_t time(time_t *out)
+{
+    time_t now = (time_t)(s_epoch_s + host_now_us() / 1000000);
+    if (out) *out = now;
+    return now;
+}
+
+void host_block_us(int64_t us)
+{
+    pthread_mutex_lock(&s_mu);
+    struct host_task *self = t_self;
+    if (!self) {
+        s_now_us += us;
+    } else {
+        self->wake_us = s_now_us + us;
+        yield_locked(self);
+    }
+    pthread_mutex_unlock(&s_mu);
+}
+
+void host_cpu_us(int64_t us)
+{
+    pthread_mutex_lock(&s_mu);
+    struct host_task *self = t_self;
+    if (!self) {
+        s_now_us += us;
+        pthread_mutex_unlock(&s_mu);
+        return;
+    }
+    int c = self->core;
+    for (int i = 0; c < 0 && i < HOST_CORES; ++i) {
+        if (!s_cores[i].task || s_cores[i].until_us <= s_now_us) c = i;
+    }
+    if (c < 0) c = 0;
+    s_cores[c] = (host_core_t){ self, s_now_us + us };
+    self->wake_us = s_now_us + us;
+    yield_locked(self);
+    if (s_cores[c].task == self) s_cores[c].task = NULL;
+    pthread_mutex_unlock(&s_mu);
+}
+
+void host_at(int64_t t_us, void (*fn)(void *), void *arg)
+{
+    pthread_mutex_lock(&s_mu);
+    if (s_nevents == HOST_MAX_EVENTS) {
+        fprintf(stderr, "host_rtos: event queue full\n");
+        abort();
+    }
+    int i = s_nevents++;
+    while (i > 0 && s_events[i - 1].t_us > t_us) {   // keep sorted by time
+        s_events[i] = s_events[i - 1];
+        --i;
+    }
+    s_events[i] = (host_event_t){ t_us, fn, arg };
+    pthread_mutex_unlock(&s_mu);
+}
+
+// ===== esp_timer =====
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    struct esp_timer *tm = calloc(1, sizeof(*tm));
+    if (!tm) return ESP_ERR_NO_MEM;
+    tm->cb = args->callback;
+    tm->arg = args->arg;
+    tm->due_us = INT64_MAX;
+    pthread_mutex_lock(&s_mu);
+    if (s_ntimers == HOST_MAX_TIMERS) {
+        pthread_mutex_unlock(&s_mu);
+        free(tm);
+        return ESP_ERR_NO_MEM;
+    }
+    s_timers[s_ntimers++] = tm;
+    pthread_mutex_unlock(&s_mu);
+    *out = tm;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t tm, uint64_t timeout_us)
+{
+    pthread_mutex_lock(&s_mu);
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    if (tm->due_us == INT64_MAX) {
+        tm->due_us = s_now_us + (int64_t)timeout_us;
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&s_mu);
+    return err;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t tm)
+{
+    pthread_mutex_lock(&s_mu);
+    esp_err_t err = tm->due_us == INT64_MAX ? ESP_ERR_INVALID_STATE : ESP_OK;
+    tm->due_us = INT64_MAX;
+    pthread_mutex_unlock(&s_mu);
+    return err;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t tm)
+{
+    pthread_mutex_lock(&s_mu);
+    for (int i = 0; i < s_ntimers; ++i) {
+        if (s_timers[i] == tm) s_timers[i] = s_timers[--s_ntimers];
+    }
+    pthread_mutex_unlock(&s_mu);
+    free(tm);
+    return ESP_OK;
+}
+
+// ===== Scheduler loop =====
+// When t, runnable from wake_us, gets core c (see the top of the file).
+static int64_t start_on(const struct host_task *t, int c)
+{
+    const host_core_t *k = &s_cores[c];
+    int64_t w = t->wake_us;
+    if (!k->task || k->task == t || k->until_us <= w || t->prio > k->task->prio) return w;
+    if (t->prio < k->task->prio) return k->until_us;
+    int64_t tick = (w / HOST_TICK_US + 1) * HOST_TICK_US;
+    return tick < k->until_us ? tick : k->until_us;
+}
+
+static int64_t start_us(const struct host_task *t)
+{
+    if (t->core >= 0) return start_on(t, t->core);
+    int64_t best = INT64_MAX;
+    for (int c = 0; c < HOST_CORES; ++c) {
+        int64_t s = start_on(t, c);
+        if (s < best) best = s;
+    }
+    return best;
+}
+
+static struct host_task *next_task(int64_t *start)
+{
+    struct host_task *best = NULL;
+    int64_t best_us = INT64_MAX;
+    for (int i = 0; i < s_ntasks; ++i) {
+        struct host_task *t = s_tasks[i];
+        if (t->deleted) continue;
+        int64_t us = start_us(t);
+        if (!best || us < best_us || (us == best_us && t->seq < best->seq)) {
+            best = t;
+            best_us = us;
+        }
+    }
+    *start = best_us;
+    return best;
+}
+
+static struct esp_timer *next_timer(void)
+{
+    struct esp_timer *best = NULL;
+    for (int i = 0; i < s_ntimers; ++i) {
+        if (!best || s_timers[i]->due_us < best->due_us) best = s_timers[i];
+    }
+    return best && best->due_us != INT64_MAX ? best : NULL;
+}
+
+void host_rtos_run(int64_t until_us)
+{
+    pthread_mutex_lock(&s_mu);
+    for (;;) {
+        int64_t start;
+        struct host_task *t = next_task(&start);
+        int64_t next = t ? start : until_us;
+        if (next > until_us) next = until_us;
+
+        // Events and timers due before the next task runs go first, in time
+        // order. A one-shot timer is disarmed before its callback runs.
+        struct esp_timer *tm = next_timer();
+        if (tm && tm->due_us <= next &&
+            (s_nevents == 0 || tm->due_us < s_events[0].t_us)) {
+            if (tm->due_us > s_now_us) s_now_us = tm->due_us;
+            tm->due_us = INT64_MAX;
+            pthread_mutex_unlock(&s_mu);
+            tm->cb(tm->arg);
+            pthread_mutex_lock(&s_mu);
+            continue;
+        }
+        if (s_nevents > 0 && s_events[0].t_us <= next) {
+            host_event_t ev = s_events[0];
+            memmove(&s_events[0], &s_events[1], (size_t)(--s_nevents) * sizeof(s_events[0]));
+            if (ev.t_us > s_now_us) s_now_us = ev.t_us;
+            pthread_mutex_unlock(&s_mu);
+            ev.fn(ev.arg);
+            pthread_mutex_lock(&s_mu);
+            continue;
+        }
+
+        if (next > s_now_us) s_now_us = next;
+        if (!t || start > until_us) break;
+
+        t->switches++;
+        s_running = t;
+        pthread_cond_signal(&t->cv);
+        while (s_running != NULL) pthread_cond_wait(&s_idle_cv, &s_mu);
+    }
+    pthread_mutex_unlock(&s_mu);
+}
+
+int host_rtos_tasks(host_task_info_t *out, int max)
+{
+    pthread_mutex_lock(&s_mu);
+    int n = 0;
+    for (int i = 0; i < s_ntasks && n < max; ++i, ++n) {
+        out[n].name     = s_tasks[i]->name;
+        out[n].cpu_ns   = s_tasks[i]->cpu_ns;
+        out[n].switches = s_tasks[i]->switches;
+        out[n].stack_depth = s_tasks[i]->stack_depth;
+        out[n].stack_used  = stack_used(s_tasks[i]);
+        out[n].prio        = s_tasks[i]->prio;
+        out[n].core        = s_tasks[i]->core;
+    }
+    pthread_mutex_unlock(&s_mu);
+    return n;
+}
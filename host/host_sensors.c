@@ -0,0 +1,456 @@
+// host/host_sensors.c — I2C/GPIO drivers backed by scripted sensor models
+//
+// The i2c_master driver calls are played against models of the BH1750 (0x23)
+// and BME280 (0x76). Register maps, byte order and the BME280 temperature
+// compensation match the parts, so sensors.c runs unmodified. Each
+// transaction blocks the caller for its time on the bus at the device's SCL
+// speed (9 bit times per byte). host_i2c_set_fault_rate() makes the bus hang
+// so that timeouts and bus clears can be exercised.
+#include "host.h"
+#include "driver/i2c_master.h"
+#include "driver/gpio.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BH1750_ADDR   0x23
+#define BME280_ADDR   0x76
+#define PIR_GPIO      27
+
+// ===== Script =====
+typedef struct {
+    double t_s;
+    float  temp_c;
+    float  lux;
+    bool   pir;
+} script_pt_t;
+
+static script_pt_t *s_pts;
+static size_t       s_npts;
+static int64_t      s_epoch;   // wall clock at t = 0, for the built-in day
+
+// Built-in day on the local wall clock: 22 °C ± 1.5 over 24 h, daylight
+// 08:00–18:00 peaking at ~600 lx with small ripple, and a room occupied
+// 09:00–17:00 where the PIR fires for 4 s out of every 45 s.
+static void synthetic(double t, float *temp, float *lux, bool *pir)
+{
+    time_t wall = (time_t)(s_epoch + (int64_t)t);
+    struct tm tm;
+    localtime_r(&wall, &tm);
+    double day = tm.tm_hour * 3600.0 + tm.tm_min * 60.0 + tm.tm_sec + (t - floor(t));
+    double h = day / 3600.0;
+    *temp = (float)(22.0 + 1.5 * sin(2 * M_PI * (h - 9.0) / 24.0) + 0.05 * sin(t / 7.0));
+    double sun = (h > 8.0 && h < 18.0) ? sin(M_PI * (h - 8.0) / 10.0) : 0.0;
+    *lux = (float)(5.0 + 600.0 * sun + 3.0 * sin(t / 3.0));
+    *pir = (h >= 9.0 && h < 17.0) && fmod(day, 45.0) < 4.0;
+}
+
+static void script_at(double t, float *temp, float *lux, bool *pir)
+{
+    if (s_npts == 0) {
+        synthetic(t, temp, lux, pir);
+        return;
+    }
+    if (t <= s_pts[0].t_s) {
+        *temp = s_pts[0].temp_c; *lux = s_pts[0].lux; *pir = s_pts[0].pir;
+        return;
+    }
+    size_t i = 1;
+    while (i < s_npts && s_pts[i].t_s < t) ++i;
+    if (i == s_npts) {
+        const script_pt_t *p = &s_pts[s_npts - 1];
+        *temp = p->temp_c; *lux = p->lux; *pir = p->pir;
+        return;
+    }
+    const script_pt_t *a = &s_pts[i - 1], *b = &s_pts[i];
+    double f = (t - a->t_s) / (b->t_s - a->t_s);
+    *temp = (float)(a->temp_c + f * (b->temp_c - a->temp_c));
+    *lux  = (float)(a->lux + f * (b->lux - a->lux));
+    *pir  = a->pir;
+}
+
+static double now_s(void)
+{
+    return (double)host_now_us() / 1e6;
+}
+
+esp_err_t host_sensors_load(const char *path, int64_t epoch_s)
+{
+    s_epoch = epoch_s;
+    free(s_pts);
+    s_pts = NULL;
+    s_npts = 0;
+    if (!path) return ESP_OK;
+
+    FILE *f = fopen(path, "r");
+    if (!f) return ESP_ERR_NOT_FOUND;
+    size_t cap = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        for (char *c = line; *c; ++c) if (*c == ',') *c = ' ';
+        char *p = line;
+        while (isspace((unsigned char)*p)) ++p;
+        if (*p == '#' || *p == '\0') continue;
+        script_pt_t pt;
+        int pir = 0;
+        if (sscanf(p, "%lf %f %f %d", &pt.t_s, &pt.temp_c, &pt.lux, &pir) != 4) {
+            fclose(f);
+            return ESP_ERR_INVALID_ARG;
+        }
+        pt.pir = pir != 0;
+        if (s_npts == cap) {
+            cap = cap ? cap * 2 : 64;
+            s_pts = realloc(s_pts, cap * sizeof(*s_pts));
+            if (!s_pts) { fclose(f); return ESP_ERR_NO_MEM; }
+        }
+        s_pts[s_npts++] = pt;
+    }
+    fclose(f);
+    return s_npts ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+// ===== Device models =====
+typedef struct i2c_dev {
+    uint8_t addr;
+    void  (*start)(struct i2c_dev *d, bool read);   // addressed after a (re)start
+    void  (*write)(struct i2c_dev *d, uint8_t b);
+    void  (*read)(struct i2c_dev *d, uint8_t *buf, size_t len);
+} i2c_dev_t;
+
+// --- BH1750: command writes, 2-byte big-endian reads of lux * 1.2 ---
+static bool   s_bh_on, s_bh_measuring;
+static size_t s_bh_idx;   // byte position within the current read
+
+// Sampler loop jitter: how much later than one period (sensors.c reads the
+// BH1750 every SENSORS_BH1750_PERIOD_MS) after the previous read each read
+// comes, in JITTER_BIN_US bins; the last bin takes everything beyond.
+#define BH1750_PERIOD_US 120000
+#define JITTER_BIN_US    100
+#define JITTER_BINS      65536
+static uint32_t s_jitter[JITTER_BINS];
+static uint32_t s_jitter_n;
+static int64_t  s_bh_last_us = -1;
+
+static void jitter_add(int64_t now)
+{
+    if (s_bh_last_us >= 0) {
+        int64_t late = now - s_bh_last_us - BH1750_PERIOD_US;
+        int64_t bin = late < 0 ? 0 : late / JITTER_BIN_US;
+        s_jitter[bin < JITTER_BINS ? bin : JITTER_BINS - 1]++;
+        s_jitter_n++;
+    }
+    s_bh_last_us = now;
+}
+
+static uint32_t jitter_quantile(uint32_t per_mille)
+{
+    uint64_t want = ((uint64_t)s_jitter_n * per_mille + 999) / 1000, seen = 0;
+    for (uint32_t b = 0; b < JITTER_BINS; ++b) {
+        seen += s_jitter[b];
+        if (seen >= want && s_jitter[b]) return (b + 1) * JITTER_BIN_US;
+    }
+    return 0;
+}
+
+void host_sensors_jitter(host_jitter_t *out)
+{
+    out->count  = s_jitter_n;
+    out->p50_us = jitter_quantile(500);
+    out->p90_us = jitter_quantile(900);
+    out->p99_us = jitter_quantile(990);
+    out->p999_us = jitter_quantile(999);
+    out->max_us = jitter_quantile(1000);
+}
+
+static void bh_start(i2c_dev_t *d, bool read) { (void)d; (void)read; s_bh_idx = 0; }
+
+static void bh_write(i2c_dev_t *d, uint8_t cmd)
+{
+    (void)d;
+    if (cmd == 0x00) { s_bh_on = false; s_bh_measuring = false; }
+    else if (cmd == 0x01) s_bh_on = true;
+    else if ((cmd & 0xF0) == 0x10 || (cmd & 0xF0) == 0x20) s_bh_measuring = s_bh_on;
+}
+
+static void bh_read(i2c_dev_t *d, uint8_t *buf, size_t len)
+{
+    (void)d;
+    uint16_t raw = 0;
+    if (s_bh_measuring) {
+        if (s_bh_idx == 0) jitter_add(host_now_us());
+        float temp, lux; bool pir;
+        script_at(now_s(), &temp, &lux, &pir);
+        float r = lux * 1.2f;
+        raw = r <= 0 ? 0 : r >= 65535.0f ? 65535 : (uint16_t)lroundf(r);
+    }
+    for (size_t i = 0; i < len; ++i, ++s_bh_idx) {
+        buf[i] = s_bh_idx == 0 ? (uint8_t)(raw >> 8) : s_bh_idx == 1 ? (uint8_t)raw : 0xFF;
+    }
+}
+
+// --- BME280: register file, first written byte is the register pointer ---
+// Calibration values are the datasheet's worked example.
+#define BME_DIG_T1 27504
+#define BME_DIG_T2 26435
+#define BME_DIG_T3 (-1000)
+
+static uint8_t s_bme_regs[256];
+static uint8_t s_bme_ptr;
+static bool    s_bme_first;
+
+static int32_t bme_comp_centi(int32_t adc_T)
+{
+    int32_t var1 = ((((adc_T >> 3) - ((int32_t)BME_DIG_T1 << 1))) * ((int32_t)BME_DIG_T2)) >> 11;
+    int32_t var2 = (((((adc_T >> 4) - ((int32_t)BME_DIG_T1)) * ((adc_T >> 4) - ((int32_t)BME_DIG_T1))) >> 12) *
+                    ((int32_t)BME_DIG_T3)) >> 14;
+    return ((var1 + var2) * 5 + 128) >> 8;
+}
+
+// Raw 20-bit ADC value that compensates to temp_c (monotonic, so bisect).
+static int32_t bme_adc_for(float temp_c)
+{
+    int32_t want = (int32_t)lroundf(temp_c * 100.0f);
+    int32_t lo = 0, hi = (1 << 20) - 1;
+    while (lo < hi) {
+        int32_t mid = lo + (hi - lo) / 2;
+        if (bme_comp_centi(mid) < want) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+static void bme_reset_regs(void)
+{
+    memset(s_bme_regs, 0, sizeof(s_bme_regs));
+    s_bme_regs[0xD0] = 0x60;
+    s_bme_regs[0x88] = BME_DIG_T1 & 0xFF;
+    s_bme_regs[0x89] = (uint8_t)(BME_DIG_T1 >> 8);
+    s_bme_regs[0x8A] = BME_DIG_T2 & 0xFF;
+    s_bme_regs[0x8B] = (uint8_t)(BME_DIG_T2 >> 8);
+    s_bme_regs[0x8C] = (uint8_t)(BME_DIG_T3 & 0xFF);
+    s_bme_regs[0x8D] = (uint8_t)((uint16_t)BME_DIG_T3 >> 8);
+    s_bme_regs[0xFA] = 0x80;   // reset value of the temperature registers
+}
+
+static void bme_start(i2c_dev_t *d, bool read) { (void)d; s_bme_first = !read; }
+
+static void bme_write(i2c_dev_t *d, uint8_t b)
+{
+    (void)d;
+    if (s_bme_first) {
+        s_bme_ptr = b;
+        s_bme_first = false;
+        return;
+    }
+    if (s_bme_ptr == 0xE0 && b == 0xB6) {
+        bme_reset_regs();
+    } else if (s_bme_ptr >= 0xF2 && s_bme_ptr <= 0xF5) {
+        s_bme_regs[s_bme_ptr] = b;
+    }
+    s_bme_ptr++;
+}
+
+static void bme_read(i2c_dev_t *d, uint8_t *buf, size_t len)
+{
+    (void)d;
+    // Any measurement mode has produced a conversion by the time anyone reads.
+    if ((s_bme_regs[0xF4] & 0x03) != 0 && (s_bme_regs[0xF4] >> 5) != 0) {
+        float temp, lux; bool pir;
+        script_at(now_s(), &temp, &lux, &pir);
+        int32_t adc = bme_adc_for(temp);
+        s_bme_regs[0xFA] = (uint8_t)(adc >> 12);
+        s_bme_regs[0xFB] = (uint8_t)(adc >> 4);
+        s_bme_regs[0xFC] = (uint8_t)((adc & 0x0F) << 4);
+    }
+    for (size_t i = 0; i < len; ++i) buf[i] = s_bme_regs[(uint8_t)(s_bme_ptr + i)];
+    s_bme_ptr = (uint8_t)(s_bme_ptr + len);
+}
+
+static i2c_dev_t s_devs[] = {
+    { BH1750_ADDR, bh_start,  bh_write,  bh_read  },
+    { BME280_ADDR, bme_start, bme_write, bme_read },
+};
+
+// ===== I2C master driver =====
+struct host_i2c_bus {
+    bool stuck;            // a slave holds SDA low until the next bus reset
+};
+
+struct host_i2c_dev {
+    i2c_dev_t *model;      // NULL: nobody answers at this address
+    uint32_t   hz;
+};
+
+static struct host_i2c_bus s_bus;
+static struct host_i2c_dev s_handles[8];
+static int                 s_nhandles;
+static host_i2c_stats_t    s_i2c;
+static double              s_fault_rate;
+static int                 s_bus_init_fails;
+
+void host_i2c_set_fault_rate(double p)
+{
+    s_fault_rate = p;
+}
+
+void host_i2c_fail_bus_init(int n)
+{
+    s_bus_init_fails = n;
+}
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *cfg, i2c_master_bus_handle_t *ret)
+{
+    (void)cfg;
+    if (s_bus_init_fails > 0) {
+        s_bus_init_fails--;
+        return ESP_FAIL;
+    }
+    bme_reset_regs();
+    s_bus.stuck = false;
+    *ret = &s_bus;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus, const i2c_device_config_t *cfg,
+                                    i2c_master_dev_handle_t *ret)
+{
+    (void)bus;
+    if (s_nhandles == (int)(sizeof(s_handles) / sizeof(s_handles[0]))) return ESP_ERR_NO_MEM;
+    struct host_i2c_dev *h = &s_handles[s_nhandles++];
+    h->model = NULL;
+    for (size_t k = 0; k < sizeof(s_devs) / sizeof(s_devs[0]); ++k) {
+        if (s_devs[k].addr == cfg->device_address) h->model = &s_devs[k];
+    }
+    h->hz = cfg->scl_speed_hz ? cfg->scl_speed_hz : 100000;
+    *ret = h;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_reset(i2c_master_bus_handle_t bus)
+{
+    s_i2c.resets++;
+    bus->stuck = false;
+    host_block_us(9 * 10 + 20);   // 9 SCL pulses at ~100 kHz + STOP
+    return ESP_OK;
+}
+
+// One transaction: [START addr+W wr...] [(RE)START addr+R rd...] STOP. The
+// caller is blocked for the bus time (9 bit times per byte plus START/STOP)
+// and ~20 µs of driver overhead.
+static esp_err_t xfer(struct host_i2c_dev *h, const uint8_t *wr, size_t wr_len,
+                      uint8_t *rd, size_t rd_len, int timeout_ms)
+{
+    s_i2c.xfers++;
+    if (!s_bus.stuck && s_fault_rate > 0 && (double)rand() / RAND_MAX < s_fault_rate) {
+        s_bus.stuck = true;
+    }
+    if (s_bus.stuck) {
+        s_i2c.timeouts++;
+        host_block_us((int64_t)timeout_ms * 1000);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    uint32_t bytes = 1;
+    esp_err_t err = ESP_OK;
+    if (!h->model) {
+        s_i2c.nacks++;
+        err = ESP_ERR_INVALID_STATE;   // address NACK
+    } else {
+        if (wr_len > 0) {
+            h->model->start(h->model, false);
+            for (size_t i = 0; i < wr_len; ++i) h->model->write(h->model, wr[i]);
+            bytes += (uint32_t)wr_len;
+            if (rd_len > 0) bytes++;   // repeated start + addr+R
+        }
+        if (rd_len > 0) {
+            h->model->start(h->model, true);
+            h->model->read(h->model, rd, rd_len);
+            bytes += (uint32_t)rd_len;
+        }
+    }
+    s_i2c.bytes += bytes;
+    host_block_us((int64_t)(bytes * 9 + 2) * 1000000 / h->hz + 20);
+    return err;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t dev, const uint8_t *wr, size_t wr_len,
+                              int timeout_ms)
+{
+    return xfer(dev, wr, wr_len, NULL, 0, timeout_ms);
+}
+
+esp_err_t i2c_master_receive(i2c_master_dev_handle_t dev, uint8_t *rd, size_t rd_len,
+                             int timeout_ms)
+{
+    return xfer(dev, NULL, 0, rd, rd_len, timeout_ms);
+}
+
+esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t dev, const uint8_t *wr,
+                                      size_t wr_len, uint8_t *rd, size_t rd_len, int timeout_ms)
+{
+    return xfer(dev, wr, wr_len, rd, rd_len, timeout_ms);
+}
+
+void host_i2c_get_stats(host_i2c_stats_t *out)
+{
+    *out = s_i2c;
+}
+
+// ===== GPIO (PIR) =====
+static gpio_isr_t s_pir_isr;
+static void      *s_pir_arg;
+
+static bool pir_level(double t)
+{
+    float temp, lux; bool pir;
+    script_at(t, &temp, &lux, &pir);
+    return pir;
+}
+
+// Next time the PIR level changes, searched at 50 ms resolution (a day at most).
+static double pir_next_edge(double t)
+{
+    bool cur = pir_level(t);
+    for (double dt = 0.05; dt < 86400.0; dt += 0.05) {
+        if (pir_level(t + dt) != cur) return t + dt;
+    }
+    return -1.0;
+}
+
+static void pir_fire(void *arg)
+{
+    (void)arg;
+    if (s_pir_isr) s_pir_isr(s_pir_arg);
+    double next = pir_next_edge(now_s());
+    if (next > 0) host_at((int64_t)(next * 1e6), pir_fire, NULL);
+}
+
+esp_err_t gpio_config(const gpio_config_t *cfg)
+{
+    (void)cfg;
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio)
+{
+    return gpio == PIR_GPIO ? pir_level(now_s()) : 0;
+}
+
+esp_err_t gpio_install_isr_service(int flags)
+{
+    (void)flags;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t isr, void *arg)
+{
+    if (gpio != PIR_GPIO) return ESP_OK;
+    s_pir_isr = isr;
+    s_pir_arg = arg;
+    double next = pir_next_edge(now_s());
+    if (next > 0) host_at((int64_t)(next * 1e6), pir_fire, NULL);
+    return ESP_OK;
+}
@@ -0,0 +1,386 @@
+// host/host_stubs.c — small IDF services for the host build: logging, NVS,
+// SNTP, RNG, Wi-Fi, plus heap accounting through the linker's --wrap
+#include "host.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "esp_sntp.h"
+#include "wifi.h"
+#include "metrics.h"
+#include "alloc_trace.h"
+
+#include <malloc.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "HOST";
+
+// ===== esp_err =====
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK:                   return "ESP_OK";
+    case ESP_FAIL:                 return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:           return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:      return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:    return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:     return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:    return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:          return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC:      return "ESP_ERR_INVALID_CRC";
+    default:                       return "UNKNOWN ERROR";
+    }
+}
+
+// ===== esp_log =====
+// Only lines at or above s_log_level reach stdout, but every line the
+// firmware's own level (INFO) lets through occupies the console UART: the
+// writer blocks until its bytes are out, queued behind earlier lines, as
+// with the blocking console driver.
+static esp_log_level_t s_log_level = ESP_LOG_INFO;
+static uint32_t        s_uart_baud = 115200;
+static int64_t         s_uart_free_us;       // transmitter idle from here on
+static uint64_t        s_uart_bytes;
+static int64_t         s_uart_busy_us;
+
+void host_log_set_level(esp_log_level_t level)
+{
+    s_log_level = level;
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;
+    s_log_level = level;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)(host_now_us() / 1000);
+}
+
+void host_uart_set_baud(uint32_t baud)
+{
+    s_uart_baud = baud;
+}
+
+void host_uart_get_stats(uint64_t *bytes, int64_t *busy_us)
+{
+    *bytes = s_uart_bytes;
+    *busy_us = s_uart_busy_us;
+}
+
+void host_uart_write(size_t len)
+{
+    s_uart_bytes += len;
+    if (!s_uart_baud) return;
+    int64_t now = host_now_us();
+    int64_t tx_us = (int64_t)len * 10 * 1000000 / s_uart_baud;   // 8N1
+    s_uart_free_us = (s_uart_free_us > now ? s_uart_free_us : now) + tx_us;
+    s_uart_busy_us += tx_us;
+    host_block_us(s_uart_free_us - now);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *fmt, ...)
+{
+    (void)tag;
+    if (level > s_log_level && level > ESP_LOG_INFO) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int len = level <= s_log_level ? vprintf(fmt, ap) : vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (len > 0 && level <= ESP_LOG_INFO) host_uart_write((size_t)len);
+}
+
+// ===== Bytes on the wire (host_http.c, host_mqtt.c) =====
+static uint64_t s_wire_out, s_wire_in;
+
+void host_wire_count(size_t out, size_t in)
+{
+    s_wire_out += out;
+    s_wire_in += in;
+}
+
+void host_wire_get(uint64_t *out, uint64_t *in)
+{
+    if (out) *out = s_wire_out;
+    if (in)  *in  = s_wire_in;
+}
+
+// ===== esp_random: xorshift32, repeatable per seed =====
+static uint32_t s_rng = 0x2545F491u;
+
+void host_random_seed(uint32_t seed)
+{
+    s_rng = seed ? seed : 0x2545F491u;
+}
+
+uint32_t esp_random(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+// ===== NVS / SNTP / Wi-Fi: the host network and clock are always up =====
+esp_err_t nvs_flash_init(void)  { return ESP_OK; }
+esp_err_t nvs_flash_erase(void) { return ESP_OK; }
+
+// NVS blobs: a fixed table, read from HOST_NVS_FILE on first use and written
+// back whole on every commit. A handle is its namespace's slot + 1.
+#define NVS_ENTRIES   16
+#define NVS_BLOB_MAX  64
+
+typedef struct {
+    char     ns[16];
+    char     key[16];
+    uint32_t len;
+    uint8_t  data[NVS_BLOB_MAX];
+} nvs_entry_t;
+
+static nvs_entry_t s_nvs[NVS_ENTRIES];
+static char        s_nvs_ns[NVS_ENTRIES][16];
+static bool        s_nvs_loaded;
+
+static void nvs_load(void)
+{
+    if (s_nvs_loaded) return;
+    s_nvs_loaded = true;
+    FILE *f = fopen(HOST_NVS_FILE, "rb");
+    if (!f) return;
+    if (fread(s_nvs, sizeof(s_nvs), 1, f) != 1) memset(s_nvs, 0, sizeof(s_nvs));
+    fclose(f);
+}
+
+static nvs_entry_t *nvs_find(nvs_handle_t h, const char *key, bool create)
+{
+    if (h == 0 || h > NVS_ENTRIES || !key) return NULL;
+    const char *ns = s_nvs_ns[h - 1];
+    nvs_entry_t *free_slot = NULL;
+    for (int i = 0; i < NVS_ENTRIES; ++i) {
+        if (!s_nvs[i].ns[0]) {
+            if (!free_slot) free_slot = &s_nvs[i];
+        } else if (!strcmp(s_nvs[i].ns, ns) && !strcmp(s_nvs[i].key, key)) {
+            return &s_nvs[i];
+        }
+    }
+    if (!create || !free_slot) return NULL;
+    snprintf(free_slot->ns, sizeof(free_slot->ns), "%s", ns);
+    snprintf(free_slot->key, sizeof(free_slot->key), "%s", key);
+    free_slot->len = 0;
+    return free_slot;
+}
+
+esp_err_t nvs_open(const char *name_space, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    (void)mode;
+    nvs_load();
+    for (int i = 0; i < NVS_ENTRIES; ++i) {
+        if (!s_nvs_ns[i][0] || !strcmp(s_nvs_ns[i], name_space)) {
+            snprintf(s_nvs_ns[i], sizeof(s_nvs_ns[i]), "%s", name_space);
+            *out = (nvs_handle_t)i + 1;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len)
+{
+    nvs_entry_t *e = nvs_find(h, key, false);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+    if (out) {
+        if (*len < e->len) return ESP_ERR_INVALID_SIZE;
+        memcpy(out, e->data, e->len);
+    }
+    *len = e->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *value, size_t len)
+{
+    if (len > NVS_BLOB_MAX) return ESP_ERR_INVALID_SIZE;
+    nvs_entry_t *e = nvs_find(h, key, true);
+    if (!e) return ESP_ERR_NO_MEM;
+    memcpy(e->data, value, len);
+    e->len = (uint32_t)len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t h)
+{
+    (void)h;
+    FILE *f = fopen(HOST_NVS_FILE, "wb");
+    if (!f) return ESP_FAIL;
+    bool ok = fwrite(s_nvs, sizeof(s_nvs), 1, f) == 1;
+    return fclose(f) == 0 && ok ? ESP_OK : ESP_FAIL;
+}
+
+void nvs_close(nvs_handle_t h) { (void)h; }
+
+// ===== SNTP =====
+static int64_t s_sntp_epoch;
+static int64_t s_sntp_at_us;
+static sntp_sync_time_cb_t s_sntp_cb;
+
+void host_sntp_set(int64_t unix_s, double sync_s)
+{
+    s_sntp_epoch = unix_s;
+    s_sntp_at_us = (int64_t)(sync_s * 1e6);
+    host_set_epoch(s_sntp_at_us > 0 ? 0 : unix_s);
+}
+
+static void sntp_fire(void *arg)
+{
+    (void)arg;
+    host_set_epoch(s_sntp_epoch);
+    int64_t now = host_now_us();
+    struct timeval tv = { .tv_sec = (time_t)(s_sntp_epoch + now / 1000000),
+                          .tv_usec = (suseconds_t)(now % 1000000) };
+    if (s_sntp_cb) s_sntp_cb(&tv);
+}
+
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback) { s_sntp_cb = callback; }
+void sntp_setoperatingmode(uint8_t mode)                { (void)mode; }
+void sntp_setservername(uint8_t idx, const char *server) { (void)idx; (void)server; }
+void sntp_init(void)
+{
+    if (s_sntp_at_us > 0) host_at(s_sntp_at_us, sntp_fire, NULL);
+}
+void sntp_stop(void) {}
+
+// ===== Wi-Fi =====
+static int64_t s_wifi_at_us;
+
+void host_wifi_set(double ip_s)
+{
+    s_wifi_at_us = (int64_t)(ip_s * 1e6);
+}
+
+static void wifi_got_ip(void *arg)
+{
+    (void)arg;
+    metrics_boot_mark(METRIC_B_FIRST_IP);
+}
+
+void wifi_init_auto(void)
+{
+    ESP_LOGI(TAG, "Wi-Fi: host network");
+    host_at(s_wifi_at_us, wifi_got_ip, NULL);
+}
+
+void wifi_init_prefer_closed(void)
+{
+    wifi_init_auto();
+}
+
+TaskHandle_t wifi_task_handle(void)
+{
+    return NULL;   // no connection manager task on the host
+}
+
+bool wifi_wait_ip(uint32_t timeout_ms)
+{
+    int64_t left = s_wifi_at_us - host_now_us();
+    if (left <= 0) return true;
+    if (left > (int64_t)timeout_ms * 1000) {
+        host_block_us((int64_t)timeout_ms * 1000);
+        return false;
+    }
+    host_block_us(left);
+    return true;
+}
+
+// ===== Heap accounting (-Wl,--wrap=malloc,...) =====
+void *__real_malloc(size_t n);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t n);
+void  __real_free(void *p);
+
+static atomic_size_t   s_in_use;
+static atomic_size_t   s_peak;
+static atomic_uint     s_allocs;
+static __thread int    t_untracked;   // host_heap_untracked() depth
+
+void host_heap_untracked(bool on)
+{
+    t_untracked += on ? 1 : -1;
+}
+
+// Every allocation the firmware (or an IDF shim) makes also goes to
+// alloc_trace, as the heap hooks would pass it on the device.
+static void account_add(void *p, bool traced)
+{
+    if (!p || t_untracked) return;
+    size_t size = malloc_usable_size(p);
+    size_t now = atomic_fetch_add(&s_in_use, size) + size;
+    size_t peak = atomic_load(&s_peak);
+    while (now > peak && !atomic_compare_exchange_weak(&s_peak, &peak, now)) {}
+    if (!traced) return;
+    atomic_fetch_add(&s_allocs, 1);
+    alloc_trace_note(size);
+}
+
+static void account_sub(void *p)
+{
+    if (p && !t_untracked) atomic_fetch_sub(&s_in_use, malloc_usable_size(p));
+}
+
+void *__wrap_malloc(size_t n)
+{
+    void *p = __real_malloc(n);
+    account_add(p, true);
+    return p;
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    void *p = __real_calloc(n, size);
+    account_add(p, true);
+    return p;
+}
+
+void *__wrap_realloc(void *old, size_t n)
+{
+    account_sub(old);
+    void *p = __real_realloc(old, n);
+    if (p) {
+        account_add(p, true);
+    } else if (n) {
+        account_add(old, false);   // failed: the old block is still held
+    }
+    return p;
+}
+
+void __wrap_free(void *p)
+{
+    account_sub(p);
+    __real_free(p);
+}
+
+void host_heap_get(size_t *in_use, size_t *peak, uint32_t *allocs)
+{
+    if (in_use) *in_use = atomic_load(&s_in_use);
+    if (peak)   *peak   = atomic_load(&s_peak);
+    if (allocs) *allocs = atomic_load(&s_allocs);
+}
+
+// Free heap as the firmware sees it: a nominal ESP32 heap minus what the
+// firmware (and the host mocks) currently hold.
+uint32_t esp_get_free_heap_size(void)
+{
+    size_t used = atomic_load(&s_in_use);
+    return used < HOST_HEAP_BYTES ? (uint32_t)(HOST_HEAP_BYTES - used) : 0;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    size_t peak = atomic_load(&s_peak);
+    return peak < HOST_HEAP_BYTES ? (uint32_t)(HOST_HEAP_BYTES - peak) : 0;
+}
@@ -0,0 +1,153 @@
+// host/i2c_check.c — sensor read scheduling: I2C transactions and time the
+// sampler spends blocked, before and after
+//
+//   ./i2c_check [SECONDS]
+//
+// Runs a sampler task for SECONDS of virtual time (default 60) over the host
+// I2C bus and sensor models (host_sensors.c), twice:
+//   before  the original fixed tick: every 100 ms a BH1750 read, then a
+//           BME280 forced-mode write, a 10 ms wait and a temperature read
+//   after   sensors.c as the firmware runs it: sensors_sample_tick() reads
+//           each sensor on its own conversion grid, and the task sleeps
+//           until the next slot (sampler_task in app_main.c). The bus fails
+//           to come up at boot, so both sensors must appear on the retry
+//           SENSORS_RETRY_MS later; the measurement starts after that.
+// and prints transactions per second and the share of time the sampler was
+// blocked inside sensor calls (bus time plus waits). The run fails if the
+// scheduled reads issue more than one transaction per sensor period, fewer
+// than 2.5x less than the tick, block more than 1 % of the time, or read
+// either sensor off its period, or if the sensors stay absent after the
+// failed bus init. Exit status is the number of failures.
+#include "host.h"
+#include "sensors.h"
+#include "driver/i2c_master.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define TICK_MS       100
+#define BH1750_ADDR   0x23
+#define BME280_ADDR   0x76
+#define BH1750_READ_MS  120     // SENSORS_BH1750_PERIOD_MS
+#define BME280_READ_MS  500     // SENSORS_BME280_PERIOD_MS
+#define RETRY_MS        5000    // SENSORS_RETRY_MS
+
+static double   s_seconds = 60;
+static int64_t  s_blocked_us;
+static bool     s_tick_stop;
+static int      s_fail;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL     : %s\n", what);
+        s_fail++;
+    }
+}
+
+// ----- before: the fixed tick, through the same bus model -----
+static void tick_task(void *pv)
+{
+    (void)pv;
+    i2c_master_bus_handle_t bus;
+    i2c_master_dev_handle_t bh, bme;
+    i2c_master_bus_config_t bcfg = { .i2c_port = 0 };
+    i2c_new_master_bus(&bcfg, &bus);
+    i2c_device_config_t d1 = { .device_address = BH1750_ADDR, .scl_speed_hz = 100000 };
+    i2c_device_config_t d2 = { .device_address = BME280_ADDR, .scl_speed_hz = 100000 };
+    i2c_master_bus_add_device(bus, &d1, &bh);
+    i2c_master_bus_add_device(bus, &d2, &bme);
+    const uint8_t cont_hi = 0x10, forced[2] = { 0xF4, (1 << 5) | 0x01 }, temp_reg = 0xFA;
+    i2c_master_transmit(bh, &cont_hi, 1, 100);
+    for (;;) {
+        int64_t t0 = host_now_us();
+        uint8_t buf[3];
+        i2c_master_receive(bh, buf, 2, 200);
+        i2c_master_transmit(bme, forced, 2, 100);
+        vTaskDelay(pdMS_TO_TICKS(10));
+        i2c_master_transmit_receive(bme, &temp_reg, 1, buf, 3, 200);
+        s_blocked_us += host_now_us() - t0;
+        vTaskDelay(pdMS_TO_TICKS(TICK_MS));
+        if (s_tick_stop) vTaskDelete(NULL);
+    }
+}
+
+// ----- after: sensors.c -----
+static void sampler_task(void *pv)
+{
+    (void)pv;
+    sensors_set_wake_task(xTaskGetCurrentTaskHandle());
+    while (1) {
+        int64_t t0 = host_now_us();
+        uint32_t wait = sensors_sample_tick();
+        s_blocked_us += host_now_us() - t0;
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait) + 2);
+    }
+}
+
+typedef struct {
+    double          xfers_per_s;
+    double          blocked;
+    sensors_stats_t warm;   // sensors.c counters at the end of the warm-up
+    sensors_stats_t end;
+} result_t;
+
+// Starts fn, lets it run warmup_ms unmeasured, then measures s_seconds.
+static void run(const char *name, TaskFunction_t fn, uint32_t warmup_ms, result_t *r)
+{
+    host_i2c_stats_t st0, st1;
+    xTaskCreate(fn, name, 4096, NULL, 10, NULL);
+    host_rtos_run(host_now_us() + (int64_t)warmup_ms * 1000);
+    host_i2c_get_stats(&st0);
+    sensors_get_stats(&r->warm);
+    int64_t t0 = host_now_us();
+    s_blocked_us = 0;
+    host_rtos_run(t0 + (int64_t)(s_seconds * 1e6));
+    host_i2c_get_stats(&st1);
+    sensors_get_stats(&r->end);
+    r->xfers_per_s = (st1.xfers - st0.xfers) / s_seconds;
+    r->blocked = s_blocked_us / (s_seconds * 1e6);
+    printf("%-8s : %6.1f I2C transactions/s, sampler blocked %4.1f%% of the time\n",
+           name, r->xfers_per_s, r->blocked * 100);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1) s_seconds = atof(argv[1]);
+    host_log_set_level(ESP_LOG_WARN);
+    host_sensors_load(NULL, 1700000000);
+
+    // One after the other on the same bus model; the tick task leaves at
+    // its next wake-up, before touching the bus again.
+    result_t before, after;
+    run("before", tick_task, 0, &before);
+    s_tick_stop = true;
+
+    host_i2c_fail_bus_init(1);
+    sensors_init();
+    run("after", sampler_task, RETRY_MS + 1000, &after);
+    printf("boot     : bus init failed, %u BH1750 and %u BME280 reads within %d ms of the retry\n",
+           (unsigned)after.warm.bh1750_reads, (unsigned)after.warm.bme280_reads, 1000);
+    check(after.warm.bh1750_reads > 0 && after.warm.bme280_reads > 0,
+          "sensors still absent after the bus retry");
+
+    uint32_t bh = after.end.bh1750_reads - after.warm.bh1750_reads;
+    uint32_t bme = after.end.bme280_reads - after.warm.bme280_reads;
+    double bh_per_s = bh / s_seconds, bme_per_s = bme / s_seconds;
+    printf("reads    : BH1750 %.2f/s (period %d ms), BME280 %.2f/s (period %d ms)\n",
+           bh_per_s, BH1750_READ_MS, bme_per_s, BME280_READ_MS);
+    check(after.xfers_per_s <= 1000.0 / BH1750_READ_MS + 1000.0 / BME280_READ_MS + 0.1,
+          "more than one transaction per sensor read");
+    check(after.xfers_per_s * 2.5 <= before.xfers_per_s, "not 2.5x fewer transactions than the tick");
+    check(after.blocked < 0.01, "sampler blocked 1 % of the time or more");
+    check(bh_per_s > 1000.0 / BH1750_READ_MS - 0.1 && bh_per_s < 1000.0 / BH1750_READ_MS + 0.1,
+          "BH1750 read off its conversion period");
+    check(bme_per_s > 1000.0 / BME280_READ_MS - 0.1 && bme_per_s < 1000.0 / BME280_READ_MS + 0.1,
+          "BME280 read off its standby period");
+    printf("%s\n", s_fail ? "FAIL" : "OK");
+    fflush(stdout);
+    _exit(s_fail);   // the task threads are parked mid-loop
+}
@@ -0,0 +1,59 @@
+// host/include/driver/i2c_master.h — I2C master driver API backed by host_sensors.c
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int i2c_port_num_t;
+#define I2C_NUM_0 0
+
+typedef enum { I2C_CLK_SRC_DEFAULT = 0 } i2c_clock_source_t;
+typedef enum { I2C_ADDR_BIT_LEN_7 = 0, I2C_ADDR_BIT_LEN_10 } i2c_addr_bit_len_t;
+
+typedef struct {
+    i2c_port_num_t     i2c_port;
+    int                sda_io_num;
+    int                scl_io_num;
+    i2c_clock_source_t clk_source;
+    uint8_t            glitch_ignore_cnt;
+    int                intr_priority;
+    size_t             trans_queue_depth;
+    struct {
+        uint32_t enable_internal_pullup : 1;
+        uint32_t allow_pd : 1;
+    } flags;
+} i2c_master_bus_config_t;
+
+typedef struct {
+    i2c_addr_bit_len_t dev_addr_length;
+    uint16_t           device_address;
+    uint32_t           scl_speed_hz;
+    uint32_t           scl_wait_us;
+    struct {
+        uint32_t disable_ack_check : 1;
+    } flags;
+} i2c_device_config_t;
+
+typedef struct host_i2c_bus *i2c_master_bus_handle_t;
+typedef struct host_i2c_dev *i2c_master_dev_handle_t;
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *cfg, i2c_master_bus_handle_t *ret);
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus, const i2c_device_config_t *cfg,
+                                    i2c_master_dev_handle_t *ret);
+esp_err_t i2c_master_bus_reset(i2c_master_bus_handle_t bus);
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t dev, const uint8_t *wr, size_t wr_len,
+                              int timeout_ms);
+esp_err_t i2c_master_receive(i2c_master_dev_handle_t dev, uint8_t *rd, size_t rd_len,
+                             int timeout_ms);
+esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t dev, const uint8_t *wr,
+                                      size_t wr_len, uint8_t *rd, size_t rd_len, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,6 @@
+// host/include/esp_attr.h — placement attributes mean nothing on the host
+#pragma once
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
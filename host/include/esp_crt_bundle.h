@@ -0,0 +1,13 @@
+// host/include/esp_crt_bundle.h — the host HTTP shim speaks plain HTTP only
+#pragma once
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_crt_bundle_attach(void *conf);
+
+#ifdef __cplusplus
+}
+#endif
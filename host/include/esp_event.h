@@ -0,0 +1,15 @@
+// host/include/esp_event.h — the event handler types mqtt_client.h uses
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef const char *esp_event_base_t;
+typedef void (*esp_event_handler_t)(void *handler_arg, esp_event_base_t base,
+                                    int32_t event_id, void *event_data);
+
+#ifdef __cplusplus
+}
+#endif
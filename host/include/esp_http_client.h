@@ -0,0 +1,82 @@
+// host/include/esp_http_client.h — the subset of the IDF client used by
+// uploader.c, implemented over plain HTTP/1.1 sockets in host_http.c
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_http_client *esp_http_client_handle_t;
+
+typedef enum {
+    HTTP_METHOD_GET = 0,
+    HTTP_METHOD_POST,
+} esp_http_client_method_t;
+
+typedef enum {
+    HTTP_TRANSPORT_UNKNOWN = 0,
+    HTTP_TRANSPORT_OVER_TCP,
+    HTTP_TRANSPORT_OVER_SSL,
+} esp_http_client_transport_t;
+
+typedef enum {
+    HTTP_EVENT_ERROR = 0,
+    HTTP_EVENT_ON_CONNECTED,
+    HTTP_EVENT_HEADERS_SENT,
+    HTTP_EVENT_ON_HEADER,
+    HTTP_EVENT_ON_DATA,
+    HTTP_EVENT_ON_FINISH,
+    HTTP_EVENT_DISCONNECTED,
+    HTTP_EVENT_REDIRECT,
+} esp_http_client_event_id_t;
+
+typedef struct esp_http_client_event {
+    esp_http_client_event_id_t event_id;
+    esp_http_client_handle_t   client;
+    void                      *data;
+    int                        data_len;
+    void                      *user_data;
+    char                      *header_key;
+    char                      *header_value;
+} esp_http_client_event_t;
+
+typedef esp_err_t (*http_event_handle_cb)(esp_http_client_event_t *evt);
+
+typedef struct {
+    const char                 *url;
+    const char                 *cert_pem;
+    esp_http_client_method_t    method;
+    int                         timeout_ms;
+    http_event_handle_cb        event_handler;
+    esp_http_client_transport_t transport_type;
+    int                         buffer_size;
+    int                         buffer_size_tx;
+    void                       *user_data;
+    bool                        skip_cert_common_name_check;
+    esp_err_t                 (*crt_bundle_attach)(void *conf);
+    bool                        keep_alive_enable;
+    int                         keep_alive_idle;
+    int                         keep_alive_interval;
+    int                         keep_alive_count;
+    bool                        save_client_session;
+} esp_http_client_config_t;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *cfg);
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t h, const char *key, const char *value);
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t h, const char *key);
+esp_err_t esp_http_client_open(esp_http_client_handle_t h, int write_len);
+int       esp_http_client_write(esp_http_client_handle_t h, const char *buf, int len);
+int64_t   esp_http_client_fetch_headers(esp_http_client_handle_t h);
+int       esp_http_client_get_status_code(esp_http_client_handle_t h);
+int64_t   esp_http_client_get_content_length(esp_http_client_handle_t h);
+int       esp_http_client_read(esp_http_client_handle_t h, char *buf, int len);
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t h, int *len);
+esp_err_t esp_http_client_close(esp_http_client_handle_t h);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t h);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,34 @@
+// host/include/esp_log.h — ESP_LOGx on stdout, stamped with the virtual clock
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+void esp_log_level_set(const char *tag, esp_log_level_t level);   // tag "*" only
+uint32_t esp_log_timestamp(void);
+
+#define ESP_LOG_LEVEL_(lvl, c, tag, fmt, ...) \
+    esp_log_write(lvl, tag, c " (%u) %s: " fmt "\n", (unsigned)esp_log_timestamp(), tag, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, fmt, ...) ESP_LOG_LEVEL_(ESP_LOG_ERROR, "E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) ESP_LOG_LEVEL_(ESP_LOG_WARN,  "W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) ESP_LOG_LEVEL_(ESP_LOG_INFO,  "I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) ESP_LOG_LEVEL_(ESP_LOG_DEBUG, "D", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) ESP_LOG_LEVEL_(ESP_LOG_VERBOSE, "V", tag, fmt, ##__VA_ARGS__)
+
+#ifdef __cplusplus
+}
+#endif
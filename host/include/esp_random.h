@@ -0,0 +1,13 @@
+// host/include/esp_random.h — seeded, repeatable stand-in for the hardware RNG
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t esp_random(void);
+
+#ifdef __cplusplus
+}
+#endif
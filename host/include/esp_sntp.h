@@ -0,0 +1,16 @@
+// host/include/esp_sntp.h — sync notification of the host SNTP stub
+#pragma once
+#include <sys/time.h>
+#include "lwip/apps/sntp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*sntp_sync_time_cb_t)(struct timeval *tv);
+
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,16 @@
+// host/include/esp_system.h — heap figures derived from host_stubs.c's accounting
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HOST_HEAP_BYTES (300u * 1024u)   // typical free heap of an ESP32 app
+
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+
+#ifdef __cplusplus
+}
+#endif
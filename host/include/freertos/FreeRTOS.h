@@ -0,0 +1,40 @@
+// host/include/freertos/FreeRTOS.h — types and macros for the host scheduler
+//
+// host_rtos.c runs every task as a pthread but lets only one of them hold the
+// CPU at a time, so critical sections need no lock.
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t TickType_t;
+typedef int      BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint8_t  StackType_t;   // stack depth is in bytes, as on ESP-IDF
+
+#define configTICK_RATE_HZ   CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS   ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)    ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000u))
+#define portMAX_DELAY        ((TickType_t)0xffffffffu)
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdFAIL  pdFALSE
+#define pdPASS  pdTRUE
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux)      ((void)(mux))
+#define portEXIT_CRITICAL(mux)       ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux)  ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux)   ((void)(mux))
+#define portYIELD_FROM_ISR(x)        ((void)(x))
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,42 @@
+// host/include/freertos/task.h — task API backed by host_rtos.c
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*TaskFunction_t)(void *);
+typedef struct host_task *TaskHandle_t;
+// Holds the task's control block (host_rtos.c checks that it fits).
+typedef struct { void *opaque[32]; } StaticTask_t;
+
+#define tskNO_AFFINITY ((BaseType_t)0x7FFFFFFF)
+
+// Priority and core only matter while a task computes (host_cpu_us()).
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                       void *arg, UBaseType_t prio, TaskHandle_t *out);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                                   void *arg, UBaseType_t prio, TaskHandle_t *out, BaseType_t core);
+// The control block lives in *tcb, so creation allocates nothing. The task
+// runs on a host stack of its own; the stack buffer is left unused.
+TaskHandle_t xTaskCreateStatic(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                               void *arg, UBaseType_t prio, StackType_t *stack,
+                               StaticTask_t *tcb);
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name,
+                                           uint32_t stack_depth, void *arg, UBaseType_t prio,
+                                           StackType_t *stack, StaticTask_t *tcb, BaseType_t core);
+void       vTaskDelay(TickType_t ticks);
+BaseType_t xTaskDelayUntil(TickType_t *prev_wake, TickType_t increment);   // pdFALSE: no wait
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+void       vTaskDelete(TaskHandle_t task);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);   // bytes, as on ESP-IDF
+
+uint32_t   ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void       vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_prio_woken);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,19 @@
+// host/include/lwip/apps/sntp.h — SNTP "syncs" the virtual wall clock at a
+// set virtual time (host_sntp_set)
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SNTP_OPMODE_POLL 0
+
+void sntp_setoperatingmode(uint8_t mode);
+void sntp_setservername(uint8_t idx, const char *server);
+void sntp_init(void);
+void sntp_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,87 @@
+// host/include/mqtt_client.h — the subset of esp-mqtt used by
+// transport_mqtt.c, implemented over plain MQTT 3.1.1 sockets in host_mqtt.c
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
+
+typedef enum {
+    MQTT_EVENT_ANY = -1,
+    MQTT_EVENT_ERROR = 0,
+    MQTT_EVENT_CONNECTED,
+    MQTT_EVENT_DISCONNECTED,
+    MQTT_EVENT_SUBSCRIBED,
+    MQTT_EVENT_UNSUBSCRIBED,
+    MQTT_EVENT_PUBLISHED,
+    MQTT_EVENT_DATA,
+    MQTT_EVENT_BEFORE_CONNECT,
+    MQTT_EVENT_DELETED,
+} esp_mqtt_event_id_t;
+
+typedef struct {
+    esp_mqtt_event_id_t      event_id;
+    esp_mqtt_client_handle_t client;
+    char *data;
+    int   data_len;
+    int   total_data_len;
+    int   current_data_offset;
+    char *topic;
+    int   topic_len;
+    int   msg_id;
+    int   session_present;
+    bool  retain;
+    int   qos;
+    bool  dup;
+} esp_mqtt_event_t;
+
+typedef esp_mqtt_event_t *esp_mqtt_event_handle_t;
+
+typedef struct {
+    struct {
+        struct {
+            const char *uri;
+        } address;
+        struct {
+            const char *certificate;
+            esp_err_t (*crt_bundle_attach)(void *conf);
+        } verification;
+    } broker;
+    struct {
+        const char *client_id;
+    } credentials;
+    struct {
+        int  keepalive;               // seconds
+        bool disable_clean_session;
+    } session;
+    struct {
+        int timeout_ms;
+        int reconnect_timeout_ms;
+    } network;
+    struct {
+        int size;
+        int out_size;
+    } buffer;
+} esp_mqtt_client_config_t;
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config);
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t handler, void *handler_arg);
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client);
+
+// msg_id (0 for QoS0), or -1 when not connected / the write failed.
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic,
+                            const char *data, int len, int qos, int retain);
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos);
+
+#ifdef __cplusplus
+}
+#endif
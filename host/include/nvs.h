@@ -0,0 +1,27 @@
+// host/include/nvs.h — the NVS blob calls used by the firmware; host_stubs.c
+// keeps them in a small file (HOST_NVS_FILE), like the flash backlog
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode_t;
+
+esp_err_t nvs_open(const char *name_space, nvs_open_mode_t mode, nvs_handle_t *out);
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len);
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *value, size_t len);
+esp_err_t nvs_commit(nvs_handle_t h);
+void      nvs_close(nvs_handle_t h);
+
+#ifdef __cplusplus
+}
+#endif
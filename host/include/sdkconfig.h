@@ -0,0 +1,19 @@
+// host/include/sdkconfig.h — the subset of ../sdkconfig the app reads
+#pragma once
+#define CONFIG_FREERTOS_HZ                    100
+#define CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS 1
+#define CONFIG_UPLOADER_ENCODING_JSON         1
+#define CONFIG_UPLOADER_GZIP_THRESHOLD        2048
+#define CONFIG_REPORT_ON_CHANGE               1
+#define CONFIG_REPORT_TEMP_DEADBAND           20
+#define CONFIG_REPORT_LUX_DEADBAND            10
+#define CONFIG_REPORT_LUX_DEADBAND_PCT        10
+#define CONFIG_REPORT_HEARTBEAT_MIN           15
+#define CONFIG_OCCUPANCY_EVENTS               1
+#define CONFIG_OCCUPANCY_VACANCY_MIN          10
+#define CONFIG_OCCUPANCY_LIGHTS_ON_LUX        200
+#define CONFIG_OCCUPANCY_LIGHTS_OFF_LUX       120
+#define CONFIG_OCCUPANCY_AC_SLOPE             100
+#define CONFIG_OCCUPANCY_AC_BAND              40
+#define CONFIG_OCCUPANCY_HEARTBEAT_MIN        60
+#define CONFIG_ALLOC_TRACE                    1
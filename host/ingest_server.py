@@ -0,0 +1,335 @@
+#!/usr/bin/env python3
+# host/ingest_server.py — local stand-in for the ingest endpoint
+#
+#   python3 host/ingest_server.py [--port 8080] [--tls-port 8443 --cert C --key K]
+#                                 [--workers N] [--delay-ms N] [--slow-rate P --slow-ms N]
+#                                 [--fail-rate P] [--reset-rate P] [--idle-s N]
+#                                 [--queue N] [--retry-after-s N]
+#                                 [--pace DEPTH:INTERVAL_S] [--directive JSON]
+#                                 [--report-s N] [--quiet]
+#
+# Takes POSTs of the node's JSON batches (gzip or plain), decodes every
+# sample and keeps, per room (building + number), the sample times seen, so
+# repeats of an already stored sample (or room state event) are counted as
+# duplicates. Every
+# request's handling time (headers read → response written) is recorded.
+# GET /stats returns the totals and latency percentiles as one JSON line;
+# they are printed on exit (Ctrl-C) and every --report-s.
+#
+# --workers bounds the requests handled at once; the rest wait for a worker
+# and that wait counts in the latency. Faults, drawn per request:
+#   --slow-rate  handling takes --slow-ms longer (the node may time out while
+#                the batch is still stored: its retry is a duplicate)
+#   --fail-rate  503, nothing stored
+#   --reset-rate the connection is reset without a response, half the time
+#                before the batch is stored and half after
+# Backpressure, as response directives (main/flow_ctl.h):
+#   --queue        a request finding N others waiting for a worker gets 503 at once
+#   --retry-after-s  Retry-After header on every 503
+#   --pace         once DEPTH requests wait for a worker (until fewer than a
+#                  quarter of that do), every response carries
+#                  {"upload_interval_s": INTERVAL_S}, otherwise {"upload_interval_s": 0}
+#   --directive    JSON body of every response when not pacing, e.g.
+#                  '{"publish_s": 30, "batch_max": 20, "encoding": "json"}'
+# Plain HTTP is what host/fleet_sim and aulasense_host speak; --tls-port
+# serves the same on HTTPS for a device, curl or aulasense_host --tls, and
+# counts the TLS handshakes that resumed a session. E.g. with a throwaway cert:
+#   openssl req -x509 -newkey rsa:2048 -nodes -days 30 -subj /CN=localhost \
+#       -keyout key.pem -out cert.pem
+import argparse
+import gzip
+import json
+import random
+import signal
+import socket
+import ssl
+import struct
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.started = time.monotonic()
+        self.first = self.last = None
+        self.requests = 0
+        self.status = {}
+        self.resets = 0
+        self.tls_handshakes = 0
+        self.tls_resumed = 0     # handshakes that resumed a client's session
+        self.shed = 0             # 503 at once, queue full
+        self.paced = 0            # responses asking for an upload interval
+        self.bytes = 0
+        self.samples = 0
+        self.duplicates = 0
+        self.undecoded = 0
+        self.rooms = {}           # (building, number) -> set of "date time"
+        self.latency = []         # seconds
+
+    def request(self, status, nbytes, latency):
+        now = time.monotonic()
+        with self.lock:
+            self.first = self.first or now
+            self.last = now
+            self.requests += 1
+            self.bytes += nbytes
+            self.latency.append(latency)
+            if status is None:
+                self.resets += 1
+            else:
+                self.status[status] = self.status.get(status, 0) + 1
+
+    def store(self, samples):
+        with self.lock:
+            for s in samples:
+                seen = self.rooms.setdefault((s.get("building"), s.get("number")), set())
+                key = f"{s.get('date')} {s.get('time')}"
+                if "state" in s:   # a room state event may share a sample's time
+                    key += f" {s['state']}"
+                if key in seen:
+                    self.duplicates += 1
+                else:
+                    seen.add(key)
+                    self.samples += 1
+
+    def snapshot(self):
+        with self.lock:
+            lat = sorted(self.latency)
+            span = (self.last - self.first) if self.first and self.last > self.first else 0.0
+
+            def q(p):
+                return round(lat[int((len(lat) - 1) * p)] * 1000, 1) if lat else None
+
+            return {
+                "requests": self.requests,
+                "status": {str(k): v for k, v in sorted(self.status.items())},
+                "resets": self.resets,
+                "tls_handshakes": self.tls_handshakes,
+                "tls_resumed": self.tls_resumed,
+                "shed": self.shed,
+                "paced": self.paced,
+                "bytes": self.bytes,
+                "rooms": len(self.rooms),
+                "samples": self.samples,
+                "duplicates": self.duplicates,
+                "undecoded": self.undecoded,
+                "req_per_s": round(self.requests / span, 2) if span else None,
+                "samples_per_s": round(self.samples / span, 2) if span else None,
+                "latency_ms": {"p50": q(0.5), "p90": q(0.9), "p99": q(0.99),
+                               "p999": q(0.999), "max": q(1.0)},
+            }
+
+
+def decode(body, content_type, content_encoding):
+    """Samples of a JSON batch, or None if it is not one."""
+    if "json" not in (content_type or ""):
+        return None
+    try:
+        if (content_encoding or "").lower() == "gzip":
+            body = gzip.decompress(body)
+        batch = json.loads(body)
+    except (OSError, ValueError, EOFError):
+        return None
+    if not isinstance(batch, list) or not all(isinstance(s, dict) for s in batch):
+        return None
+    return batch
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--port", type=int, default=8080)
+    ap.add_argument("--tls-port", type=int)
+    ap.add_argument("--cert")
+    ap.add_argument("--key")
+    ap.add_argument("--workers", type=int, default=8)
+    ap.add_argument("--delay-ms", type=float, default=0.0, help="added to every request")
+    ap.add_argument("--slow-rate", type=float, default=0.0)
+    ap.add_argument("--slow-ms", type=float, default=15000.0)
+    ap.add_argument("--fail-rate", type=float, default=0.0)
+    ap.add_argument("--reset-rate", type=float, default=0.0)
+    ap.add_argument("--idle-s", type=float, default=60.0, help="keep-alive idle timeout")
+    ap.add_argument("--queue", type=int, default=0, help="max requests waiting; 0 = unbounded")
+    ap.add_argument("--retry-after-s", type=int, default=0)
+    ap.add_argument("--pace", help="DEPTH:INTERVAL_S")
+    ap.add_argument("--directive", help="JSON object sent as the response body")
+    ap.add_argument("--report-s", type=float, default=0.0)
+    ap.add_argument("--quiet", action="store_true")
+    args = ap.parse_args()
+    if args.tls_port and not (args.cert and args.key):
+        ap.error("--tls-port needs --cert and --key")
+    pace_depth = pace_interval = 0
+    if args.pace:
+        try:
+            pace_depth, pace_interval = (int(x) for x in args.pace.split(":"))
+        except ValueError:
+            ap.error("--pace takes DEPTH:INTERVAL_S")
+    if args.directive:
+        try:
+            if not isinstance(json.loads(args.directive), dict):
+                raise ValueError
+        except ValueError:
+            ap.error("--directive must be a JSON object")
+
+    stats = Stats()
+    workers = threading.BoundedSemaphore(args.workers)
+    waiting = [0]                 # requests waiting for a worker
+    pacing = [False]
+    wait_lock = threading.Lock()
+
+    def directive():
+        """Response body: pacing state, the fixed directive, or nothing."""
+        if pace_depth:
+            with wait_lock:
+                if waiting[0] >= pace_depth:
+                    pacing[0] = True
+                elif waiting[0] < pace_depth / 4:
+                    pacing[0] = False
+                on = pacing[0]
+            if on:
+                with stats.lock:
+                    stats.paced += 1
+            return json.dumps({"upload_interval_s": pace_interval if on else 0}).encode()
+        return args.directive.encode() if args.directive else None
+
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+        timeout = args.idle_s
+
+        def reply(self, status, body, ctype="text/plain"):
+            self.send_response(status)
+            if status == 503 and args.retry_after_s:
+                self.send_header("Retry-After", str(args.retry_after_s))
+            self.send_header("Content-Type", ctype)
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+            self.wfile.flush()
+
+        def setup(self):
+            if isinstance(self.request, ssl.SSLSocket):
+                self.request.settimeout(args.idle_s)
+                try:
+                    self.request.do_handshake()
+                except (OSError, ssl.SSLError):
+                    pass   # the read that follows fails and ends the connection
+                else:
+                    with stats.lock:
+                        stats.tls_handshakes += 1
+                        stats.tls_resumed += self.request.session_reused
+            super().setup()
+
+        def reset(self):
+            # RST instead of FIN: no response at all
+            self.connection.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER,
+                                       struct.pack("ii", 1, 0))
+            self.connection.close()
+            self.close_connection = True
+
+        def do_GET(self):
+            if self.path == "/stats":
+                self.reply(200, (json.dumps(stats.snapshot()) + "\n").encode(), "application/json")
+            else:
+                self.reply(404, b"not found")
+
+        def answer(self, status, text):
+            d = directive()
+            if d is None:
+                self.reply(status, text)
+            else:
+                self.reply(status, d, "application/json")
+
+        def do_POST(self):
+            t0 = time.monotonic()
+            body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+            with wait_lock:
+                shed = args.queue > 0 and waiting[0] >= args.queue
+                if not shed:
+                    waiting[0] += 1
+            if shed:
+                with stats.lock:
+                    stats.shed += 1
+                self.answer(503, b"queue full")
+                stats.request(503, len(body), time.monotonic() - t0)
+                return
+            u = random.random()
+            fault = None
+            for name, p in (("slow", args.slow_rate), ("fail", args.fail_rate),
+                            ("reset", args.reset_rate)):
+                if u < p:
+                    fault = name
+                    break
+                u -= p
+            after = random.random() < 0.5
+
+            with workers:
+                with wait_lock:
+                    waiting[0] -= 1
+                delay = args.delay_ms + (args.slow_ms if fault == "slow" else 0.0)
+                if delay > 0:
+                    time.sleep(delay / 1000.0)
+                if fault == "reset" and not after:
+                    stats.request(None, len(body), time.monotonic() - t0)
+                    return self.reset()
+                status = 503 if fault == "fail" else 200
+                samples = None
+                if status == 200:
+                    samples = decode(body, self.headers.get("Content-Type"),
+                                     self.headers.get("Content-Encoding"))
+                    if samples is None:
+                        with stats.lock:
+                            stats.undecoded += 1
+                    else:
+                        stats.store(samples)
+                if fault == "reset":
+                    stats.request(None, len(body), time.monotonic() - t0)
+                    return self.reset()
+                self.answer(status, b"OK" if status == 200 else b"busy")
+            stats.request(status, len(body), time.monotonic() - t0)
+            if not args.quiet:
+                print(f"{self.path} {status} {len(body)} B "
+                      f"{len(samples) if samples is not None else '-'} samples "
+                      f"{(time.monotonic() - t0) * 1000:.1f} ms", flush=True)
+
+        def log_message(self, *a):
+            pass
+
+    class Server(ThreadingHTTPServer):
+        daemon_threads = True
+        request_queue_size = 1024
+
+        def handle_error(self, request, client_address):
+            pass   # resets and idle timeouts are expected
+
+    servers = [Server(("127.0.0.1", args.port), Handler)]
+    if args.tls_port:
+        ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        ctx.load_cert_chain(args.cert, args.key)
+        tls = Server(("127.0.0.1", args.tls_port), Handler)
+        # Handshake in the handler thread, not in accept()
+        tls.socket = ctx.wrap_socket(tls.socket, server_side=True,
+                                     do_handshake_on_connect=False)
+        servers.append(tls)
+    for s in servers:
+        threading.Thread(target=s.serve_forever, daemon=True).start()
+    print(f"ingest: http://127.0.0.1:{args.port}/"
+          + (f" https://127.0.0.1:{args.tls_port}/" if args.tls_port else ""), flush=True)
+
+    def finish(*_):
+        print(json.dumps(stats.snapshot()), flush=True)
+        sys.exit(0)
+
+    signal.signal(signal.SIGINT, finish)
+    signal.signal(signal.SIGTERM, finish)
+    while True:
+        if args.report_s > 0:
+            time.sleep(args.report_s)
+            print(json.dumps(stats.snapshot()), flush=True)
+        else:
+            signal.pause()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,460 @@
+// host/json_check.c — payload_json against cJSON_PrintUnformatted(), chunking
+// and cost
+//
+//   ./json_check [N]
+//
+// Builds N random records (random bits in every field, event records, held
+// samples, identity strings with quotes, backslashes and control characters)
+// and checks, batch by batch, that payload_json_write() produces exactly the
+// bytes cJSON_PrintUnformatted() gives for the same tree, and that
+// payload_json_size() predicts them. The reference below is cJSON 1.7's tree
+// and printer (the json component ESP-IDF ships) reduced to the node types a
+// batch uses, with its allocation pattern: one node per value, a strdup per
+// key and string, a 256 B print buffer doubled with realloc, then trimmed.
+//
+// It also checks that the sink sees full PAYLOAD_JSON_CHUNK writes, and times
+// both paths on 50-sample batches, with the reference's heap peak. Exit status
+// is the number of failures (capped).
+#include "payload_json.h"
+#include "occupancy.h"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef PAYLOAD_JSON_CHUNK
+#define PAYLOAD_JSON_CHUNK 1024
+#endif
+
+#define BATCH UPLOADER_MAX_SAMPLES
+
+// ---------- reference: cJSON's tree and unformatted printer ----------
+enum { J_FALSE, J_TRUE, J_NULL, J_NUMBER, J_STRING, J_ARRAY, J_OBJECT };
+
+typedef struct jnode {
+    struct jnode *next, *prev, *child;
+    int    type;
+    char  *valuestring;
+    int    valueint;
+    double valuedouble;
+    char  *string;           // key
+} jnode_t;
+
+static size_t s_heap, s_heap_peak, s_allocs;
+
+static void *j_alloc(size_t n)
+{
+    size_t *p = malloc(n + sizeof(size_t));
+    if (!p) abort();
+    *p = n;
+    s_heap += n;
+    if (s_heap > s_heap_peak) s_heap_peak = s_heap;
+    s_allocs++;
+    return p + 1;
+}
+
+static void j_free(void *q)
+{
+    if (!q) return;
+    size_t *p = (size_t *)q - 1;
+    s_heap -= *p;
+    free(p);
+}
+
+static void *j_realloc(void *q, size_t n)
+{
+    size_t *p = (size_t *)q - 1;
+    s_heap -= *p;
+    p = realloc(p, n + sizeof(size_t));
+    if (!p) abort();
+    *p = n;
+    s_heap += n;
+    if (s_heap > s_heap_peak) s_heap_peak = s_heap;
+    s_allocs++;
+    return p + 1;
+}
+
+static char *j_strdup(const char *s)
+{
+    size_t n = strlen(s) + 1;
+    char *d = j_alloc(n);
+    memcpy(d, s, n);
+    return d;
+}
+
+static jnode_t *j_new(int type)
+{
+    jnode_t *n = j_alloc(sizeof(*n));
+    memset(n, 0, sizeof(*n));
+    n->type = type;
+    return n;
+}
+
+static void j_delete(jnode_t *n)
+{
+    while (n) {
+        jnode_t *next = n->next;
+        j_delete(n->child);
+        j_free(n->valuestring);
+        j_free(n->string);
+        j_free(n);
+        n = next;
+    }
+}
+
+static void j_append(jnode_t *parent, jnode_t *item)
+{
+    jnode_t *c = parent->child;
+    if (!c) {
+        parent->child = item;
+        item->prev = item;
+        return;
+    }
+    jnode_t *last = c->prev;
+    last->next = item;
+    item->prev = last;
+    c->prev = item;
+}
+
+static void j_add(jnode_t *obj, const char *key, jnode_t *item)
+{
+    item->string = j_strdup(key);
+    j_append(obj, item);
+}
+
+static void j_number(jnode_t *obj, const char *key, double num)
+{
+    jnode_t *n = j_new(J_NUMBER);
+    n->valuedouble = num;
+    n->valueint = num >= INT_MAX ? INT_MAX : num <= (double)INT_MIN ? INT_MIN : (int)num;
+    j_add(obj, key, n);
+}
+
+static void j_string(jnode_t *obj, const char *key, const char *s)
+{
+    jnode_t *n = j_new(J_STRING);
+    n->valuestring = j_strdup(s);
+    j_add(obj, key, n);
+}
+
+typedef struct {
+    char  *buf;
+    size_t len, off;
+} jprint_t;
+
+static char *ensure(jprint_t *p, size_t needed)
+{
+    needed += p->off + 1;
+    if (needed > p->len) {
+        size_t newsize = needed * 2;
+        p->buf = j_realloc(p->buf, newsize);
+        p->len = newsize;
+    }
+    return p->buf + p->off;
+}
+
+static void print_number(const jnode_t *n, jprint_t *p)
+{
+    double d = n->valuedouble, test = 0.0;
+    char nb[26];
+    int length;
+    if (isnan(d) || isinf(d)) {
+        length = sprintf(nb, "null");
+    } else if (d == (double)n->valueint) {
+        length = sprintf(nb, "%d", n->valueint);
+    } else {
+        length = sprintf(nb, "%1.15g", d);
+        double max = 0;
+        if (sscanf(nb, "%lg", &test) == 1) max = fabs(test) > fabs(d) ? fabs(test) : fabs(d);
+        if (sscanf(nb, "%lg", &test) != 1 || !(fabs(test - d) <= max * DBL_EPSILON)) {
+            length = sprintf(nb, "%1.17g", d);
+        }
+    }
+    memcpy(ensure(p, (size_t)length + 1), nb, (size_t)length + 1);
+    p->off += (size_t)length;
+}
+
+static void print_string(const char *in, jprint_t *p)
+{
+    size_t extra = 0, len = 0;
+    for (const unsigned char *c = (const unsigned char *)in; *c; ++c, ++len) {
+        switch (*c) {
+            case '"': case '\\': case '\b': case '\f': case '\n': case '\r': case '\t':
+                extra++; break;
+            default:
+                if (*c < 32) extra += 5;
+        }
+    }
+    char *o = ensure(p, len + extra + 3);
+    *o++ = '"';
+    for (const unsigned char *c = (const unsigned char *)in; *c; ++c) {
+        if (*c > 31 && *c != '"' && *c != '\\') {
+            *o++ = (char)*c;
+            continue;
+        }
+        *o++ = '\\';
+        switch (*c) {
+            case '\\': *o++ = '\\'; break;
+            case '"':  *o++ = '"';  break;
+            case '\b': *o++ = 'b';  break;
+            case '\f': *o++ = 'f';  break;
+            case '\n': *o++ = 'n';  break;
+            case '\r': *o++ = 'r';  break;
+            case '\t': *o++ = 't';  break;
+            default:   sprintf(o, "u%04x", *c); o += 5;
+        }
+    }
+    *o++ = '"';
+    *o = '\0';
+    p->off += len + extra + 2;
+}
+
+static void print_value(const jnode_t *n, jprint_t *p)
+{
+    switch (n->type) {
+        case J_NULL:   memcpy(ensure(p, 5), "null", 5);  p->off += 4; return;
+        case J_FALSE:  memcpy(ensure(p, 6), "false", 6); p->off += 5; return;
+        case J_TRUE:   memcpy(ensure(p, 5), "true", 5);  p->off += 4; return;
+        case J_NUMBER: print_number(n, p); return;
+        case J_STRING: print_string(n->valuestring, p); return;
+    }
+    bool obj = n->type == J_OBJECT;
+    *ensure(p, 1) = obj ? '{' : '[';
+    p->off++;
+    for (const jnode_t *c = n->child; c; c = c->next) {
+        if (obj) {
+            print_string(c->string, p);
+            *ensure(p, 1) = ':';
+            p->off++;
+        }
+        print_value(c, p);
+        if (c->next) {
+            *ensure(p, 1) = ',';
+            p->off++;
+        }
+    }
+    char *o = ensure(p, 2);
+    o[0] = obj ? '}' : ']';
+    o[1] = '\0';
+    p->off++;
+}
+
+static char *j_print_unformatted(const jnode_t *n)
+{
+    jprint_t p = { j_alloc(256), 256, 0 };
+    print_value(n, &p);
+    return j_realloc(p.buf, p.off + 1);
+}
+
+// The tree the uploader used to build, from the same record.
+static jnode_t *reference_tree(const device_id_t *id, const sample_t *s, int n)
+{
+    jnode_t *arr = j_new(J_ARRAY);
+    for (int i = 0; i < n; ++i, ++s) {
+        jnode_t *o = j_new(J_OBJECT);
+        struct tm tm;
+        char date[16], hms[16], held[32];
+        sample_wall_split(s->t, &tm);
+        strftime(date, sizeof(date), "%Y-%m-%d", &tm);
+        strftime(hms, sizeof(hms), "%H:%M:%S", &tm);
+        j_string(o, "date", date);
+        j_string(o, "time", hms);
+        if (s->flags & SAMPLE_F_EVENT) {
+            j_string(o, "state", occupancy_state_name(s->ev_state));
+            if (s->ev_prev == OCC_UNKNOWN) j_add(o, "prev", j_new(J_NULL));
+            else j_string(o, "prev", occupancy_state_name(s->ev_prev));
+            j_number(o, "prev_s", s->ev_prev_s);
+        } else {
+            j_number(o, "temp", s->temp / 100.0);
+            j_number(o, "lux", s->lux / 10.0);
+            j_add(o, "motion", j_new(s->flags & SAMPLE_F_MOTION ? J_TRUE : J_FALSE));
+            j_number(o, "temp_min", s->temp_min / 100.0);
+            j_number(o, "temp_max", s->temp_max / 100.0);
+            j_number(o, "temp_var", s->temp_var / 10000.0);
+            j_number(o, "lux_min", s->lux_min / 10.0);
+            j_number(o, "lux_max", s->lux_max / 10.0);
+            j_number(o, "lux_var", s->lux_var / 100.0);
+            j_number(o, "motion_duty", s->motion_duty / 1000.0);
+            j_number(o, "motion_edges", s->motion_edges);
+            j_number(o, "motion_s", s->motion_ds / 10.0);
+            if (s->motion_first == SAMPLE_MOTION_NONE) j_add(o, "motion_first", j_new(J_NULL));
+            else j_number(o, "motion_first", s->motion_first / 10.0);
+            if (s->motion_last == SAMPLE_MOTION_NONE) j_add(o, "motion_last", j_new(J_NULL));
+            else j_number(o, "motion_last", s->motion_last / 10.0);
+            j_number(o, "motion_glitches", s->motion_glitches);
+            if (s->unchanged_since) {
+                sample_wall_split(s->unchanged_since, &tm);
+                strftime(held, sizeof(held), "%Y-%m-%d %H:%M:%S", &tm);
+                j_string(o, "unchanged_since", held);
+            }
+        }
+        j_string(o, "building", id->building);
+        j_string(o, "number", id->number);
+        j_append(arr, o);
+    }
+    return arr;
+}
+
+// ---------- device under test ----------
+static char   s_out[BATCH * 1024];
+static size_t s_out_len;
+static int    s_writes, s_short_writes;   // sink calls; ones under a full chunk
+
+static esp_err_t collect(void *ctx, const char *data, size_t len)
+{
+    (void)ctx;
+    if (len > PAYLOAD_JSON_CHUNK || s_out_len + len > sizeof(s_out)) return ESP_ERR_NO_MEM;
+    if (len < PAYLOAD_JSON_CHUNK) s_short_writes++;
+    s_writes++;
+    memcpy(s_out + s_out_len, data, len);
+    s_out_len += len;
+    return ESP_OK;
+}
+
+static esp_err_t discard(void *ctx, const char *data, size_t len)
+{
+    (void)ctx; (void)data; (void)len;
+    return ESP_OK;
+}
+
+static uint32_t rnd32(void)
+{
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+static void random_sample(sample_t *s)
+{
+    uint8_t *p = (uint8_t *)s;
+    for (size_t i = 0; i < sizeof(*s); ++i) p[i] = (uint8_t)rand();
+    s->t = 1700000000u + rnd32() % 400000000u;
+    s->unchanged_since = rand() % 4 ? 0 : s->t - rnd32() % 86400u;
+    s->flags &= SAMPLE_F_MOTION | SAMPLE_F_EVENT;
+    if (rand() % 8 == 0) s->motion_first = s->motion_last = SAMPLE_MOTION_NONE;
+    if (s->flags & SAMPLE_F_EVENT) {
+        s->ev_state = (uint8_t)(rand() % 8);
+        s->ev_prev = rand() % 5 ? (uint8_t)(rand() % 8) : OCC_UNKNOWN;
+    }
+}
+
+static void random_id(device_id_t *id)
+{
+    static const char k_chars[] = "AZaz09 -_\"\\/\t\n\r\b\f\x01\x1f\x7f\xc3\xa9";
+    char *f[2] = { id->building, id->number };
+    for (int k = 0; k < 2; ++k) {
+        int n = rand() % 16;
+        for (int i = 0; i < n; ++i) f[k][i] = k_chars[rand() % (sizeof(k_chars) - 1)];
+        f[k][n] = '\0';
+    }
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    long n = argc > 1 ? strtol(argv[1], NULL, 0) : 20000;
+    int bad = 0;
+    srand(1);
+
+    // Byte identity, batch by batch.
+    static sample_t batch[BATCH];
+    device_id_t id;
+    for (long done = 0; done < n; done += BATCH) {
+        int k = (int)(n - done < BATCH ? n - done : BATCH);
+        random_id(&id);
+        for (int i = 0; i < k; ++i) random_sample(&batch[i]);
+
+        s_out_len = 0;
+        s_writes = s_short_writes = 0;
+        esp_err_t err = payload_json_write(&id, batch, k, collect, NULL);
+        jnode_t *tree = reference_tree(&id, batch, k);
+        char *want = j_print_unformatted(tree);
+        size_t want_len = strlen(want);
+
+        if (err != ESP_OK || s_out_len != want_len || memcmp(s_out, want, want_len) != 0) {
+            if (bad++ < 5) {
+                size_t at = 0;
+                while (at < s_out_len && at < want_len && s_out[at] == want[at]) ++at;
+                printf("batch at %ld: differs from cJSON at byte %zu: ...%.40s\n"
+                       "                                     cJSON: ...%.40s\n",
+                       done, at, s_out + at, want + at);
+            }
+        } else if (payload_json_size(&id, batch, k) != want_len) {
+            if (bad++ < 5) printf("batch at %ld: payload_json_size() is off\n", done);
+        } else if (s_short_writes > 1) {
+            if (bad++ < 5) printf("batch at %ld: %d sink writes under a full chunk\n",
+                                  done, s_short_writes);
+        }
+        j_free(want);
+        j_delete(tree);
+    }
+    printf("identity : %ld records, escaped identities and event rows: %s\n",
+           n, bad ? "MISMATCH" : "byte-identical to cJSON_PrintUnformatted()");
+
+    // Worst case element: every number at its longest, identities escaped.
+    sample_t w;
+    memset(&w, 0, sizeof(w));
+    w.t = 2000000000u;
+    w.temp = w.temp_min = w.temp_max = -32767;
+    w.temp_var = w.motion_duty = w.motion_ds = w.motion_glitches = 65533;
+    w.motion_first = w.motion_last = 65533;
+    w.lux = w.lux_min = w.lux_max = w.lux_var = 4294967291u;
+    w.motion_edges = 255;
+    w.unchanged_since = 1999999999u;
+    memset(id.building, '\x01', 15);
+    memset(id.number, '\x1f', 15);
+    id.building[15] = id.number[15] = '\0';
+    size_t worst = payload_json_size(&id, &w, 1) - 2;
+    s_out_len = 0;
+    esp_err_t werr = payload_json_write(&id, &w, 1, collect, NULL);
+    printf("worst    : one object is %zu B (element buffer 768 B): %s\n",
+           worst, werr == ESP_OK ? "fits" : "DOES NOT FIT");
+    if (werr != ESP_OK) bad++;
+
+    // Cost of a typical 50-sample batch.
+    device_id_get(&id);
+    for (int i = 0; i < BATCH; ++i) {
+        random_sample(&batch[i]);
+        batch[i].flags &= (uint8_t)~SAMPLE_F_EVENT;
+    }
+    s_out_len = 0;
+    s_writes = s_short_writes = 0;
+    payload_json_write(&id, batch, BATCH, collect, NULL);
+    size_t body = s_out_len;
+    int writes = s_writes;
+
+    const int reps = 2000;
+    double t0 = now_s();
+    for (int r = 0; r < reps; ++r) {
+        size_t len = payload_json_size(&id, batch, BATCH);
+        if (len != body || payload_json_write(&id, batch, BATCH, discard, NULL) != ESP_OK) bad++;
+    }
+    double t1 = now_s();
+    s_heap_peak = s_allocs = 0;
+    for (int r = 0; r < reps; ++r) {
+        jnode_t *tree = reference_tree(&id, batch, BATCH);
+        char *out = j_print_unformatted(tree);
+        j_delete(tree);
+        j_free(out);
+    }
+    double t2 = now_s();
+
+    printf("batch    : %d samples, %zu B body, %d sink writes of up to %d B\n",
+           BATCH, body, writes, PAYLOAD_JSON_CHUNK);
+    printf("payload  : size+write %.1f MB/s, heap 0 B\n", body * reps / (t1 - t0) / 1e6);
+    printf("cJSON    : build+print %.1f MB/s, %.1f allocations per sample, peak heap %zu B\n"
+           "           (x86-64 nodes of %zu B; the ESP32's are 40 B)\n",
+           body * reps / (t2 - t1) / 1e6, (double)s_allocs / reps / BATCH, s_heap_peak,
+           sizeof(jnode_t));
+
+    printf("%s\n", bad ? "FAIL" : "OK");
+    return bad > 100 ? 100 : bad;
+}
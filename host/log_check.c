@@ -0,0 +1,288 @@
+// host/log_check.c — sample_log on its file stand-in: append, drain, write
+// amplification, remount and torn records
+//
+//   ./log_check [N]
+//
+// Appends N numbered samples (default 20000, more than the partition holds,
+// so the ring wraps), drains them 50 at a time and checks that what comes out
+// is the newest run, in order, with nothing lost but the counted drops. Then
+// it checks that a remount finds exactly what was pending, that a flush cut
+// short by power loss at any byte costs the torn record only, and that a
+// record failing its CRC drops out of the count as soon as a peek reaches it.
+// Each boot is a child process, so the log's state comes from the file alone.
+// Exit status is the number of failed checks.
+#include "sample_log.h"
+#include "metrics.h"
+#include "esp_log.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BATCH 50
+
+// sample_log.c's only outside dependencies.
+_Atomic uint32_t g_metrics_count[METRIC_C_COUNT];
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *fmt, ...)
+{
+    (void)level; (void)tag; (void)fmt;
+}
+
+uint32_t esp_log_timestamp(void) { return 0; }
+
+const char *esp_err_to_name(esp_err_t code) { return code == ESP_OK ? "ESP_OK" : "ERROR"; }
+
+static int s_fail;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL     : %s\n", what);
+        s_fail++;
+    }
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void make(sample_t *s, uint32_t i)
+{
+    memset(s, 0, sizeof(*s));
+    s->t = i;
+    s->temp = (int16_t)(2000 + i % 700);
+    s->lux = i * 7u;
+    s->flags = SAMPLE_F_MOTION;
+}
+
+static bool same(const sample_t *s, uint32_t i)
+{
+    sample_t want;
+    make(&want, i);
+    return memcmp(s, &want, sizeof(want)) == 0;
+}
+
+// Appends [from, to) and flushes.
+static bool append_run(uint32_t from, uint32_t to)
+{
+    for (uint32_t i = from; i < to; ++i) {
+        sample_t s;
+        make(&s, i);
+        if (sample_log_append(&s) != ESP_OK) return false;
+    }
+    return sample_log_flush() == ESP_OK;
+}
+
+// Drains everything; true if it is exactly [from, to) in order.
+static bool drain_run(uint32_t from, uint32_t to, uint32_t *batches)
+{
+    sample_t buf[BATCH];
+    uint32_t next = from;
+    int n;
+    while ((n = sample_log_peek(buf, BATCH)) > 0) {
+        for (int k = 0; k < n; ++k, ++next) {
+            if (next >= to || !same(&buf[k], next)) return false;
+        }
+        if (sample_log_consume(n) != ESP_OK) return false;
+        if (batches) ++*batches;
+    }
+    return next == to && sample_log_count() == 0;
+}
+
+// Runs fn in a fresh process, as a boot of its own; its exit status is the
+// number of failures.
+static int boot(int (*fn)(void *), void *arg)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (sample_log_init() != ESP_OK) _exit(100);
+        int rc = fn(arg);
+        fflush(stdout);
+        _exit(rc);
+    }
+    int st = 0;
+    if (pid < 0 || waitpid(pid, &st, 0) != pid || !WIFEXITED(st)) return 1;
+    return WEXITSTATUS(st);
+}
+
+static void *read_file(size_t *len)
+{
+    FILE *f = fopen(SAMPLE_LOG_HOST_FILE, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = (size_t)ftell(f);
+    rewind(f);
+    void *p = malloc(*len);
+    if (p && fread(p, 1, *len, f) != *len) {
+        free(p);
+        p = NULL;
+    }
+    fclose(f);
+    return p;
+}
+
+static bool write_file(const void *p, size_t len)
+{
+    FILE *f = fopen(SAMPLE_LOG_HOST_FILE, "wb");
+    if (!f) return false;
+    bool ok = fwrite(p, 1, len, f) == len;
+    return fclose(f) == 0 && ok;
+}
+
+// ----- boots -----
+static int boot_throughput(void *arg)
+{
+    uint32_t n = *(uint32_t *)arg;
+    sample_log_stats_t st0, st1, st2;
+    sample_log_get_stats(&st0);
+
+    double t0 = now_s();
+    check(append_run(0, n), "append");
+    double t1 = now_s();
+    sample_log_get_stats(&st1);
+
+    uint32_t kept = sample_log_count(), batches = 0;
+    check(st1.dropped + kept == n, "appended = dropped + pending");
+    check(drain_run(n - kept, n, &batches), "drain returns the newest samples in order");
+    double t2 = now_s();
+    sample_log_get_stats(&st2);
+
+    printf("log      : %u samples of %u B in %u B slots\n",
+           (unsigned)st1.capacity, (unsigned)sizeof(sample_t), (unsigned)st1.record_bytes);
+    printf("append   : %u samples, %.2f M samples/s; %u oldest dropped on wrap\n",
+           (unsigned)n, n / (t1 - t0) / 1e6, (unsigned)st1.dropped);
+    printf("drain    : %u samples in %u batches, %.2f M samples/s (peek %d + consume)\n",
+           (unsigned)kept, (unsigned)batches, kept / (t2 - t1) / 1e6, BATCH);
+    printf("flash    : %.2f B programmed per payload byte, 1 erase per %.1f samples\n",
+           (double)(st1.flash_bytes - st0.flash_bytes) / ((double)st1.flushed * sizeof(sample_t)),
+           (double)st1.flushed / (st1.sector_erases - st0.sector_erases));
+    printf("           draining programmed %.1f B per %d-sample batch (bitmap only)\n",
+           (double)(st2.flash_bytes - st1.flash_bytes) / batches, BATCH);
+    return s_fail;
+}
+
+static int boot_fill(void *arg)
+{
+    uint32_t *r = arg;   // append [r[0], r[1]), consume r[2]
+    check(append_run(r[0], r[1]), "append");
+    check(sample_log_consume((int)r[2]) == ESP_OK, "consume");
+    return s_fail;
+}
+
+static int boot_verify(void *arg)
+{
+    uint32_t *r = arg;   // expect [r[0], r[1]) pending
+    check(sample_log_count() == r[1] - r[0], "pending count after remount");
+    check(drain_run(r[0], r[1], NULL), "remount returns the pending samples in order");
+    // The log goes on from where it was.
+    check(append_run(r[1], r[1] + 100), "append after remount");
+    check(drain_run(r[1], r[1] + 100, NULL), "drain after remount");
+    return s_fail;
+}
+
+static int boot_corrupt(void *arg)
+{
+    uint32_t *r = arg;   // [0, r[1]) pending, record r[0] corrupt
+    sample_t buf[BATCH];
+    check(sample_log_count() == r[1], "pending count before the corrupt record");
+    check(sample_log_peek(buf, (int)r[0]) == (int)r[0] && same(&buf[0], 0) &&
+          sample_log_consume((int)r[0]) == ESP_OK, "consume up to the corrupt record");
+    // The next peek starts at the corrupt record: it must not stay counted.
+    int n = sample_log_peek(buf, BATCH);
+    sample_log_stats_t st;
+    sample_log_get_stats(&st);
+    check(n > 0 && same(&buf[0], r[0] + 1), "peek skips the corrupt record");
+    check(sample_log_count() == r[1] - r[0] - 1 && st.corrupt == 1,
+          "corrupt record still counted after the peek");
+    check(drain_run(r[0] + 1, r[1], NULL), "drain after the corrupt record");
+    return s_fail;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t n = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 20000;
+    int fail = 0;
+
+    unlink(SAMPLE_LOG_HOST_FILE);
+    fail += boot(boot_throughput, &n);
+
+    // Remount: 700 of 1000 left pending, across a sector boundary.
+    unlink(SAMPLE_LOG_HOST_FILE);
+    uint32_t fill[3] = { 0, 1000, 300 }, left[2] = { 300, 1000 };
+    fail += boot(boot_fill, fill);
+    int remount = boot(boot_verify, left);
+    printf("remount  : 700 of 1000 pending, found in order: %s\n", remount ? "no" : "yes");
+    fail += remount;
+
+    // Torn flush: 40 samples on flash, then 8 more programmed in one go. Cut
+    // that program at every 5th byte, i.e. leave the rest of it erased, and
+    // remount: the records before the cut survive, the cut one is dropped.
+    unlink(SAMPLE_LOG_HOST_FILE);
+    uint32_t base[3] = { 0, 40, 0 }, more[3] = { 40, 48, 0 };
+    size_t len0 = 0, len1 = 0;
+    fail += boot(boot_fill, base);
+    uint8_t *before = read_file(&len0);
+    fail += boot(boot_fill, more);
+    uint8_t *after = read_file(&len1);
+    if (!before || !after || len0 != len1) {
+        printf("FAIL     : cannot snapshot %s\n", SAMPLE_LOG_HOST_FILE);
+        return 1;
+    }
+    size_t lo = 0, hi = len1;
+    while (lo < len1 && before[lo] == after[lo]) ++lo;
+    while (hi > lo && before[hi - 1] == after[hi - 1]) --hi;
+    sample_log_stats_t st;
+    sample_log_get_stats(&st);
+    size_t slot = st.record_bytes;
+    check(hi - lo == 8 * slot, "8 records programmed in one flush");
+    int cuts = 0, torn_fail = 0;
+    for (size_t cut = 0; cut < hi - lo; cut += 5, ++cuts) {
+        uint8_t *img = malloc(len1);
+        memcpy(img, after, len1);
+        memcpy(img + lo + cut, before + lo + cut, hi - lo - cut);
+        write_file(img, len1);
+        free(img);
+        uint32_t want[2] = { 0, 40 + (uint32_t)(cut / slot) };
+        torn_fail += boot(boot_verify, want) != 0;
+    }
+    printf("torn     : %d cuts in an 8-record flush, intact records kept: %s\n",
+           cuts, torn_fail ? "no" : "yes");
+    fail += torn_fail + s_fail;
+
+    // Corrupt record: 200 records, so the first sector is not the head one
+    // (mount only checks that), and one byte of record 10 flipped. Consuming
+    // records 0-9 stops in front of it; the peek after must drop it from the
+    // count, or the uploader sees a sample it can never read.
+    unlink(SAMPLE_LOG_HOST_FILE);
+    uint32_t full[3] = { 0, 200, 0 }, bad[2] = { 10, 200 };
+    fail += boot(boot_fill, full);
+    free(after);
+    after = read_file(&len1);
+    sample_t rec;
+    make(&rec, bad[0]);
+    uint8_t *hit = after ? memmem(after, len1, &rec, sizeof(rec)) : NULL;
+    check(hit != NULL, "record 10 not found in the log file");
+    if (hit) {
+        hit[sizeof(rec) - 1] ^= 0xFF;
+        write_file(after, len1);
+    }
+    int corrupt = boot(boot_corrupt, bad);
+    printf("corrupt  : record %u of %u fails its CRC, released on the next peek: %s\n",
+           (unsigned)bad[0], (unsigned)bad[1], corrupt ? "no" : "yes");
+    fail += corrupt;
+    free(before);
+    free(after);
+    unlink(SAMPLE_LOG_HOST_FILE);
+
+    printf("%s\n", fail ? "FAIL" : "OK");
+    return fail > 100 ? 100 : fail;
+}
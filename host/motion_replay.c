@@ -0,0 +1,191 @@
+// host/motion_replay.c — replays a PIR edge trace through motion_track
+//
+//   ./motion_replay host/motion_traces/chatter.txt
+//
+// Trace lines (times in ms, '#' comments):
+//   debounce <ms>                                  before start; default MOTION_DEBOUNCE_US
+//   <t> start high|low                             pin level at boot
+//   <t> high | low                                 raw edge as the ISR timestamps it
+//   <t> take                                       close the publish window
+//   expect occupied=<ms> first=<t>|none last=<t>|none edges=<n> [glitches=<n>]
+// An expect line checks the window closed by the last take; first/last are
+// absolute trace times. Every window is printed; the exit status is the number
+// of failed expectations.
+#include "motion_track.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static motion_track_t  s_m;
+static motion_window_t s_last;
+static int64_t         s_last_start;
+static int             s_failed;
+
+__attribute__((format(printf, 2, 3)))
+static void fail(int line, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    printf("FAIL line %d: ", line);
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+    s_failed++;
+}
+
+static void time_text(int64_t us, char *out, size_t cap)
+{
+    if (us < 0) snprintf(out, cap, "none");
+    else        snprintf(out, cap, "%lld", (long long)(us / 1000));
+}
+
+// "none" or a time in ms; returns false on a malformed value.
+static bool parse_time(const char *v, int64_t *us)
+{
+    if (strcmp(v, "none") == 0) {
+        *us = -1;
+        return true;
+    }
+    char *end;
+    double ms = strtod(v, &end);
+    *us = (int64_t)(ms * 1000.0);
+    return end != v && *end == '\0';
+}
+
+static void expect(int line, char *save)
+{
+    char *kv;
+    while ((kv = strtok_r(NULL, " \t\r\n", &save))) {
+        char *eq = strchr(kv, '=');
+        if (!eq) {
+            fail(line, "bad expectation '%s'", kv);
+            continue;
+        }
+        *eq = '\0';
+        const char *key = kv, *val = eq + 1;
+        int64_t want, got;
+        if (strcmp(key, "occupied") == 0) {
+            want = (int64_t)(atof(val) * 1000.0);
+            got = s_last.occupied_us;
+        } else if (strcmp(key, "first") == 0 || strcmp(key, "last") == 0) {
+            if (!parse_time(val, &want)) {
+                fail(line, "bad time '%s'", val);
+                continue;
+            }
+            got = key[0] == 'f' ? s_last.first_us : s_last.last_us;
+        } else if (strcmp(key, "edges") == 0) {
+            want = atoll(val);
+            got = s_last.edges;
+        } else if (strcmp(key, "glitches") == 0) {
+            want = atoll(val);
+            got = s_last.glitches;
+        } else {
+            fail(line, "unknown key '%s'", key);
+            continue;
+        }
+        if (got != want) {
+            bool us = strcmp(key, "edges") != 0 && strcmp(key, "glitches") != 0;
+            char g[24], w[24];
+            if (us) {
+                time_text(got, g, sizeof(g));
+                time_text(want, w, sizeof(w));
+            } else {
+                snprintf(g, sizeof(g), "%lld", (long long)got);
+                snprintf(w, sizeof(w), "%lld", (long long)want);
+            }
+            fail(line, "%s=%s, expected %s", key, g, w);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s TRACE\n", argv[0]);
+        return 2;
+    }
+    FILE *f = fopen(argv[1], "r");
+    if (!f) {
+        perror(argv[1]);
+        return 2;
+    }
+
+    int64_t debounce_us = MOTION_DEBOUNCE_US;
+    int64_t now = 0;
+    bool started = false;
+    uint32_t windows = 0, raw_edges = 0, edges = 0, glitches = 0;
+    int64_t occupied = 0, span = 0;
+
+    char line[256];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char *save = NULL;
+        char *tok = strtok_r(line, " \t\r\n", &save);
+        if (!tok) continue;
+
+        if (strcmp(tok, "debounce") == 0) {
+            char *v = strtok_r(NULL, " \t\r\n", &save);
+            debounce_us = (int64_t)((v ? atof(v) : 0.0) * 1000.0);
+            continue;
+        }
+        if (strcmp(tok, "expect") == 0) {
+            expect(lineno, save);
+            continue;
+        }
+
+        int64_t t = (int64_t)(atof(tok) * 1000.0);
+        char *what = strtok_r(NULL, " \t\r\n", &save);
+        if (!what) {
+            fail(lineno, "missing event");
+            continue;
+        }
+        if (t < now) fail(lineno, "time goes backwards");
+        now = t;
+
+        if (strcmp(what, "start") == 0) {
+            char *lv = strtok_r(NULL, " \t\r\n", &save);
+            motion_track_init(&s_m, t, lv && strcmp(lv, "high") == 0, debounce_us);
+            started = true;
+            continue;
+        }
+        if (!started) {
+            fail(lineno, "event before start");
+            continue;
+        }
+        if (strcmp(what, "high") == 0 || strcmp(what, "low") == 0) {
+            motion_track_edge(&s_m, t, what[0] == 'h');
+            raw_edges++;
+        } else if (strcmp(what, "take") == 0) {
+            s_last_start = s_m.win_start;
+            motion_track_take(&s_m, t, &s_last);
+            char first[24], last[24];
+            time_text(s_last.first_us, first, sizeof(first));
+            time_text(s_last.last_us, last, sizeof(last));
+            printf("%8lld ms  window %lld..%lld  occupied=%lld first=%s last=%s edges=%u glitches=%u\n",
+                   (long long)(t / 1000), (long long)(s_last_start / 1000),
+                   (long long)(t / 1000), (long long)(s_last.occupied_us / 1000),
+                   first, last, (unsigned)s_last.edges, (unsigned)s_last.glitches);
+            windows++;
+            edges += s_last.edges;
+            glitches += s_last.glitches;
+            occupied += s_last.occupied_us;
+            span += t - s_last_start;
+        } else {
+            fail(lineno, "unknown event '%s'", what);
+        }
+    }
+    fclose(f);
+
+    printf("\n%u windows, %u raw edges -> %u motion starts, %u glitches rejected\n",
+           (unsigned)windows, (unsigned)raw_edges, (unsigned)edges, (unsigned)glitches);
+    printf("occupied %.3f s of %.3f s (%.1f%%), debounce %lld ms\n",
+           occupied / 1e6, span / 1e6, span > 0 ? 100.0 * occupied / span : 0.0,
+           (long long)(debounce_us / 1000));
+    printf("%s\n", s_failed ? "FAILED" : "OK");
+    return s_failed;
+}
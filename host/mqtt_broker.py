@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+# host/mqtt_broker.py — local MQTT 3.1.1 broker for the host build
+#
+#   python3 host/mqtt_broker.py [--port 1883] [--directive JSON]
+#                               [--drop-rate P] [--lose-ack-rate P] [--quiet]
+#
+# A stand-in for Mosquitto with just what transport_mqtt.c needs: CONNECT
+# (persistent sessions keep their subscriptions), PUBLISH at QoS 0/1 with
+# PUBACK, SUBSCRIBE with + and # filters, PINGREQ and DISCONNECT. Publishes
+# are forwarded to matching subscribers, so a second client can push .../ctl
+# directives. --directive is kept as the retained message of every .../ctl
+# topic (see main/flow_ctl.h). --drop-rate closes the connection instead of
+# acknowledging that share of QoS1 publishes. --lose-ack-rate takes that
+# share (printed and forwarded) and then closes before the PUBACK, as when
+# the acknowledgement is lost with the link. Prints one line per publish;
+# a QoS1 payload seen before is marked "duplicate" with the running count.
+import argparse
+import hashlib
+import random
+import socket
+import struct
+import threading
+
+lock = threading.Lock()
+sessions = {}   # client id -> set of filters (persistent sessions only)
+clients = {}    # client id -> Conn
+retained = {}   # topic -> payload
+seen = set()    # digests of QoS1 payloads taken
+dups = 0
+
+
+def matches(flt, topic):
+    f, t = flt.split("/"), topic.split("/")
+    for i, part in enumerate(f):
+        if part == "#":
+            return True
+        if i >= len(t) or (part != "+" and part != t[i]):
+            return False
+    return len(f) == len(t)
+
+
+def frame(kind, body):
+    n, hdr = len(body), bytearray([kind])
+    while True:
+        b, n = n % 128, n // 128
+        hdr.append(b | (0x80 if n else 0))
+        if not n:
+            return bytes(hdr) + body
+
+
+def publish_frame(topic, payload, qos, mid):
+    t = topic.encode()
+    body = struct.pack(">H", len(t)) + t + (struct.pack(">H", mid) if qos else b"") + payload
+    return frame(0x30 | (qos << 1), body)
+
+
+class Conn:
+    def __init__(self, sock, args):
+        self.sock, self.args = sock, args
+        self.cid, self.subs, self.mid = None, set(), 0
+        self.wlock = threading.Lock()
+
+    def send(self, data):
+        with self.wlock:
+            self.sock.sendall(data)
+
+    def deliver(self, topic, payload):
+        self.mid = self.mid % 65535 + 1
+        self.send(publish_frame(topic, payload, 1, self.mid))
+
+    def recv_exact(self, n):
+        buf = b""
+        while len(buf) < n:
+            chunk = self.sock.recv(n - len(buf))
+            if not chunk:
+                raise ConnectionError
+            buf += chunk
+        return buf
+
+    def read(self):
+        kind = self.recv_exact(1)[0]
+        n, mul = 0, 1
+        while True:
+            b = self.recv_exact(1)[0]
+            n += (b & 0x7F) * mul
+            mul *= 128
+            if not b & 0x80:
+                break
+        return kind, self.recv_exact(n)
+
+    def run(self):
+        try:
+            while True:
+                kind, body = self.read()
+                if not self.handle(kind >> 4, kind, body):
+                    break
+        except (ConnectionError, OSError):
+            pass
+        finally:
+            with lock:
+                if self.cid and clients.get(self.cid) is self:
+                    del clients[self.cid]
+            self.sock.close()
+
+    def handle(self, typ, kind, body):
+        global dups
+        a = self.args
+        if typ == 1:   # CONNECT
+            plen = struct.unpack(">H", body[:2])[0]
+            flags = body[2 + plen + 1]
+            p = 2 + plen + 4
+            clen = struct.unpack(">H", body[p:p + 2])[0]
+            self.cid = body[p + 2:p + 2 + clen].decode()
+            clean = bool(flags & 0x02)
+            with lock:
+                old = clients.get(self.cid)
+                if old:
+                    old.sock.close()
+                clients[self.cid] = self
+                present = not clean and self.cid in sessions
+                if clean:
+                    sessions.pop(self.cid, None)
+                self.subs = sessions.setdefault(self.cid, set()) if not clean else set()
+            self.send(frame(0x20, bytes([1 if present else 0, 0])))
+            if not a.quiet:
+                print(f"CONNECT {self.cid} clean={int(clean)} session_present={int(present)}", flush=True)
+        elif typ == 3:   # PUBLISH
+            qos = (kind >> 1) & 3
+            tlen = struct.unpack(">H", body[:2])[0]
+            topic = body[2:2 + tlen].decode()
+            p = 2 + tlen
+            mid = None
+            if qos:
+                mid = struct.unpack(">H", body[p:p + 2])[0]
+                p += 2
+            payload = body[p:]
+            if qos and random.random() < a.drop_rate:
+                if not a.quiet:
+                    print(f"{topic} {len(payload)} B qos{qos} DROPPED", flush=True)
+                return False
+            if kind & 1:
+                retained[topic] = payload
+            note = ""
+            if qos:
+                digest = hashlib.sha1(topic.encode() + payload).digest()
+                with lock:
+                    if digest in seen:
+                        dups += 1
+                        note = f" duplicate ({dups} so far)"
+                    seen.add(digest)
+            lose = qos and random.random() < a.lose_ack_rate
+            if qos and not lose:
+                self.send(frame(0x40, struct.pack(">H", mid)))
+            if not a.quiet or note or lose:
+                print(f"{topic} {len(payload)} B qos{qos}{note}" + (" ACK LOST" if lose else ""), flush=True)
+            with lock:
+                targets = [c for c in clients.values() if any(matches(f, topic) for f in c.subs)]
+            for c in targets:
+                try:
+                    c.deliver(topic, payload)
+                except OSError:
+                    pass
+            if lose:
+                return False
+        elif typ == 8:   # SUBSCRIBE
+            mid = struct.unpack(">H", body[:2])[0]
+            p, granted, filters = 2, bytearray(), []
+            while p < len(body):
+                flen = struct.unpack(">H", body[p:p + 2])[0]
+                flt = body[p + 2:p + 2 + flen].decode()
+                p += 2 + flen
+                granted.append(min(body[p], 1))
+                p += 1
+                filters.append(flt)
+            with lock:
+                self.subs.update(filters)
+            out = frame(0x90, struct.pack(">H", mid) + bytes(granted))
+            for flt in filters:
+                if a.directive and flt.endswith("/ctl"):
+                    retained.setdefault(flt, a.directive.encode())
+                for topic, payload in list(retained.items()):
+                    if matches(flt, topic):
+                        self.mid = self.mid % 65535 + 1
+                        out += publish_frame(topic, payload, 1, self.mid)
+            self.send(out)   # SUBACK and the retained messages in one write
+            if not a.quiet:
+                print(f"SUBSCRIBE {self.cid} {' '.join(filters)}", flush=True)
+        elif typ == 12:  # PINGREQ
+            self.send(frame(0xD0, b""))
+        elif typ == 14:  # DISCONNECT
+            return False
+        return True      # PUBACK from the client and anything else: nothing to do
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--port", type=int, default=1883)
+    ap.add_argument("--directive", help='e.g. \'{"publish_s": 30, "batch_max": 10}\'')
+    ap.add_argument("--drop-rate", type=float, default=0.0)
+    ap.add_argument("--lose-ack-rate", type=float, default=0.0)
+    ap.add_argument("--quiet", action="store_true")
+    args = ap.parse_args()
+
+    srv = socket.socket()
+    srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    srv.bind(("127.0.0.1", args.port))
+    srv.listen(64)
+    while True:
+        sock, _ = srv.accept()
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        threading.Thread(target=Conn(sock, args).run, daemon=True).start()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,445 @@
+// host/report_bench.c — uplink volume with report_filter and room state events
+//
+//   ./report_bench [--min-accuracy PCT] host/room_traces/lecture_day.txt host/room_traces/empty_weekend.txt
+//
+// Replays room traces (the aulasense_host --sensors format) the way the node
+// samples them: BH1750 every 120 ms and BME280 every 500 ms with sensor noise
+// and their quantisation, PIR edges through motion_track, one sample per
+// 10 s window. Each trace is run through the same upload_sched and encoders
+// four times: sending every sample (as before), through report_filter with
+// its defaults, occupancy events only, and events alongside the filtered
+// samples. The records, POSTs and body bytes are compared. The
+// reconstruction columns show the largest error a server makes by repeating
+// the last reported sample over held windows.
+//
+// A trace with a .labels file next to it (t_s and state per line, each
+// holding until the next) also gets the events scored: the share of time the
+// timeline a server rebuilds from them matches the labels, overall and per
+// state bit, and the same for the state the node holds live. --min-accuracy
+// fails the run (exit status 1) if a timeline scores lower.
+#include "motion_track.h"
+#include "occupancy.h"
+#include "payload_cbor.h"
+#include "payload_json.h"
+#include "report_filter.h"
+#include "upload_sched.h"
+#include "window_stats.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WINDOW_S     10
+#define LUX_EVERY_MS 120
+#define TEMP_EVERY_MS 500
+#define EPOCH        1757304000   // 2025-09-08 04:00 UTC, wall-clock base
+
+typedef struct {
+    double t_s;
+    float  temp_c, lux;
+    bool   pir;
+} pt_t;
+
+static pt_t  *s_pts;
+static size_t s_npts;
+static size_t s_cur;    // interpolation cursor
+
+static bool load(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+    size_t cap = 0;
+    char line[256];
+    s_npts = 0;
+    s_cur = 0;
+    while (fgets(line, sizeof(line), f)) {
+        for (char *c = line; *c; ++c) if (*c == ',') *c = ' ';
+        char *p = line;
+        while (isspace((unsigned char)*p)) ++p;
+        if (*p == '#' || *p == '\0') continue;
+        pt_t pt;
+        int pir = 0;
+        if (sscanf(p, "%lf %f %f %d", &pt.t_s, &pt.temp_c, &pt.lux, &pir) != 4) break;
+        pt.pir = pir != 0;
+        if (s_npts == cap) {
+            cap = cap ? cap * 2 : 256;
+            s_pts = realloc(s_pts, cap * sizeof(*s_pts));
+        }
+        s_pts[s_npts++] = pt;
+    }
+    fclose(f);
+    return s_npts > 0;
+}
+
+// Same interpolation as host_sensors.c: temp/lux linear, pir held. t must
+// not decrease between calls for one trace.
+
+static void at(double t, float *temp, float *lux, bool *pir)
+{
+    if (t <= s_pts[0].t_s || s_npts == 1) {
+        *temp = s_pts[0].temp_c; *lux = s_pts[0].lux; *pir = s_pts[0].pir;
+        return;
+    }
+    if (s_cur == 0) s_cur = 1;
+    while (s_cur < s_npts && s_pts[s_cur].t_s < t) ++s_cur;
+    if (s_cur == s_npts) {
+        const pt_t *p = &s_pts[s_npts - 1];
+        *temp = p->temp_c; *lux = p->lux; *pir = p->pir;
+        return;
+    }
+    const pt_t *a = &s_pts[s_cur - 1], *b = &s_pts[s_cur];
+    double f = (t - a->t_s) / (b->t_s - a->t_s);
+    *temp = (float)(a->temp_c + f * (b->temp_c - a->temp_c));
+    *lux  = (float)(a->lux + f * (b->lux - a->lux));
+    *pir  = a->pir;
+}
+
+static uint32_t s_rng = 12345;
+
+static double gauss(void)   // Box-Muller on xorshift32
+{
+    double u[2];
+    for (int k = 0; k < 2; ++k) {
+        s_rng ^= s_rng << 13;
+        s_rng ^= s_rng >> 17;
+        s_rng ^= s_rng << 5;
+        u[k] = (s_rng + 1.0) / 4294967297.0;
+    }
+    return sqrt(-2.0 * log(u[0])) * cos(2 * M_PI * u[1]);
+}
+
+// BME280 with IIR x4: ~0.005 °C rms, 0.01 °C steps.
+static float read_temp(float t) { return roundf((float)(t + 0.005 * gauss()) * 100.0f) / 100.0f; }
+
+// BH1750 high-res: counts of 1/1.2 lx, ~0.5 count + 0.5 % rms.
+static float read_lux(float l)
+{
+    double c = l * 1.2 + (0.5 + 0.005 * l * 1.2) * gauss();
+    return c > 0 ? (float)(round(c) / 1.2) : 0.0f;
+}
+
+// Labels: the state from t_s on.
+typedef struct {
+    uint32_t t_s;
+    uint8_t  state;
+} label_t;
+
+#define MAX_LABELS 256
+static label_t s_labels[MAX_LABELS];
+static int     s_nlabels;
+
+static int state_from_name(const char *name)
+{
+    for (int st = 0; st < 8; ++st) {
+        if (!strcmp(name, occupancy_state_name((uint8_t)st))) return st;
+    }
+    return -1;
+}
+
+// <trace>.labels for <trace>.txt; false if there is none.
+static bool load_labels(const char *trace)
+{
+    char path[512];
+    const char *dot = strrchr(trace, '.');
+    int stem = dot ? (int)(dot - trace) : (int)strlen(trace);
+    snprintf(path, sizeof(path), "%.*s.labels", stem, trace);
+    s_nlabels = 0;
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+    char line[256], name[64];
+    unsigned t;
+    while (fgets(line, sizeof(line), f) && s_nlabels < MAX_LABELS) {
+        char *p = line;
+        while (isspace((unsigned char)*p)) ++p;
+        if (*p == '#' || *p == '\0') continue;
+        int st;
+        if (sscanf(p, "%u %63s", &t, name) != 2 || (st = state_from_name(name)) < 0) {
+            fprintf(stderr, "%s: bad line: %s", path, p);
+            break;
+        }
+        s_labels[s_nlabels++] = (label_t){ t, (uint8_t)st };
+    }
+    fclose(f);
+    return s_nlabels > 0;
+}
+
+static uint8_t label_at(uint32_t t_s)
+{
+    uint8_t st = s_labels[0].state;
+    for (int i = 0; i < s_nlabels && s_labels[i].t_s <= t_s; ++i) st = s_labels[i].state;
+    return st;
+}
+
+// Time in agreement with the labels: all bits, then OCC_OCCUPIED/LIGHTS/AC.
+typedef struct {
+    uint32_t total;
+    uint32_t match[4];
+} score_t;
+
+static void score_add(score_t *sc, uint8_t got, uint8_t want, uint32_t s)
+{
+    sc->total += s;
+    if (got == want) sc->match[0] += s;
+    for (int b = 0; b < 3; ++b) {
+        if (!((got ^ want) & (1u << b))) sc->match[1 + b] += s;
+    }
+}
+
+static double score_pct(const score_t *sc, int k)
+{
+    return sc->total ? 100.0 * sc->match[k] / sc->total : 0.0;
+}
+
+typedef struct {
+    const char *name;
+    bool        samples;         // send the samples...
+    bool        filter;          // ...through report_filter
+    bool        events;          // send the occupancy events
+    report_filter_t rf;
+    upload_sched_t  sched;
+    sample_t    queue[UPLOADER_MAX_SAMPLES * 4];
+    int         n;
+    uint32_t    records, posts;
+    size_t      json, cbor;
+    sample_t    last;            // server side: last sample received
+    double      err_temp, err_lux;
+    uint32_t    err_motion;
+} run_t;
+
+static void run_init(run_t *r, const char *name, bool samples, bool filter, bool events)
+{
+    memset(r, 0, sizeof(*r));
+    r->name = name;
+    r->samples = samples;
+    r->filter = filter;
+    r->events = events;
+    report_filter_init(&r->rf, NULL);
+    upload_sched_init(&r->sched, NULL, 1);
+    r->sched.cfg.batch_max = UPLOADER_MAX_SAMPLES;
+}
+
+static void run_pump(run_t *r, const device_id_t *id, uint32_t now_ms)
+{
+    while (r->n > 0 && upload_sched_due(&r->sched, (uint32_t)r->n, now_ms) == 0) {
+        int k = r->n < UPLOADER_MAX_SAMPLES ? r->n : UPLOADER_MAX_SAMPLES;
+        r->json += payload_json_size(id, r->queue, k);
+        r->cbor += payload_cbor_size(id, r->queue, k);
+        r->posts++;
+        memmove(r->queue, r->queue + k, (size_t)(r->n - k) * sizeof(sample_t));
+        r->n -= k;
+        upload_sched_report(&r->sched, true, now_ms);
+    }
+}
+
+static void run_queue(run_t *r, const sample_t *s)
+{
+    r->records++;
+    if (r->n < (int)(sizeof(r->queue) / sizeof(r->queue[0]))) r->queue[r->n++] = *s;
+}
+
+static void run_sample(run_t *r, const sample_t *in, uint32_t now_s)
+{
+    if (!r->samples) return;
+    sample_t s = *in;
+    if (r->filter && !report_filter_check(&r->rf, &s, now_s)) {
+        // The server repeats r->last for this window.
+        double dt = fabs((s.temp - r->last.temp) / 100.0);
+        double dl = fabs(((double)s.lux - r->last.lux) / 10.0);
+        if (dt > r->err_temp) r->err_temp = dt;
+        if (dl > r->err_lux)  r->err_lux = dl;
+        if ((s.flags ^ r->last.flags) & SAMPLE_F_MOTION) r->err_motion++;
+        return;
+    }
+    r->last = s;
+    run_queue(r, &s);
+}
+
+static void print_run(const run_t *r, const run_t *base)
+{
+    printf("  %-8s %7u records %6u POSTs %9zu B JSON %8zu B CBOR",
+           r->name, (unsigned)r->records, (unsigned)r->posts, r->json, r->cbor);
+    if (base == r) {
+        printf("\n");
+        return;
+    }
+    printf("  (-%.1f%% / -%.1f%% / -%.1f%%)",
+           100.0 * (1.0 - (double)r->records / base->records),
+           100.0 * (1.0 - (double)r->posts / base->posts),
+           100.0 * (1.0 - (double)r->json / base->json));
+    if (r->filter) {
+        printf("  max err %.2f C, %.1f lx, %u motion\n", r->err_temp, r->err_lux,
+               (unsigned)r->err_motion);
+        printf("  %-8s %u held, %u heartbeats\n", "", (unsigned)r->rf.stats.held,
+               (unsigned)r->rf.stats.heartbeats);
+    } else {
+        printf("\n");
+    }
+}
+
+// What a server learns from the events: state from at_s on.
+#define MAX_EVENTS 4096
+static label_t s_timeline[MAX_EVENTS];
+static int     s_nevents;
+
+// Returns the timeline's accuracy in percent, or -1 without labels.
+static double bench(const char *path, const device_id_t *id)
+{
+    double end = s_pts[s_npts - 1].t_s;
+    static run_t all, chg, evt, both;
+    run_init(&all, "today", true, false, false);
+    run_init(&chg, "change", true, true, false);
+    run_init(&evt, "events", false, false, true);
+    run_init(&both, "both", true, true, true);
+    run_t *runs[] = { &all, &chg, &evt, &both };
+    const int nruns = (int)(sizeof(runs) / sizeof(runs[0]));
+
+    bool labelled = load_labels(path);
+    occupancy_t occ;
+    occupancy_init(&occ, NULL);
+    score_t live = {0};
+    s_nevents = 0;
+
+    float temp, lux;
+    bool pir;
+    at(0, &temp, &lux, &pir);
+    motion_track_t m;
+    motion_track_init(&m, 0, pir, MOTION_DEBOUNCE_US);
+    size_t next_pt = 1;
+
+    window_stats_t w;
+    window_stats_begin(&w, 0);
+    int64_t t_us = 0;
+    for (int64_t win_end = WINDOW_S * 1000000LL; win_end <= (int64_t)(end * 1e6); win_end += WINDOW_S * 1000000LL) {
+        for (; t_us < win_end; t_us += 10000) {   // 10 ms steps
+            // PIR edges at script points inside this step
+            while (next_pt < s_npts && s_pts[next_pt].t_s * 1e6 <= t_us) {
+                if (s_pts[next_pt].pir != s_pts[next_pt - 1].pir) {
+                    motion_track_edge(&m, (int64_t)(s_pts[next_pt].t_s * 1e6), s_pts[next_pt].pir);
+                }
+                next_pt++;
+            }
+            if (t_us % (LUX_EVERY_MS * 1000) == 0 || t_us % (TEMP_EVERY_MS * 1000) == 0) {
+                at(t_us / 1e6, &temp, &lux, &pir);
+                if (t_us % (LUX_EVERY_MS * 1000) == 0)  stat_acc_add(&w.lux, read_lux(lux));
+                if (t_us % (TEMP_EVERY_MS * 1000) == 0) stat_acc_add(&w.temp, read_temp(temp));
+            }
+        }
+
+        motion_window_t mw;
+        int64_t start = m.win_start;
+        motion_track_take(&m, win_end, &mw);
+        sensors_window_t sw = {
+            .temp_n = w.temp.n, .temp_min = w.temp.min, .temp_max = w.temp.max,
+            .temp_mean = w.temp.mean, .temp_var = stat_acc_var(&w.temp),
+            .lux_n = w.lux.n, .lux_min = w.lux.min, .lux_max = w.lux.max,
+            .lux_mean = w.lux.mean, .lux_var = stat_acc_var(&w.lux),
+            .end_us = win_end, .motion = mw.motion,
+            .motion_s = (float)mw.occupied_us / 1e6f,
+            .motion_duty = (float)mw.occupied_us / (float)(win_end - start),
+            .motion_first_us = mw.first_us, .motion_last_us = mw.last_us,
+            .motion_edges = mw.edges, .motion_glitches = mw.glitches,
+        };
+        window_stats_begin(&w, win_end);
+
+        sample_t s;
+        uint32_t now_s = (uint32_t)(win_end / 1000000);
+        sample_pack(&s, EPOCH + now_s, &sw);
+
+        occupancy_event_t ev[OCC_MAX_EVENTS];
+        int n_ev = occupancy_update(&occ, &sw, ev);
+        for (int i = 0; i < n_ev; ++i) {
+            sample_t e;
+            occupancy_pack(&e, &s, &ev[i]);
+            for (int k = 0; k < nruns; ++k) {
+                if (runs[k]->events) run_queue(runs[k], &e);
+            }
+            if (ev[i].prev != ev[i].state && s_nevents < MAX_EVENTS) {
+                s_timeline[s_nevents++] = (label_t){ now_s - ev[i].before_s, ev[i].state };
+            }
+        }
+        if (labelled) score_add(&live, occ.state, label_at(now_s - 1), WINDOW_S);
+
+        for (int k = 0; k < nruns; ++k) run_sample(runs[k], &s, now_s);
+        for (uint32_t ms = 0; ms < WINDOW_S * 1000; ms += 1000) {
+            for (int k = 0; k < nruns; ++k) run_pump(runs[k], id, now_s * 1000 + ms);
+        }
+    }
+
+    printf("%s (%.1f h)\n", path, end / 3600.0);
+    for (int k = 0; k < nruns; ++k) print_run(runs[k], &all);
+    printf("  %-8s %u transitions", "", (unsigned)(occ.stats.events - 1));
+    if (labelled) printf(" (%d labelled)", s_nlabels - 1);
+    printf(", %u heartbeats\n", (unsigned)occ.stats.heartbeats);
+
+    double pct = -1;
+    if (labelled && s_nevents > 0) {
+        // The server's timeline, second by second from the first event.
+        score_t tl = {0};
+        int cur = 0;
+        for (uint32_t t = s_timeline[0].t_s; t < (uint32_t)end; ++t) {
+            while (cur + 1 < s_nevents && s_timeline[cur + 1].t_s <= t) ++cur;
+            score_add(&tl, s_timeline[cur].state, label_at(t), 1);
+        }
+        pct = score_pct(&tl, 0);
+        printf("  %-8s timeline matches the labels %.1f%% of the time "
+               "(occupied %.1f%%, lights %.1f%%, ac %.1f%%); live state %.1f%%\n", "",
+               pct, score_pct(&tl, 1), score_pct(&tl, 2), score_pct(&tl, 3),
+               score_pct(&live, 0));
+        for (int i = 0; i < s_nevents; ++i) {
+            uint32_t t = s_timeline[i].t_s;
+            printf("  %-8s %7u s  %02u:%02u:%02u  %s\n", "", (unsigned)t, (unsigned)(t / 3600),
+                   (unsigned)(t / 60 % 60), (unsigned)(t % 60),
+                   occupancy_state_name(s_timeline[i].state));
+        }
+    }
+    printf("\n");
+    return pct;
+}
+
+int main(int argc, char **argv)
+{
+    double min_accuracy = 0;
+    int first = 1;
+    if (argc > 2 && !strcmp(argv[1], "--min-accuracy")) {
+        min_accuracy = atof(argv[2]);
+        first = 3;
+    }
+    if (argc <= first) {
+        fprintf(stderr, "usage: %s [--min-accuracy PCT] TRACE...\n", argv[0]);
+        return 2;
+    }
+    device_id_t id;
+    device_id_get(&id);
+
+    report_filter_t f;
+    report_filter_init(&f, NULL);
+    occupancy_t o;
+    occupancy_init(&o, NULL);
+    printf("deadbands: temp %.2f C, lux max(%.0f lx, %u%%), occupancy %.1f s; heartbeat %u min\n"
+           "room state: empty after %u min, lights %u/%u lx, ac %.2f C/h back by %.2f C; "
+           "heartbeat %u min\n"
+           "other rows: reduction in records / POSTs / JSON bytes against today\n\n",
+           f.cfg.temp_db / 100.0, f.cfg.lux_db / 10.0, (unsigned)f.cfg.lux_db_pct,
+           f.cfg.motion_db / 10.0, (unsigned)(f.cfg.heartbeat_s / 60),
+           (unsigned)(o.cfg.vacancy_s / 60), (unsigned)(o.cfg.lights_on / 10),
+           (unsigned)(o.cfg.lights_off / 10), o.cfg.ac_slope / 100.0, o.cfg.ac_band / 100.0,
+           (unsigned)(o.cfg.heartbeat_s / 60));
+
+    int rc = 0;
+    for (int i = first; i < argc; ++i) {
+        if (!load(argv[i])) {
+            fprintf(stderr, "%s: cannot read trace\n", argv[i]);
+            return 2;
+        }
+        double pct = bench(argv[i], &id);
+        if (min_accuracy > 0 && pct >= 0) {
+            bool ok = pct >= min_accuracy;
+            printf("accuracy : %s (%s %.1f%%, limit %.1f%%)\n\n", ok ? "PASS" : "FAIL",
+                   argv[i], pct, min_accuracy);
+            if (!ok) rc = 1;
+        }
+    }
+    return rc;
+}
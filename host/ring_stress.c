@@ -0,0 +1,154 @@
+// host/ring_stress.c — sample_ring under two real threads
+//
+//   ./ring_stress [N] [SEED]
+//
+// A producer thread pushes N numbered samples (default 5 000 000), retrying
+// while the ring is full where publisher_task would drop the sample. A consumer
+// thread peeks batches of random size and releases random prefixes of what it
+// peeked, as sender_task does when the log takes only part of a batch. Every
+// sample is filled from its number, so the consumer checks each copy for
+// loss, duplication, reordering and torn slots. Exit status is the number of
+// failures (capped).
+//
+// The threads only interleave on a single-CPU host; for the memory-ordering
+// side, build it with -fsanitize=thread as well:
+//   cmake -S host -B build-tsan -DCMAKE_C_FLAGS=-fsanitize=thread
+//   cmake --build build-tsan --target ring_stress && ./build-tsan/ring_stress 1000000
+#include "sample_ring.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static sample_ring_t s_ring;
+static uint32_t      s_n;
+static uint32_t      s_seed = 1;
+static uint64_t      s_full;                    // pushes refused, producer side
+static uint64_t      s_peeks, s_empty, s_released;
+static uint32_t      s_bad_seq, s_bad_body;
+static atomic_bool   s_stop;                    // consumer gave up
+
+static uint32_t rnd(uint32_t *x)
+{
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+// Every field a function of the number, so a half-copied slot shows.
+static void fill(sample_t *s, uint32_t i)
+{
+    memset(s, 0, sizeof(*s));
+    s->t = i;
+    s->temp = (int16_t)(i * 7u);
+    s->flags = (uint8_t)(i & SAMPLE_F_MOTION);
+    s->motion_edges = (uint8_t)(i >> 8);
+    s->lux = ~i;
+    s->temp_min = (int16_t)(i >> 3);
+    s->temp_max = (int16_t)(i >> 5);
+    s->lux_min = i * 2654435761u;
+    s->lux_max = i ^ 0x5a5a5a5au;
+    s->lux_var = i + 1;
+    s->unchanged_since = i * 3u;
+}
+
+static void *producer(void *arg)
+{
+    (void)arg;
+    uint32_t x = s_seed * 2654435761u | 1;
+    sample_t s;
+    for (uint32_t i = 0; i < s_n; ++i) {
+        fill(&s, i);
+        while (!sample_ring_push(&s_ring, &s)) {
+            if (atomic_load(&s_stop)) return NULL;
+            s_full++;
+            sched_yield();
+        }
+        if (rnd(&x) % 64 == 0) sched_yield();   // vary the interleaving
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    (void)arg;
+    uint32_t x = s_seed * 40503u | 1;
+    sample_t out[SAMPLE_RING_CAPACITY + 4], want;
+    uint32_t next = 0;
+    while (next < s_n) {
+        int max = (int)(rnd(&x) % (SAMPLE_RING_CAPACITY + 4)) + 1;   // sometimes > capacity
+        int n = sample_ring_peek(&s_ring, out, max);
+        s_peeks++;
+        if (n == 0) {
+            s_empty++;
+            sched_yield();
+            continue;
+        }
+        // Every peek starts at the oldest unreleased sample.
+        for (int k = 0; k < n; ++k) {
+            if (out[k].t != next + (uint32_t)k) {
+                if (s_bad_seq++ < 5) {
+                    printf("FAIL     : expected sample %u, got %u\n",
+                           (unsigned)(next + k), (unsigned)out[k].t);
+                }
+                break;
+            }
+            fill(&want, out[k].t);
+            if (memcmp(&out[k], &want, sizeof(want)) != 0 && s_bad_body++ < 5) {
+                printf("FAIL     : sample %u copied torn\n", (unsigned)out[k].t);
+            }
+        }
+        int rel = (int)(rnd(&x) % (uint32_t)(n + 1));   // 0..n, as the log allows
+        sample_ring_release(&s_ring, rel);
+        s_released += (uint32_t)rel;
+        next += (uint32_t)rel;
+        if (s_bad_seq > 100) {
+            atomic_store(&s_stop, true);
+            break;
+        }
+    }
+    return NULL;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    s_n = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 5000000;
+    if (argc > 2) s_seed = (uint32_t)strtoul(argv[2], NULL, 0);
+    sample_ring_init(&s_ring);
+
+    double t0 = now_s();
+    pthread_t p, c;
+    pthread_create(&c, NULL, consumer, NULL);
+    pthread_create(&p, NULL, producer, NULL);
+    pthread_join(p, NULL);
+    pthread_join(c, NULL);
+    double t1 = now_s();
+
+    int fail = (int)(s_bad_seq + s_bad_body);
+    if (s_released != s_n || sample_ring_count(&s_ring) != 0) {
+        printf("FAIL     : %llu of %u samples released, %u left in the ring\n",
+               (unsigned long long)s_released, (unsigned)s_n,
+               (unsigned)sample_ring_count(&s_ring));
+        fail++;
+    }
+    printf("ring     : %d slots of %u B\n", SAMPLE_RING_CAPACITY, (unsigned)sizeof(sample_t));
+    printf("stress   : %u samples through in %.2f s (%.1f M/s), %llu peeks (%llu empty), "
+           "%llu pushes refused (full)\n",
+           (unsigned)s_n, t1 - t0, s_n / (t1 - t0) / 1e6, (unsigned long long)s_peeks,
+           (unsigned long long)s_empty, (unsigned long long)s_full);
+    printf("checks   : %u out of sequence, %u torn copies\n",
+           (unsigned)s_bad_seq, (unsigned)s_bad_body);
+    printf("%s\n", fail ? "FAIL" : "OK");
+    return fail > 100 ? 100 : fail;
+}
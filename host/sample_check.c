@@ -0,0 +1,247 @@
+// host/sample_check.c — packed sample_t: size report and JSON round trip
+//
+//   ./sample_check [N]
+//
+// Packs N random publish windows (local time in IST/IDT) into sample_t,
+// encodes them with payload_json in batches of UPLOADER_MAX_SAMPLES, parses
+// the JSON back and checks every field against what the float-based record
+// put on the wire before: the same date/time strings (strftime on the local
+// time), motion and identity unchanged, numbers within half a step of the
+// fixed-point resolution. Exit status is the number of mismatches (capped).
+#include "payload_json.h"
+#include "payload_cbor.h"
+#include "sample_ring.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// The record as it was before packing, laid out as on the ESP32 (newlib's
+// struct tm is nine ints).
+typedef struct {
+    int      tm_local[9];
+    float    temp_c, lux;
+    bool     motion;
+    char     building[16], number[16];
+    float    temp_min, temp_max, temp_var;
+    float    lux_min, lux_max, lux_var;
+    float    motion_duty;
+    uint16_t motion_edges;
+} legacy_sample_t;
+
+typedef struct {
+    time_t           when;
+    sensors_window_t w;
+    uint32_t         held_s;   // unchanged_since this long before, 0 = none
+} window_t;
+
+static char   s_json[UPLOADER_MAX_SAMPLES * 768];
+static size_t s_json_len;
+static int    s_bad;
+
+static esp_err_t collect(void *ctx, const char *data, size_t len)
+{
+    (void)ctx;
+    if (s_json_len + len > sizeof(s_json)) return ESP_ERR_NO_MEM;
+    memcpy(s_json + s_json_len, data, len);
+    s_json_len += len;
+    return ESP_OK;
+}
+
+static double urand(double lo, double hi)
+{
+    return lo + (hi - lo) * ((double)rand() / RAND_MAX);
+}
+
+static void random_window(window_t *x)
+{
+    x->when = (time_t)urand(1.70e9, 2.10e9);
+    sensors_window_t *w = &x->w;
+    memset(w, 0, sizeof(*w));
+    w->temp_n    = 20;
+    w->temp_mean = (float)urand(-10.0, 45.0);
+    w->temp_min  = w->temp_mean - (float)urand(0.0, 0.5);
+    w->temp_max  = w->temp_mean + (float)urand(0.0, 0.5);
+    w->temp_var  = (float)urand(0.0, 0.2);
+    w->lux_n     = 80;
+    w->lux_mean  = (float)urand(0.0, 54000.0);
+    w->lux_min   = w->lux_mean * (float)urand(0.5, 1.0);
+    w->lux_max   = w->lux_mean * (float)urand(1.0, 1.2);
+    w->lux_var   = (float)urand(0.0, 90000.0);
+    w->end_us       = (int64_t)urand(1e7, 1e12);
+    w->motion       = rand() & 1;
+    w->motion_first_us = w->motion_last_us = -1;
+    if (w->motion) {
+        w->motion_s     = (float)urand(0.0, 10.0);
+        w->motion_first_us = w->end_us - (int64_t)urand(0.0, 10e6);
+        w->motion_last_us  = w->motion_first_us + (int64_t)urand(0.0, (double)(w->end_us - w->motion_first_us));
+        w->motion_edges = (uint32_t)urand(0.0, 12.0);
+        w->motion_glitches = (uint32_t)urand(0.0, 5.0);
+    }
+    w->motion_duty  = w->motion_s / 10.0f;
+    x->held_s = rand() % 4 ? 0 : 10 + (uint32_t)urand(0.0, 900.0);
+}
+
+// "key": seconds before the sample time, or null for at_us < 0.
+static void check_before(long i, const char *obj, const char *end, const char *key,
+                         const sensors_window_t *w, int64_t at_us);
+
+// Value of "key": inside one JSON object [obj, end).
+static const char *field(const char *obj, const char *end, const char *key)
+{
+    char pat[32];
+    int n = snprintf(pat, sizeof(pat), "\"%s\":", key);
+    for (const char *p = obj; p + n <= end; ++p) {
+        if (memcmp(p, pat, (size_t)n) == 0) return p + n;
+    }
+    return NULL;
+}
+
+static void mismatch(long i, const char *what, const char *detail)
+{
+    if (s_bad++ < 20) printf("sample %ld: %s mismatch (%s)\n", i, what, detail);
+}
+
+static void check_num(long i, const char *obj, const char *end, const char *key,
+                      double want, double step)
+{
+    const char *v = field(obj, end, key);
+    double got = v ? strtod(v, NULL) : NAN;
+    if (!(fabs(got - want) <= step / 2 + fabs(want) * 1e-6)) {
+        char d[96];
+        snprintf(d, sizeof(d), "%s: got %.6g, float was %.6g", key, got, want);
+        mismatch(i, key, d);
+    }
+}
+
+static void check_str(long i, const char *obj, const char *end, const char *key,
+                      const char *want)
+{
+    const char *v = field(obj, end, key);
+    size_t n = strlen(want);
+    if (!v || v[0] != '"' || v + n + 2 > end || memcmp(v + 1, want, n) != 0 || v[n + 1] != '"') {
+        char d[96];
+        snprintf(d, sizeof(d), "%s: expected \"%s\"", key, want);
+        mismatch(i, key, d);
+    }
+}
+
+static void check_before(long i, const char *obj, const char *end, const char *key,
+                         const sensors_window_t *w, int64_t at_us)
+{
+    if (at_us >= 0) {
+        check_num(i, obj, end, key, (double)(w->end_us - at_us) / 1e6, 0.1);
+        return;
+    }
+    const char *v = field(obj, end, key);
+    if (!v || strncmp(v, "null", 4) != 0) mismatch(i, key, "expected null");
+}
+
+// Compare one batch's JSON with the float windows it was packed from.
+static void check_batch(long base, const window_t *x, int n, const device_id_t *id)
+{
+    const char *p = s_json;
+    const char *end = s_json + s_json_len;
+    for (int k = 0; k < n; ++k) {
+        const char *obj = memchr(p, '{', (size_t)(end - p));
+        const char *close = obj ? memchr(obj, '}', (size_t)(end - obj)) : NULL;
+        if (!close) {
+            mismatch(base + k, "object", "missing");
+            return;
+        }
+        const window_t *wx = &x[k];
+        const sensors_window_t *w = &wx->w;
+        struct tm tm;
+        localtime_r(&wx->when, &tm);
+        char date[16], tod[16];
+        strftime(date, sizeof(date), "%Y-%m-%d", &tm);
+        strftime(tod, sizeof(tod), "%H:%M:%S", &tm);
+
+        check_str(base + k, obj, close, "date", date);
+        check_str(base + k, obj, close, "time", tod);
+        check_num(base + k, obj, close, "temp", w->temp_mean, 0.01);
+        check_num(base + k, obj, close, "lux", w->lux_mean, 0.1);
+        const char *m = field(obj, close, "motion");
+        if (!m || strncmp(m, w->motion ? "true" : "false", w->motion ? 4 : 5) != 0) {
+            mismatch(base + k, "motion", w->motion ? "expected true" : "expected false");
+        }
+        check_num(base + k, obj, close, "temp_min", w->temp_min, 0.01);
+        check_num(base + k, obj, close, "temp_max", w->temp_max, 0.01);
+        check_num(base + k, obj, close, "temp_var", w->temp_var, 0.0001);
+        check_num(base + k, obj, close, "lux_min", w->lux_min, 0.1);
+        check_num(base + k, obj, close, "lux_max", w->lux_max, 0.1);
+        check_num(base + k, obj, close, "lux_var", w->lux_var, 0.01);
+        check_num(base + k, obj, close, "motion_duty", w->motion_duty, 0.001);
+        check_num(base + k, obj, close, "motion_edges", w->motion_edges, 0.0);
+        check_num(base + k, obj, close, "motion_s", w->motion_s, 0.1);
+        check_before(base + k, obj, close, "motion_first", w, w->motion_first_us);
+        check_before(base + k, obj, close, "motion_last", w, w->motion_last_us);
+        check_num(base + k, obj, close, "motion_glitches", w->motion_glitches, 0.0);
+        if (wx->held_s) {
+            char since[32];
+            time_t t = wx->when - wx->held_s;
+            localtime_r(&t, &tm);
+            strftime(since, sizeof(since), "%Y-%m-%d %H:%M:%S", &tm);
+            check_str(base + k, obj, close, "unchanged_since", since);
+        } else if (field(obj, close, "unchanged_since")) {
+            mismatch(base + k, "unchanged_since", "present on a sample that was not held");
+        }
+        check_str(base + k, obj, close, "building", id->building);
+        check_str(base + k, obj, close, "number", id->number);
+        p = close + 1;
+    }
+}
+
+static void report(void)
+{
+    size_t old_sz = sizeof(legacy_sample_t), new_sz = sizeof(sample_t);
+    printf("sample_t     : %zu B packed (12 B core + %zu B window stats/occupancy), was %zu B (%.1fx)\n",
+           new_sz, new_sz - 12, old_sz, (double)old_sz / new_sz);
+    printf("ring         : %d samples = %zu B, was %zu B; same RAM now holds %zu samples\n",
+           SAMPLE_RING_CAPACITY, SAMPLE_RING_CAPACITY * new_sz, SAMPLE_RING_CAPACITY * old_sz,
+           SAMPLE_RING_CAPACITY * old_sz / new_sz);
+    printf("batch buffer : %d samples = %zu B, was %zu B\n",
+           UPLOADER_MAX_SAMPLES, UPLOADER_MAX_SAMPLES * new_sz, UPLOADER_MAX_SAMPLES * old_sz);
+}
+
+int main(int argc, char **argv)
+{
+    long total = argc > 1 ? atol(argv[1]) : 100000;
+    setenv("TZ", "IST-2IDT,M3.4.4/26,M10.5.0", 1);   // as time_sync_start()
+    tzset();
+    srand(1);
+
+    device_id_t id;
+    device_id_get(&id);
+
+    static window_t x[UPLOADER_MAX_SAMPLES];
+    static sample_t s[UPLOADER_MAX_SAMPLES];
+    size_t json_bytes = 0, cbor_bytes = 0;
+    for (long done = 0; done < total;) {
+        int n = total - done < UPLOADER_MAX_SAMPLES ? (int)(total - done) : UPLOADER_MAX_SAMPLES;
+        for (int k = 0; k < n; ++k) {
+            random_window(&x[k]);
+            struct tm tm;
+            localtime_r(&x[k].when, &tm);
+            sample_pack(&s[k], sample_wall_seconds(&tm), &x[k].w);
+            if (x[k].held_s) s[k].unchanged_since = s[k].t - x[k].held_s;
+        }
+        s_json_len = 0;
+        if (payload_json_write(&id, s, n, collect, NULL) != ESP_OK ||
+            payload_json_size(&id, s, n) != s_json_len) {
+            mismatch(done, "batch", "encoder error or size disagrees with output");
+        }
+        check_batch(done, x, n, &id);
+        json_bytes += s_json_len;
+        cbor_bytes += payload_cbor_size(&id, s, n);
+        done += n;
+    }
+
+    report();
+    printf("round trip   : %ld samples, %zu B JSON, %zu B CBOR, %d mismatches\n",
+           total, json_bytes, cbor_bytes, s_bad);
+    printf("%s\n", s_bad ? "FAILED" : "OK");
+    return s_bad > 100 ? 100 : s_bad;
+}
@@ -0,0 +1,235 @@
+// host/sched_sim.c — upload_sched on a simulated clock against a scripted
+// flaky server
+//
+//   ./sched_sim [SEED]
+//
+// Runs sender_task's loop (app_main.c) in simulated milliseconds: a sample
+// every 10 s, waits capped at APP_QUEUE_DRAIN_MS plus a tick, a POST taking
+// RTT_MS and carrying up to UPLOADER_MAX_SAMPLES. The server follows a
+// script: up, down for 30 min, up, answering 503 with Retry-After for a
+// while, up again. Checks, with the scheduler's defaults:
+//   backoff   after the k-th failure in a row the next attempt waits between
+//             half and all of min(10 s * 2^(k-1), 10 min), jittered per node
+//   drain     once the server is back, full batches go 200 ms apart (after
+//             each response) until the backlog is below one batch
+//   coalesce  otherwise a POST carries at least 6 samples or its oldest
+//             sample has waited 60 s, goes as soon as the 6th is in, and no
+//             sample waits longer than 60 s plus the 1 s poll
+//   defer     no attempt before Retry-After, none later than 10 % past it
+//             plus the poll
+// Exit status is the number of failed checks.
+#include "upload_sched.h"
+#include "uploader.h"   // UPLOADER_MAX_SAMPLES
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SAMPLE_MS   10000u
+#define RTT_MS      100u
+#define TICK_MS     1u       // vTaskDelay(pdMS_TO_TICKS(wait) + 1)
+#define DRAIN_MS    60000u   // APP_QUEUE_DRAIN_MS
+#define RUN_MS      (120u * 60000u)
+
+// ----- scripted server -----
+typedef enum { SRV_UP, SRV_DOWN, SRV_BUSY } srv_mode_t;
+
+typedef struct {
+    uint32_t   from_ms;
+    srv_mode_t mode;
+    uint32_t   retry_after_ms;   // SRV_BUSY
+} srv_step_t;
+
+static const srv_step_t k_script[] = {
+    { 0,              SRV_UP,   0 },
+    { 10u * 60000u,   SRV_DOWN, 0 },        // 30 min outage
+    { 40u * 60000u,   SRV_UP,   0 },
+    { 70u * 60000u,   SRV_BUSY, 120000 },   // 503 + Retry-After: 120 for 5 min
+    { 75u * 60000u,   SRV_UP,   0 },
+};
+
+static const srv_step_t *server_at(uint32_t t)
+{
+    const srv_step_t *s = &k_script[0];
+    for (size_t i = 0; i < sizeof(k_script) / sizeof(k_script[0]); ++i) {
+        if (k_script[i].from_ms <= t) s = &k_script[i];
+    }
+    return s;
+}
+
+// ----- run -----
+typedef struct {
+    uint32_t t;            // attempt start
+    bool     ok;
+    uint32_t n;            // samples carried
+    uint32_t backlog;      // samples ready at the attempt
+    uint32_t oldest_age;   // ms the oldest carried sample waited
+    uint32_t failures;     // consecutive failures before this attempt
+    uint32_t defer_until;  // busy answer: earliest allowed retry
+} attempt_t;
+
+static attempt_t s_att[4096];
+static int       s_natt;
+static int       s_fail;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL     : %s\n", what);
+        s_fail++;
+    }
+}
+
+static void run(uint32_t seed)
+{
+    upload_sched_t sched;
+    upload_sched_init(&sched, NULL, seed);
+    sched.cfg.batch_max = UPLOADER_MAX_SAMPLES;
+
+    uint32_t now = 0, sent = 0, failures = 0;
+    s_natt = 0;
+    while (now < RUN_MS && s_natt < (int)(sizeof(s_att) / sizeof(s_att[0]))) {
+        uint32_t made = now / SAMPLE_MS + 1;   // samples at 0, 10 s, 20 s, ...
+        uint32_t backlog = made - sent;
+        uint32_t wait = upload_sched_due(&sched, backlog, now);
+        if (wait > 0) {
+            now += (wait > DRAIN_MS ? DRAIN_MS : wait) + TICK_MS;
+            continue;
+        }
+        const srv_step_t *srv = server_at(now);
+        attempt_t *a = &s_att[s_natt++];
+        a->t = now;
+        a->backlog = backlog;
+        a->n = backlog < UPLOADER_MAX_SAMPLES ? backlog : UPLOADER_MAX_SAMPLES;
+        a->oldest_age = now - sent * SAMPLE_MS;
+        a->failures = failures;
+        a->ok = srv->mode == SRV_UP;
+        a->defer_until = 0;
+        now += RTT_MS;
+        upload_sched_report(&sched, a->ok, now);
+        if (a->ok) {
+            sent += a->n;
+            failures = 0;
+        } else {
+            failures++;
+            if (srv->mode == SRV_BUSY) {
+                upload_sched_defer(&sched, srv->retry_after_ms, now);
+                a->defer_until = now + srv->retry_after_ms;
+            }
+        }
+    }
+}
+
+static uint32_t backoff_cap(uint32_t k)   // k-th failure in a row, from 1
+{
+    uint32_t b = UPLOAD_SCHED_BACKOFF_MIN_MS;
+    for (uint32_t i = 1; i < k && b < UPLOAD_SCHED_BACKOFF_MAX_MS; ++i) b *= 2;
+    return b < UPLOAD_SCHED_BACKOFF_MAX_MS ? b : UPLOAD_SCHED_BACKOFF_MAX_MS;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t seed = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 1;
+    run(seed);
+
+    int posts = 0, backoff_bad = 0, drain_bad = 0, coalesce_bad = 0, defer_bad = 0;
+    int outage_tries = 0;
+    uint32_t max_age = 0, back_ok = 0, drained_at = 0, back_at = 40u * 60000u;
+    char what[160];
+    for (int i = 0; i < s_natt; ++i) {
+        const attempt_t *a = &s_att[i];
+        posts += a->ok;
+        if (i == 0) continue;
+        const attempt_t *p = &s_att[i - 1];
+        uint32_t gap = a->t - (p->t + RTT_MS);   // from the previous response
+
+        if (!p->ok && p->defer_until) {
+            // Retry-After, plus up to 10 % spread; the backoff may be longer.
+            uint32_t lo = p->defer_until - p->t - RTT_MS;
+            uint32_t hi = lo + lo / 10 + backoff_cap(p->failures + 1) + UPLOAD_SCHED_POLL_MS;
+            if (gap < lo || gap > hi) {
+                if (defer_bad++ < 3) printf("defer    : retry %u ms after a %u ms Retry-After\n",
+                                            (unsigned)gap, (unsigned)lo);
+            }
+        } else if (!p->ok) {
+            uint32_t cap = backoff_cap(p->failures + 1);
+            outage_tries++;
+            // Waits are cut at APP_QUEUE_DRAIN_MS and each costs a tick.
+            if (gap < cap / 2 || gap > cap + (cap / DRAIN_MS + 1) * TICK_MS) {
+                if (backoff_bad++ < 3) {
+                    printf("backoff  : failure %u waited %u ms, want %u..%u\n",
+                           (unsigned)(p->failures + 1), (unsigned)gap, (unsigned)(cap / 2),
+                           (unsigned)cap);
+                }
+            }
+        } else if (p->backlog - p->n >= UPLOADER_MAX_SAMPLES) {
+            // Draining: a full batch is left, so it goes after the gap.
+            if (gap < UPLOAD_SCHED_DRAIN_GAP_MS || gap > UPLOAD_SCHED_DRAIN_GAP_MS + TICK_MS) {
+                if (drain_bad++ < 3) printf("drain    : %u ms between full batches\n", (unsigned)gap);
+            }
+        }
+        if (a->ok && a->t >= back_at && !back_ok) back_ok = a->t;
+        if (a->ok && back_ok && !drained_at && a->backlog - a->n < UPLOADER_MAX_SAMPLES) {
+            drained_at = a->t + RTT_MS;   // what is left goes by coalescing
+        }
+        // Steady state: the previous POST went through and left nothing
+        // behind, so this one carries only what came in since.
+        if (a->ok && p->ok && p->backlog == p->n) {
+            // Samples come 10 s apart and the poll is 1 s, so the POST goes
+            // with the 6th sample, not later.
+            if ((a->backlog < UPLOAD_SCHED_COALESCE_MIN && a->oldest_age < UPLOAD_SCHED_COALESCE_MAX_MS) ||
+                a->backlog > UPLOAD_SCHED_COALESCE_MIN) {
+                if (coalesce_bad++ < 3) printf("coalesce : %u samples, oldest %u ms\n",
+                                               (unsigned)a->backlog, (unsigned)a->oldest_age);
+            }
+            if (a->oldest_age > max_age) max_age = a->oldest_age;
+        }
+    }
+    check(outage_tries >= 5, "the outage saw retries");
+    snprintf(what, sizeof(what), "%d retries outside [B/2, B] of their backoff", backoff_bad);
+    check(backoff_bad == 0, what);
+    snprintf(what, sizeof(what), "%d full batches not %u ms apart", drain_bad,
+             (unsigned)UPLOAD_SCHED_DRAIN_GAP_MS);
+    check(drain_bad == 0, what);
+    snprintf(what, sizeof(what), "%d POSTs not at %u samples or %u ms", coalesce_bad,
+             (unsigned)UPLOAD_SCHED_COALESCE_MIN, (unsigned)UPLOAD_SCHED_COALESCE_MAX_MS);
+    check(coalesce_bad == 0, what);
+    check(max_age <= UPLOAD_SCHED_COALESCE_MAX_MS + UPLOAD_SCHED_POLL_MS + TICK_MS,
+          "a sample waited longer than the coalescing bound");
+    check(defer_bad == 0, "Retry-After not honoured");
+    // The first retry after the server is back comes within the backoff then
+    // in force; from there the backlog goes at the drain pace.
+    check(back_ok && back_ok - back_at <= UPLOAD_SCHED_BACKOFF_MAX_MS + DRAIN_MS,
+          "a retry reached the recovered server");
+    check(drained_at && drained_at - back_ok < 10000, "backlog drained within 10 s of recovery");
+
+    // Jitter: the first retry after the outage began, over many nodes, must
+    // spread across the whole [5 s, 10 s] band rather than land together.
+    uint32_t lo = UINT32_MAX, hi = 0;
+    for (uint32_t n = 1; n <= 200; ++n) {
+        run(n * 7919u);
+        for (int i = 1; i < s_natt; ++i) {
+            if (!s_att[i - 1].ok && s_att[i - 1].failures == 0 && !s_att[i - 1].defer_until) {
+                uint32_t gap = s_att[i].t - s_att[i - 1].t - RTT_MS;
+                if (gap < lo) lo = gap;
+                if (gap > hi) hi = gap;
+                break;
+            }
+        }
+    }
+    check(hi - lo >= UPLOAD_SCHED_BACKOFF_MIN_MS * 4 / 10, "first retries of 200 nodes bunch up");
+
+    run(seed);
+    printf("run      : %u min, server down 10..40 min, 503 Retry-After 120 s at 70..75 min\n",
+           (unsigned)(RUN_MS / 60000u));
+    printf("posts    : %d attempts, %d acknowledged; %d retries during the outage\n",
+           s_natt, posts, outage_tries);
+    printf("drain    : first retry %.1f s after the server came back, backlog below one "
+           "batch %.1f s later\n", (back_ok - back_at) / 1000.0,
+           drained_at ? (drained_at - back_ok) / 1000.0 : -1.0);
+    printf("coalesce : oldest sample waited at most %.1f s in steady state\n", max_age / 1000.0);
+    printf("jitter   : first retry of 200 nodes between %.2f s and %.2f s\n", lo / 1000.0,
+           hi / 1000.0);
+    printf("%s\n", s_fail ? "FAIL" : "OK");
+    return s_fail;
+}
@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+# host/sink_server.py — local upload endpoint for the host build
+#
+#   python3 host/sink_server.py [--port 8080] [--fail-rate 0.2] [--close]
+#                               [--accept cbor|json] [--retry-after-s N]
+#                               [--directive JSON]
+#
+# Accepts any POST with keep-alive and answers 200 (or 503 for --fail-rate of
+# requests, with Retry-After if given). --directive is sent as the JSON body
+# of every response (see main/flow_ctl.h). Prints one line per request.
+import argparse
+import random
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--port", type=int, default=8080)
+    ap.add_argument("--fail-rate", type=float, default=0.0)
+    ap.add_argument("--close", action="store_true", help="send Connection: close")
+    ap.add_argument("--accept", choices=["cbor", "json"])
+    ap.add_argument("--retry-after-s", type=int, default=0)
+    ap.add_argument("--directive", help='e.g. \'{"publish_s": 30, "batch_max": 10}\'')
+    ap.add_argument("--quiet", action="store_true")
+    args = ap.parse_args()
+
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def do_POST(self):
+            body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+            status = 503 if random.random() < args.fail_rate else 200
+            reply = b"OK" if status == 200 else b"busy"
+            if args.directive:
+                reply = args.directive.encode()
+            self.send_response(status)
+            self.send_header("Content-Type", "application/json" if args.directive else "text/plain")
+            self.send_header("Content-Length", str(len(reply)))
+            if status == 503 and args.retry_after_s:
+                self.send_header("Retry-After", str(args.retry_after_s))
+            if args.accept:
+                self.send_header("X-AulaSense-Accept", args.accept)
+            if args.close:
+                self.send_header("Connection", "close")
+            self.end_headers()
+            self.wfile.write(reply)
+            if not args.quiet:
+                health = self.headers.get("X-AulaSense-Health")
+                print(f"{self.path} {status} {len(body)} B "
+                      f"{self.headers.get('Content-Type')} {self.headers.get('Content-Encoding') or ''}"
+                      + (f" health={health}" if health else ""),
+                      flush=True)
+
+        def log_message(self, *a):
+            pass
+
+    ThreadingHTTPServer(("127.0.0.1", args.port), Handler).serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,164 @@
+// host/stats_check.c — window_stats: accuracy against a double two-pass
+// reference, and cost per reading
+//
+//   ./stats_check
+//
+// Feeds stat_acc_t the series a window sees (20 temperatures and 83 lux
+// readings per 10 s, plus hour-long runs) and compares min, max, mean and
+// variance with the same series summed in double over two passes. The hard
+// cases are the ones float sums of squares get wrong: a large offset with a
+// small spread (bright lux), a constant series (variance must be exactly 0,
+// never negative), and a step in the middle of a window. The naive float
+// E[x^2] - E[x]^2 is run alongside to show what the running form saves.
+// Reports the time per stat_acc_add(), which the sampler pays per read.
+// Exit status is the number of failures.
+#include "window_stats.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MAX_N 40000
+
+static int s_fail;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL     : %s\n", what);
+        s_fail++;
+    }
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t s_rnd = 1;
+
+static double urand(void)   // [0, 1)
+{
+    s_rnd ^= s_rnd << 13;
+    s_rnd ^= s_rnd >> 17;
+    s_rnd ^= s_rnd << 5;
+    return s_rnd / 4294967296.0;
+}
+
+// ----- series -----
+typedef enum { SER_TEMP, SER_LUX, SER_BRIGHT, SER_CONST, SER_STEP, SER_DRIFT } series_t;
+
+// x[i] as the sensor hands it over: BME280 in 0.01 °C, BH1750 in 1/1.2 lx
+// steps, so the float inputs carry the quantisation the firmware sees.
+static float sample(series_t s, int i)
+{
+    switch (s) {
+    case SER_TEMP:   return roundf((float)(2180 + 3 * sin(i / 7.0) + 4 * urand())) / 100.0f;
+    case SER_LUX:    return roundf((float)((430 + 20 * urand()) * 1.2)) / 1.2f;
+    case SER_BRIGHT: return roundf((float)((54000 + 6 * urand()) * 1.2)) / 1.2f;
+    case SER_CONST:  return 21.37f;
+    case SER_STEP:   return i < 40 ? 305.0f : 1200.0f;   // lights on mid-window
+    case SER_DRIFT:  return roundf((float)(1900 + i * 0.02 + 5 * urand())) / 100.0f;
+    }
+    return 0.0f;
+}
+
+typedef struct {
+    const char *name;
+    series_t    s;
+    int         n;
+    double      var_tol;   // relative
+} case_t;
+
+static const case_t k_cases[] = {
+    { "temp 10 s",   SER_TEMP,   20,    1e-4 },
+    { "lux 10 s",    SER_LUX,    83,    1e-4 },
+    { "bright 10 s", SER_BRIGHT, 83,    1e-3 },
+    { "const 10 s",  SER_CONST,  83,    0 },
+    { "step 10 s",   SER_STEP,   83,    1e-5 },
+    { "temp 1 h",    SER_DRIFT,  7200,  1e-3 },
+    { "bright 1 h",  SER_BRIGHT, 30000, 5e-3 },
+};
+
+static void run_case(const case_t *c)
+{
+    static float x[MAX_N];
+    s_rnd = 12345;
+    for (int i = 0; i < c->n; ++i) x[i] = sample(c->s, i);
+
+    stat_acc_t a;
+    stat_acc_reset(&a);
+    float naive_s = 0, naive_s2 = 0;
+    double sum = 0, lo = x[0], hi = x[0];
+    for (int i = 0; i < c->n; ++i) {
+        stat_acc_add(&a, x[i]);
+        naive_s += x[i];
+        naive_s2 += x[i] * x[i];
+        sum += x[i];
+        if (x[i] < lo) lo = x[i];
+        if (x[i] > hi) hi = x[i];
+    }
+    double mean = sum / c->n, m2 = 0;
+    for (int i = 0; i < c->n; ++i) m2 += (x[i] - mean) * (x[i] - mean);
+    double var = m2 / c->n;
+    float nm = naive_s / c->n, naive_var = naive_s2 / c->n - nm * nm;
+
+    double got = stat_acc_var(&a);
+    double mean_err = fabs(a.mean - mean) / (fabs(mean) > 1 ? fabs(mean) : 1);
+    double var_err = var > 0 ? fabs(got - var) / var : fabs(got);
+    double naive_err = var > 0 ? fabs(naive_var - var) / var : fabs(naive_var);
+    printf("%-11s: n %5d  mean %10.3f (rel err %.1e)  var %12.5f (rel err %.1e, naive float %.1e)\n",
+           c->name, c->n, mean, mean_err, var, var_err, naive_err);
+
+    char what[96];
+    snprintf(what, sizeof(what), "%s: n, min or max wrong", c->name);
+    check(a.n == (uint32_t)c->n && a.min == (float)lo && a.max == (float)hi, what);
+    snprintf(what, sizeof(what), "%s: mean off by more than 1e-5", c->name);
+    check(mean_err <= 1e-5, what);
+    snprintf(what, sizeof(what), "%s: variance off by more than %g", c->name, c->var_tol);
+    check(got >= 0 && var_err <= c->var_tol, what);
+}
+
+int main(void)
+{
+    // Edges: empty, one value, reset.
+    stat_acc_t a;
+    stat_acc_reset(&a);
+    check(a.n == 0 && stat_acc_var(&a) == 0.0f, "empty accumulator");
+    stat_acc_add(&a, -3.5f);
+    check(a.n == 1 && a.min == -3.5f && a.max == -3.5f && a.mean == -3.5f && stat_acc_var(&a) == 0.0f,
+          "one value");
+    stat_acc_add(&a, 4.5f);
+    check(stat_acc_var(&a) == 16.0f && a.mean == 0.5f, "two values");
+    window_stats_t w;
+    w.temp = a;
+    window_stats_begin(&w, 42);
+    check(w.temp.n == 0 && w.lux.n == 0 && w.start_us == 42, "window_stats_begin resets");
+
+    for (size_t i = 0; i < sizeof(k_cases) / sizeof(k_cases[0]); ++i) run_case(&k_cases[i]);
+
+    // Cost per reading: what the sampler adds to each BH1750/BME280 read.
+    static float x[4096];
+    s_rnd = 7;
+    for (int i = 0; i < 4096; ++i) x[i] = sample(SER_LUX, i);
+    const int reps = 20000;
+    volatile float sink = 0;
+    double t0 = now_s();
+    for (int r = 0; r < reps; ++r) {
+        stat_acc_reset(&a);
+        for (int i = 0; i < 4096; ++i) stat_acc_add(&a, x[i]);
+        sink += stat_acc_var(&a);
+    }
+    double ns = (now_s() - t0) / ((double)reps * 4096) * 1e9;
+    (void)sink;
+    printf("cost     : %.1f ns per stat_acc_add (host), %.1f us/s of sampler time at 10.3 reads/s\n",
+           ns, ns * 10.33 / 1000.0);
+    printf("memory   : %u B per accumulator, %u B per window\n",
+           (unsigned)sizeof(stat_acc_t), (unsigned)sizeof(window_stats_t));
+
+    printf("%s\n", s_fail ? "FAIL" : "OK");
+    return s_fail;
+}
@@ -0,0 +1,231 @@
+// host/wifi_replay.c — replays a scripted Wi-Fi event sequence through wifi_fsm
+//
+//   ./wifi_replay host/wifi_scripts/link_loss.txt
+//
+// Script lines (times in ms, '#' comments):
+//   ssid    <closed ssid>                         preferred closed network
+//   cache   <ssid> <bssid> <ch> open|psk          last good AP from NVS
+//   <t> start | got_ip | disconnected | rssi <dBm>
+//   <t> scan_done [<ssid>,<bssid>,<ch>,<rssi>,open|psk ...]
+//   <t> expect <STATE> <action>                   check the last step
+//   <t> expect_outage <max ms>                    check the last link outage
+// Before each line, every deadline the machine set that falls due by <t> is
+// delivered as a timeout. Actions print as "connect <ssid> ch=<n> [pinned]
+// [roam]", "scan ch=<n>", "scan all", "poll_rssi" or "none". Every step is
+// traced; the exit status is the number of failed expectations.
+#include "wifi_fsm.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Airtime of one active scan: ~120 ms dwell per channel, 13 channels.
+#define SCAN_DWELL_MS 120
+#define SCAN_CHANNELS 13
+
+static wifi_fsm_t        s_fsm;
+static wifi_fsm_action_t s_last;
+static uint32_t          s_now;
+static int               s_failed;
+
+static const char *ev_name(wifi_fsm_event_kind_t k)
+{
+    static const char *const names[] = {
+        "start", "got_ip", "disconnected", "scan_done", "rssi", "timeout",
+    };
+    return names[k];
+}
+
+static void act_text(const wifi_fsm_action_t *a, char *out, size_t cap)
+{
+    switch (a->kind) {
+    case WIFI_ACT_NONE:
+        snprintf(out, cap, "none");
+        break;
+    case WIFI_ACT_CONNECT:
+        snprintf(out, cap, "connect %s ch=%u%s%s", a->ap.ssid, (unsigned)a->ap.channel,
+                 a->pin_bssid ? " pinned" : "", a->roam ? " roam" : "");
+        break;
+    case WIFI_ACT_SCAN:
+        if (a->channel) snprintf(out, cap, "scan ch=%u", (unsigned)a->channel);
+        else            snprintf(out, cap, "scan all");
+        break;
+    case WIFI_ACT_POLL_RSSI:
+        snprintf(out, cap, "poll_rssi");
+        break;
+    }
+}
+
+static void step(const wifi_fsm_event_t *ev)
+{
+    wifi_fsm_step(&s_fsm, ev, s_now, &s_last);
+    char text[96];
+    act_text(&s_last, text, sizeof(text));
+    printf("%8u ms  %-12s -> %-12s %s%s\n", (unsigned)s_now, ev_name(ev->kind),
+           wifi_fsm_state_name(s_fsm.state), text, s_last.save ? " [save]" : "");
+}
+
+// Deliver every timeout that falls due up to t.
+static void advance(uint32_t t)
+{
+    while (s_fsm.has_deadline && (int32_t)(t - s_fsm.deadline) >= 0) {
+        uint32_t due = s_fsm.deadline;
+        s_now = due;
+        step(&(wifi_fsm_event_t){ .kind = WIFI_EV_TIMEOUT });
+        if (s_fsm.has_deadline && s_fsm.deadline == due) break;   // no progress
+    }
+    s_now = t;
+}
+
+static bool parse_bssid(const char *s, uint8_t out[6])
+{
+    unsigned b[6];
+    if (sscanf(s, "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != 6) return false;
+    for (int i = 0; i < 6; ++i) out[i] = (uint8_t)b[i];
+    return true;
+}
+
+static bool parse_ap(char *tok, wifi_fsm_ap_t *ap)
+{
+    char *f[5];
+    for (int i = 0; i < 5; ++i) {
+        f[i] = strsep(&tok, ",");
+        if (!f[i]) return false;
+    }
+    memset(ap, 0, sizeof(*ap));
+    snprintf(ap->ssid, sizeof(ap->ssid), "%s", f[0]);
+    if (!parse_bssid(f[1], ap->bssid)) return false;
+    ap->channel = (uint8_t)atoi(f[2]);
+    ap->rssi = (int8_t)atoi(f[3]);
+    ap->open = strcmp(f[4], "open") == 0;
+    return true;
+}
+
+__attribute__((format(printf, 2, 3)))
+static void fail(int line, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    printf("FAIL line %d: ", line);
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+    s_failed++;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s SCRIPT\n", argv[0]);
+        return 2;
+    }
+    FILE *f = fopen(argv[1], "r");
+    if (!f) {
+        perror(argv[1]);
+        return 2;
+    }
+
+    wifi_fsm_cfg_t cfg;
+    wifi_fsm_init(&s_fsm, NULL, NULL);
+    cfg = s_fsm.cfg;
+    wifi_fsm_ap_t cache;
+    bool have_cache = false;
+
+    char line[1024];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char *save = NULL;
+        char *tok = strtok_r(line, " \t\r\n", &save);
+        if (!tok) continue;
+
+        if (strcmp(tok, "ssid") == 0) {
+            char *v = strtok_r(NULL, " \t\r\n", &save);
+            snprintf(cfg.ssid, sizeof(cfg.ssid), "%s", v ? v : "");
+            continue;
+        }
+        if (strcmp(tok, "cache") == 0) {
+            char *ssid = strtok_r(NULL, " \t\r\n", &save);
+            char *bssid = strtok_r(NULL, " \t\r\n", &save);
+            char *ch = strtok_r(NULL, " \t\r\n", &save);
+            char *auth = strtok_r(NULL, " \t\r\n", &save);
+            memset(&cache, 0, sizeof(cache));
+            if (!ssid || !bssid || !ch || !auth || !parse_bssid(bssid, cache.bssid)) {
+                fail(lineno, "bad cache line");
+                continue;
+            }
+            snprintf(cache.ssid, sizeof(cache.ssid), "%s", ssid);
+            cache.channel = (uint8_t)atoi(ch);
+            cache.open = strcmp(auth, "open") == 0;
+            have_cache = true;
+            continue;
+        }
+
+        uint32_t t = (uint32_t)strtoul(tok, NULL, 10);
+        char *what = strtok_r(NULL, " \t\r\n", &save);
+        if (!what) {
+            fail(lineno, "missing event");
+            continue;
+        }
+        if (strcmp(what, "start") == 0) {
+            wifi_fsm_init(&s_fsm, &cfg, have_cache ? &cache : NULL);
+            s_now = t;
+            step(&(wifi_fsm_event_t){ .kind = WIFI_EV_START });
+            continue;
+        }
+        advance(t);
+
+        if (strcmp(what, "got_ip") == 0) {
+            step(&(wifi_fsm_event_t){ .kind = WIFI_EV_GOT_IP });
+        } else if (strcmp(what, "disconnected") == 0) {
+            step(&(wifi_fsm_event_t){ .kind = WIFI_EV_DISCONNECTED });
+        } else if (strcmp(what, "rssi") == 0) {
+            char *v = strtok_r(NULL, " \t\r\n", &save);
+            step(&(wifi_fsm_event_t){ .kind = WIFI_EV_RSSI, .rssi = (int8_t)(v ? atoi(v) : 0) });
+        } else if (strcmp(what, "scan_done") == 0) {
+            wifi_fsm_ap_t aps[WIFI_FSM_MAX_APS];
+            int n = 0;
+            char *ap;
+            while ((ap = strtok_r(NULL, " \t\r\n", &save)) && n < WIFI_FSM_MAX_APS) {
+                if (!parse_ap(ap, &aps[n])) fail(lineno, "bad AP '%s'", ap);
+                else n++;
+            }
+            step(&(wifi_fsm_event_t){ .kind = WIFI_EV_SCAN_DONE, .aps = aps, .n_aps = n });
+        } else if (strcmp(what, "expect") == 0) {
+            char *state = strtok_r(NULL, " \t\r\n", &save);
+            char *rest = strtok_r(NULL, "\r\n", &save);
+            char got[96];
+            act_text(&s_last, got, sizeof(got));
+            if (!state || strcmp(state, wifi_fsm_state_name(s_fsm.state)) != 0) {
+                fail(lineno, "state %s, expected %s", wifi_fsm_state_name(s_fsm.state),
+                     state ? state : "?");
+            } else if (rest && strcmp(rest, got) != 0) {
+                fail(lineno, "action '%s', expected '%s'", got, rest);
+            }
+        } else if (strcmp(what, "expect_outage") == 0) {
+            char *v = strtok_r(NULL, " \t\r\n", &save);
+            uint32_t max = v ? (uint32_t)strtoul(v, NULL, 10) : 0;
+            if (s_fsm.stats.last_outage_ms > max) {
+                fail(lineno, "outage %u ms, expected <= %u ms",
+                     (unsigned)s_fsm.stats.last_outage_ms, (unsigned)max);
+            }
+        } else {
+            fail(lineno, "unknown event '%s'", what);
+        }
+    }
+    fclose(f);
+
+    const wifi_fsm_stats_t *st = &s_fsm.stats;
+    printf("\nscans: %u all-channel, %u single-channel (~%u ms of scan airtime)\n",
+           (unsigned)st->scans_all, (unsigned)st->scans_channel,
+           (unsigned)(st->scans_all * SCAN_CHANNELS * SCAN_DWELL_MS +
+                      st->scans_channel * SCAN_DWELL_MS));
+    printf("connects: %u (%u pinned, no scan), link losses %u, roams %u, last outage %u ms\n",
+           (unsigned)st->connects, (unsigned)st->fast_connects, (unsigned)st->link_losses,
+           (unsigned)st->roams, (unsigned)st->last_outage_ms);
+    printf("%s\n", s_failed ? "FAILED" : "OK");
+    return s_failed;
+}
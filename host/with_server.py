@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+# host/with_server.py — run a command against a stand-in server, for CTest
+#
+#   python3 host/with_server.py SERVER.py [SERVER_ARGS...] -- COMMAND [ARGS...]
+#
+# Starts SERVER.py (host/ingest_server.py, host/mqtt_broker.py or
+# host/sink_server.py) on a free port with --port, waits until it accepts
+# connections, runs COMMAND with every {port} in its arguments replaced by
+# that port, then stops the server. The exit status is COMMAND's, or 1 if
+# the server did not come up. Each run has its own port, so tests using it
+# can run in parallel.
+import socket
+import subprocess
+import sys
+import time
+
+
+def free_port():
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+def wait_listening(port, proc, timeout_s=10.0):
+    end = time.monotonic() + timeout_s
+    while time.monotonic() < end:
+        if proc.poll() is not None:
+            return False
+        try:
+            with socket.create_connection(("127.0.0.1", port), timeout=0.5):
+                return True
+        except OSError:
+            time.sleep(0.05)
+    return False
+
+
+def main():
+    argv = sys.argv[1:]
+    if "--" not in argv or argv.index("--") == 0 or argv[-1] == "--":
+        sys.exit("usage: with_server.py SERVER.py [SERVER_ARGS...] -- COMMAND [ARGS...]")
+    cut = argv.index("--")
+    server, cmd = argv[:cut], argv[cut + 1:]
+
+    port = free_port()
+    srv = subprocess.Popen([sys.executable, *server, "--port", str(port), "--quiet"],
+                           stdout=subprocess.DEVNULL)
+    try:
+        if not wait_listening(port, srv):
+            print(f"with_server: {server[0]} did not come up on port {port}", flush=True)
+            return 1
+        return subprocess.call([a.replace("{port}", str(port)) for a in cmd])
+    finally:
+        srv.terminate()
+        try:
+            srv.wait(timeout=5)
+        except subprocess.TimeoutExpired:
+            srv.kill()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,117 @@
+// main/alloc_trace.c — post-boot heap allocations by module (see alloc_trace.h)
+#include "alloc_trace.h"
+#include "sdkconfig.h"
+
+#if CONFIG_ALLOC_TRACE
+#include <stdatomic.h>
+#include "binlog.h"
+
+// Steady-state allowances. The firmware's own code allocates nothing after
+// boot; what remains is inside the libraries it calls.
+//  - transport: esp_http_client formats Content-Length into a fresh string
+//    and copies it into the header list on every request (2), and copies
+//    each header it is given (3 for a new one, such as the health record).
+//    esp-mqtt copies every QoS1 publish into its outbox until the PUBACK
+//    (2). Once: the first Content-Length, Content-Type, Content-Encoding
+//    and health headers, 3 each.
+//  - uploader, wifi: NVS allocates while it writes a blob (a server setting,
+//    the last good AP), which happens only when one changes.
+static const alloc_budget_t k_budget[ALLOC_MOD_COUNT] = {
+    [ALLOC_MOD_SYSTEM]    = { ALLOC_BUDGET_NONE, 0 },
+    [ALLOC_MOD_SENSORS]   = { 0, 0 },
+    [ALLOC_MOD_PUBLISHER] = { 0, 0 },
+    [ALLOC_MOD_UPLOADER]  = { 4, 0 },
+    [ALLOC_MOD_TRANSPORT] = { 12, 5 },
+    [ALLOC_MOD_WIFI]      = { 4, 0 },
+    [ALLOC_MOD_LOG]       = { 0, 0 },
+};
+
+static const char *const k_names[ALLOC_MOD_COUNT] = {
+    "system", "sensors", "publisher", "uploader", "transport", "wifi", "log",
+};
+
+static _Atomic bool     s_started;
+static _Atomic uint32_t s_boot_allocs;
+static _Atomic uint32_t s_batches;
+static _Atomic uint32_t s_allocs[ALLOC_MOD_COUNT];
+static _Atomic uint32_t s_bytes[ALLOC_MOD_COUNT];
+static _Atomic uint32_t s_largest[ALLOC_MOD_COUNT];
+static _Atomic bool     s_over[ALLOC_MOD_COUNT];
+
+// Per task: thread-local storage lives in the task's TCB on ESP-IDF.
+static __thread uint8_t t_task_mod;    // set once by the task itself
+static __thread uint8_t t_scope_mod;   // alloc_trace_enter(), 0 = none
+
+void alloc_trace_start(void) { atomic_store(&s_started, true); }
+
+void alloc_trace_task(alloc_mod_t m) { t_task_mod = (uint8_t)m; }
+
+alloc_mod_t alloc_trace_enter(alloc_mod_t m)
+{
+    alloc_mod_t prev = (alloc_mod_t)t_scope_mod;
+    t_scope_mod = (uint8_t)m;
+    return prev;
+}
+
+void alloc_trace_leave(alloc_mod_t prev) { t_scope_mod = (uint8_t)prev; }
+
+void alloc_trace_batch(void)
+{
+    atomic_fetch_add_explicit(&s_batches, 1, memory_order_relaxed);
+}
+
+static uint32_t allowed(alloc_mod_t m)
+{
+    const alloc_budget_t *b = &k_budget[m];
+    return b->once + b->per_batch * atomic_load_explicit(&s_batches, memory_order_relaxed);
+}
+
+void alloc_trace_note(size_t size)
+{
+    if (!atomic_load_explicit(&s_started, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&s_boot_allocs, 1, memory_order_relaxed);
+        return;
+    }
+    alloc_mod_t m = (alloc_mod_t)(t_scope_mod ? t_scope_mod : t_task_mod);
+    uint32_t n = atomic_fetch_add_explicit(&s_allocs[m], 1, memory_order_relaxed) + 1;
+    atomic_fetch_add_explicit(&s_bytes[m], (uint32_t)size, memory_order_relaxed);
+    uint32_t big = atomic_load_explicit(&s_largest[m], memory_order_relaxed);
+    while (size > big && !atomic_compare_exchange_weak(&s_largest[m], &big, (uint32_t)size)) {}
+    if (m == ALLOC_MOD_SYSTEM) return;   // the Wi-Fi driver alone would flood the log
+
+    BINLOG(ALLOC, m, (uint32_t)size, n);
+    if (n > allowed(m) && !atomic_exchange(&s_over[m], true)) {
+        BINLOG(ALLOC_OVER, m, n, allowed(m));
+    }
+}
+
+void alloc_trace_get(alloc_trace_stats_t *out)
+{
+    out->boot_allocs = atomic_load(&s_boot_allocs);
+    out->batches = atomic_load(&s_batches);
+    for (int m = 0; m < ALLOC_MOD_COUNT; ++m) {
+        out->allocs[m]  = atomic_load(&s_allocs[m]);
+        out->bytes[m]   = atomic_load(&s_bytes[m]);
+        out->largest[m] = atomic_load(&s_largest[m]);
+        out->over[m]    = atomic_load(&s_over[m]);
+    }
+}
+
+const alloc_budget_t *alloc_trace_budget(alloc_mod_t m) { return &k_budget[m]; }
+
+const char *alloc_trace_name(alloc_mod_t m) { return k_names[m]; }
+
+#ifdef ESP_PLATFORM
+#include "esp_heap_caps.h"
+
+// Called by heap_caps after every successful allocation.
+void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    (void)ptr; (void)caps;
+    alloc_trace_note(size);
+}
+
+void esp_heap_trace_free_hook(void *ptr) { (void)ptr; }
+#endif
+
+#endif // CONFIG_ALLOC_TRACE
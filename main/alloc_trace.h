@@ -0,0 +1,89 @@
+// main/alloc_trace.h — which module allocates from the heap after boot
+//
+// In steady state the firmware should not touch the heap: buffers are static
+// and clients are kept for the life of the node. With CONFIG_ALLOC_TRACE
+// every allocation made after alloc_trace_start() is counted against the
+// module that made it and checked against that module's budget. The module
+// is the innermost alloc_trace_enter() region on the calling task, else the
+// task's own (alloc_trace_task()). ESP-IDF's tasks (lwIP, Wi-Fi driver,
+// esp-mqtt, event loop) set none and land in ALLOC_MOD_SYSTEM, which is
+// counted but has no budget.
+//
+// The counts come from the heap hooks (CONFIG_HEAP_USE_HOOKS, selected by
+// CONFIG_ALLOC_TRACE); the host build feeds them from its malloc wrappers.
+// Each traced allocation is also logged through binlog, and the first one
+// over budget in a module as a warning.
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ALLOC_MOD_SYSTEM = 0,   // ESP-IDF tasks, and anything before a task is tagged
+    ALLOC_MOD_SENSORS,      // sampler_task: sensors.c, i2c_bus.c
+    ALLOC_MOD_PUBLISHER,    // publisher_task: windows, report filter, sample ring
+    ALLOC_MOD_UPLOADER,     // sender_task: backlog, encoders, scheduling
+    ALLOC_MOD_TRANSPORT,    // transport_*.c and the client library under it
+    ALLOC_MOD_WIFI,         // wifi_task
+    ALLOC_MOD_LOG,          // log_task
+    ALLOC_MOD_COUNT
+} alloc_mod_t;
+
+// Steady-state allowance: once + per_batch × batches submitted since start.
+typedef struct {
+    uint16_t once;
+    uint16_t per_batch;
+} alloc_budget_t;
+
+#define ALLOC_BUDGET_NONE UINT16_MAX   // in once: counted, never over budget
+
+typedef struct {
+    uint32_t allocs[ALLOC_MOD_COUNT];   // since alloc_trace_start()
+    uint32_t bytes[ALLOC_MOD_COUNT];
+    uint32_t largest[ALLOC_MOD_COUNT];
+    uint32_t boot_allocs;               // before alloc_trace_start()
+    uint32_t batches;
+    bool     over[ALLOC_MOD_COUNT];
+} alloc_trace_stats_t;
+
+#if CONFIG_ALLOC_TRACE
+
+// End of boot: count from here on. app_main(), once every task is created.
+void alloc_trace_start(void);
+
+// Tag the calling task; its allocations count against m from here on.
+void alloc_trace_task(alloc_mod_t m);
+
+// Count the calling task's allocations against m until alloc_trace_leave()
+// is called with the value returned.
+alloc_mod_t alloc_trace_enter(alloc_mod_t m);
+void alloc_trace_leave(alloc_mod_t prev);
+
+// One batch handed to the transport (uploader.c); scales per_batch budgets.
+void alloc_trace_batch(void);
+
+void alloc_trace_get(alloc_trace_stats_t *out);
+const alloc_budget_t *alloc_trace_budget(alloc_mod_t m);
+const char *alloc_trace_name(alloc_mod_t m);
+
+// What the heap hooks call; the host build calls it from its malloc wrapper.
+void alloc_trace_note(size_t size);
+
+#else
+
+static inline void alloc_trace_start(void) {}
+static inline void alloc_trace_task(alloc_mod_t m) { (void)m; }
+static inline alloc_mod_t alloc_trace_enter(alloc_mod_t m) { (void)m; return ALLOC_MOD_SYSTEM; }
+static inline void alloc_trace_leave(alloc_mod_t prev) { (void)prev; }
+static inline void alloc_trace_batch(void) {}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,14 +1,23 @@
-// main/app_main.c — 10Hz sampling, 1Hz raw logging, 10s publish, 10s send
+// main/app_main.c — per-sensor sampling, 1Hz raw logging, 10s publish, scheduled send
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 
 #include "sensors.h"
 #include "time_sync.h"
 #include "wifi.h"
 #include "uploader.h"
+#include "transport.h"
+#include "upload_sched.h"
+#include "report_filter.h"
+#include "occupancy.h"
 #include "device_id.h"
+#include "metrics.h"
+#include "binlog.h"
+#include "alloc_trace.h"
 
 #include <time.h>
 #include <string.h>
@@ -16,101 +25,288 @@
 
 static const char *TAG = "APP";
 
+// Default sample period; the server may change it (flow_ctl.h).
+#ifndef APP_PUBLISH_MS
+#define APP_PUBLISH_MS 10000
+#endif
+
+// Longest the sender sleeps without moving the RAM queue to flash. The queue
+// (SAMPLE_RING_CAPACITY) holds 160 s at the shortest publish period.
+#ifndef APP_QUEUE_DRAIN_MS
+#define APP_QUEUE_DRAIN_MS 60000
+#endif
+
+// How often log_task prints what the other tasks queued with BINLOG().
+#ifndef APP_LOG_DRAIN_MS
+#define APP_LOG_DRAIN_MS 100
+#endif
+
+// Task stacks in bytes. Static, like the tasks' control blocks, so nothing
+// here comes from the heap. Sized from the peak use aulasense_host measures
+// on painted stacks (24 h with a 6 h outage, both transports), rounded up to
+// 512 B. Those are x86-64 frames through glibc's printf, deeper than the
+// ESP32's; the health record reports the margin left on the device. The
+// sender also runs the TLS handshake inside esp_http_client: with --tls
+// (OpenSSL) it peaks at 9944 B on the host, and IDF's HTTPS examples give
+// that path 8 KB on the ESP32, so it gets 10 KB rather than its 5 KB of
+// plain-HTTP use.
+#ifndef APP_SAMPLER_STACK
+#define APP_SAMPLER_STACK   4096
+#endif
+#ifndef APP_PUBLISHER_STACK
+#define APP_PUBLISHER_STACK 4096
+#endif
+#ifndef APP_SENDER_STACK
+#define APP_SENDER_STACK    10240
+#endif
+#ifndef APP_LOG_STACK
+#define APP_LOG_STACK       4096
+#endif
+
+// Cores and priorities. Wi-Fi, lwIP and esp_timer run on core 0, and so does
+// the sender with its TLS handshakes. The sampler has core 1 to itself above
+// everything else there, so its reads land on their slots whatever the
+// network does; the publisher and the log drain fill in below it.
+#if CONFIG_FREERTOS_UNICORE
+#define APP_SAMPLE_CORE 0
+#else
+#define APP_SAMPLE_CORE 1
+#endif
+#define APP_NET_CORE    0
+#ifndef APP_SAMPLER_PRIO
+#define APP_SAMPLER_PRIO   10
+#endif
+#ifndef APP_PUBLISHER_PRIO
+#define APP_PUBLISHER_PRIO 5
+#endif
+#ifndef APP_SENDER_PRIO
+#define APP_SENDER_PRIO    5
+#endif
+#ifndef APP_LOG_PRIO
+#define APP_LOG_PRIO       1
+#endif
+
+static StackType_t  s_sampler_stack[APP_SAMPLER_STACK];
+static StackType_t  s_publisher_stack[APP_PUBLISHER_STACK];
+static StackType_t  s_sender_stack[APP_SENDER_STACK];
+static StackType_t  s_log_stack[APP_LOG_STACK];
+static StaticTask_t s_sampler_tcb, s_publisher_tcb, s_sender_tcb, s_log_tcb;
+
+static inline uint32_t now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
 // --------- tasks ---------
 
-// Keep sensor values fresh (BH1750/BME280/PIR) at 10 Hz
+// Keep sensor values fresh (BH1750/BME280/PIR). Sleeps until the next read
+// slot instead of polling at a fixed rate: sensors.c arms an esp_timer for
+// it, and the PIR ISR wakes the task early when an edge is queued. Both
+// notify; the tick timeout is only a backstop.
 static void sampler_task(void *pv) {
     (void)pv;
-    int log_ctr = 0;
+    alloc_trace_task(ALLOC_MOD_SENSORS);
+    sensors_set_wake_task(xTaskGetCurrentTaskHandle());
+    uint32_t next_log = now_ms() + 1000;
     while (1) {
-        sensors_sample_tick();   // updates internal cache
+        uint32_t wait = sensors_sample_tick();   // updates internal cache
 
-        // Print once per second (every 10th sample)
-        if (++log_ctr >= 10) {
+        // Print once per second
+        if ((int32_t)(now_ms() - next_log) >= 0) {
             float t = 0.0f, lux = 0.0f;
             bool m = false;
             sensors_get_latest(&t, &lux, &m);
-            ESP_LOGI("SAMPLER", "Raw: Temp=%.2fC Lux=%.1f Motion=%s",
-                     t, lux, m ? "true" : "false");
-            log_ctr = 0;
+            BINLOG(SAMPLER_RAW, t, lux, m);
+            next_log = now_ms() + 1000;
         }
 
-        vTaskDelay(pdMS_TO_TICKS(100));   // every 100 ms → 10 Hz
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait) + 2);
     }
 }
 
-// Build one sample every 10 s, print locally (with local time), and buffer it
+// Build one sample every publish period (10 s unless the server set another)
+// from the window statistics, log it (log_task adds the local time), and
+// buffer it unless report_filter holds it back as unchanged. Before SNTP
+// sync the sample carries the boot clock instead (SAMPLE_F_UNSYNCED). With
+// CONFIG_OCCUPANCY_EVENTS the window also feeds the room state machine, and
+// its transitions are buffered as events ahead of the sample, or instead of
+// it with CONFIG_OCCUPANCY_ONLY.
 static void publisher_task(void *pv) {
     (void)pv;
+    alloc_trace_task(ALLOC_MOD_PUBLISHER);
 
     device_id_t id;
     device_id_get(&id); // fills building/number
+    ESP_LOGI(TAG, "Publishing as %s/%s", id.building, id.number);
 
+    report_filter_t filter;
+    report_filter_init(&filter, NULL);
+#if CONFIG_OCCUPANCY_EVENTS
+    static occupancy_t occ;   // ~300 B of trend buckets, kept off the stack
+    occupancy_init(&occ, NULL);
+#endif
+
+    TickType_t last = xTaskGetTickCount();
     while (1) {
-        float t_c = 0.0f, lux = 0.0f;
-        bool motion_inst = false;
-        bool motion_lat  = sensors_get_motion_latched();
+        // Sleep first: the first window covers the first period from boot
+        // rather than the few ms before any sensor was read. Windows close on
+        // a fixed grid, so closing one does not lengthen the next; if a whole
+        // period was missed, the grid restarts instead of closing empty
+        // windows back to back.
+        flow_ctl_t flow;
+        uploader_get_flow(&flow);
+        TickType_t period = pdMS_TO_TICKS(flow.publish_ms ? flow.publish_ms : APP_PUBLISH_MS);
+        if (!xTaskDelayUntil(&last, period)) last = xTaskGetTickCount();
 
-        sensors_get_latest(&t_c, &lux, &motion_inst);
+        sensors_window_t w;
+        sensors_take_window(&w);
 
+        time_t now = 0;
+        time(&now);
         // Local timestamp (IST/IDT) — SNTP + TZ handled in time_sync_start()
-        char ts_local[32];
-        time_sync_fmt(ts_local, sizeof(ts_local));
+        BINLOG(APP_SAMPLE, now,
+               w.temp_mean, w.temp_min, w.temp_max,
+               w.lux_mean, w.lux_min, w.lux_max,
+               w.motion, w.motion_s, w.motion_edges);
 
-        ESP_LOGI(TAG,
-                 "[%s] Temp=%.2fC Lux=%.1f Motion(inst)=%s Motion(latched)=%s %s/%s",
-                 ts_local,
-                 t_c, lux,
-                 motion_inst ? "true" : "false",
-                 motion_lat  ? "true" : "false",
-                 id.building, id.number);
+        sample_t s;
+        uint32_t boot_s = time_sync_boot_s();
+        if (boot_s) {
+            struct tm tm_local = {0};
+            localtime_r(&now, &tm_local);
+            sample_pack(&s, sample_wall_seconds(&tm_local), &w);
+            // A reference taken before sync would mix clocks in unchanged_since.
+            sample_rebase(&filter.ref, boot_s);
+        } else {
+            // No wall clock yet: stamp with the boot clock; the uploader
+            // dates it once SNTP has set the time, and holds it until then.
+            sample_pack(&s, (uint32_t)(w.end_us / 1000000), &w);
+            s.flags |= SAMPLE_F_UNSYNCED;
+        }
 
-        time_t now = 0;
-        time(&now);
-        struct tm tm_local = {0};
-        localtime_r(&now, &tm_local);
+#if CONFIG_OCCUPANCY_EVENTS
+        occupancy_event_t ev[OCC_MAX_EVENTS];
+        int n_ev = occupancy_update(&occ, &w, ev);
+        for (int i = 0; i < n_ev; ++i) {
+            BINLOG(ROOM_STATE, ev[i].state, ev[i].before_s,
+                   ev[i].prev == OCC_UNKNOWN ? 8 : ev[i].prev, ev[i].prev_s);
+            sample_t e;
+            occupancy_pack(&e, &s, &ev[i]);
+            if (uploader_add(&e)) metrics_boot_mark(METRIC_B_FIRST_SAMPLE);
+            else ESP_LOGW(TAG, "Uploader buffer full — event dropped");
+        }
+#endif
 
-        sample_t s = {0};
-        s.tm_local = tm_local;
-        s.temp_c   = t_c;
-        s.lux      = lux;
-        s.motion   = (motion_inst || motion_lat);
+#if CONFIG_OCCUPANCY_ONLY
+        bool report = false;
+#elif CONFIG_REPORT_ON_CHANGE
+        bool report = report_filter_check(&filter, &s, now_ms() / 1000);
+#else
+        bool report = true;
+#endif
+        if (report) {
+            if (uploader_add(&s)) metrics_boot_mark(METRIC_B_FIRST_SAMPLE);
+            else ESP_LOGW(TAG, "Uploader buffer full — sample dropped");
+        }
+    }
+}
+
+// Push buffered samples (HTTPS or MQTT) when upload_sched says so:
+// coalesced while the backlog is small, back-to-back while draining, backing
+// off with jitter while the server is unreachable, and paced by the server's
+// directives (upload interval, batch size, Retry-After). Waiting never stops
+// the RAM queue from reaching flash.
+static void sender_task(void *pv) {
+    (void)pv;
+    alloc_trace_task(ALLOC_MOD_UPLOADER);
+#if CONFIG_UPLOADER_LOG_PAYLOAD
+    uploader_set_log_json(true);   // exact JSON, straight to the UART
+#endif
+
+    // Nothing to send to before the first IP. Keep moving the RAM queue to
+    // flash meanwhile; later link losses are the scheduler's to back off.
+    while (!wifi_wait_ip(APP_QUEUE_DRAIN_MS)) uploader_drain_queue();
 
-        strncpy(s.building, id.building, sizeof(s.building) - 1);
-        strncpy(s.number,   id.number,   sizeof(s.number)   - 1);
+    upload_sched_t sched;
+    upload_sched_init(&sched, NULL, esp_random());
 
-        if (!uploader_add(&s)) {
-            ESP_LOGW(TAG, "Uploader buffer full — sample dropped");
+    while (1) {
+        flow_ctl_t flow;
+        uploader_get_flow(&flow);
+        sched.cfg.batch_max = flow.batch_max ? flow.batch_max : UPLOADER_MAX_SAMPLES;
+        sched.cfg.interval_ms = flow.upload_interval_ms;
+
+        uploader_drain_queue();
+        // Samples waiting for SNTP don't count: with nothing else ready the
+        // scheduler polls, and sends them once the clock is set.
+        uint32_t wait = upload_sched_due(&sched, (uint32_t)uploader_count_ready(), now_ms());
+        if (wait > 0) {
+            if (wait > APP_QUEUE_DRAIN_MS) wait = APP_QUEUE_DRAIN_MS;
+            vTaskDelay(pdMS_TO_TICKS(wait) + 1);   // +1: never spin on a sub-tick wait
+            continue;
         }
+        esp_err_t err = uploader_send();
+        upload_sched_report(&sched, err == ESP_OK, now_ms());
 
-        sensors_clear_motion_latch();
-        vTaskDelay(pdMS_TO_TICKS(10000));   // every 10s
+        uploader_stats_t st;
+        uploader_get_stats(&st);
+        if (st.retry_after_ms) upload_sched_defer(&sched, st.retry_after_ms, now_ms());
     }
 }
 
-// Push buffered samples via HTTPS every 10 s (and log exact JSON)
-static void sender_task(void *pv) {
+// Print what the other tasks queued with BINLOG(). Lowest priority, so only
+// this task ever waits for the UART.
+static void log_task(void *pv) {
     (void)pv;
-    uploader_set_log_json(true);
+    alloc_trace_task(ALLOC_MOD_LOG);
     while (1) {
-        uploader_send();
-        vTaskDelay(pdMS_TO_TICKS(10000));   // every 10s
+        binlog_drain(now_ms());
+        vTaskDelay(pdMS_TO_TICKS(APP_LOG_DRAIN_MS));
     }
 }
 
 // --------- entry ---------
+// Startup runs in dependency order, and nothing waits for the network:
+// sensors and the tasks that sample and publish start at once, Wi-Fi and
+// SNTP come up in the background, and sender_task waits for the first IP
+// itself. Samples taken before the clock is set are dated later (uploader.h).
 void app_main(void) {
     ESP_LOGI(TAG, "App starting...");
     ESP_ERROR_CHECK(nvs_flash_init());
 
-    // Wi-Fi: try closed SSID first, fallback to open scan
-    wifi_init_prefer_closed();
+    sensors_init();   // no waits: the sampler holds the first reads
+#if CONFIG_UPLOADER_TRANSPORT_MQTT
+    uploader_set_transport(&transport_mqtt);
+    uploader_init(CONFIG_UPLOADER_MQTT_URI);   // before the first sample
+#else
+    uploader_init("https://aulasense.onrender.com/sensors/upload");   // before the first sample
+#endif
 
+    // Stack high-water marks go into the health record in this order, then
+    // wifi_task's.
+    TaskHandle_t tasks[4] = {0};
+    tasks[0] = xTaskCreateStaticPinnedToCore(sampler_task, "sampler_task", APP_SAMPLER_STACK,
+                                             NULL, APP_SAMPLER_PRIO, s_sampler_stack,
+                                             &s_sampler_tcb, APP_SAMPLE_CORE);
+    tasks[1] = xTaskCreateStaticPinnedToCore(publisher_task, "publisher_task", APP_PUBLISHER_STACK,
+                                             NULL, APP_PUBLISHER_PRIO, s_publisher_stack,
+                                             &s_publisher_tcb, APP_SAMPLE_CORE);
+    tasks[3] = xTaskCreateStaticPinnedToCore(log_task, "log_task", APP_LOG_STACK,
+                                             NULL, APP_LOG_PRIO, s_log_stack,
+                                             &s_log_tcb, APP_SAMPLE_CORE);
+
+    // Wi-Fi: try closed SSID first, fallback to open scan. SNTP needs the
+    // network stack it brings up.
+    wifi_init_prefer_closed();
     time_sync_start();
-    sensors_init();
-    uploader_init("https://aulasense.onrender.com/sensors/upload");
+    time_sync_on_set(uploader_set_boot_time);
+
+    tasks[2] = xTaskCreateStaticPinnedToCore(sender_task, "sender_task", APP_SENDER_STACK,
+                                             NULL, APP_SENDER_PRIO, s_sender_stack,
+                                             &s_sender_tcb, APP_NET_CORE);
+    for (int i = 0; i < 4; ++i) metrics_register_task(tasks[i]);
+    metrics_register_task(wifi_task_handle());
 
-    xTaskCreate(sampler_task,   "sampler_task",   4096, NULL, 5, NULL);
-    xTaskCreate(publisher_task, "publisher_task", 4096, NULL, 5, NULL);
-    xTaskCreate(sender_task,    "sender_task",    4096, NULL, 5, NULL);
+    // Boot is over: from here on every heap allocation counts against the
+    // budget of the module that makes it (alloc_trace.h).
+    alloc_trace_start();
 }
@@ -0,0 +1,152 @@
+// main/binlog.c — record ring for BINLOG() and its drain (see binlog.h)
+#include "binlog.h"
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#include <stdio.h>
+
+#if (BINLOG_RING_WORDS & (BINLOG_RING_WORDS - 1)) != 0
+#error "BINLOG_RING_WORDS must be a power of two"
+#endif
+
+#define RING_MASK (BINLOG_RING_WORDS - 1u)
+#define LINE_MAX  192
+
+// Writers copy a whole record in under s_mux and the drain copies one out
+// the same way; head and tail are free-running word counts.
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_ring[BINLOG_RING_WORDS];
+static uint32_t s_head, s_tail;
+static uint8_t  s_seq;
+static binlog_stats_t s_stats;
+
+// Drain side only
+static uint32_t s_tokens = BINLOG_BURST_BYTES;
+static uint32_t s_refill_ms;
+static uint32_t s_lost_ms;
+static uint32_t s_lost_dropped, s_lost_suppressed;   // already reported
+
+void binlog_write(binlog_id_t id, const uint32_t *args, unsigned nargs)
+{
+    if (nargs > BINLOG_MAX_ARGS) nargs = BINLOG_MAX_ARGS;
+    uint32_t t_ms = (uint32_t)(esp_timer_get_time() / 1000);
+
+    portENTER_CRITICAL(&s_mux);
+    uint32_t seq = s_seq++;   // dropped records leave a gap in seq too
+    uint32_t used = s_head - s_tail;
+    if (BINLOG_RING_WORDS - used < 2 + nargs) {
+        s_stats.dropped++;
+        portEXIT_CRITICAL(&s_mux);
+        return;
+    }
+    uint32_t h = s_head;
+    s_ring[h++ & RING_MASK] = (uint32_t)id | (uint32_t)nargs << 16 | seq << 24;
+    s_ring[h++ & RING_MASK] = t_ms;
+    for (unsigned i = 0; i < nargs; ++i) s_ring[h++ & RING_MASK] = args[i];
+    s_head = h;
+    if (used + 2 + nargs > s_stats.peak_words) s_stats.peak_words = used + 2 + nargs;
+    s_stats.written++;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+static bool take(binlog_rec_t *r)
+{
+    portENTER_CRITICAL(&s_mux);
+    bool have = s_head != s_tail;
+    if (have) {
+        uint32_t t = s_tail;
+        uint32_t hdr = s_ring[t++ & RING_MASK];
+        r->id    = (uint16_t)hdr;
+        r->nargs = (uint8_t)(hdr >> 16);
+        r->seq   = (uint8_t)(hdr >> 24);
+        r->t_ms  = s_ring[t++ & RING_MASK];
+        for (unsigned i = 0; i < r->nargs; ++i) r->args[i] = s_ring[t++ & RING_MASK];
+        s_tail = t;
+    }
+    portEXIT_CRITICAL(&s_mux);
+    return have;
+}
+
+static esp_log_level_t level_of(char c)
+{
+    switch (c) {
+    case 'E': return ESP_LOG_ERROR;
+    case 'W': return ESP_LOG_WARN;
+    case 'I': return ESP_LOG_INFO;
+    default:  return ESP_LOG_DEBUG;
+    }
+}
+
+// Spend len bytes of the console budget; warnings and errors always pass.
+static bool budget(esp_log_level_t level, size_t len)
+{
+    if (level <= ESP_LOG_WARN) {
+        s_tokens = s_tokens > len ? s_tokens - (uint32_t)len : 0;
+        return true;
+    }
+    if (s_tokens < len) return false;
+    s_tokens -= (uint32_t)len;
+    return true;
+}
+
+static void emit(const binlog_rec_t *r)
+{
+    const binlog_msg_t *m = binlog_msg(r->id);
+    if (!m) return;
+    esp_log_level_t level = level_of(m->level);
+#if CONFIG_APP_LOG_BINARY
+    uint8_t frame[BINLOG_FRAME_MAX];
+    size_t n = binlog_frame(frame, r);
+    if (!budget(level, n)) {
+        s_stats.suppressed++;
+        return;
+    }
+    fwrite(frame, 1, n, stdout);
+    fflush(stdout);
+#else
+    char line[LINE_MAX];
+    size_t n = binlog_format(line, sizeof(line), m->fmt, r->args, r->nargs);
+    n += 16 + strlen(m->tag);   // "I (12345678) TAG: ...\n"
+    if (!budget(level, n)) {
+        s_stats.suppressed++;
+        return;
+    }
+    esp_log_write(level, m->tag, "%c (%u) %s: %s\n", m->level, (unsigned)r->t_ms, m->tag, line);
+#endif
+    s_stats.printed++;
+    s_stats.bytes += (uint32_t)n;
+}
+
+void binlog_drain(uint32_t now_ms)
+{
+    uint64_t tokens = s_tokens + (uint64_t)(now_ms - s_refill_ms) * BINLOG_RATE_BPS / 1000;
+    s_tokens = tokens > BINLOG_BURST_BYTES ? BINLOG_BURST_BYTES : (uint32_t)tokens;
+    s_refill_ms = now_ms;
+
+    binlog_rec_t r;
+    while (take(&r)) emit(&r);
+
+    portENTER_CRITICAL(&s_mux);
+    uint32_t dropped = s_stats.dropped;
+    portEXIT_CRITICAL(&s_mux);
+    if ((dropped != s_lost_dropped || s_stats.suppressed != s_lost_suppressed) &&
+        now_ms - s_lost_ms >= BINLOG_LOST_REPORT_MS) {
+        binlog_rec_t lost = {   // made here, outside the seq numbering
+            .id = BL_LOST, .nargs = 2, .seq = 0, .t_ms = now_ms,
+            .args = { dropped - s_lost_dropped, s_stats.suppressed - s_lost_suppressed },
+        };
+        s_lost_dropped = dropped;
+        s_lost_suppressed = s_stats.suppressed;
+        s_lost_ms = now_ms;
+        emit(&lost);
+    }
+}
+
+void binlog_get_stats(binlog_stats_t *out)
+{
+    portENTER_CRITICAL(&s_mux);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_mux);
+}
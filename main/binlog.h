@@ -0,0 +1,94 @@
+// main/binlog.h — deferred logging for the hot paths
+//
+// BINLOG(NAME, args...) stores message BL_NAME (binlog_fmt.h) and its raw
+// arguments in a RAM ring: one short critical section and a few word
+// copies, no formatting and no UART. binlog_drain(), called from a
+// low-priority task, turns the records into ordinary esp_log lines, or with
+// CONFIG_APP_LOG_BINARY writes them as frames for tools/log_decode.c, so
+// a slow console only ever holds up that task.
+//
+// Output is limited to BINLOG_RATE_BPS (warnings and errors always go out).
+// A record that finds the ring full is dropped; dropped and unprinted
+// records are counted and reported in a BL_LOST line.
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "binlog_fmt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef BINLOG_RING_WORDS
+#define BINLOG_RING_WORDS     512    // 2 KB, power of two: ~85 records of 4 args
+#endif
+#ifndef BINLOG_RATE_BPS
+#define BINLOG_RATE_BPS       2048   // console bytes/s for I and D lines
+#endif
+#ifndef BINLOG_BURST_BYTES
+#define BINLOG_BURST_BYTES    4096
+#endif
+#ifndef BINLOG_LOST_REPORT_MS
+#define BINLOG_LOST_REPORT_MS 10000  // at most one BL_LOST line this often
+#endif
+
+// Tasks only, not ISRs. 1..BINLOG_MAX_ARGS arguments: integers, bools or
+// floats (doubles are narrowed to float).
+#define BINLOG(name, ...) do {                                       \
+        const uint32_t binlog_a_[] = { BINLOG_MAP_(__VA_ARGS__) };   \
+        binlog_write(BL_##name, binlog_a_,                           \
+                     sizeof(binlog_a_) / sizeof(binlog_a_[0]));      \
+    } while (0)
+
+void binlog_write(binlog_id_t id, const uint32_t *args, unsigned nargs);
+
+// Format and print everything queued. now_ms paces the rate limit.
+void binlog_drain(uint32_t now_ms);
+
+typedef struct {
+    uint32_t written;      // records queued
+    uint32_t dropped;      // records that found the ring full
+    uint32_t suppressed;   // records drained but not printed (rate limit)
+    uint32_t printed;
+    uint32_t bytes;        // console bytes written
+    uint32_t peak_words;   // ring high-water mark
+} binlog_stats_t;
+
+void binlog_get_stats(binlog_stats_t *out);
+
+// ===== Argument packing =====
+static inline uint32_t binlog_f32_(float f)
+{
+    uint32_t w;
+    memcpy(&w, &f, sizeof(w));
+    return w;
+}
+
+#define BINLOG_W_(x) _Generic((x),                   \
+        float:   binlog_f32_((float)(x)),             \
+        double:  binlog_f32_((float)(x)),             \
+        default: (uint32_t)(x))
+
+#define BINLOG_CAT_(a, b)  BINLOG_CAT2_(a, b)
+#define BINLOG_CAT2_(a, b) a##b
+#define BINLOG_NTH_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, n, ...) n
+#define BINLOG_NARGS_(...) \
+    BINLOG_NTH_(__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define BINLOG_MAP_(...) BINLOG_CAT_(BINLOG_MAP_, BINLOG_NARGS_(__VA_ARGS__))(__VA_ARGS__)
+#define BINLOG_MAP_1(a)       BINLOG_W_(a)
+#define BINLOG_MAP_2(a, ...)  BINLOG_W_(a), BINLOG_MAP_1(__VA_ARGS__)
+#define BINLOG_MAP_3(a, ...)  BINLOG_W_(a), BINLOG_MAP_2(__VA_ARGS__)
+#define BINLOG_MAP_4(a, ...)  BINLOG_W_(a), BINLOG_MAP_3(__VA_ARGS__)
+#define BINLOG_MAP_5(a, ...)  BINLOG_W_(a), BINLOG_MAP_4(__VA_ARGS__)
+#define BINLOG_MAP_6(a, ...)  BINLOG_W_(a), BINLOG_MAP_5(__VA_ARGS__)
+#define BINLOG_MAP_7(a, ...)  BINLOG_W_(a), BINLOG_MAP_6(__VA_ARGS__)
+#define BINLOG_MAP_8(a, ...)  BINLOG_W_(a), BINLOG_MAP_7(__VA_ARGS__)
+#define BINLOG_MAP_9(a, ...)  BINLOG_W_(a), BINLOG_MAP_8(__VA_ARGS__)
+#define BINLOG_MAP_10(a, ...) BINLOG_W_(a), BINLOG_MAP_9(__VA_ARGS__)
+#define BINLOG_MAP_11(a, ...) BINLOG_W_(a), BINLOG_MAP_10(__VA_ARGS__)
+#define BINLOG_MAP_12(a, ...) BINLOG_W_(a), BINLOG_MAP_11(__VA_ARGS__)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,185 @@
+// main/binlog_fmt.c — message table, frame encoder and formatter for binlog
+// records (see binlog_fmt.h); no IDF dependencies, tools/log_decode.c links it
+#include "binlog_fmt.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define LEVEL_E 'E'
+#define LEVEL_W 'W'
+#define LEVEL_I 'I'
+#define LEVEL_D 'D'
+
+static const binlog_msg_t k_msgs[BL_COUNT] = {
+#define BINLOG_MSG_(name, level, tag, fmt) { LEVEL_##level, tag, fmt },
+    BINLOG_MESSAGES(BINLOG_MSG_)
+#undef BINLOG_MSG_
+};
+
+const binlog_msg_t *binlog_msg(uint16_t id)
+{
+    return id < BL_COUNT ? &k_msgs[id] : NULL;
+}
+
+uint8_t binlog_crc8(const uint8_t *p, size_t len)
+{
+    uint8_t crc = 0;
+    while (len--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; ++i) crc = (uint8_t)(crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+    }
+    return crc;
+}
+
+static uint8_t *stuff(uint8_t *o, uint8_t b)
+{
+    if (b == BINLOG_FLAG || b == BINLOG_ESC || b == '\n' || b == '\r') {
+        *o++ = BINLOG_ESC;
+        b ^= 0x20;
+    }
+    *o++ = b;
+    return o;
+}
+
+size_t binlog_frame(uint8_t *out, const binlog_rec_t *r)
+{
+    const uint8_t *p = (const uint8_t *)r;
+    size_t len = BINLOG_REC_BYTES(r->nargs);
+    uint8_t *o = out;
+    *o++ = BINLOG_FLAG;
+    for (size_t i = 0; i < len; ++i) o = stuff(o, p[i]);
+    o = stuff(o, binlog_crc8(p, len));
+    *o++ = BINLOG_FLAG;
+    return (size_t)(o - out);
+}
+
+// ===== Formatter =====
+typedef struct {
+    char  *buf;
+    size_t cap;
+    size_t n;
+} out_t;
+
+static void put(out_t *o, const char *s, size_t len)
+{
+    if (o->n + 1 >= o->cap) return;
+    if (len > o->cap - 1 - o->n) len = o->cap - 1 - o->n;
+    memcpy(o->buf + o->n, s, len);
+    o->n += len;
+    o->buf[o->n] = '\0';
+}
+
+// snprintf's return value is what it wanted to write, not what fit.
+static void put_len(out_t *o, int k)
+{
+    if (k < 0) return;
+    size_t room = o->cap - 1 - o->n;
+    o->n += (size_t)k < room ? (size_t)k : room;
+}
+
+// "%{a|b|c}": alternative idx of the list between the braces at p. Returns
+// the character after the closing brace.
+static const char *alternative(out_t *o, const char *p, uint32_t idx, bool have)
+{
+    const char *end = strchr(p, '}');
+    if (!end) end = p + strlen(p);
+    const char *s = p;
+    uint32_t i = 0;
+    while (have && i < idx) {
+        const char *bar = memchr(s, '|', (size_t)(end - s));
+        if (!bar) break;
+        s = bar + 1;
+        ++i;
+    }
+    if (!have || i < idx) {
+        put(o, "?", 1);
+    } else {
+        const char *bar = memchr(s, '|', (size_t)(end - s));
+        put(o, s, (size_t)((bar ? bar : end) - s));
+    }
+    return *end ? end + 1 : end;
+}
+
+static void wall_time(out_t *o, uint32_t unix_s)
+{
+    // Same "not synced yet" cut-off as time_sync_fmt()
+    if (unix_s < 1700000000u) {
+        put(o, "UNSYNCED", 8);
+        return;
+    }
+    time_t t = (time_t)unix_s;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    char s[24];
+    put(o, s, strftime(s, sizeof(s), "%Y-%m-%d %H:%M:%S", &tm));
+}
+
+size_t binlog_format(char *buf, size_t cap, const char *fmt,
+                     const uint32_t *args, unsigned nargs)
+{
+    out_t o = { buf, cap, 0 };
+    unsigned a = 0;
+    if (!cap) return 0;
+    buf[0] = '\0';
+    while (*fmt) {
+        const char *pct = strchr(fmt, '%');
+        if (!pct) {
+            put(&o, fmt, strlen(fmt));
+            break;
+        }
+        put(&o, fmt, (size_t)(pct - fmt));
+        const char *p = pct + 1;
+        if (*p == '%') {
+            put(&o, "%", 1);
+            fmt = p + 1;
+            continue;
+        }
+        if (*p == '{') {
+            bool have = a < nargs;
+            fmt = alternative(&o, p + 1, have ? args[a++] : 0, have);
+            continue;
+        }
+
+        // Rebuild the conversion without length modifiers for snprintf.
+        char spec[16];
+        size_t k = 0;
+        spec[k++] = '%';
+        while (*p && strchr("-+ #0123456789.", *p)) {
+            if (k < sizeof(spec) - 2) spec[k++] = *p;
+            ++p;
+        }
+        while (*p && strchr("hlLqjzt", *p)) ++p;
+        char conv = *p;
+        fmt = *p ? p + 1 : p;
+        spec[k++] = conv;
+        spec[k] = '\0';
+
+        if (a >= nargs) {
+            put(&o, "?", 1);
+            continue;
+        }
+        uint32_t w = args[a++];
+        switch (conv) {
+        case 'd': case 'i':
+            put_len(&o, snprintf(o.buf + o.n, o.cap - o.n, spec, (int)(int32_t)w));
+            break;
+        case 'u': case 'x': case 'X': case 'o': case 'c':
+            put_len(&o, snprintf(o.buf + o.n, o.cap - o.n, spec, (unsigned)w));
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': {
+            float f;
+            memcpy(&f, &w, sizeof(f));
+            put_len(&o, snprintf(o.buf + o.n, o.cap - o.n, spec, (double)f));
+            break;
+        }
+        case 'T':
+            wall_time(&o, w);
+            break;
+        default:
+            put(&o, "?", 1);
+            break;
+        }
+    }
+    return o.n;
+}
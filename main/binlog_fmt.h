@@ -0,0 +1,92 @@
+// main/binlog_fmt.h — the messages logged through binlog.h, their record and
+// frame layout, and the formatter shared with tools/log_decode.c
+//
+// One X() line per message: name, level (E/W/I/D), tag, format. A record
+// carries the message's position in this list, so new messages go at the end
+// and none is ever removed or reordered. Arguments are 32-bit words:
+//
+//   %d %i %u %x %X %o %c   integer
+//   %f %e %g (any case)    float
+//   %T                     unix time, printed as local "YYYY-MM-DD HH:MM:SS"
+//   %{a|b|...}             integer, printed as the alternative it indexes
+//
+// Flags, width and precision work as in printf; length modifiers are ignored.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BINLOG_MESSAGES(X) \
+    X(LOST,        W, "BINLOG",   "%u record(s) lost (ring full), %u not printed (rate limit)") \
+    X(SAMPLER_RAW, I, "SAMPLER",  "Raw: Temp=%.2fC Lux=%.1f Motion=%{false|true}") \
+    X(APP_SAMPLE,  I, "APP",      "[%T] Temp=%.2fC [%.2f..%.2f] Lux=%.1f [%.1f..%.1f] " \
+                                  "Motion=%{false|true} occupied=%.1fs edges=%u") \
+    X(UP_PREPARE,  I, "UPLOADER", "Preparing to POST %d sample(s) (%u bytes %{JSON|CBOR}%{|, gzip})") \
+    X(UP_STATUS,   I, "UPLOADER", "HTTP status: %d, content-length: %d") \
+    X(UP_TOOK,     I, "UPLOADER", "Upload took %u ms (%{new|reused} connection, %u handshake(s) so far)") \
+    X(UP_OK,       I, "UPLOADER", "Upload OK — clearing %d buffered sample(s)") \
+    X(ALLOC,       I, "ALLOC",    "%{system|sensors|publisher|uploader|transport|wifi|log}: " \
+                                  "%u B from the heap (%u since boot)") \
+    X(ALLOC_OVER,  W, "ALLOC",    "%{system|sensors|publisher|uploader|transport|wifi|log} " \
+                                  "over its heap budget: %u allocation(s), %u allowed") \
+    X(ROOM_STATE,  I, "APP",      "Room %{empty|occupied|empty+lights|occupied+lights|empty+ac|" \
+                                  "occupied+ac|empty+lights+ac|occupied+lights+ac} since %u s ago " \
+                                  "(was %{empty|occupied|empty+lights|occupied+lights|empty+ac|" \
+                                  "occupied+ac|empty+lights+ac|occupied+lights+ac|unknown} for %u s)")
+
+typedef enum {
+#define BINLOG_ID_(name, level, tag, fmt) BL_##name,
+    BINLOG_MESSAGES(BINLOG_ID_)
+#undef BINLOG_ID_
+    BL_COUNT
+} binlog_id_t;
+
+typedef struct {
+    char        level;   // 'E', 'W', 'I' or 'D'
+    const char *tag;
+    const char *fmt;
+} binlog_msg_t;
+
+// NULL for an id this build does not know.
+const binlog_msg_t *binlog_msg(uint16_t id);
+
+#define BINLOG_MAX_ARGS 12
+
+// A record (little-endian, as in the ring): u16 id, u8 nargs, u8 seq,
+// u32 t_ms (ms since boot), u32 args[nargs]. seq counts every record
+// written or dropped, so a gap means the ring was full.
+typedef struct {
+    uint16_t id;
+    uint8_t  nargs;
+    uint8_t  seq;
+    uint32_t t_ms;
+    uint32_t args[BINLOG_MAX_ARGS];
+} binlog_rec_t;
+
+#define BINLOG_REC_BYTES(nargs) (8u + 4u * (nargs))
+
+// On the console (CONFIG_APP_LOG_BINARY) a record is followed by its CRC-8
+// and sent between two BINLOG_FLAG bytes. FLAG, ESC, '\n' and '\r' inside
+// are sent as ESC, b ^ 0x20, so a frame survives the console's line-ending
+// translation and never looks like the end of a text line.
+#define BINLOG_FLAG      0x7E
+#define BINLOG_ESC       0x7D
+#define BINLOG_FRAME_MAX (2 + 2 * (BINLOG_REC_BYTES(BINLOG_MAX_ARGS) + 1))
+
+uint8_t binlog_crc8(const uint8_t *p, size_t len);
+
+// Encode r as a frame into out (BINLOG_FRAME_MAX bytes); returns its length.
+size_t  binlog_frame(uint8_t *out, const binlog_rec_t *r);
+
+// Format fmt with args into out, always NUL-terminated. Conversions with no
+// argument left, or that this formatter does not know, print as "?".
+// Returns the length written.
+size_t  binlog_format(char *out, size_t cap, const char *fmt,
+                      const uint32_t *args, unsigned nargs);
+
+#ifdef __cplusplus
+}
+#endif
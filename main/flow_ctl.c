@@ -0,0 +1,228 @@
+// main/flow_ctl.c — response directives: Retry-After, X-AulaSense-Accept and
+// a flat JSON object of settings (see flow_ctl.h)
+//
+// The body parser walks one JSON object without building anything: known
+// keys take a number or a string, every other value (nested ones included)
+// is skipped.
+#include "flow_ctl.h"
+#include <string.h>
+#include <strings.h>
+
+typedef struct {
+    const char *p;
+    const char *end;
+} cursor_t;
+
+static const struct {
+    const char *key;
+    uint32_t    field;
+} k_keys[] = {
+    { "retry_after_s",     FLOW_F_RETRY },
+    { "upload_interval_s", FLOW_F_INTERVAL },
+    { "publish_s",         FLOW_F_PUBLISH },
+    { "batch_max",         FLOW_F_BATCH },
+    { "encoding",          FLOW_F_ENCODING },
+};
+
+void flow_directive_init(flow_directive_t *d)
+{
+    memset(d, 0, sizeof(*d));
+}
+
+static void skip_ws(cursor_t *c)
+{
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\r' || *c->p == '\n')) c->p++;
+}
+
+static bool eat(cursor_t *c, char ch)
+{
+    skip_ws(c);
+    if (c->p < c->end && *c->p == ch) {
+        c->p++;
+        return true;
+    }
+    return false;
+}
+
+// A string value; out gets it truncated to cap-1 bytes, escapes kept as the
+// escaped character.
+static bool parse_string(cursor_t *c, char *out, size_t cap)
+{
+    size_t n = 0;
+    if (!eat(c, '"')) return false;
+    while (c->p < c->end) {
+        char ch = *c->p++;
+        if (ch == '"') {
+            if (cap) out[n] = '\0';
+            return true;
+        }
+        if (ch == '\\') {
+            if (c->p >= c->end) return false;
+            ch = *c->p++;
+        }
+        if (n + 1 < cap) out[n++] = ch;
+    }
+    return false;
+}
+
+// A non-negative decimal in thousandths, saturating ("1.5" -> 1500). false
+// for anything else, including exponents.
+static bool parse_milli(cursor_t *c, uint32_t *out)
+{
+    skip_ws(c);
+    const char *start = c->p;
+    uint64_t v = 0;
+    while (c->p < c->end && *c->p >= '0' && *c->p <= '9') {
+        if (v < UINT32_MAX) v = v * 10 + (uint64_t)(*c->p - '0');
+        c->p++;
+    }
+    if (c->p == start) return false;
+    v *= 1000;
+    if (c->p < c->end && *c->p == '.') {
+        c->p++;
+        uint32_t scale = 100;
+        while (c->p < c->end && *c->p >= '0' && *c->p <= '9') {
+            v += (uint64_t)(*c->p - '0') * scale;
+            scale /= 10;
+            c->p++;
+        }
+    }
+    if (c->p < c->end && (*c->p == 'e' || *c->p == 'E')) return false;
+    *out = v > UINT32_MAX ? UINT32_MAX : (uint32_t)v;
+    return true;
+}
+
+// Any value: string, number, literal, or a nested object/array.
+static bool skip_value(cursor_t *c)
+{
+    skip_ws(c);
+    if (c->p >= c->end) return false;
+    if (*c->p == '"') return parse_string(c, NULL, 0);
+    if (*c->p != '{' && *c->p != '[') {
+        while (c->p < c->end && *c->p != ',' && *c->p != '}' && *c->p != ']' &&
+               *c->p != ' ' && *c->p != '\t' && *c->p != '\r' && *c->p != '\n') c->p++;
+        return true;
+    }
+    int depth = 0;
+    while (c->p < c->end) {
+        char ch = *c->p;
+        if (ch == '"') {
+            if (!parse_string(c, NULL, 0)) return false;
+            continue;
+        }
+        c->p++;
+        if (ch == '{' || ch == '[') depth++;
+        else if ((ch == '}' || ch == ']') && --depth == 0) return true;
+    }
+    return false;
+}
+
+static bool parse_encoding(const char *s, uint8_t *out)
+{
+    if (strcasecmp(s, "cbor") == 0) *out = FLOW_ENC_CBOR;
+    else if (strcasecmp(s, "json") == 0) *out = FLOW_ENC_JSON;
+    else return false;
+    return true;
+}
+
+static void set_field(flow_directive_t *d, uint32_t field, uint32_t milli)
+{
+    uint32_t whole = milli / 1000;
+    switch (field) {
+    case FLOW_F_RETRY:
+        d->retry_after_ms = milli > FLOW_CTL_RETRY_MAX_MS ? FLOW_CTL_RETRY_MAX_MS : milli;
+        break;
+    case FLOW_F_INTERVAL:
+        d->set.upload_interval_ms = milli;
+        break;
+    case FLOW_F_PUBLISH:
+        d->set.publish_ms = milli;
+        break;
+    case FLOW_F_BATCH:
+        d->set.batch_max = whole > UINT16_MAX ? UINT16_MAX : (uint16_t)whole;
+        break;
+    default:
+        return;
+    }
+    d->fields |= field;
+}
+
+bool flow_ctl_header(flow_directive_t *d, const char *key, const char *value)
+{
+    if (!key || !value) return false;
+    if (strcasecmp(key, "Retry-After") == 0) {
+        // delta-seconds only; an HTTP-date would need a synced clock
+        cursor_t c = { value, value + strlen(value) };
+        uint32_t ms;
+        if (!parse_milli(&c, &ms)) return false;
+        skip_ws(&c);
+        if (c.p != c.end) return false;
+        set_field(d, FLOW_F_RETRY, ms);
+        return true;
+    }
+    if (strcasecmp(key, "X-AulaSense-Accept") == 0) {
+        if (!parse_encoding(value, &d->set.encoding)) return false;
+        d->fields |= FLOW_F_ENCODING;
+        return true;
+    }
+    return false;
+}
+
+bool flow_ctl_body(flow_directive_t *d, const char *body, size_t len)
+{
+    if (!body) return false;
+    cursor_t c = { body, body + len };
+    if (!eat(&c, '{')) return false;
+    if (eat(&c, '}')) return true;
+    for (;;) {
+        char key[24];
+        if (!parse_string(&c, key, sizeof(key)) || !eat(&c, ':')) return false;
+
+        uint32_t field = 0;
+        for (size_t i = 0; i < sizeof(k_keys) / sizeof(k_keys[0]); ++i) {
+            if (strcmp(key, k_keys[i].key) == 0) field = k_keys[i].field;
+        }
+        skip_ws(&c);
+        if (field == FLOW_F_ENCODING && c.p < c.end && *c.p == '"') {
+            char enc[8];
+            if (!parse_string(&c, enc, sizeof(enc))) return false;
+            if (parse_encoding(enc, &d->set.encoding)) d->fields |= FLOW_F_ENCODING;
+        } else if (field && field != FLOW_F_ENCODING && c.p < c.end && *c.p >= '0' && *c.p <= '9') {
+            uint32_t milli;
+            if (parse_milli(&c, &milli)) set_field(d, field, milli);
+            else if (!skip_value(&c)) return false;   // e.g. 1e3: ignored
+        } else if (!skip_value(&c)) {
+            return false;
+        }
+
+        if (eat(&c, ',')) continue;
+        return eat(&c, '}');
+    }
+}
+
+static uint32_t clamp(uint32_t v, uint32_t lo, uint32_t hi)
+{
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+bool flow_ctl_apply(flow_ctl_t *f, const flow_directive_t *d, uint16_t batch_cap)
+{
+    flow_ctl_t n = *f;
+    if (d->fields & FLOW_F_INTERVAL) {
+        n.upload_interval_ms = clamp(d->set.upload_interval_ms, 0, FLOW_CTL_INTERVAL_MAX_MS);
+    }
+    if (d->fields & FLOW_F_PUBLISH) {
+        n.publish_ms = d->set.publish_ms == 0 ? 0
+                     : clamp(d->set.publish_ms, FLOW_CTL_PUBLISH_MIN_MS, FLOW_CTL_PUBLISH_MAX_MS);
+    }
+    if (d->fields & FLOW_F_BATCH) {
+        n.batch_max = d->set.batch_max > batch_cap ? batch_cap : d->set.batch_max;
+    }
+    if (d->fields & FLOW_F_ENCODING) {
+        n.encoding = d->set.encoding;
+    }
+    bool changed = n.upload_interval_ms != f->upload_interval_ms || n.publish_ms != f->publish_ms ||
+                   n.batch_max != f->batch_max || n.encoding != f->encoding;
+    *f = n;
+    return changed;
+}
@@ -0,0 +1,88 @@
+// main/flow_ctl.h — upload settings the server can change from its responses
+//
+// Every upload response may carry directives, in a header or in a JSON
+// object body (any other body is ignored):
+//
+//   Retry-After: 30                   no POST before 30 s from now (once)
+//   X-AulaSense-Accept: cbor|json     wire format of the next batches
+//   {"retry_after_s": 30,             as Retry-After
+//    "upload_interval_s": 120,        at least this long between POSTs
+//    "batch_max": 25,                 samples per POST
+//    "publish_s": 30,                 sample period
+//    "encoding": "cbor"}              as X-AulaSense-Accept
+//
+// Unknown keys are skipped and a value of 0 puts a setting back to the
+// firmware default. Except for the one-shot retry delay, the settings are
+// kept (uploader.c stores them in NVS) until the server changes them again.
+// Values are clamped to the ranges below. Pure parsing, no I/O.
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef FLOW_CTL_INTERVAL_MAX_MS
+#define FLOW_CTL_INTERVAL_MAX_MS 3600000   // 1 h between POSTs at most
+#endif
+#ifndef FLOW_CTL_PUBLISH_MIN_MS
+#define FLOW_CTL_PUBLISH_MIN_MS  5000
+#endif
+#ifndef FLOW_CTL_PUBLISH_MAX_MS
+#define FLOW_CTL_PUBLISH_MAX_MS  3600000
+#endif
+#ifndef FLOW_CTL_RETRY_MAX_MS
+#define FLOW_CTL_RETRY_MAX_MS    3600000
+#endif
+#ifndef FLOW_CTL_BODY_MAX
+#define FLOW_CTL_BODY_MAX        256       // response bytes looked at
+#endif
+
+enum {
+    FLOW_ENC_DEFAULT = 0,
+    FLOW_ENC_JSON,
+    FLOW_ENC_CBOR,
+};
+
+// 0 in any field = firmware default. This is also the NVS record.
+typedef struct {
+    uint32_t upload_interval_ms;   // minimum gap between POSTs
+    uint32_t publish_ms;           // sample period
+    uint16_t batch_max;            // samples per POST
+    uint8_t  encoding;             // FLOW_ENC_*
+    uint8_t  reserved;
+} flow_ctl_t;
+
+enum {
+    FLOW_F_RETRY    = 1u << 0,
+    FLOW_F_INTERVAL = 1u << 1,
+    FLOW_F_PUBLISH  = 1u << 2,
+    FLOW_F_BATCH    = 1u << 3,
+    FLOW_F_ENCODING = 1u << 4,
+};
+
+// What one response asked for.
+typedef struct {
+    uint32_t   fields;             // FLOW_F_* present
+    uint32_t   retry_after_ms;
+    flow_ctl_t set;                // values of the other fields present
+} flow_directive_t;
+
+void flow_directive_init(flow_directive_t *d);
+
+// One response header; false if it is not a directive.
+bool flow_ctl_header(flow_directive_t *d, const char *key, const char *value);
+
+// The response body; false unless it is a JSON object. Fields seen before
+// a syntax error are kept.
+bool flow_ctl_body(flow_directive_t *d, const char *body, size_t len);
+
+// Merge d into *f, clamping; batch_max is also capped at batch_cap.
+// true if *f changed.
+bool flow_ctl_apply(flow_ctl_t *f, const flow_directive_t *d, uint16_t batch_cap);
+
+#ifdef __cplusplus
+}
+#endif
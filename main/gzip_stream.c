@@ -0,0 +1,241 @@
+// main/gzip_stream.c — greedy LZ77 + fixed-Huffman deflate in a gzip wrapper
+//
+// One final fixed-Huffman block: no tree building and no extra buffering, so
+// memory stays at sizeof(gzip_stream_t) (~10 KB) whatever the payload size.
+// Upload JSON is so repetitive that the matches carry the ratio; dynamic
+// trees would add only a few percent.
+#include "gzip_stream.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define W          GZIP_STREAM_WINDOW
+#define HASH_SIZE  (1u << GZIP_STREAM_HASH_BITS)
+#define MIN_MATCH  3
+#define MAX_MATCH  258
+#define MAX_CHAIN  8
+
+static const uint16_t len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// --------- output ---------
+static void out_byte(gzip_stream_t *z, uint8_t b)
+{
+    z->size_out++;
+    if (!z->sink || z->err != ESP_OK) return;
+    z->out[z->out_used++] = b;
+    if (z->out_used == sizeof(z->out)) {
+        z->err = z->sink(z->ctx, (const char *)z->out, z->out_used);
+        z->out_used = 0;
+    }
+}
+
+// Deflate packs bits LSB first.
+static void put_bits(gzip_stream_t *z, uint32_t v, int n)
+{
+    z->bitbuf |= v << z->bitcount;
+    z->bitcount += n;
+    while (z->bitcount >= 8) {
+        out_byte(z, (uint8_t)z->bitbuf);
+        z->bitbuf >>= 8;
+        z->bitcount -= 8;
+    }
+}
+
+// Huffman codes are defined MSB first, so reverse them before packing.
+static void put_code(gzip_stream_t *z, uint32_t code, int n)
+{
+    uint32_t r = 0;
+    for (int i = 0; i < n; ++i) {
+        r = (r << 1) | (code & 1);
+        code >>= 1;
+    }
+    put_bits(z, r, n);
+}
+
+static void put_litlen(gzip_stream_t *z, unsigned v)
+{
+    if (v < 144)      put_code(z, 0x30 + v, 8);
+    else if (v < 256) put_code(z, 0x190 + (v - 144), 9);
+    else if (v < 280) put_code(z, v - 256, 7);
+    else              put_code(z, 0xC0 + (v - 280), 8);
+}
+
+static void put_match(gzip_stream_t *z, unsigned len, unsigned dist)
+{
+    int lc = 28;
+    while (len_base[lc] > len) lc--;
+    put_litlen(z, 257 + (unsigned)lc);
+    put_bits(z, len - len_base[lc], len_extra[lc]);
+
+    int dc = 29;
+    while (dist_base[dc] > dist) dc--;
+    put_code(z, (uint32_t)dc, 5);
+    put_bits(z, dist - dist_base[dc], dist_extra[dc]);
+}
+
+// --------- CRC-32 (gzip trailer) ---------
+static uint32_t crc32_update(uint32_t crc, const uint8_t *p, size_t len)
+{
+    static const uint32_t tab[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+        0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C };
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ tab[crc & 15];
+        crc = (crc >> 4) ^ tab[crc & 15];
+    }
+    return ~crc;
+}
+
+// --------- LZ77 ---------
+static inline uint32_t hash3(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 10 ^ (uint32_t)p[1] << 5 ^ p[2]) & (HASH_SIZE - 1);
+}
+
+// Positions are stored +1 so that 0 means "empty".
+static inline void insert(gzip_stream_t *z, uint32_t pos)
+{
+    uint32_t h = hash3(&z->win[pos]);
+    z->prev[pos & (W - 1)] = z->head[h];
+    z->head[h] = (uint16_t)(pos + 1);
+}
+
+static unsigned longest_match(gzip_stream_t *z, uint32_t *dist)
+{
+    uint32_t pos = z->strstart;
+    uint32_t limit = pos > W ? pos - W : 0;
+    unsigned max = z->lookahead < MAX_MATCH ? z->lookahead : MAX_MATCH;
+    unsigned best = 0;
+    uint32_t cand = z->head[hash3(&z->win[pos])];
+
+    for (int chain = 0; chain < MAX_CHAIN && cand > limit; ++chain) {
+        uint32_t c = cand - 1;
+        if (c >= pos) break;
+        const uint8_t *a = &z->win[pos], *b = &z->win[c];
+        if (b[best] == a[best]) {
+            unsigned n = 0;
+            while (n < max && a[n] == b[n]) n++;
+            if (n > best) {
+                best = n;
+                *dist = pos - c;
+                if (n == max) break;
+            }
+        }
+        uint32_t next = z->prev[c & (W - 1)];
+        if (next >= cand) break;   // slot reused by a newer position
+        cand = next;
+    }
+    return best >= MIN_MATCH ? best : 0;
+}
+
+// Encodes buffered input, keeping MAX_MATCH of lookahead unless flushing.
+static void compress(gzip_stream_t *z, bool flush)
+{
+    while (z->lookahead >= (flush ? 1u : (unsigned)MAX_MATCH)) {
+        uint32_t dist = 0;
+        unsigned len = 0;
+        if (z->lookahead >= MIN_MATCH) {
+            len = longest_match(z, &dist);
+            insert(z, z->strstart);
+        }
+        if (len) {
+            put_match(z, len, dist);
+            for (unsigned i = 1; i < len; ++i) {
+                if (z->lookahead - i >= MIN_MATCH) insert(z, z->strstart + i);
+            }
+            z->strstart  += len;
+            z->lookahead -= len;
+        } else {
+            put_litlen(z, z->win[z->strstart]);
+            z->strstart++;
+            z->lookahead--;
+        }
+    }
+}
+
+// Drops the older half of the window once the buffer is full.
+static void slide(gzip_stream_t *z)
+{
+    memmove(z->win, z->win + W, W);
+    z->strstart -= W;
+    for (uint32_t i = 0; i < HASH_SIZE; ++i) {
+        z->head[i] = z->head[i] > W ? (uint16_t)(z->head[i] - W) : 0;
+    }
+    for (uint32_t i = 0; i < W; ++i) {
+        z->prev[i] = z->prev[i] > W ? (uint16_t)(z->prev[i] - W) : 0;
+    }
+}
+
+// --------- public API ---------
+void gzip_stream_begin(gzip_stream_t *z, payload_sink_t sink, void *ctx)
+{
+    memset(z->head, 0, sizeof(z->head));
+    memset(z->prev, 0, sizeof(z->prev));
+    z->strstart = z->lookahead = 0;
+    z->bitbuf = 0;
+    z->bitcount = 0;
+    z->out_used = 0;
+    z->crc = 0;
+    z->size_in = 0;
+    z->size_out = 0;
+    z->sink = sink;
+    z->ctx = ctx;
+    z->err = ESP_OK;
+
+    // ID1 ID2 CM=deflate FLG=0 MTIME=0 XFL=0 OS=unknown
+    static const uint8_t hdr[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF };
+    for (size_t i = 0; i < sizeof(hdr); ++i) out_byte(z, hdr[i]);
+
+    put_bits(z, 1, 1);   // BFINAL
+    put_bits(z, 1, 2);   // BTYPE = fixed Huffman
+}
+
+esp_err_t gzip_stream_sink(void *ctx, const char *data, size_t len)
+{
+    gzip_stream_t *z = ctx;
+    const uint8_t *p = (const uint8_t *)data;
+
+    z->crc = crc32_update(z->crc, p, len);
+    z->size_in += (uint32_t)len;
+
+    while (len > 0 && z->err == ESP_OK) {
+        if (z->strstart + z->lookahead >= sizeof(z->win)) slide(z);
+        size_t room = sizeof(z->win) - (z->strstart + z->lookahead);
+        size_t n = len < room ? len : room;
+        memcpy(&z->win[z->strstart + z->lookahead], p, n);
+        z->lookahead += (uint32_t)n;
+        p += n;
+        len -= n;
+        compress(z, false);
+    }
+    return z->err;
+}
+
+esp_err_t gzip_stream_finish(gzip_stream_t *z)
+{
+    compress(z, true);
+    put_litlen(z, 256);            // end of block
+    if (z->bitcount > 0) put_bits(z, 0, 8 - z->bitcount);
+
+    for (int i = 0; i < 4; ++i) out_byte(z, (uint8_t)(z->crc >> (8 * i)));
+    for (int i = 0; i < 4; ++i) out_byte(z, (uint8_t)(z->size_in >> (8 * i)));
+
+    if (z->sink && z->err == ESP_OK && z->out_used > 0) {
+        z->err = z->sink(z->ctx, (const char *)z->out, z->out_used);
+        z->out_used = 0;
+    }
+    return z->err;
+}
@@ -0,0 +1,50 @@
+// main/gzip_stream.h — small-window streaming gzip (deflate) compressor
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "payload_json.h"   // payload_sink_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// History window. Deflate allows up to 32 KB; upload batches repeat every
+// ~310 bytes (one JSON object), so 2 KB still spans six of them
+// (host/gzip_check).
+#ifndef GZIP_STREAM_WINDOW
+#define GZIP_STREAM_WINDOW 2048
+#endif
+#define GZIP_STREAM_HASH_BITS 10
+
+typedef struct {
+    uint8_t        win[2 * GZIP_STREAM_WINDOW];
+    uint16_t       head[1u << GZIP_STREAM_HASH_BITS];
+    uint16_t       prev[GZIP_STREAM_WINDOW];
+    uint32_t       strstart;     // next byte to encode (index into win)
+    uint32_t       lookahead;    // bytes buffered at strstart
+    uint32_t       bitbuf;
+    int            bitcount;
+    uint8_t        out[256];
+    size_t         out_used;
+    uint32_t       crc;
+    uint32_t       size_in;
+    size_t         size_out;     // compressed bytes emitted so far
+    payload_sink_t sink;         // NULL: only count size_out
+    void          *ctx;
+    esp_err_t      err;
+} gzip_stream_t;
+
+// Start a gzip member; compressed bytes go to sink (or are only counted).
+void      gzip_stream_begin(gzip_stream_t *z, payload_sink_t sink, void *ctx);
+
+// Feed uncompressed bytes. Has the payload_sink_t signature with ctx = z, so
+// an encoder can write straight into the compressor.
+esp_err_t gzip_stream_sink(void *z, const char *data, size_t len);
+
+// Flush everything and write the gzip trailer.
+esp_err_t gzip_stream_finish(gzip_stream_t *z);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,126 @@
+// main/i2c_bus.c — I2C transport with fixed device slots and bus recovery
+#include "i2c_bus.h"
+#include "metrics.h"
+
+#include "driver/i2c_master.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "I2C_BUS";
+
+struct i2c_bus_dev {
+    i2c_master_dev_handle_t h;
+    uint8_t  addr;
+    bool     seen;       // has acknowledged at least once
+    uint8_t  fail_run;   // consecutive failures
+};
+
+static i2c_master_bus_handle_t s_bus = NULL;
+static struct i2c_bus_dev      s_devs[I2C_BUS_MAX_DEVS];
+static int                     s_ndevs = 0;
+static i2c_bus_stats_t         s_stats;   // sampler task only
+
+esp_err_t i2c_bus_init(int sda_gpio, int scl_gpio)
+{
+    if (s_bus) return ESP_OK;
+    i2c_master_bus_config_t cfg = {
+        .i2c_port = I2C_NUM_0,
+        .sda_io_num = sda_gpio,
+        .scl_io_num = scl_gpio,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .trans_queue_depth = 0,          // synchronous: no per-transaction queue items
+        .flags.enable_internal_pullup = true,
+    };
+    esp_err_t err = i2c_new_master_bus(&cfg, &s_bus);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Bus init failed: %s", esp_err_to_name(err));
+        s_bus = NULL;
+    }
+    return err;
+}
+
+i2c_bus_dev_t i2c_bus_device(uint8_t addr)
+{
+    for (int i = 0; i < s_ndevs; ++i) {
+        if (s_devs[i].addr == addr) return &s_devs[i];
+    }
+    if (!s_bus || s_ndevs == I2C_BUS_MAX_DEVS) return NULL;
+
+    i2c_device_config_t cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = addr,
+        .scl_speed_hz = I2C_BUS_FREQ_HZ,
+    };
+    struct i2c_bus_dev *d = &s_devs[s_ndevs];
+    if (i2c_master_bus_add_device(s_bus, &cfg, &d->h) != ESP_OK) return NULL;
+    d->addr = addr;
+    s_ndevs++;
+    return d;
+}
+
+// Clock out a stuck slave (9 SCL pulses + STOP) and re-arm the controller.
+static void bus_reset(const char *why, uint8_t addr)
+{
+    s_stats.resets++;
+    metrics_count(METRIC_C_I2C_RESETS, 1);
+    esp_err_t err = i2c_master_bus_reset(s_bus);
+    ESP_LOGW(TAG, "Bus clear after %s at 0x%02X: %s", why, addr, esp_err_to_name(err));
+    for (int i = 0; i < s_ndevs; ++i) s_devs[i].fail_run = 0;
+}
+
+// Accounting and recovery around one driver call.
+static esp_err_t done(struct i2c_bus_dev *d, esp_err_t err, int64_t t0)
+{
+    metrics_hist_add(METRIC_H_I2C, (uint32_t)(esp_timer_get_time() - t0));
+    s_stats.xfers++;
+    if (err == ESP_OK) {
+        d->seen = true;
+        d->fail_run = 0;
+        return ESP_OK;
+    }
+
+    s_stats.errors++;
+    metrics_count(METRIC_C_I2C_ERRORS, 1);
+    if (err == ESP_ERR_TIMEOUT) {
+        s_stats.timeouts++;
+        bus_reset("timeout", d->addr);
+    } else {
+        s_stats.nacks++;
+        // An absent device NACKs forever; that is not a bus fault.
+        if (d->seen && ++d->fail_run >= I2C_BUS_RESET_AFTER) bus_reset("errors", d->addr);
+    }
+    return err;
+}
+
+esp_err_t i2c_bus_write(i2c_bus_dev_t d, const uint8_t *data, size_t len)
+{
+    if (!d) return ESP_ERR_INVALID_STATE;
+    int64_t t0 = esp_timer_get_time();
+    return done(d, i2c_master_transmit(d->h, data, len, I2C_BUS_TIMEOUT_MS), t0);
+}
+
+esp_err_t i2c_bus_write_reg(i2c_bus_dev_t d, uint8_t reg, uint8_t val)
+{
+    const uint8_t buf[2] = { reg, val };
+    return i2c_bus_write(d, buf, sizeof(buf));
+}
+
+esp_err_t i2c_bus_read(i2c_bus_dev_t d, uint8_t *buf, size_t len)
+{
+    if (!d) return ESP_ERR_INVALID_STATE;
+    int64_t t0 = esp_timer_get_time();
+    return done(d, i2c_master_receive(d->h, buf, len, I2C_BUS_TIMEOUT_MS), t0);
+}
+
+esp_err_t i2c_bus_read_reg(i2c_bus_dev_t d, uint8_t reg, uint8_t *buf, size_t len)
+{
+    if (!d) return ESP_ERR_INVALID_STATE;
+    int64_t t0 = esp_timer_get_time();
+    return done(d, i2c_master_transmit_receive(d->h, &reg, 1, buf, len, I2C_BUS_TIMEOUT_MS), t0);
+}
+
+void i2c_bus_get_stats(i2c_bus_stats_t *out)
+{
+    *out = s_stats;
+}
@@ -0,0 +1,56 @@
+// main/i2c_bus.h — I2C master transport on driver/i2c_master.h
+//
+// Devices are registered once at init and kept as driver handles, so a
+// transaction is one synchronous driver call with caller-owned buffers and no
+// heap. Failures are counted, never fatal: a timeout (bus held low) or a run
+// of errors from a device that has answered before triggers a bus clear.
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef I2C_BUS_FREQ_HZ
+#define I2C_BUS_FREQ_HZ      400000   // fast mode; BH1750 and BME280 both support it
+#endif
+#ifndef I2C_BUS_TIMEOUT_MS
+#define I2C_BUS_TIMEOUT_MS   20       // per transaction; the longest burst takes < 1 ms
+#endif
+#ifndef I2C_BUS_RESET_AFTER
+#define I2C_BUS_RESET_AFTER  3        // consecutive failures of a known device → bus clear
+#endif
+
+#define I2C_BUS_MAX_DEVS 4
+
+typedef struct i2c_bus_dev *i2c_bus_dev_t;
+
+typedef struct {
+    uint32_t xfers;      // transactions issued
+    uint32_t errors;     // ...that failed (any reason)
+    uint32_t nacks;      // ...that were not acknowledged
+    uint32_t timeouts;   // ...that timed out
+    uint32_t resets;     // bus clears performed
+} i2c_bus_stats_t;
+
+// Create the bus on the given pins. Safe to call again after a failure.
+esp_err_t     i2c_bus_init(int sda_gpio, int scl_gpio);
+
+// Handle for the 7-bit address addr, created on first use; NULL if the bus is
+// down or all I2C_BUS_MAX_DEVS slots are taken.
+i2c_bus_dev_t i2c_bus_device(uint8_t addr);
+
+esp_err_t     i2c_bus_write(i2c_bus_dev_t d, const uint8_t *data, size_t len);
+esp_err_t     i2c_bus_write_reg(i2c_bus_dev_t d, uint8_t reg, uint8_t val);
+esp_err_t     i2c_bus_read(i2c_bus_dev_t d, uint8_t *buf, size_t len);
+// Register read with a repeated start: write reg, then read len bytes.
+esp_err_t     i2c_bus_read_reg(i2c_bus_dev_t d, uint8_t reg, uint8_t *buf, size_t len);
+
+void          i2c_bus_get_stats(i2c_bus_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
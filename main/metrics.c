@@ -0,0 +1,163 @@
+// main/metrics.c — histogram summaries and the periodic health record
+//
+// The hot paths only ever add to g_metrics_*. Everything here runs on the
+// sender task when a record is due, so the window baseline needs no lock.
+#include "metrics.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include <string.h>
+
+static const char *TAG = "METRICS";
+
+_Atomic uint32_t g_metrics_hist[METRIC_H_COUNT][METRICS_BUCKETS];
+_Atomic uint32_t g_metrics_count[METRIC_C_COUNT];
+
+static uint32_t     s_base[METRIC_H_COUNT][METRICS_BUCKETS];   // last committed
+static uint32_t     s_pending[METRIC_H_COUNT][METRICS_BUCKETS]; // last encoded
+static TaskHandle_t s_tasks[METRICS_MAX_TASKS];
+static int          s_ntasks;
+static _Atomic uint32_t s_boot_ms[METRIC_B_COUNT];
+
+void metrics_register_task(TaskHandle_t task)
+{
+    if (task && s_ntasks < METRICS_MAX_TASKS) s_tasks[s_ntasks++] = task;
+}
+
+uint32_t metrics_counter(metric_counter_t c)
+{
+    return atomic_load_explicit(&g_metrics_count[c], memory_order_relaxed);
+}
+
+void metrics_boot_mark(metric_boot_t b)
+{
+    static const char *const names[METRIC_B_COUNT] = {
+        "first sample", "first IP", "first clock sync", "first upload",
+    };
+    uint32_t ms = (uint32_t)(esp_timer_get_time() / 1000);
+    uint32_t none = 0;
+    if (ms == 0) ms = 1;
+    if (atomic_compare_exchange_strong(&s_boot_ms[b], &none, ms)) {
+        ESP_LOGI(TAG, "Boot: %s at %u ms", names[b], (unsigned)ms);
+    }
+}
+
+uint32_t metrics_boot_ms(metric_boot_t b)
+{
+    return atomic_load_explicit(&s_boot_ms[b], memory_order_relaxed);
+}
+
+static void snap(metric_hist_t h, uint32_t out[METRICS_BUCKETS])
+{
+    for (int b = 0; b < METRICS_BUCKETS; ++b) {
+        out[b] = atomic_load_explicit(&g_metrics_hist[h][b], memory_order_relaxed);
+    }
+}
+
+// Smallest bucket holding the q-th fraction (per mille) of n values.
+static uint8_t quantile(const uint32_t *bins, uint32_t n, uint32_t per_mille)
+{
+    uint64_t want = ((uint64_t)n * per_mille + 999) / 1000;
+    uint64_t seen = 0;
+    for (int b = 0; b < METRICS_BUCKETS; ++b) {
+        seen += bins[b];
+        if (seen >= want && seen > 0) return (uint8_t)b;
+    }
+    return 0;
+}
+
+static uint8_t max_bucket(const uint32_t *bins)
+{
+    for (int b = METRICS_BUCKETS - 1; b > 0; --b) {
+        if (bins[b]) return (uint8_t)b;
+    }
+    return 0;
+}
+
+static uint32_t total(const uint32_t *bins)
+{
+    uint32_t n = 0;
+    for (int b = 0; b < METRICS_BUCKETS; ++b) n += bins[b];
+    return n;
+}
+
+void metrics_summary(metric_hist_t h, metrics_summary_t *out)
+{
+    uint32_t bins[METRICS_BUCKETS];
+    snap(h, bins);
+    out->count  = total(bins);
+    out->p50_us = metrics_bucket_us(quantile(bins, out->count, 500));
+    out->p90_us = metrics_bucket_us(quantile(bins, out->count, 900));
+    out->p99_us = metrics_bucket_us(quantile(bins, out->count, 990));
+    out->max_us = metrics_bucket_us(max_bucket(bins));
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i) p[i] = (uint8_t)(v >> (8 * i));
+    return p + 4;
+}
+
+static size_t base64(const uint8_t *in, size_t n, char *out, size_t cap)
+{
+    static const char abc[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t len = (n + 2) / 3 * 4;
+    if (cap <= len) return 0;
+    char *o = out;
+    for (size_t i = 0; i < n; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < n) v |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < n) v |= in[i + 2];
+        *o++ = abc[(v >> 18) & 63];
+        *o++ = abc[(v >> 12) & 63];
+        *o++ = i + 1 < n ? abc[(v >> 6) & 63] : '=';
+        *o++ = i + 2 < n ? abc[v & 63] : '=';
+    }
+    *o = '\0';
+    return len;
+}
+
+size_t metrics_health_encode(char *out, size_t cap)
+{
+    uint8_t rec[METRICS_HEALTH_MAX];
+    uint8_t *p = rec;
+
+    *p++ = METRICS_HEALTH_VER;
+    *p++ = (uint8_t)s_ntasks;
+    p = put_u32(p, (uint32_t)(esp_timer_get_time() / 1000000));
+    p = put_u32(p, esp_get_free_heap_size());
+    p = put_u32(p, esp_get_minimum_free_heap_size());
+    for (int c = 0; c < METRIC_C_COUNT; ++c) p = put_u32(p, metrics_counter((metric_counter_t)c));
+
+    for (int h = 0; h < METRIC_H_COUNT; ++h) {
+        uint32_t win[METRICS_BUCKETS];
+        snap((metric_hist_t)h, s_pending[h]);
+        for (int b = 0; b < METRICS_BUCKETS; ++b) win[b] = s_pending[h][b] - s_base[h][b];
+        uint32_t n = total(win);
+        p = put_u32(p, n);
+        *p++ = quantile(win, n, 500);
+        *p++ = quantile(win, n, 900);
+        *p++ = quantile(win, n, 990);
+        *p++ = max_bucket(win);
+    }
+
+    for (int i = 0; i < s_ntasks; ++i) {
+        UBaseType_t hwm = uxTaskGetStackHighWaterMark(s_tasks[i]);
+        p = put_u16(p, hwm > UINT16_MAX ? UINT16_MAX : (uint16_t)hwm);
+    }
+    for (int b = 0; b < METRIC_B_COUNT; ++b) p = put_u32(p, metrics_boot_ms((metric_boot_t)b));
+    return base64(rec, (size_t)(p - rec), out, cap);
+}
+
+void metrics_health_commit(void)
+{
+    memcpy(s_base, s_pending, sizeof(s_base));
+}
@@ -0,0 +1,114 @@
+// main/metrics.h — always-on counters and latency histograms for the hot paths
+#pragma once
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A health record goes out with the first upload after this much time.
+#ifndef METRICS_HEALTH_PERIOD_MS
+#define METRICS_HEALTH_PERIOD_MS 300000   // 5 min
+#endif
+
+#define METRICS_BUCKETS     32   // log2 µs: bucket b holds [2^(b-1), 2^b)
+#define METRICS_MAX_TASKS   5
+#define METRICS_HEALTH_VER  6   // 2: + i2c_resets counter, 3: + sample_late,
+                                // 4: + samples_undated, 5: + boot timeline,
+                                // 6: http_connects -> connects (MQTT too)
+
+typedef enum {
+    METRIC_H_I2C = 0,          // one I2C transaction (sensors.c)
+    METRIC_H_UPLOAD_CONNECT,   // TCP + TLS handshake inside the HTTP open
+    METRIC_H_UPLOAD_XFER,      // request body out → response headers in
+    METRIC_H_UPLOAD_TOTAL,     // one uploader_send() attempt, end to end
+    METRIC_H_SAMPLE_LATE,      // sampler tick past its read slot (sensors.c)
+    METRIC_H_COUNT
+} metric_hist_t;
+
+typedef enum {
+    METRIC_C_SAMPLES_DROPPED = 0,   // uploader_add(): RAM queue full
+    METRIC_C_LOG_DROPPED,           // flash backlog wrapped over unsent samples
+    METRIC_C_I2C_ERRORS,
+    METRIC_C_WIFI_DISCONNECTS,
+    METRIC_C_CONNECTS,              // transport handshakes, HTTP or MQTT
+    METRIC_C_UPLOAD_FAILS,
+    METRIC_C_I2C_RESETS,            // bus clears (i2c_bus.c)
+    METRIC_C_SAMPLES_UNDATED,       // taken before SNTP sync, then a reboot
+    METRIC_C_COUNT
+} metric_counter_t;
+
+// Boot timeline: when each first happened, in ms since boot.
+typedef enum {
+    METRIC_B_FIRST_SAMPLE = 0,   // first sample or event queued for upload (app_main.c)
+    METRIC_B_FIRST_IP,           // first IP address (wifi.c)
+    METRIC_B_FIRST_SYNC,         // wall clock first set (time_sync.c)
+    METRIC_B_FIRST_UPLOAD,       // first upload acknowledged (uploader.c)
+    METRIC_B_COUNT
+} metric_boot_t;
+
+// Updated with relaxed atomics: a record is one bucket index computation and
+// one add, so it can stay enabled in production builds.
+extern _Atomic uint32_t g_metrics_hist[METRIC_H_COUNT][METRICS_BUCKETS];
+extern _Atomic uint32_t g_metrics_count[METRIC_C_COUNT];
+
+static inline void metrics_hist_add(metric_hist_t h, uint32_t us)
+{
+    uint32_t b = us ? 32u - (uint32_t)__builtin_clz(us) : 0u;
+    if (b >= METRICS_BUCKETS) b = METRICS_BUCKETS - 1;
+    atomic_fetch_add_explicit(&g_metrics_hist[h][b], 1, memory_order_relaxed);
+}
+
+static inline void metrics_count(metric_counter_t c, uint32_t n)
+{
+    atomic_fetch_add_explicit(&g_metrics_count[c], n, memory_order_relaxed);
+}
+
+// Upper bound in µs of the values counted in bucket b.
+static inline uint32_t metrics_bucket_us(uint32_t b)
+{
+    return b == 0 ? 0 : b >= 32 ? UINT32_MAX : (1u << b) - 1u;
+}
+
+typedef struct {
+    uint32_t count;
+    uint32_t p50_us, p90_us, p99_us, max_us;   // bucket upper bounds
+} metrics_summary_t;
+
+// Histogram summary since boot.
+void     metrics_summary(metric_hist_t h, metrics_summary_t *out);
+uint32_t metrics_counter(metric_counter_t c);
+
+// Record milestone b at the current time; only the first call counts. Any
+// task. metrics_boot_ms() is 0 until then (a milestone at 0 ms reads as 1).
+void     metrics_boot_mark(metric_boot_t b);
+uint32_t metrics_boot_ms(metric_boot_t b);
+
+// Tasks whose stack high-water mark goes into the health record, in
+// registration order.
+void     metrics_register_task(TaskHandle_t task);
+
+// Health record (little-endian, see tools/health_decode.c):
+//   u8  version, u8 n_tasks, u32 uptime_s, u32 free_heap, u32 min_free_heap
+//   u32 counters[METRIC_C_COUNT]                 (since boot)
+//   per histogram: u32 count, u8 p50, p90, p99, max bucket
+//                                                (since the last committed record)
+//   u16 stack high-water mark in bytes per registered task
+//   u32 boot timeline ms[METRIC_B_COUNT], 0 = not yet
+#define METRICS_HEALTH_MAX  (14 + 4 * METRIC_C_COUNT + 8 * METRIC_H_COUNT + 2 * METRICS_MAX_TASKS + \
+                             4 * METRIC_B_COUNT)
+
+// Encode a record as base64 into out (NUL-terminated) for an HTTP header.
+// Returns the string length, 0 if out is too small. The histogram window
+// only moves on metrics_health_commit(), so a record that never reached the
+// server is folded into the next one.
+size_t   metrics_health_encode(char *out, size_t cap);
+void     metrics_health_commit(void);
+
+#ifdef __cplusplus
+}
+#endif
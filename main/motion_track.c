@@ -0,0 +1,85 @@
+// main/motion_track.c — see motion_track.h
+//
+// A change still pending when a window closes is booked from the start of
+// the next window, so a window is never reopened; the error is bounded by
+// the debounce time.
+#include "motion_track.h"
+#include <string.h>
+
+static void window_reset(motion_track_t *m, int64_t now_us)
+{
+    memset(&m->win, 0, sizeof(m->win));
+    m->win_start = now_us;
+    m->win.first_us = m->win.last_us = -1;
+    if (m->level) {
+        m->win.motion = true;
+        m->win.first_us = now_us;
+    }
+}
+
+void motion_track_init(motion_track_t *m, int64_t now_us, bool level, int64_t debounce_us)
+{
+    memset(m, 0, sizeof(*m));
+    m->debounce_us = debounce_us;
+    m->level = level;
+    m->level_since = now_us;
+    window_reset(m, now_us);
+}
+
+static inline int64_t max64(int64_t a, int64_t b) { return a > b ? a : b; }
+
+// The debounced level flips at `at` (the raw edge time).
+static void commit(motion_track_t *m, int64_t at)
+{
+    at = max64(at, m->win_start);
+    if (m->level) {
+        m->win.occupied_us += at - max64(m->level_since, m->win_start);
+        m->win.last_us = at;
+    }
+    m->level = !m->level;
+    m->level_since = at;
+    if (m->level) {
+        m->win.edges++;
+        m->win.motion = true;
+        if (m->win.first_us < 0) m->win.first_us = at;
+    }
+}
+
+void motion_track_advance(motion_track_t *m, int64_t now_us)
+{
+    if (m->pend && now_us - m->pend_us >= m->debounce_us) {
+        m->pend = false;
+        commit(m, m->pend_us);
+    }
+}
+
+void motion_track_edge(motion_track_t *m, int64_t t_us, bool level)
+{
+    motion_track_advance(m, t_us);
+    if (m->pend) {
+        if (level == m->level) {   // back before the debounce time: a glitch
+            m->pend = false;
+            m->win.glitches++;
+        }
+    } else if (level != m->level) {
+        m->pend = true;
+        m->pend_us = t_us;
+    }
+}
+
+int64_t motion_track_pending_us(const motion_track_t *m, int64_t now_us)
+{
+    if (!m->pend) return -1;
+    return max64(0, m->pend_us + m->debounce_us - now_us);
+}
+
+void motion_track_take(motion_track_t *m, int64_t now_us, motion_window_t *out)
+{
+    motion_track_advance(m, now_us);
+    if (m->level) {
+        m->win.occupied_us += now_us - max64(m->level_since, m->win_start);
+        m->win.last_us = now_us;
+    }
+    *out = m->win;
+    window_reset(m, now_us);
+}
@@ -0,0 +1,56 @@
+// main/motion_track.h — PIR edge debouncing and per-window occupancy
+//
+// Fed with raw, timestamped PIR edges (from the GPIO ISR via pir_ring.h). A
+// level change counts only once it has held for debounce_us; shorter pulses
+// are dropped as glitches. An accepted change is booked at the time of its
+// original edge, so occupancy is exact to the edge timestamps rather than to
+// a polling period. No IDF calls: the host replays edge traces through it
+// (host/motion_replay.c).
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MOTION_DEBOUNCE_US
+#define MOTION_DEBOUNCE_US  50000   // PIR outputs are clean but EMI spikes are not
+#endif
+
+typedef struct {
+    int64_t  occupied_us;     // time with motion high in the window
+    int64_t  first_us;        // first instant with motion high, -1 if none
+    int64_t  last_us;         // last instant with motion high, -1 if none
+    uint32_t edges;           // debounced rising edges
+    uint32_t glitches;        // pulses shorter than the debounce time
+    bool     motion;          // motion high at any time in the window
+} motion_window_t;
+
+typedef struct {
+    int64_t  debounce_us;
+    bool     level;           // debounced level
+    int64_t  level_since;     // when it took effect
+    bool     pend;            // a change is waiting out the debounce time
+    int64_t  pend_us;         // time of that raw edge
+    int64_t  win_start;
+    motion_window_t win;
+} motion_track_t;
+
+void motion_track_init(motion_track_t *m, int64_t now_us, bool level, int64_t debounce_us);
+
+// A raw edge: the pin read level at t_us. Edges must come in time order.
+void motion_track_edge(motion_track_t *m, int64_t t_us, bool level);
+
+// Accept a pending change once it has held until now_us.
+void motion_track_advance(motion_track_t *m, int64_t now_us);
+
+// µs until a pending change settles (then call advance), or -1 if none.
+int64_t motion_track_pending_us(const motion_track_t *m, int64_t now_us);
+
+// Close the window at now_us into *out and start the next one.
+void motion_track_take(motion_track_t *m, int64_t now_us, motion_window_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,249 @@
+// main/occupancy.c — see occupancy.h
+//
+// The trend is fitted to bucket means rather than to every window, so its
+// cost and memory stay the same whatever the publish period, and a window
+// whose temperature reading failed simply leaves its bucket thinner. After
+// the AC goes off, the room drifting back the other way is not a new AC run:
+// that direction is ignored until the trend has settled below half the
+// threshold.
+#include "occupancy.h"
+#include "sdkconfig.h"
+#include <math.h>
+#include <string.h>
+
+// Defaults for occupancy_init(o, NULL): Kconfig (App Config), else these.
+#ifndef OCCUPANCY_VACANCY_S
+#ifdef CONFIG_OCCUPANCY_VACANCY_MIN
+#define OCCUPANCY_VACANCY_S (CONFIG_OCCUPANCY_VACANCY_MIN * 60)
+#else
+#define OCCUPANCY_VACANCY_S 600       // 10 min
+#endif
+#endif
+#ifndef OCCUPANCY_LIGHTS_ON
+#ifdef CONFIG_OCCUPANCY_LIGHTS_ON_LUX
+#define OCCUPANCY_LIGHTS_ON (CONFIG_OCCUPANCY_LIGHTS_ON_LUX * 10)
+#else
+#define OCCUPANCY_LIGHTS_ON 2000      // lux x 10
+#endif
+#endif
+#ifndef OCCUPANCY_LIGHTS_OFF
+#ifdef CONFIG_OCCUPANCY_LIGHTS_OFF_LUX
+#define OCCUPANCY_LIGHTS_OFF (CONFIG_OCCUPANCY_LIGHTS_OFF_LUX * 10)
+#else
+#define OCCUPANCY_LIGHTS_OFF 1200     // lux x 10
+#endif
+#endif
+#ifndef OCCUPANCY_LIGHTS_HOLD_S
+#define OCCUPANCY_LIGHTS_HOLD_S 30
+#endif
+#ifndef OCCUPANCY_TREND_S
+#define OCCUPANCY_TREND_S 600         // 10 min
+#endif
+#ifndef OCCUPANCY_AC_SLOPE
+#ifdef CONFIG_OCCUPANCY_AC_SLOPE
+#define OCCUPANCY_AC_SLOPE CONFIG_OCCUPANCY_AC_SLOPE
+#else
+#define OCCUPANCY_AC_SLOPE 100        // centi-degrees C per hour
+#endif
+#endif
+#ifndef OCCUPANCY_AC_BAND
+#ifdef CONFIG_OCCUPANCY_AC_BAND
+#define OCCUPANCY_AC_BAND CONFIG_OCCUPANCY_AC_BAND
+#else
+#define OCCUPANCY_AC_BAND 40          // centi-degrees C
+#endif
+#endif
+#ifndef OCCUPANCY_HEARTBEAT_S
+#ifdef CONFIG_OCCUPANCY_HEARTBEAT_MIN
+#define OCCUPANCY_HEARTBEAT_S (CONFIG_OCCUPANCY_HEARTBEAT_MIN * 60)
+#else
+#define OCCUPANCY_HEARTBEAT_S 3600    // 1 h
+#endif
+#endif
+
+typedef struct {
+    uint8_t  bit;
+    bool     on;
+    uint32_t at_s;
+} change_t;
+
+void occupancy_init(occupancy_t *o, const occupancy_cfg_t *cfg)
+{
+    memset(o, 0, sizeof(*o));
+    if (cfg) {
+        o->cfg = *cfg;
+    } else {
+        o->cfg = (occupancy_cfg_t){
+            .vacancy_s     = OCCUPANCY_VACANCY_S,
+            .lights_on     = OCCUPANCY_LIGHTS_ON,
+            .lights_off    = OCCUPANCY_LIGHTS_OFF,
+            .lights_hold_s = OCCUPANCY_LIGHTS_HOLD_S,
+            .trend_s       = OCCUPANCY_TREND_S,
+            .ac_slope      = OCCUPANCY_AC_SLOPE,
+            .ac_band       = OCCUPANCY_AC_BAND,
+            .heartbeat_s   = OCCUPANCY_HEARTBEAT_S,
+        };
+    }
+}
+
+static inline uint32_t secs(int64_t us) { return us > 0 ? (uint32_t)(us / 1000000) : 0; }
+
+static uint32_t bucket_s(const occupancy_t *o)
+{
+    uint32_t b = o->cfg.trend_s / OCC_TREND_BUCKETS;
+    return b ? b : 1;
+}
+
+static void trend_add(occupancy_t *o, float temp, uint32_t now_s)
+{
+    uint32_t idx = now_s / bucket_s(o);
+    occupancy_bucket_t *b = &o->bucket[idx % OCC_TREND_BUCKETS];
+    if (b->idx != idx || b->n == 0) {
+        b->idx = idx;
+        b->sum = 0.0f;
+        b->n = 0;
+    }
+    b->sum += temp;
+    b->n++;
+}
+
+float occupancy_trend(const occupancy_t *o)
+{
+    uint32_t cur = o->prev_end_s / bucket_s(o);
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int n = 0;
+    uint32_t lo = UINT32_MAX, hi = 0;
+    for (int i = 0; i < OCC_TREND_BUCKETS; ++i) {
+        const occupancy_bucket_t *b = &o->bucket[i];
+        if (b->n == 0 || cur - b->idx >= OCC_TREND_BUCKETS) continue;
+        double x = -(double)(cur - b->idx), y = b->sum / b->n;
+        sx += x; sy += y; sxx += x * x; sxy += x * y;
+        n++;
+        if (b->idx < lo) lo = b->idx;
+        if (b->idx > hi) hi = b->idx;
+    }
+    if (n < OCC_TREND_BUCKETS / 2 || hi - lo < OCC_TREND_BUCKETS / 2) return NAN;
+    double d = n * sxx - sx * sx;
+    if (d <= 0) return NAN;
+    return (float)((n * sxy - sx * sy) / d * 3600.0 / bucket_s(o));   // per bucket → per hour
+}
+
+static void ac_update(occupancy_t *o, float temp, uint32_t now_s, change_t *ch, int *n)
+{
+    float slope = occupancy_trend(o);
+    float th = o->cfg.ac_slope / 100.0f, band = o->cfg.ac_band / 100.0f;
+    if (fabsf(slope) < th / 2) o->ac_block = 0;   // false for NAN
+
+    if (o->ac_dir == 0) {
+        int dir = slope >= th ? 1 : slope <= -th ? -1 : 0;
+        if (dir == 0 || dir == o->ac_block) return;
+        o->ac_dir = (int8_t)dir;
+        o->ac_held = temp;
+        uint32_t half = o->cfg.trend_s / 2;
+        ch[(*n)++] = (change_t){ OCC_AC, true, now_s > half ? now_s - half : 0 };
+    } else if (o->ac_dir > 0 ? temp > o->ac_held : temp < o->ac_held) {
+        o->ac_held = temp;
+    } else if (o->ac_dir > 0 ? temp <= o->ac_held - band : temp >= o->ac_held + band) {
+        o->ac_block = (int8_t)-o->ac_dir;
+        o->ac_dir = 0;
+        ch[(*n)++] = (change_t){ OCC_AC, false, now_s };
+    }
+}
+
+int occupancy_update(occupancy_t *o, const sensors_window_t *w,
+                     occupancy_event_t ev[OCC_MAX_EVENTS])
+{
+    uint32_t now = secs(w->end_us);
+    uint32_t start = o->started ? o->prev_end_s : now;   // this window's
+    uint32_t lux = (uint32_t)lroundf(w->lux_mean * 10.0f);
+    o->prev_end_s = now;
+    if (w->temp_n > 0) trend_add(o, w->temp_mean, now);
+
+    if (!o->started) {
+        o->started = true;
+        o->state = (w->motion ? OCC_OCCUPIED : 0) |
+                   (w->lux_n > 0 && lux >= o->cfg.lights_on ? OCC_LIGHTS : 0);
+        o->motion_s = w->motion_last_us >= 0 ? secs(w->motion_last_us) : now;
+        o->since_s = o->sent_s = now;
+        ev[0] = (occupancy_event_t){ .state = o->state, .prev = OCC_UNKNOWN };
+        o->stats.events++;
+        return 1;
+    }
+
+    change_t ch[OCC_MAX_EVENTS];
+    int n = 0;
+
+    if (w->motion) {
+        o->motion_s = w->motion_last_us >= 0 ? secs(w->motion_last_us) : now;
+        if (!(o->state & OCC_OCCUPIED)) {
+            uint32_t first = w->motion_first_us >= 0 ? secs(w->motion_first_us) : now;
+            ch[n++] = (change_t){ OCC_OCCUPIED, true, first };
+        }
+    } else if ((o->state & OCC_OCCUPIED) && now - o->motion_s >= o->cfg.vacancy_s) {
+        ch[n++] = (change_t){ OCC_OCCUPIED, false, o->motion_s };
+    }
+
+    if (w->lux_n > 0) {
+        bool on = o->state & OCC_LIGHTS;
+        if (on ? lux < o->cfg.lights_off : lux >= o->cfg.lights_on) {
+            if (!o->lux_cand) {
+                o->lux_cand = true;
+                o->lux_cand_s = start;
+            }
+            if (now - o->lux_cand_s >= o->cfg.lights_hold_s) {
+                ch[n++] = (change_t){ OCC_LIGHTS, !on, o->lux_cand_s };
+                o->lux_cand = false;
+            }
+        } else {
+            o->lux_cand = false;
+        }
+    }
+
+    if (w->temp_n > 0) ac_update(o, w->temp_mean, now, ch, &n);
+
+    // Oldest first. Evidence can date a change before the last one reported;
+    // such a change is moved up to it, so the timeline never runs backwards.
+    for (int i = 1; i < n; ++i) {
+        for (int k = i; k > 0 && ch[k].at_s < ch[k - 1].at_s; --k) {
+            change_t t = ch[k]; ch[k] = ch[k - 1]; ch[k - 1] = t;
+        }
+    }
+    int k = 0;
+    for (int i = 0; i < n; ++i) {
+        uint32_t at = ch[i].at_s < o->since_s ? o->since_s : ch[i].at_s > now ? now : ch[i].at_s;
+        uint8_t next = ch[i].on ? (uint8_t)(o->state | ch[i].bit)
+                                : (uint8_t)(o->state & ~ch[i].bit);
+        if (k > 0 && at == o->since_s) {
+            ev[k - 1].state = next;   // same instant as the previous one: merge
+            if (next == ev[k - 1].prev) --k;
+        } else {
+            ev[k++] = (occupancy_event_t){
+                .state = next, .prev = o->state, .before_s = now - at, .prev_s = at - o->since_s,
+            };
+        }
+        o->state = next;
+        o->since_s = at;
+    }
+
+    if (k > 0) {
+        o->sent_s = now;
+        o->stats.events += (uint32_t)k;
+    } else if (o->cfg.heartbeat_s > 0 && now - o->sent_s >= o->cfg.heartbeat_s) {
+        ev[k++] = (occupancy_event_t){
+            .state = o->state, .prev = o->state, .before_s = 0, .prev_s = now - o->since_s,
+        };
+        o->sent_s = now;
+        o->stats.heartbeats++;
+    }
+    return k;
+}
+
+void occupancy_pack(sample_t *e, const sample_t *s, const occupancy_event_t *ev)
+{
+    memset(e, 0, sizeof(*e));
+    e->t         = s->t > ev->before_s ? s->t - ev->before_s : 0;
+    e->flags     = SAMPLE_F_EVENT | (s->flags & SAMPLE_F_UNSYNCED);
+    e->ev_state  = ev->state;
+    e->ev_prev   = ev->prev;
+    e->ev_prev_s = ev->prev_s;
+}
@@ -0,0 +1,118 @@
+// main/occupancy.h — room state (occupied, lights, AC) from the publish windows
+//
+// What the dashboard shows is room state, not the 10 s series. Fed one
+// publish window at a time, occupancy_update() runs three detectors, each
+// with its own hysteresis, and reports every change of the combined state:
+//  - occupied: motion in a window; empty after vacancy_s without motion.
+//  - lights:   mean lux at or above lights_on, off below lights_off, either
+//              held for lights_hold_s.
+//  - ac:       the temperature trend (least squares over trend_s) reaches
+//              ac_slope, warming or cooling. It stays on while the room
+//              holds, and goes off once the temperature has drifted ac_band
+//              back from the warmest (or coolest) point it reached.
+// A transition is dated where its evidence starts, not where the hysteresis
+// ends: the last motion for "empty", the first window past a lux threshold
+// for the lights, half the trend span back for the AC coming on. Each event
+// says how long the previous state lasted, so a server keeps a timeline from
+// events alone. Pure logic on the windows' own clock (end_us), so
+// host/report_bench replays labelled traces through it.
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensors.h"   // sensors_window_t
+#include "sample.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OCC_OCCUPIED 0x01u
+#define OCC_LIGHTS   0x02u
+#define OCC_AC       0x04u
+#define OCC_UNKNOWN  0xFFu   // prev of the first event after boot
+
+#define OCC_MAX_EVENTS 3     // per occupancy_update(): one per detector
+
+#ifndef OCC_TREND_BUCKETS
+#define OCC_TREND_BUCKETS 20   // the trend is fitted to trend_s / 20 means
+#endif
+
+typedef struct {
+    uint32_t vacancy_s;      // no motion this long: empty
+    uint32_t lights_on;      // lux x 10, window mean: on at or above...
+    uint32_t lights_off;     // ...off below this
+    uint16_t lights_hold_s;
+    uint16_t trend_s;        // temperature trend over this span
+    uint16_t ac_slope;       // centi-degrees C per hour, either sign
+    uint16_t ac_band;        // centi-degrees C
+    uint32_t heartbeat_s;    // resend an unchanged state this often; 0 = never
+} occupancy_cfg_t;
+
+typedef struct {
+    uint8_t  state;          // OCC_* from the event on
+    uint8_t  prev;           // before it; == state for a heartbeat
+    uint32_t before_s;       // event time, seconds before the window end
+    uint32_t prev_s;         // how long prev lasted (heartbeat: so far)
+} occupancy_event_t;
+
+typedef struct {             // one trend_s / OCC_TREND_BUCKETS slice
+    uint32_t idx;            // window clock / slice length
+    float    sum;            // of the window mean temperatures in it
+    uint16_t n;
+} occupancy_bucket_t;
+
+typedef struct {
+    uint32_t events;         // transitions reported
+    uint32_t heartbeats;
+} occupancy_stats_t;
+
+typedef struct {
+    occupancy_cfg_t cfg;
+    bool     started;
+    uint8_t  state;
+    uint32_t since_s;        // time of the last transition
+    uint32_t sent_s;         // time of the last event or heartbeat
+    uint32_t prev_end_s;     // previous window end
+    // occupied
+    uint32_t motion_s;       // last motion seen
+    // lights
+    bool     lux_cand;       // lux past the threshold for the other state...
+    uint32_t lux_cand_s;     // ...since this window start
+    // ac
+    occupancy_bucket_t bucket[OCC_TREND_BUCKETS];   // ring, by idx
+    int8_t   ac_dir;         // +1 heating, -1 cooling, 0 off
+    int8_t   ac_block;       // direction ignored until the trend settles
+    float    ac_held;        // warmest (heating) or coolest point since on
+    occupancy_stats_t stats;
+} occupancy_t;
+
+// cfg may be NULL for the defaults (CONFIG_OCCUPANCY_* or occupancy.c's).
+void occupancy_init(occupancy_t *o, const occupancy_cfg_t *cfg);
+
+// Feed the next window. Fills ev[] with the changes it brought, oldest first,
+// or a heartbeat, and returns how many (0..OCC_MAX_EVENTS). The first window
+// after init reports the initial state (prev OCC_UNKNOWN); the AC bit needs
+// trend_s of windows before it can come on.
+int  occupancy_update(occupancy_t *o, const sensors_window_t *w,
+                      occupancy_event_t ev[OCC_MAX_EVENTS]);
+
+// Temperature trend in degrees C per hour, NAN until there is enough data.
+float occupancy_trend(const occupancy_t *o);
+
+// The event as a SAMPLE_F_EVENT record; s is the sample packed from the
+// window that produced it (its t and clock flag are used).
+void occupancy_pack(sample_t *e, const sample_t *s, const occupancy_event_t *ev);
+
+// "empty", "occupied+lights", "empty+lights+ac", ...
+static inline const char *occupancy_state_name(uint8_t state)
+{
+    static const char *const k_names[8] = {
+        "empty", "occupied", "empty+lights", "occupied+lights",
+        "empty+ac", "occupied+ac", "empty+lights+ac", "occupied+lights+ac",
+    };
+    return state < 8 ? k_names[state] : "unknown";
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,194 @@
+// main/payload_cbor.c — columnar CBOR batch encoder (see payload_cbor.h)
+//
+// The same encode pass either counts bytes (sink == NULL) or streams them
+// through a small fixed buffer, so sizing and sending need no heap.
+#include "payload_cbor.h"
+#include "occupancy.h"   // OCC_UNKNOWN
+#include <stdbool.h>
+#include <string.h>
+
+#ifndef PAYLOAD_CBOR_CHUNK
+#define PAYLOAD_CBOR_CHUNK 256
+#endif
+
+enum {
+    CBOR_UINT  = 0,
+    CBOR_NINT  = 1,
+    CBOR_BYTES = 2,
+    CBOR_TEXT  = 3,
+    CBOR_ARRAY = 4,
+    CBOR_MAP   = 5,
+};
+
+typedef struct {
+    uint8_t        buf[PAYLOAD_CBOR_CHUNK];
+    size_t         used;
+    size_t         total;
+    payload_sink_t sink;     // NULL: count only
+    void          *ctx;
+    esp_err_t      err;
+} cbor_out_t;
+
+static void out_bytes(cbor_out_t *o, const void *data, size_t len)
+{
+    o->total += len;
+    if (!o->sink || o->err != ESP_OK) return;
+
+    const uint8_t *p = data;
+    while (len > 0) {
+        size_t n = sizeof(o->buf) - o->used;
+        if (n > len) n = len;
+        memcpy(o->buf + o->used, p, n);
+        o->used += n; p += n; len -= n;
+        if (o->used == sizeof(o->buf)) {
+            o->err = o->sink(o->ctx, (const char *)o->buf, o->used);
+            o->used = 0;
+            if (o->err != ESP_OK) return;
+        }
+    }
+}
+
+static void out_head(cbor_out_t *o, uint8_t major, uint64_t v)
+{
+    uint8_t h[9];
+    size_t n;
+    if (v < 24) {
+        h[0] = (uint8_t)(major << 5 | v); n = 1;
+    } else if (v <= 0xFF) {
+        h[0] = (uint8_t)(major << 5 | 24); h[1] = (uint8_t)v; n = 2;
+    } else if (v <= 0xFFFF) {
+        h[0] = (uint8_t)(major << 5 | 25);
+        h[1] = (uint8_t)(v >> 8); h[2] = (uint8_t)v; n = 3;
+    } else if (v <= 0xFFFFFFFFu) {
+        h[0] = (uint8_t)(major << 5 | 26);
+        for (int i = 0; i < 4; ++i) h[1 + i] = (uint8_t)(v >> (24 - 8 * i));
+        n = 5;
+    } else {
+        h[0] = (uint8_t)(major << 5 | 27);
+        for (int i = 0; i < 8; ++i) h[1 + i] = (uint8_t)(v >> (56 - 8 * i));
+        n = 9;
+    }
+    out_bytes(o, h, n);
+}
+
+static void out_int(cbor_out_t *o, int64_t v)
+{
+    if (v >= 0) out_head(o, CBOR_UINT, (uint64_t)v);
+    else        out_head(o, CBOR_NINT, (uint64_t)(-1 - v));
+}
+
+static void out_text(cbor_out_t *o, const char *s)
+{
+    size_t len = strlen(s);
+    out_head(o, CBOR_TEXT, len);
+    out_bytes(o, s, len);
+}
+
+static const sample_t k_no_window;   // what event rows read in the window columns
+
+// One integer column: key followed by an array of scaled per-sample values.
+#define OUT_COLUMN(o, key, n, expr)                                        \
+    do {                                                                   \
+        out_text((o), (key));                                              \
+        out_head((o), CBOR_ARRAY, (uint64_t)(n));                          \
+        for (int i = 0; i < (n); ++i) {                                    \
+            const sample_t *s = &samples[i];                               \
+            if (s->flags & SAMPLE_F_EVENT) s = &k_no_window;               \
+            out_int((o), (expr));                                          \
+        }                                                                  \
+    } while (0)
+
+// An event column: the value for event rows, -1 for window rows.
+#define OUT_EVENT_COLUMN(o, key, n, expr)                                  \
+    do {                                                                   \
+        out_text((o), (key));                                              \
+        out_head((o), CBOR_ARRAY, (uint64_t)(n));                          \
+        for (int i = 0; i < (n); ++i) {                                    \
+            const sample_t *s = &samples[i];                               \
+            bool ev = s->flags & SAMPLE_F_EVENT;                           \
+            out_int((o), ev ? (int64_t)(expr) : -1);                       \
+        }                                                                  \
+    } while (0)
+
+static void encode(cbor_out_t *o, const device_id_t *id, const sample_t *samples, int n)
+{
+    int64_t t0 = n > 0 ? samples[0].t : 0;
+    int events = 0;
+    for (int i = 0; i < n; ++i) events += (samples[i].flags & SAMPLE_F_EVENT) != 0;
+    bool windows = events < n || n == 0;
+
+    out_head(o, CBOR_MAP, 5 + (windows ? 16 : 0) + (events ? 3 : 0));
+
+    out_text(o, "v");  out_int(o, PAYLOAD_CBOR_VERSION);
+    out_text(o, "b");  out_text(o, id->building);
+    out_text(o, "n");  out_text(o, id->number);
+    out_text(o, "t0"); out_int(o, t0);
+
+    out_text(o, "dt");
+    out_head(o, CBOR_ARRAY, (uint64_t)n);
+    int64_t prev = t0;
+    for (int i = 0; i < n; ++i) {
+        int64_t t = samples[i].t;
+        out_int(o, t - prev);   // negative if the clock stepped back
+        prev = t;
+    }
+
+    if (events) {
+        OUT_EVENT_COLUMN(o, "e",  n, s->ev_state);
+        OUT_EVENT_COLUMN(o, "ep", n, s->ev_prev == OCC_UNKNOWN ? -1 : s->ev_prev);
+        OUT_EVENT_COLUMN(o, "ed", n, s->ev_prev_s);
+    }
+    if (!windows) return;
+
+    OUT_COLUMN(o, "t",  n, s->temp);
+    OUT_COLUMN(o, "l",  n, s->lux);
+
+    out_text(o, "m");
+    out_head(o, CBOR_BYTES, (uint64_t)(n + 7) / 8);
+    for (int i = 0; i < n; i += 8) {
+        uint8_t bits = 0;
+        for (int k = 0; k < 8 && i + k < n; ++k) {
+            if (samples[i + k].flags & SAMPLE_F_MOTION) bits |= (uint8_t)(1u << k);
+        }
+        out_bytes(o, &bits, 1);
+    }
+
+    OUT_COLUMN(o, "tn", n, s->temp_min);
+    OUT_COLUMN(o, "tx", n, s->temp_max);
+    OUT_COLUMN(o, "tv", n, s->temp_var);
+    OUT_COLUMN(o, "ln", n, s->lux_min);
+    OUT_COLUMN(o, "lx", n, s->lux_max);
+    OUT_COLUMN(o, "lv", n, s->lux_var);
+    OUT_COLUMN(o, "md", n, s->motion_duty);
+    OUT_COLUMN(o, "me", n, s->motion_edges);
+    OUT_COLUMN(o, "ms", n, s->motion_ds);
+    OUT_COLUMN(o, "mf", n, s->motion_first == SAMPLE_MOTION_NONE ? -1 : s->motion_first);
+    OUT_COLUMN(o, "ml", n, s->motion_last == SAMPLE_MOTION_NONE ? -1 : s->motion_last);
+    OUT_COLUMN(o, "mg", n, s->motion_glitches);
+    OUT_COLUMN(o, "u",  n, s->unchanged_since ? (int64_t)s->t - s->unchanged_since : 0);
+}
+
+size_t payload_cbor_size(const device_id_t *id, const sample_t *samples, int n)
+{
+    cbor_out_t o = { .sink = NULL };
+    encode(&o, id, samples, n);
+    return o.total;
+}
+
+esp_err_t payload_cbor_write(const device_id_t *id, const sample_t *samples, int n,
+                             payload_sink_t sink, void *ctx)
+{
+    if (!sink || !id || (n > 0 && !samples)) return ESP_ERR_INVALID_ARG;
+
+    static cbor_out_t o;   // 256 B chunk; sender task only
+    memset(&o, 0, sizeof(o));
+    o.sink = sink;
+    o.ctx  = ctx;
+    o.err  = ESP_OK;
+
+    encode(&o, id, samples, n);
+    if (o.err == ESP_OK && o.used > 0) {
+        o.err = sink(ctx, (const char *)o.buf, o.used);
+    }
+    return o.err;
+}
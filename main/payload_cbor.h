@@ -0,0 +1,55 @@
+// main/payload_cbor.h — compact binary (CBOR) encoding of an upload batch
+#pragma once
+#include <stddef.h>
+#include "esp_err.h"
+#include "uploader.h"       // sample_t
+#include "payload_json.h"   // payload_sink_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Batch layout, one CBOR map (Content-Type: application/cbor):
+//   "v"  : 5                      format version
+//   "b"  : text                   building
+//   "n"  : text                   room number
+//   "t0" : uint                   local wall-clock seconds since 1970 of sample 0
+//   "dt" : [uint...]              seconds since the previous sample (first = 0)
+//   "t"  : [int...]               temperature, centi-degrees C
+//   "l"  : [uint...]              lux x 10
+//   "m"  : bytes                  motion bitset, bit i = sample i, LSB first
+//   "tn", "tx" : [int...]         window min/max temperature, centi-degrees C
+//   "tv" : [uint...]              window temperature variance, (centi-degrees C)^2
+//   "ln", "lx" : [uint...]        window min/max lux x 10
+//   "lv" : [uint...]              window lux variance, (lux x 10)^2
+//   "md" : [uint...]              motion duty cycle, per mille
+//   "me" : [uint...]              rising motion edges in the window
+//   "ms" : [uint...]              occupied time in the window, deciseconds
+//   "mf", "ml" : [int...]         first/last motion, deciseconds before the
+//                                 sample time; -1 if no motion
+//   "mg" : [uint...]              PIR pulses rejected by the debounce
+//   "u"  : [int...]               unchanged since this many seconds before the
+//                                 sample time (held samples); 0 = none held
+// Only in batches that hold room state events (SAMPLE_F_EVENT), -1 in the
+// rows of ordinary samples:
+//   "e"  : [int...]               room state from the row's time on (OCC_* bits)
+//   "ep" : [int...]               the state before; -1 = none (first after boot)
+//   "ed" : [int...]               how long the state before lasted, seconds
+// Event rows read 0 in the window columns, and a batch of events only has
+// none of them (t..u, m). "t" and "l" are the window means. Version 1 had no
+// window columns, version 2 no occupancy columns (ms..mg), version 3 no "u",
+// version 4 no events.
+// "Local wall-clock seconds" means the local date/time fields read as if they
+// were UTC, so gmtime() on the decoder side gives back the JSON date/time.
+// The columns are sample_t's own fields, so encoding is a plain copy.
+// tools/cbor_decode.c is the reference decoder.
+
+#define PAYLOAD_CBOR_VERSION 5
+
+size_t    payload_cbor_size(const device_id_t *id, const sample_t *samples, int n);
+esp_err_t payload_cbor_write(const device_id_t *id, const sample_t *samples, int n,
+                             payload_sink_t sink, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
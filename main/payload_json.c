@@ -0,0 +1,272 @@
+// main/payload_json.c — streams a batch as JSON without building a cJSON tree
+//
+// The server has always received cJSON_PrintUnformatted() output, so numbers
+// and strings follow cJSON's rules exactly (see put_number/put_string).
+// Values come from the packed fixed-point record, so they print at its
+// resolution (24.6, not 24.600000381469727).
+#include "payload_json.h"
+#include "occupancy.h"   // state names
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef PAYLOAD_JSON_CHUNK
+#define PAYLOAD_JSON_CHUNK 1024
+#endif
+
+// Worst case for one object: 580 B with both 15-char identity strings fully
+// \u-escaped, every number at its longest and unchanged_since (host/json_check).
+#define ELEM_MAX 768
+
+static char s_chunk[PAYLOAD_JSON_CHUNK];
+static char s_elem[ELEM_MAX];   // one encoded element, kept off the sender's stack
+
+typedef struct {
+    char  *p;
+    char  *end;
+} out_t;
+
+static inline void put_char(out_t *o, char c)
+{
+    if (o->p < o->end) *o->p = c;
+    o->p++;
+}
+
+static inline void put_raw(out_t *o, const char *s, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) put_char(o, s[i]);
+}
+
+#define PUT_LIT(o, lit) put_raw((o), (lit), sizeof(lit) - 1)
+
+// Zero-padded decimal, at least `width` digits (what strftime's %Y/%m/%d do).
+static void put_uint(out_t *o, unsigned v, int width)
+{
+    char tmp[12];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n < width) tmp[n++] = '0';
+    while (n) put_char(o, tmp[--n]);
+}
+
+// Same as cJSON print_number(): integers as %d, otherwise the shortest of
+// %1.15g / %1.17g that round-trips.
+static void put_number(out_t *o, double d)
+{
+    char buf[32];
+    int len;
+
+    int vi = (d >= INT_MAX) ? INT_MAX : (d <= (double)INT_MIN) ? INT_MIN : (int)d;
+
+    if (isnan(d) || isinf(d)) {
+        len = snprintf(buf, sizeof(buf), "null");
+    } else if (d == (double)vi) {
+        len = snprintf(buf, sizeof(buf), "%d", vi);
+    } else {
+        len = snprintf(buf, sizeof(buf), "%1.15g", d);
+        double test = strtod(buf, NULL);
+        double max = fabs(test) > fabs(d) ? fabs(test) : fabs(d);
+        if (!(fabs(test - d) <= max * DBL_EPSILON)) {
+            len = snprintf(buf, sizeof(buf), "%1.17g", d);
+        }
+    }
+    put_raw(o, buf, (size_t)len);
+}
+
+// Same escaping as cJSON print_string_ptr().
+static void put_string(out_t *o, const char *s)
+{
+    static const char hex[] = "0123456789abcdef";
+    put_char(o, '"');
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        switch (c) {
+            case '"':  PUT_LIT(o, "\\\""); break;
+            case '\\': PUT_LIT(o, "\\\\"); break;
+            case '\b': PUT_LIT(o, "\\b");  break;
+            case '\f': PUT_LIT(o, "\\f");  break;
+            case '\n': PUT_LIT(o, "\\n");  break;
+            case '\r': PUT_LIT(o, "\\r");  break;
+            case '\t': PUT_LIT(o, "\\t");  break;
+            default:
+                if (c < 32) {
+                    PUT_LIT(o, "\\u00");
+                    put_char(o, hex[c >> 4]);
+                    put_char(o, hex[c & 0xF]);
+                } else {
+                    put_char(o, (char)c);
+                }
+        }
+    }
+    put_char(o, '"');
+}
+
+static void put_date(out_t *o, const struct tm *tm)
+{
+    put_uint(o, (unsigned)(tm->tm_year + 1900), 4);
+    put_char(o, '-');
+    put_uint(o, (unsigned)(tm->tm_mon + 1), 2);
+    put_char(o, '-');
+    put_uint(o, (unsigned)tm->tm_mday, 2);
+}
+
+static void put_time(out_t *o, const struct tm *tm)
+{
+    put_uint(o, (unsigned)tm->tm_hour, 2);
+    put_char(o, ':');
+    put_uint(o, (unsigned)tm->tm_min, 2);
+    put_char(o, ':');
+    put_uint(o, (unsigned)tm->tm_sec, 2);
+}
+
+// "YYYY-MM-DD HH:MM:SS" of a sample_t wall-clock time.
+static void put_wall(out_t *o, uint32_t t)
+{
+    struct tm tm;
+    sample_wall_split(t, &tm);
+    put_date(o, &tm);
+    put_char(o, ' ');
+    put_time(o, &tm);
+}
+
+// Seconds before the sample time, or null when there was no motion.
+static void put_before(out_t *o, uint16_t ds)
+{
+    if (ds == SAMPLE_MOTION_NONE) PUT_LIT(o, "null");
+    else put_number(o, ds / 10.0);
+}
+
+// The window fields of an ordinary sample.
+static void encode_window(out_t *o, const sample_t *s)
+{
+    PUT_LIT(o, ",\"temp\":");
+    put_number(o, s->temp / 100.0);
+    PUT_LIT(o, ",\"lux\":");
+    put_number(o, s->lux / 10.0);
+    PUT_LIT(o, ",\"motion\":");
+    if (s->flags & SAMPLE_F_MOTION) PUT_LIT(o, "true"); else PUT_LIT(o, "false");
+    PUT_LIT(o, ",\"temp_min\":");
+    put_number(o, s->temp_min / 100.0);
+    PUT_LIT(o, ",\"temp_max\":");
+    put_number(o, s->temp_max / 100.0);
+    PUT_LIT(o, ",\"temp_var\":");
+    put_number(o, s->temp_var / 10000.0);
+    PUT_LIT(o, ",\"lux_min\":");
+    put_number(o, s->lux_min / 10.0);
+    PUT_LIT(o, ",\"lux_max\":");
+    put_number(o, s->lux_max / 10.0);
+    PUT_LIT(o, ",\"lux_var\":");
+    put_number(o, s->lux_var / 100.0);
+    PUT_LIT(o, ",\"motion_duty\":");
+    put_number(o, s->motion_duty / 1000.0);
+    PUT_LIT(o, ",\"motion_edges\":");
+    put_number(o, s->motion_edges);
+    PUT_LIT(o, ",\"motion_s\":");
+    put_number(o, s->motion_ds / 10.0);
+    PUT_LIT(o, ",\"motion_first\":");
+    put_before(o, s->motion_first);
+    PUT_LIT(o, ",\"motion_last\":");
+    put_before(o, s->motion_last);
+    PUT_LIT(o, ",\"motion_glitches\":");
+    put_number(o, s->motion_glitches);
+    if (s->unchanged_since) {
+        PUT_LIT(o, ",\"unchanged_since\":\"");
+        put_wall(o, s->unchanged_since);
+        put_char(o, '"');
+    }
+}
+
+// A SAMPLE_F_EVENT record: the room state from date/time on, and the one before.
+static void encode_event(out_t *o, const sample_t *s)
+{
+    PUT_LIT(o, ",\"state\":");
+    put_string(o, occupancy_state_name(s->ev_state));
+    PUT_LIT(o, ",\"prev\":");
+    if (s->ev_prev == OCC_UNKNOWN) PUT_LIT(o, "null");
+    else put_string(o, occupancy_state_name(s->ev_prev));
+    PUT_LIT(o, ",\"prev_s\":");
+    put_number(o, s->ev_prev_s);
+}
+
+// One array element; returns its length (may exceed cap, nothing is written past it).
+static size_t encode_sample(char *buf, size_t cap, const device_id_t *id, const sample_t *s)
+{
+    out_t o = { buf, buf + cap };
+    struct tm tm;
+    sample_wall_split(s->t, &tm);
+
+    PUT_LIT(&o, "{\"date\":\"");
+    put_date(&o, &tm);
+    PUT_LIT(&o, "\",\"time\":\"");
+    put_time(&o, &tm);
+    put_char(&o, '"');
+    if (s->flags & SAMPLE_F_EVENT) encode_event(&o, s);
+    else encode_window(&o, s);
+    PUT_LIT(&o, ",\"building\":");
+    put_string(&o, id->building);
+    PUT_LIT(&o, ",\"number\":");
+    put_string(&o, id->number);
+    put_char(&o, '}');
+
+    return (size_t)(o.p - buf);
+}
+
+size_t payload_json_size(const device_id_t *id, const sample_t *samples, int n)
+{
+    size_t total = 2;                       // [ ]
+    if (n > 1) total += (size_t)(n - 1);    // commas
+    for (int i = 0; i < n; ++i) {
+        total += encode_sample(s_elem, sizeof(s_elem), id, &samples[i]);
+    }
+    return total;
+}
+
+typedef struct {
+    payload_sink_t sink;
+    void          *ctx;
+    size_t         used;   // bytes waiting in s_chunk
+} stream_t;
+
+// Appends to the chunk; each full chunk goes to the sink, so every write but
+// the last is exactly PAYLOAD_JSON_CHUNK bytes, whatever the element sizes.
+static esp_err_t stream_put(stream_t *st, const char *data, size_t len)
+{
+    while (len > 0) {
+        size_t n = sizeof(s_chunk) - st->used;
+        if (n > len) n = len;
+        memcpy(s_chunk + st->used, data, n);
+        st->used += n;
+        data += n;
+        len -= n;
+        if (st->used == sizeof(s_chunk)) {
+            esp_err_t err = st->sink(st->ctx, s_chunk, st->used);
+            if (err != ESP_OK) return err;
+            st->used = 0;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t payload_json_write(const device_id_t *id, const sample_t *samples, int n,
+                             payload_sink_t sink, void *ctx)
+{
+    if (!sink || !id || (n > 0 && !samples)) return ESP_ERR_INVALID_ARG;
+
+    stream_t st = { sink, ctx, 0 };
+    esp_err_t err = stream_put(&st, "[", 1);
+    for (int i = 0; i < n && err == ESP_OK; ++i) {
+        if (i > 0 && (err = stream_put(&st, ",", 1)) != ESP_OK) break;
+        size_t len = encode_sample(s_elem, sizeof(s_elem), id, &samples[i]);
+        if (len > sizeof(s_elem)) return ESP_ERR_INVALID_SIZE;
+        err = stream_put(&st, s_elem, len);
+    }
+    if (err == ESP_OK) err = stream_put(&st, "]", 1);
+    if (err != ESP_OK || st.used == 0) return err;
+    return sink(ctx, s_chunk, st.used);
+}
@@ -0,0 +1,28 @@
+// main/payload_json.h — heap-free JSON encoder for upload batches
+#pragma once
+#include <stddef.h>
+#include "esp_err.h"
+#include "uploader.h"   // sample_t
+#include "device_id.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Receives consecutive pieces of the encoded payload.
+typedef esp_err_t (*payload_sink_t)(void *ctx, const char *data, size_t len);
+
+// Exact byte length of the JSON array for samples[0..n). Every object
+// repeats the batch identity id.
+size_t    payload_json_size(const device_id_t *id, const sample_t *samples, int n);
+
+// Encode samples[0..n) as a JSON array, handing it to sink in pieces of
+// PAYLOAD_JSON_CHUNK bytes (the last one shorter). Output is byte-identical
+// to cJSON_PrintUnformatted() on the equivalent cJSON tree; host/json_check
+// compares the two. No heap is used.
+esp_err_t payload_json_write(const device_id_t *id, const sample_t *samples, int n,
+                             payload_sink_t sink, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
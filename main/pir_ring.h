@@ -0,0 +1,63 @@
+// main/pir_ring.h — lock-free queue of timestamped PIR edges, ISR → task
+//
+// Same single-producer/single-consumer scheme as sample_ring.c, but inline so
+// the GPIO ISR's push compiles into IRAM with the handler and never calls
+// into flash.
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Must be a power of two. A PIR toggles a few times per second at most; 32
+// edges cover any realistic consumer delay plus a burst of EMI glitches.
+#ifndef PIR_RING_CAPACITY
+#define PIR_RING_CAPACITY 32
+#endif
+
+typedef struct {
+    int64_t t_us;     // esp_timer_get_time() in the ISR
+    bool    level;    // pin level read in the ISR
+} pir_edge_t;
+
+typedef struct {
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    pir_edge_t       slots[PIR_RING_CAPACITY];
+} pir_ring_t;
+
+_Static_assert((PIR_RING_CAPACITY & (PIR_RING_CAPACITY - 1u)) == 0,
+               "PIR_RING_CAPACITY must be a power of two");
+
+// Producer (ISR). Returns false, dropping the edge, if the ring is full.
+static inline bool pir_ring_push(pir_ring_t *r, int64_t t_us, bool level)
+{
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (head - tail >= PIR_RING_CAPACITY) return false;
+
+    pir_edge_t *e = &r->slots[head & (PIR_RING_CAPACITY - 1u)];
+    e->t_us = t_us;
+    e->level = level;
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    return true;
+}
+
+// Consumer (task). Returns false if the ring is empty.
+static inline bool pir_ring_pop(pir_ring_t *r, pir_edge_t *out)
+{
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (head == tail) return false;
+
+    *out = r->slots[tail & (PIR_RING_CAPACITY - 1u)];
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
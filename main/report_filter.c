@@ -0,0 +1,94 @@
+// main/report_filter.c — see report_filter.h
+//
+// Deadbands are measured against the last reported sample, not the previous
+// window, so a slow drift is reported once it adds up. Temperature and lux are
+// checked over the window's min..max, so a short excursion inside a window is
+// not hidden behind an unchanged mean.
+#include "report_filter.h"
+#include "sdkconfig.h"
+#include <string.h>
+
+// Defaults for report_filter_init(f, NULL): Kconfig (App Config), else these.
+#ifndef REPORT_TEMP_DEADBAND
+#ifdef CONFIG_REPORT_TEMP_DEADBAND
+#define REPORT_TEMP_DEADBAND CONFIG_REPORT_TEMP_DEADBAND
+#else
+#define REPORT_TEMP_DEADBAND 20       // centi-degrees C
+#endif
+#endif
+#ifndef REPORT_LUX_DEADBAND
+#ifdef CONFIG_REPORT_LUX_DEADBAND
+#define REPORT_LUX_DEADBAND (CONFIG_REPORT_LUX_DEADBAND * 10)
+#else
+#define REPORT_LUX_DEADBAND 100       // lux x 10
+#endif
+#endif
+#ifndef REPORT_LUX_DEADBAND_PCT
+#ifdef CONFIG_REPORT_LUX_DEADBAND_PCT
+#define REPORT_LUX_DEADBAND_PCT CONFIG_REPORT_LUX_DEADBAND_PCT
+#else
+#define REPORT_LUX_DEADBAND_PCT 10
+#endif
+#endif
+#ifndef REPORT_HEARTBEAT_S
+#ifdef CONFIG_REPORT_HEARTBEAT_MIN
+#define REPORT_HEARTBEAT_S (CONFIG_REPORT_HEARTBEAT_MIN * 60)
+#else
+#define REPORT_HEARTBEAT_S 900        // 15 min
+#endif
+#endif
+#ifndef REPORT_MOTION_DEADBAND
+#define REPORT_MOTION_DEADBAND 20     // deciseconds of occupied time
+#endif
+
+void report_filter_init(report_filter_t *f, const report_filter_cfg_t *cfg)
+{
+    memset(f, 0, sizeof(*f));
+    if (cfg) {
+        f->cfg = *cfg;
+    } else {
+        f->cfg = (report_filter_cfg_t){
+            .temp_db     = REPORT_TEMP_DEADBAND,
+            .lux_db      = REPORT_LUX_DEADBAND,
+            .lux_db_pct  = REPORT_LUX_DEADBAND_PCT,
+            .motion_db   = REPORT_MOTION_DEADBAND,
+            .heartbeat_s = REPORT_HEARTBEAT_S,
+        };
+    }
+}
+
+static inline uint32_t udiff(int64_t a, int64_t b) { return (uint32_t)(a > b ? a - b : b - a); }
+
+static bool changed(const report_filter_cfg_t *c, const sample_t *ref, const sample_t *s)
+{
+    if ((s->flags ^ ref->flags) & SAMPLE_F_MOTION) return true;
+    if (udiff(s->motion_ds, ref->motion_ds) > c->motion_db) return true;
+
+    if (udiff(s->temp_min, ref->temp) > c->temp_db ||
+        udiff(s->temp_max, ref->temp) > c->temp_db) return true;
+
+    uint32_t lux_db = (uint32_t)((uint64_t)ref->lux * c->lux_db_pct / 100);
+    if (lux_db < c->lux_db) lux_db = c->lux_db;
+    return udiff(s->lux_min, ref->lux) > lux_db || udiff(s->lux_max, ref->lux) > lux_db;
+}
+
+bool report_filter_check(report_filter_t *f, sample_t *s, uint32_t now_s)
+{
+    s->unchanged_since = 0;
+    if (f->have_ref && f->cfg.heartbeat_s > 0) {
+        bool beat = now_s - f->ref_s >= f->cfg.heartbeat_s;
+        if (!beat && !changed(&f->cfg, &f->ref, s)) {
+            f->held_run++;
+            f->stats.held++;
+            return false;
+        }
+        if (beat && !changed(&f->cfg, &f->ref, s)) f->stats.heartbeats++;
+        if (f->held_run) s->unchanged_since = f->ref.t;
+    }
+    f->have_ref = true;
+    f->ref = *s;
+    f->ref_s = now_s;
+    f->held_run = 0;
+    f->stats.reported++;
+    return true;
+}
@@ -0,0 +1,53 @@
+// main/report_filter.h — deadband (report-on-change) filter with a heartbeat
+//
+// Decides which published samples are worth sending. A sample is reported
+// when temperature or lux leaves the deadband around the last reported
+// sample, when motion starts or stops, when occupied time moves by more than
+// its deadband, or when the heartbeat period has passed. Every other sample
+// is held (dropped). The first sample reported after held ones carries
+// unchanged_since = the time of the previous reported sample, meaning every
+// window in between stayed within the deadbands of that sample: the server
+// reconstructs the series by repeating it. Pure logic on a caller-supplied
+// seconds clock, so host/report_bench replays traces through it.
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "sample.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint16_t temp_db;        // centi-degrees C
+    uint32_t lux_db;         // lux x 10, absolute...
+    uint16_t lux_db_pct;     // ...or this percentage of the reported lux, if larger
+    uint16_t motion_db;      // deciseconds of occupied time
+    uint32_t heartbeat_s;    // report at least this often; 0 = every sample
+} report_filter_cfg_t;
+
+typedef struct {
+    uint32_t reported;       // samples passed on
+    uint32_t held;           // samples dropped as unchanged
+    uint32_t heartbeats;     // reported only because the heartbeat was due
+} report_filter_stats_t;
+
+typedef struct {
+    report_filter_cfg_t   cfg;
+    bool                  have_ref;
+    sample_t              ref;        // last reported sample
+    uint32_t              ref_s;      // clock value when it was reported
+    uint32_t              held_run;   // samples held since then
+    report_filter_stats_t stats;
+} report_filter_t;
+
+// cfg may be NULL for the defaults (CONFIG_REPORT_* or the values above).
+void report_filter_init(report_filter_t *f, const report_filter_cfg_t *cfg);
+
+// true = report *s (its unchanged_since is set); false = hold it. now_s is a
+// monotonic clock in seconds; the sample's own wall-clock time may step.
+bool report_filter_check(report_filter_t *f, sample_t *s, uint32_t now_s);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,125 @@
+// main/sample.c — packing and wall-clock helpers for sample_t (see sample.h)
+#include "sample.h"
+#include <math.h>
+#include <string.h>
+
+// Days since 1970-01-01 for a proleptic Gregorian date (H. Hinnant's algorithm).
+static int64_t days_from_civil(int64_t y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned)(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+// Inverse of days_from_civil() for days >= 0.
+static void civil_from_days(int64_t z, int *y, unsigned *m, unsigned *d)
+{
+    z += 719468;
+    const int64_t era = z / 146097;
+    const unsigned doe = (unsigned)(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    *d = doy - (153 * mp + 2) / 5 + 1;
+    *m = mp < 10 ? mp + 3 : mp - 9;
+    *y = (int)(yoe + era * 400 + (*m <= 2));
+}
+
+uint32_t sample_wall_seconds(const struct tm *tm)
+{
+    int64_t days = days_from_civil((int64_t)tm->tm_year + 1900,
+                                   (unsigned)(tm->tm_mon + 1), (unsigned)tm->tm_mday);
+    int64_t t = days * 86400 + tm->tm_hour * 3600 + tm->tm_min * 60 + tm->tm_sec;
+    return t < 0 ? 0 : t > (int64_t)UINT32_MAX ? UINT32_MAX : (uint32_t)t;
+}
+
+void sample_wall_split(uint32_t t, struct tm *out)
+{
+    int y;
+    unsigned m, d;
+    civil_from_days(t / 86400, &y, &m, &d);
+    uint32_t sod = t % 86400;
+
+    memset(out, 0, sizeof(*out));
+    out->tm_year = y - 1900;
+    out->tm_mon  = (int)m - 1;
+    out->tm_mday = (int)d;
+    out->tm_hour = (int)(sod / 3600);
+    out->tm_min  = (int)(sod / 60 % 60);
+    out->tm_sec  = (int)(sod % 60);
+}
+
+static int16_t q_i16(float v, float scale)
+{
+    float x = v * scale;
+    if (!(x > INT16_MIN)) return INT16_MIN;   // also NaN
+    if (x >= INT16_MAX) return INT16_MAX;
+    return (int16_t)lroundf(x);
+}
+
+static uint16_t q_u16(float v, float scale)
+{
+    float x = v * scale;
+    if (!(x > 0.0f)) return 0;
+    if (x >= UINT16_MAX) return UINT16_MAX;
+    return (uint16_t)lroundf(x);
+}
+
+static uint32_t q_u32(float v, float scale)
+{
+    float x = v * scale;
+    if (!(x > 0.0f)) return 0;
+    if (x >= 4294967040.0f) return UINT32_MAX;   // largest float below 2^32
+    return (uint32_t)llroundf(x);
+}
+
+// Time from at_us back to w->end_us in deciseconds, SAMPLE_MOTION_NONE if none.
+static uint16_t q_before(const sensors_window_t *w, int64_t at_us)
+{
+    if (at_us < 0) return SAMPLE_MOTION_NONE;
+    int64_t ds = (w->end_us - at_us + 50000) / 100000;
+    if (ds < 0) return 0;
+    return ds >= SAMPLE_MOTION_NONE ? SAMPLE_MOTION_NONE - 1 : (uint16_t)ds;
+}
+
+void sample_pack(sample_t *s, uint32_t t, const sensors_window_t *w)
+{
+    memset(s, 0, sizeof(*s));
+    s->t            = t;
+    s->temp         = q_i16(w->temp_mean, 100.0f);
+    s->flags        = w->motion ? SAMPLE_F_MOTION : 0;
+    s->motion_edges = (uint8_t)(w->motion_edges > UINT8_MAX ? UINT8_MAX : w->motion_edges);
+    s->lux          = q_u32(w->lux_mean, 10.0f);
+    s->temp_min     = q_i16(w->temp_min, 100.0f);
+    s->temp_max     = q_i16(w->temp_max, 100.0f);
+    s->temp_var     = q_u16(w->temp_var, 10000.0f);
+    s->motion_duty  = q_u16(w->motion_duty, 1000.0f);
+    s->lux_min      = q_u32(w->lux_min, 10.0f);
+    s->lux_max      = q_u32(w->lux_max, 10.0f);
+    s->lux_var      = q_u32(w->lux_var, 100.0f);
+    s->motion_ds    = q_u16(w->motion_s, 10.0f);
+    s->motion_first = q_before(w, w->motion_first_us);
+    s->motion_last  = q_before(w, w->motion_last_us);
+    s->motion_glitches = (uint16_t)(w->motion_glitches > UINT16_MAX ? UINT16_MAX
+                                                                     : w->motion_glitches);
+}
+
+// Unix time → local wall-clock seconds, as sample_wall_seconds() counts them.
+static uint32_t local_wall(uint32_t unix_s)
+{
+    time_t t = (time_t)unix_s;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    return sample_wall_seconds(&tm);
+}
+
+void sample_rebase(sample_t *s, uint32_t boot_unix_s)
+{
+    if (!(s->flags & SAMPLE_F_UNSYNCED)) return;
+    s->t = local_wall(boot_unix_s + s->t);
+    if (s->unchanged_since) s->unchanged_since = local_wall(boot_unix_s + s->unchanged_since);
+    s->flags &= (uint8_t)~SAMPLE_F_UNSYNCED;
+}
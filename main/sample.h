@@ -0,0 +1,77 @@
+// main/sample.h — packed sample record kept in RAM and in the flash backlog
+//
+// Values are stored at the fixed-point resolution the CBOR encoding uses
+// (centi-degrees C, lux x 10, per mille), so nothing the server can see is
+// lost by packing. The timestamp is local wall-clock seconds (see
+// sample_wall_seconds); the date/time strings are produced only by the
+// encoders. Building and room number are the same for every sample and are
+// supplied once per batch (device_id_t), not stored per record.
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "sensors.h"   // sensors_window_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAMPLE_F_MOTION   0x01u   // PIR high at any time in the window
+#define SAMPLE_F_UNSYNCED 0x02u   // taken before SNTP sync: t and unchanged_since
+                                  // are seconds since boot (sample_rebase)
+#define SAMPLE_F_EVENT    0x04u   // a room state change (occupancy.h), not a
+                                  // window: only t, flags and ev_* are set
+
+#define SAMPLE_MOTION_NONE 0xFFFFu   // motion_first/motion_last: no motion
+
+typedef struct {
+    uint32_t t;              // local wall-clock seconds since 1970 (or boot, see flags)
+    int16_t  temp;           // centi-degrees C, window mean
+    uint8_t  flags;          // SAMPLE_F_*
+    uint8_t  motion_edges;   // rising PIR edges in the window (saturating)
+    uint32_t lux;            // lux x 10, window mean
+    union {
+        struct {
+            // Publish-window statistics (sensors_take_window)
+            int16_t  temp_min, temp_max;   // centi-degrees C
+            uint16_t temp_var;       // (centi-degrees C)^2, saturating
+            uint16_t motion_duty;    // per mille
+            uint32_t lux_min, lux_max;     // lux x 10
+            uint32_t lux_var;        // (lux x 10)^2, saturating
+            // Occupancy from debounced PIR edges, in deciseconds (saturating)
+            uint16_t motion_ds;      // time with motion in the window
+            uint16_t motion_first;   // first motion, before t; SAMPLE_MOTION_NONE if none
+            uint16_t motion_last;    // last motion, before t; SAMPLE_MOTION_NONE if none
+            uint16_t motion_glitches;      // PIR pulses rejected by the debounce
+        };
+        struct {                     // SAMPLE_F_EVENT
+            uint8_t  ev_state;       // OCC_* from t on
+            uint8_t  ev_prev;        // before t; OCC_UNKNOWN after boot
+            uint16_t ev_reserved;
+            uint32_t ev_prev_s;      // how long ev_prev lasted, seconds
+        };
+    };
+    // Set by report_filter: the windows since this time were held back as
+    // unchanged from the sample reported then. 0 = none held.
+    uint32_t unchanged_since;      // on the same clock as t
+} sample_t;                  // 44 bytes: a 12-byte core + window statistics or event
+
+// Local date/time fields read as if they were UTC, so sample_wall_split()
+// (or gmtime() on a server) gives back the local date and time.
+uint32_t sample_wall_seconds(const struct tm *tm_local);
+
+// Inverse of sample_wall_seconds(): fills year/mon/mday/hour/min/sec only.
+void     sample_wall_split(uint32_t t, struct tm *out);
+
+// Quantise one publish window into *s; t is the wall-clock time of
+// w->end_us.
+void     sample_pack(sample_t *s, uint32_t t, const sensors_window_t *w);
+
+// Date a SAMPLE_F_UNSYNCED sample: boot_unix_s is the unix time the device
+// booted at, so t and unchanged_since become local wall-clock seconds and
+// the flag is cleared. Other samples are left as they are.
+void     sample_rebase(sample_t *s, uint32_t boot_unix_s);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,586 @@
+// main/sample_log.c — append-only sample log over a ring of flash sectors
+//
+// Every 4 KB sector starts with a header {magic, seq, pending bitmap} followed
+// by fixed-size record slots. A record is programmed once and never rewritten;
+// consuming it only clears its bit in the sector bitmap (1→0, no erase). A
+// sector is erased only when the ring wraps back onto it, so all sectors wear
+// at the same rate.
+//
+// Nothing but the flash contents is needed to recover after a reset: the
+// sector with the highest seq holds the head, the oldest sector of the
+// consecutive seq run holds the tail, and a record torn by power loss fails
+// its CRC and is skipped.
+#include "sample_log.h"
+#include "metrics.h"
+#include <string.h>
+#include "esp_log.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+#else
+#include <stdio.h>
+#endif
+
+#define LOG_PART_LABEL   "samplelog"
+#define LOG_SECTOR_SIZE  4096u
+#define LOG_MAGIC        0x354C5341u   // "ASL5"; bump whenever sample_t changes
+#define LOG_REC_MARK     0xA55Au
+
+// RAM write-ahead cache: samples wait here and reach flash in one program op.
+// While uploads succeed they are usually consumed before ever touching flash.
+#ifndef SAMPLE_LOG_CACHE_RECORDS
+#define SAMPLE_LOG_CACHE_RECORDS 8
+#endif
+
+typedef struct {
+    uint16_t mark;
+    uint16_t crc;
+} log_rec_hdr_t;
+
+#define LOG_SLOT_SIZE    ((sizeof(log_rec_hdr_t) + sizeof(sample_t) + 3u) & ~3u)
+#define LOG_MAX_SLOTS    ((LOG_SECTOR_SIZE - 8u) / LOG_SLOT_SIZE)
+#define LOG_BITMAP_BYTES ((LOG_MAX_SLOTS + 7u) / 8u)
+#define LOG_HDR_SIZE     ((8u + LOG_BITMAP_BYTES + 3u) & ~3u)
+#define LOG_SLOTS        ((LOG_SECTOR_SIZE - LOG_HDR_SIZE) / LOG_SLOT_SIZE)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+} log_sec_hdr_t;
+
+static const char *TAG = "SAMPLE_LOG";
+
+static bool     s_mounted = false;
+static uint32_t s_sectors = 0;
+static uint32_t s_head_sec, s_head_slot, s_head_seq;   // next free slot
+static uint32_t s_tail_sec, s_tail_slot;               // nothing pending before this
+static uint32_t s_pending = 0;                         // records in flash
+
+static sample_t s_cache[SAMPLE_LOG_CACHE_RECORDS];
+static int      s_cache_n = 0;
+static uint8_t  s_wbuf[SAMPLE_LOG_CACHE_RECORDS * LOG_SLOT_SIZE];
+
+static sample_log_stats_t s_stats;
+
+// --------- flash backend ---------
+#ifdef ESP_PLATFORM
+static const esp_partition_t *s_part = NULL;
+
+static esp_err_t flash_open(uint32_t *size)
+{
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                      ESP_PARTITION_SUBTYPE_ANY, LOG_PART_LABEL);
+    if (!s_part) return ESP_ERR_NOT_FOUND;
+    *size = s_part->size;
+    return ESP_OK;
+}
+
+static esp_err_t flash_read(uint32_t off, void *dst, size_t len)
+{
+    return esp_partition_read(s_part, off, dst, len);
+}
+
+static esp_err_t flash_program(uint32_t off, const void *src, size_t len)
+{
+    return esp_partition_write(s_part, off, src, len);
+}
+
+static esp_err_t flash_erase(uint32_t off)
+{
+    return esp_partition_erase_range(s_part, off, LOG_SECTOR_SIZE);
+}
+#else
+// Host stand-in: the partition is a file with NOR semantics (program can only
+// clear bits, erase sets a whole sector back to 0xFF).
+#ifndef SAMPLE_LOG_HOST_SIZE
+#define SAMPLE_LOG_HOST_SIZE (176u * LOG_SECTOR_SIZE)   // partitions.csv
+#endif
+
+static FILE *s_file = NULL;
+
+static esp_err_t flash_erase(uint32_t off);
+
+static esp_err_t flash_open(uint32_t *size)
+{
+    s_file = fopen(SAMPLE_LOG_HOST_FILE, "r+b");
+    if (!s_file) {
+        s_file = fopen(SAMPLE_LOG_HOST_FILE, "w+b");
+        if (!s_file) return ESP_ERR_NOT_FOUND;
+        for (uint32_t off = 0; off < SAMPLE_LOG_HOST_SIZE; off += LOG_SECTOR_SIZE) {
+            if (flash_erase(off) != ESP_OK) return ESP_FAIL;
+        }
+    }
+    *size = SAMPLE_LOG_HOST_SIZE;
+    return ESP_OK;
+}
+
+static esp_err_t flash_read(uint32_t off, void *dst, size_t len)
+{
+    if (fseek(s_file, (long)off, SEEK_SET) != 0) return ESP_FAIL;
+    return fread(dst, 1, len, s_file) == len ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t flash_program(uint32_t off, const void *src, size_t len)
+{
+    uint8_t cur[256];
+    const uint8_t *p = src;
+    while (len > 0) {
+        size_t n = len < sizeof(cur) ? len : sizeof(cur);
+        if (flash_read(off, cur, n) != ESP_OK) return ESP_FAIL;
+        for (size_t i = 0; i < n; ++i) cur[i] &= p[i];
+        if (fseek(s_file, (long)off, SEEK_SET) != 0) return ESP_FAIL;
+        if (fwrite(cur, 1, n, s_file) != n) return ESP_FAIL;
+        off += n; p += n; len -= n;
+    }
+    return fflush(s_file) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t flash_erase(uint32_t off)
+{
+    uint8_t ff[256];
+    memset(ff, 0xFF, sizeof(ff));
+    if (fseek(s_file, (long)off, SEEK_SET) != 0) return ESP_FAIL;
+    for (uint32_t i = 0; i < LOG_SECTOR_SIZE; i += sizeof(ff)) {
+        if (fwrite(ff, 1, sizeof(ff), s_file) != sizeof(ff)) return ESP_FAIL;
+    }
+    return fflush(s_file) == 0 ? ESP_OK : ESP_FAIL;
+}
+#endif
+
+// --------- helpers ---------
+static uint16_t crc16(const uint8_t *p, size_t len)
+{
+    uint16_t crc = 0xFFFF;   // CRC-16/CCITT-FALSE
+    while (len--) {
+        crc ^= (uint16_t)(*p++) << 8;
+        for (int i = 0; i < 8; ++i) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static inline uint32_t sec_off(uint32_t sec) { return sec * LOG_SECTOR_SIZE; }
+
+static inline uint32_t slot_off(uint32_t sec, uint32_t slot)
+{
+    return sec_off(sec) + LOG_HDR_SIZE + slot * LOG_SLOT_SIZE;
+}
+
+static esp_err_t program(uint32_t off, const void *src, size_t len)
+{
+    esp_err_t err = flash_program(off, src, len);
+    if (err == ESP_OK) {
+        s_stats.flash_writes++;
+        s_stats.flash_bytes += len;
+    }
+    return err;
+}
+
+static inline bool bit_get(const uint8_t *bm, uint32_t i) { return (bm[i >> 3] >> (i & 7)) & 1u; }
+static inline void bit_clear(uint8_t *bm, uint32_t i)     { bm[i >> 3] &= (uint8_t)~(1u << (i & 7)); }
+
+static esp_err_t read_bitmap(uint32_t sec, uint8_t *bm)
+{
+    return flash_read(sec_off(sec) + sizeof(log_sec_hdr_t), bm, LOG_BITMAP_BYTES);
+}
+
+static esp_err_t write_bitmap(uint32_t sec, const uint8_t *bm)
+{
+    return program(sec_off(sec) + sizeof(log_sec_hdr_t), bm, LOG_BITMAP_BYTES);
+}
+
+static uint32_t count_pending(const uint8_t *bm, uint32_t used)
+{
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < used; ++i) n += bit_get(bm, i);
+    return n;
+}
+
+// Reads one slot; fails if it is erased or its CRC does not match.
+static esp_err_t read_record(uint32_t sec, uint32_t slot, sample_t *out)
+{
+    uint8_t buf[LOG_SLOT_SIZE];
+    esp_err_t err = flash_read(slot_off(sec, slot), buf, sizeof(buf));
+    if (err != ESP_OK) return err;
+
+    log_rec_hdr_t h;
+    memcpy(&h, buf, sizeof(h));
+    if (h.mark != LOG_REC_MARK) return ESP_ERR_NOT_FOUND;
+    if (h.crc != crc16(buf + sizeof(h), sizeof(sample_t))) return ESP_ERR_INVALID_CRC;
+    if (out) memcpy(out, buf + sizeof(h), sizeof(sample_t));
+    return ESP_OK;
+}
+
+// Moves (*sec, *slot) forward to the next pending slot. Returns false once the
+// head is reached. bm/bm_sec cache the bitmap of the sector being walked.
+static bool seek_pending(uint32_t *sec, uint32_t *slot, uint8_t *bm, uint32_t *bm_sec)
+{
+    for (;;) {
+        if (*sec == s_head_sec && *slot >= s_head_slot) return false;
+        if (*slot >= LOG_SLOTS) {
+            *sec = (*sec + 1) % s_sectors;
+            *slot = 0;
+            continue;
+        }
+        if (*bm_sec != *sec) {
+            if (read_bitmap(*sec, bm) != ESP_OK) {
+                *slot = LOG_SLOTS;   // unreadable sector: skip it
+                continue;
+            }
+            *bm_sec = *sec;
+        }
+        if (bit_get(bm, *slot)) return true;
+        (*slot)++;
+    }
+}
+
+// Erases the sector after the head and makes it the new head. If the ring is
+// full, the oldest sector is sacrificed and its pending samples are dropped.
+static esp_err_t open_next_sector(void)
+{
+    uint32_t next = (s_head_sec + 1) % s_sectors;
+
+    if (s_pending > 0 && s_tail_sec == next) {
+        uint8_t bm[LOG_BITMAP_BYTES];
+        uint32_t lost = 0;
+        if (read_bitmap(next, bm) == ESP_OK) lost = count_pending(bm, LOG_SLOTS);
+        if (lost > s_pending) lost = s_pending;
+        s_pending -= lost;
+        s_stats.dropped += lost;
+        metrics_count(METRIC_C_LOG_DROPPED, lost);
+        s_tail_sec  = (next + 1) % s_sectors;
+        s_tail_slot = 0;
+        ESP_LOGW(TAG, "Log full — dropped %u oldest sample(s)", (unsigned)lost);
+    }
+
+    esp_err_t err = flash_erase(sec_off(next));
+    if (err != ESP_OK) return err;
+    s_stats.sector_erases++;
+
+    log_sec_hdr_t h = { .magic = LOG_MAGIC, .seq = s_head_seq + 1 };
+    err = program(sec_off(next), &h, sizeof(h));
+    if (err != ESP_OK) return err;
+
+    s_head_sec  = next;
+    s_head_slot = 0;
+    s_head_seq  = h.seq;
+    if (s_pending == 0) {
+        s_tail_sec  = s_head_sec;
+        s_tail_slot = 0;
+    }
+    return ESP_OK;
+}
+
+// Rebuilds head, tail and the pending count from the sector headers.
+static esp_err_t mount(void)
+{
+    bool found = false;
+    for (uint32_t sec = 0; sec < s_sectors; ++sec) {
+        log_sec_hdr_t h;
+        if (flash_read(sec_off(sec), &h, sizeof(h)) != ESP_OK) continue;
+        if (h.magic != LOG_MAGIC || h.seq == 0xFFFFFFFFu) continue;
+        if (!found || h.seq > s_head_seq) {
+            s_head_seq = h.seq;
+            s_head_sec = sec;
+            found = true;
+        }
+    }
+
+    s_pending = 0;
+    if (!found) {
+        // Fresh partition: the first flush opens sector 0 with seq 1.
+        s_head_sec  = s_sectors - 1;
+        s_head_slot = LOG_SLOTS;
+        s_head_seq  = 0;
+        s_tail_sec  = 0;
+        s_tail_slot = 0;
+        return ESP_OK;
+    }
+
+    // Head slot = first erased slot of the head sector.
+    s_head_slot = LOG_SLOTS;
+    for (uint32_t slot = 0; slot < LOG_SLOTS; ++slot) {
+        log_rec_hdr_t h;
+        if (flash_read(slot_off(s_head_sec, slot), &h, sizeof(h)) != ESP_OK) continue;
+        if (h.mark == 0xFFFF && h.crc == 0xFFFF) {
+            s_head_slot = slot;
+            break;
+        }
+    }
+
+    // A torn write can only sit in the head sector: release it right away.
+    uint8_t bm[LOG_BITMAP_BYTES];
+    esp_err_t err = read_bitmap(s_head_sec, bm);
+    if (err != ESP_OK) return err;
+    bool torn = false;
+    for (uint32_t slot = 0; slot < s_head_slot; ++slot) {
+        if (bit_get(bm, slot) && read_record(s_head_sec, slot, NULL) != ESP_OK) {
+            bit_clear(bm, slot);
+            torn = true;
+        }
+    }
+    if (torn) {
+        ESP_LOGW(TAG, "Discarding torn record(s) in sector %u", (unsigned)s_head_sec);
+        write_bitmap(s_head_sec, bm);
+    }
+
+    // Walk back over the run of consecutive seq numbers to find the oldest sector.
+    uint32_t oldest = s_head_sec;
+    for (uint32_t k = 1; k < s_sectors; ++k) {
+        uint32_t sec = (s_head_sec + s_sectors - k) % s_sectors;
+        log_sec_hdr_t h;
+        if (flash_read(sec_off(sec), &h, sizeof(h)) != ESP_OK) break;
+        if (h.magic != LOG_MAGIC || h.seq != s_head_seq - k) break;
+        oldest = sec;
+    }
+
+    for (uint32_t sec = oldest;; sec = (sec + 1) % s_sectors) {
+        if (read_bitmap(sec, bm) == ESP_OK) {
+            s_pending += count_pending(bm, sec == s_head_sec ? s_head_slot : LOG_SLOTS);
+        }
+        if (sec == s_head_sec) break;
+    }
+
+    s_tail_sec  = oldest;
+    s_tail_slot = 0;
+    if (s_pending > 0) {
+        uint32_t bm_sec = UINT32_MAX;
+        seek_pending(&s_tail_sec, &s_tail_slot, bm, &bm_sec);
+    } else {
+        s_tail_sec  = s_head_sec;
+        s_tail_slot = s_head_slot;
+    }
+    return ESP_OK;
+}
+
+// --------- public API ---------
+esp_err_t sample_log_init(void)
+{
+    if (s_mounted) return ESP_OK;
+
+    uint32_t size = 0;
+    esp_err_t err = flash_open(&size);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "No '%s' partition — backlog limited to %d sample(s) in RAM",
+                 LOG_PART_LABEL, SAMPLE_LOG_CACHE_RECORDS);
+        return err;
+    }
+    s_sectors = size / LOG_SECTOR_SIZE;
+    if (s_sectors < 2) return ESP_ERR_INVALID_SIZE;
+
+    err = mount();
+    if (err != ESP_OK) return err;
+    s_mounted = true;
+
+    ESP_LOGI(TAG, "Mounted: %u sectors x %u slots (%u B/slot), %u sample(s) pending",
+             (unsigned)s_sectors, (unsigned)LOG_SLOTS, (unsigned)LOG_SLOT_SIZE,
+             (unsigned)s_pending);
+    return ESP_OK;
+}
+
+esp_err_t sample_log_flush(void)
+{
+    if (s_cache_n == 0) return ESP_OK;
+    if (!s_mounted) return ESP_ERR_INVALID_STATE;
+
+    int done = 0;
+    esp_err_t err = ESP_OK;
+    while (done < s_cache_n) {
+        if (s_head_slot >= LOG_SLOTS) {
+            err = open_next_sector();
+            if (err != ESP_OK) break;
+        }
+        uint32_t n = LOG_SLOTS - s_head_slot;
+        if (n > (uint32_t)(s_cache_n - done)) n = (uint32_t)(s_cache_n - done);
+
+        memset(s_wbuf, 0xFF, n * LOG_SLOT_SIZE);
+        for (uint32_t i = 0; i < n; ++i) {
+            uint8_t *slot = s_wbuf + i * LOG_SLOT_SIZE;
+            log_rec_hdr_t h = {
+                .mark = LOG_REC_MARK,
+                .crc  = crc16((const uint8_t *)&s_cache[done + i], sizeof(sample_t)),
+            };
+            memcpy(slot, &h, sizeof(h));
+            memcpy(slot + sizeof(h), &s_cache[done + i], sizeof(sample_t));
+        }
+
+        err = program(slot_off(s_head_sec, s_head_slot), s_wbuf, n * LOG_SLOT_SIZE);
+        if (err != ESP_OK) break;
+
+        if (s_pending == 0) {
+            s_tail_sec  = s_head_sec;
+            s_tail_slot = s_head_slot;
+        }
+        s_head_slot += n;
+        s_pending   += n;
+        s_stats.flushed += n;
+        done += (int)n;
+    }
+
+    if (done > 0) {
+        memmove(s_cache, s_cache + done, (size_t)(s_cache_n - done) * sizeof(sample_t));
+        s_cache_n -= done;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Flush failed: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t sample_log_append(const sample_t *s)
+{
+    if (!s) return ESP_ERR_INVALID_ARG;
+    if (s_cache_n >= SAMPLE_LOG_CACHE_RECORDS && sample_log_flush() != ESP_OK) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_cache[s_cache_n++] = *s;
+    s_stats.appended++;
+    return ESP_OK;
+}
+
+int sample_log_peek(sample_t *out, int max)
+{
+    return sample_log_peek_from(0, out, max);
+}
+
+int sample_log_peek_from(int skip, sample_t *out, int max)
+{
+    return sample_log_peek_pos(skip, out, NULL, max);
+}
+
+// Sector seq runs consecutively from the tail to the head, so a slot's
+// number follows from how far its sector is behind the head.
+static uint32_t slot_pos(uint32_t sec, uint32_t slot)
+{
+    uint32_t seq = s_head_seq - (s_head_sec + s_sectors - sec) % s_sectors;
+    return (seq - 1) * LOG_SLOTS + slot;
+}
+
+uint32_t sample_log_flash_pos(void)
+{
+    return s_mounted ? slot_pos(s_head_sec, s_head_slot) : 0;
+}
+
+// A pending slot that fails its CRC will never be sent: clear its bit now,
+// so sample_log_count() stops counting it. bm is the sector's cached bitmap.
+static void release_corrupt(uint32_t sec, uint32_t slot, uint8_t *bm)
+{
+    bit_clear(bm, slot);
+    write_bitmap(sec, bm);
+    s_pending--;
+    s_stats.corrupt++;
+    ESP_LOGW(TAG, "Releasing corrupt record %u/%u", (unsigned)sec, (unsigned)slot);
+    if (s_pending == 0) {
+        s_tail_sec  = s_head_sec;
+        s_tail_slot = s_head_slot;
+    }
+}
+
+int sample_log_peek_pos(int skip, sample_t *out, uint32_t *pos, int max)
+{
+    if (!out || max <= 0) return 0;
+    if (skip < 0) skip = 0;
+
+    int n = 0;
+    if (s_mounted && s_pending > 0) {
+        uint8_t bm[LOG_BITMAP_BYTES];
+        uint32_t bm_sec = UINT32_MAX;
+        uint32_t sec = s_tail_sec, slot = s_tail_slot;
+        while (n < max && seek_pending(&sec, &slot, bm, &bm_sec)) {
+            // Skipped ones are read too: like consume, count only good records.
+            esp_err_t err = read_record(sec, slot, &out[n]);
+            if (err == ESP_OK) {
+                if (skip > 0) {
+                    skip--;
+                } else {
+                    if (pos) pos[n] = slot_pos(sec, slot);
+                    n++;
+                }
+            } else if (err == ESP_ERR_INVALID_CRC || err == ESP_ERR_NOT_FOUND) {
+                release_corrupt(sec, slot, bm);
+            }
+            slot++;
+        }
+    }
+    // The cache goes to flash in order, from the head on.
+    uint32_t head = sample_log_flash_pos();
+    for (int i = skip; i < s_cache_n && n < max; ++i) {
+        if (pos) pos[n] = head + (uint32_t)i;
+        out[n++] = s_cache[i];
+    }
+    return n;
+}
+
+esp_err_t sample_log_consume(int n)
+{
+    if (n <= 0) return ESP_OK;
+
+    esp_err_t err = ESP_OK;
+    if (s_mounted && s_pending > 0) {
+        uint8_t bm[LOG_BITMAP_BYTES];
+        uint32_t bm_sec = UINT32_MAX;
+        bool dirty = false;
+        uint32_t sec = s_tail_sec, slot = s_tail_slot;
+
+        // Clear bits, one bitmap write per sector touched. Corrupt slots on
+        // the way are released too but do not count towards n.
+        while (n > 0 && s_pending > 0 && !(sec == s_head_sec && slot >= s_head_slot)) {
+            if (slot >= LOG_SLOTS) {
+                if (dirty && (err = write_bitmap(bm_sec, bm)) != ESP_OK) break;
+                dirty = false;
+                sec = (sec + 1) % s_sectors;
+                slot = 0;
+                continue;
+            }
+            if (bm_sec != sec) {
+                if (read_bitmap(sec, bm) != ESP_OK) {
+                    slot = LOG_SLOTS;
+                    continue;
+                }
+                bm_sec = sec;
+            }
+            if (bit_get(bm, slot)) {
+                if (read_record(sec, slot, NULL) == ESP_OK) {
+                    n--;
+                    s_stats.consumed++;
+                } else {
+                    s_stats.corrupt++;
+                }
+                bit_clear(bm, slot);
+                dirty = true;
+                s_pending--;
+            }
+            slot++;
+        }
+        if (dirty && err == ESP_OK) err = write_bitmap(bm_sec, bm);
+
+        s_tail_sec  = sec;
+        s_tail_slot = slot;
+        if (s_pending == 0) {
+            s_tail_sec  = s_head_sec;
+            s_tail_slot = s_head_slot;
+        }
+    }
+
+    if (n > s_cache_n) n = s_cache_n;
+    if (n > 0) {
+        memmove(s_cache, s_cache + n, (size_t)(s_cache_n - n) * sizeof(sample_t));
+        s_cache_n -= n;
+        s_stats.consumed += (uint32_t)n;
+    }
+    return err;
+}
+
+uint32_t sample_log_count(void)
+{
+    return s_pending + (uint32_t)s_cache_n;
+}
+
+void sample_log_get_stats(sample_log_stats_t *out)
+{
+    if (!out) return;
+    *out = s_stats;
+    out->capacity = s_mounted ? s_sectors * LOG_SLOTS : 0;
+    out->record_bytes = LOG_SLOT_SIZE;
+}
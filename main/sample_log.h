@@ -0,0 +1,72 @@
+// main/sample_log.h — persistent sample backlog in a dedicated flash partition
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "uploader.h"   // sample_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef ESP_PLATFORM
+// Host stand-in for the partition; host/CMakeLists.txt puts it in the build dir.
+#ifndef SAMPLE_LOG_HOST_FILE
+#define SAMPLE_LOG_HOST_FILE "/tmp/aulasense-samplelog.bin"
+#endif
+#endif
+
+typedef struct {
+    uint32_t appended;       // samples accepted by sample_log_append()
+    uint32_t flushed;        // samples programmed into flash
+    uint32_t consumed;       // samples released by sample_log_consume()
+    uint32_t dropped;        // oldest samples lost because the log wrapped
+    uint32_t corrupt;        // records released because they failed their CRC
+    uint32_t flash_writes;   // program operations (records, headers, markers)
+    uint32_t flash_bytes;    // bytes programmed
+    uint32_t sector_erases;  // 4 KB sector erases
+    uint32_t capacity;       // samples the mounted partition holds (0 = RAM only)
+    uint32_t record_bytes;   // flash slot per sample, header included
+} sample_log_stats_t;
+
+// Mount the "samplelog" partition and rebuild head/tail from flash.
+// On the host build the partition is a plain file (see sample_log.c).
+// If no partition is found the log keeps working from its RAM cache only.
+esp_err_t sample_log_init(void);
+
+// Queue one sample in the RAM write-ahead cache. The cache is written to
+// flash in one batch when it fills up.
+esp_err_t sample_log_append(const sample_t *s);
+
+// Write the RAM cache to flash now.
+esp_err_t sample_log_flush(void);
+
+// Copy up to max of the oldest pending samples into out (flash first, then
+// the RAM cache). Returns how many were copied; nothing is removed, except
+// corrupt records on the way, which are released so the count skips them.
+int       sample_log_peek(sample_t *out, int max);
+
+// The same, after the skip oldest ones (batches already in flight).
+int       sample_log_peek_from(int skip, sample_t *out, int max);
+
+// The same, also giving each sample's append-order number (see
+// sample_log_flash_pos()); pos may be NULL.
+int       sample_log_peek_pos(int skip, sample_t *out, uint32_t *pos, int max);
+
+// Append-order number the next sample to reach flash gets. Every sample ever
+// written to the partition has its own, they only grow, and they survive a
+// reboot (they come from the sector sequence numbers). 0 on a fresh log, and
+// always 0 without a partition.
+uint32_t  sample_log_flash_pos(void);
+
+// Release the n oldest samples, i.e. the ones returned by the last peek.
+esp_err_t sample_log_consume(int n);
+
+// Samples waiting to be uploaded (flash + RAM cache).
+uint32_t  sample_log_count(void);
+
+void      sample_log_get_stats(sample_log_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,58 @@
+// main/sample_ring.c — SPSC ring with snapshot-and-commit consumption
+//
+// The producer publishes a slot by storing head with release ordering after
+// writing it; the consumer reads head with acquire ordering before copying.
+// Symmetrically, the consumer frees slots by a release store of tail.
+#include "sample_ring.h"
+
+#define RING_MASK (SAMPLE_RING_CAPACITY - 1u)
+
+_Static_assert((SAMPLE_RING_CAPACITY & RING_MASK) == 0,
+               "SAMPLE_RING_CAPACITY must be a power of two");
+
+void sample_ring_init(sample_ring_t *r)
+{
+    atomic_store_explicit(&r->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, 0, memory_order_relaxed);
+}
+
+bool sample_ring_push(sample_ring_t *r, const sample_t *s)
+{
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (head - tail >= SAMPLE_RING_CAPACITY) return false;
+
+    r->slots[head & RING_MASK] = *s;
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    return true;
+}
+
+int sample_ring_peek(sample_ring_t *r, sample_t *out, int max)
+{
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    uint32_t n = head - tail;
+    if (max < 0) max = 0;
+    if (n > (uint32_t)max) n = (uint32_t)max;
+
+    for (uint32_t i = 0; i < n; ++i) {
+        out[i] = r->slots[(tail + i) & RING_MASK];
+    }
+    return (int)n;
+}
+
+void sample_ring_release(sample_ring_t *r, int n)
+{
+    if (n <= 0) return;
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    if ((uint32_t)n > head - tail) n = (int)(head - tail);
+    atomic_store_explicit(&r->tail, tail + (uint32_t)n, memory_order_release);
+}
+
+uint32_t sample_ring_count(sample_ring_t *r)
+{
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    return head - tail;
+}
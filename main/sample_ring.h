@@ -0,0 +1,41 @@
+// main/sample_ring.h — lock-free single-producer/single-consumer sample queue
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "uploader.h"   // sample_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Must be a power of two. 32 samples = 5+ minutes at one sample per 10 s.
+#ifndef SAMPLE_RING_CAPACITY
+#define SAMPLE_RING_CAPACITY 32
+#endif
+
+// head is written only by the producer, tail only by the consumer. Both are
+// free-running counters; the difference is the fill level.
+typedef struct {
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    sample_t         slots[SAMPLE_RING_CAPACITY];
+} sample_ring_t;
+
+void     sample_ring_init(sample_ring_t *r);
+
+// Producer side. Never blocks; returns false if the ring is full.
+bool     sample_ring_push(sample_ring_t *r, const sample_t *s);
+
+// Consumer side: copy up to max of the oldest samples without removing them
+// (snapshot), then release the first n once they are safely handed off
+// (commit). Samples pushed in between are untouched.
+int      sample_ring_peek(sample_ring_t *r, sample_t *out, int max);
+void     sample_ring_release(sample_ring_t *r, int n);
+
+// Fill level; exact on either side, a snapshot from anywhere else.
+uint32_t sample_ring_count(sample_ring_t *r);
+
+#ifdef __cplusplus
+}
+#endif
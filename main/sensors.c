@@ -1,9 +1,14 @@
 // sensors.c — BME280 (temp only) + BH1750 + PIR
 #include "sensors.h"
+#include "window_stats.h"
+#include "motion_track.h"
+#include "pir_ring.h"
+#include "i2c_bus.h"
+#include "metrics.h"
 
-#include "driver/i2c.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -12,11 +17,9 @@
 
 #define TAG "SENSORS"
 
-// ===== I2C config =====
-#define I2C_PORT        I2C_NUM_0
+// ===== I2C config (bus speed, timeouts and recovery: i2c_bus.h) =====
 #define I2C_SDA         GPIO_NUM_21
 #define I2C_SCL         GPIO_NUM_22
-#define I2C_FREQ_HZ     100000
 
 // ===== BH1750 =====
 #define BH1750_ADDR     0x23  // change to 0x5C if ADDR tied to VCC
@@ -24,6 +27,13 @@
 #define BH1750_RESET    0x07
 #define BH1750_CONT_HI  0x10  // continuous high-res (1 lx / 1.2)
 
+// A new high-res value is ready every ~120 ms (180 ms max); reading faster
+// than that just returns the previous conversion again.
+#ifndef SENSORS_BH1750_PERIOD_MS
+#define SENSORS_BH1750_PERIOD_MS 120
+#endif
+#define BH1750_FIRST_MS 180   // first conversion after power-on, worst case
+
 // ===== BME280 (temp) =====
 #define BME280_ADDR     0x76  // change to 0x77 if SDO high
 
@@ -35,108 +45,99 @@
 #define BME280_REG_STATUS   0xF3
 #define BME280_REG_CTRL_MEAS 0xF4
 #define BME280_REG_CONFIG   0xF5
-#define BME280_REG_TEMP_MSB 0xFA
+#define BME280_REG_DATA     0xF7   // press[3] temp[3] hum[2], burst-read as one block
+#define BME280_DATA_LEN     8
 
 // ctrl_meas bits
 #define BME280_OSRS_T_x1    (1<<5)
-#define BME280_MODE_FORCED  0x01
+#define BME280_MODE_NORMAL  0x03
+
+// config bits: standby between conversions and IIR filter coefficient
+#define BME280_T_SB_500MS   (4<<5)
+#define BME280_FILTER_4     (2<<2)
+
+// Normal mode: the chip converts on its own every t_sb + ~3.5 ms (temp x1)
+// and the data registers always hold the latest filtered result, so a read
+// never has to wait. The read period tracks the standby time.
+#ifndef SENSORS_BME280_PERIOD_MS
+#define SENSORS_BME280_PERIOD_MS 500
+#endif
+#define BME280_CONFIG_VAL   (BME280_T_SB_500MS | BME280_FILTER_4)
+
+// A sensor that failed init is probed again this often.
+#ifndef SENSORS_RETRY_MS
+#define SENSORS_RETRY_MS 5000
+#endif
 
 // ===== PIR =====
 #ifndef PIR_GPIO
 #define PIR_GPIO GPIO_NUM_27
 #endif
 
-static volatile bool s_motion_instant = false;
-static volatile bool s_motion_latched = false;
+// The ISR only timestamps edges; the sampler task debounces them.
+static pir_ring_t            s_pir_ring;
+static TaskHandle_t volatile s_wake_task = NULL;   // sampler: PIR edges, read slots
+static volatile uint32_t     s_pir_overflows = 0;   // written by the ISR only
 
 // ===== latest values =====
 static float s_latest_temp_c = 0.0f;
 static float s_latest_lux    = 0.0f;
+static int64_t s_temp_us = 0;
+static int64_t s_lux_us  = 0;
+
+// ===== per-sensor schedule =====
+typedef struct {
+    uint32_t period_ms;   // minimum spacing between reads
+    int64_t  next_us;     // esp_timer time the next read is due
+    bool     present;     // init succeeded; if not, next_us is the next retry
+} sensor_sched_t;
+
+static sensor_sched_t s_bh1750 = { .period_ms = SENSORS_BH1750_PERIOD_MS };
+static sensor_sched_t s_bme280 = { .period_ms = SENSORS_BME280_PERIOD_MS };
+
+// Wakes the sampler at the next read slot. A one-shot re-armed every tick
+// rather than a periodic timer: the two periods and the PIR settle times
+// share no useful base tick, and this keeps µs resolution instead of the
+// scheduler tick's.
+static esp_timer_handle_t s_slot_timer;
+
+static sensors_stats_t s_stats;
+
+// ===== publish window (sampler adds, publisher takes) =====
+static window_stats_t s_win;
+static motion_track_t s_motion;
+static portMUX_TYPE   s_win_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// ===== I2C devices (handles created once the bus is up) =====
+static i2c_bus_dev_t s_bh_dev;
+static i2c_bus_dev_t s_bme_dev;
+static uint8_t       s_rx[BME280_DATA_LEN];   // sampler task only
 
 // ===== BME280 calibration for temperature =====
 static uint16_t dig_T1;
 static int16_t  dig_T2, dig_T3;
 static int32_t  t_fine;
 
-// --------- helpers ---------
-static esp_err_t i2c_master_init(void) {
-    i2c_config_t conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = I2C_SDA,
-        .scl_io_num = I2C_SCL,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = I2C_FREQ_HZ,
-        .clk_flags = 0
-    };
-    ESP_ERROR_CHECK(i2c_param_config(I2C_PORT, &conf));
-    return i2c_driver_install(I2C_PORT, conf.mode, 0, 0, 0);
-}
-
-static esp_err_t i2c_write_cmd(uint8_t addr, uint8_t cmd) {
-    i2c_cmd_handle_t c = i2c_cmd_link_create();
-    i2c_master_start(c);
-    i2c_master_write_byte(c, (addr<<1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(c, cmd, true);
-    i2c_master_stop(c);
-    esp_err_t err = i2c_master_cmd_begin(I2C_PORT, c, pdMS_TO_TICKS(100));
-    i2c_cmd_link_delete(c);
-    return err;
-}
-
-static esp_err_t i2c_write_reg(uint8_t addr, uint8_t reg, uint8_t val) {
-    i2c_cmd_handle_t c = i2c_cmd_link_create();
-    i2c_master_start(c);
-    i2c_master_write_byte(c, (addr<<1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(c, reg, true);
-    i2c_master_write_byte(c, val, true);
-    i2c_master_stop(c);
-    esp_err_t err = i2c_master_cmd_begin(I2C_PORT, c, pdMS_TO_TICKS(100));
-    i2c_cmd_link_delete(c);
-    return err;
-}
-
-static esp_err_t i2c_read_bytes(uint8_t addr, uint8_t reg, uint8_t *buf, size_t len) {
-    i2c_cmd_handle_t c = i2c_cmd_link_create();
-    i2c_master_start(c);
-    i2c_master_write_byte(c, (addr<<1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(c, reg, true);
-    i2c_master_start(c);
-    i2c_master_write_byte(c, (addr<<1) | I2C_MASTER_READ, true);
-    if (len > 1) {
-        i2c_master_read(c, buf, len-1, I2C_MASTER_ACK);
-    }
-    i2c_master_read_byte(c, buf+len-1, I2C_MASTER_NACK);
-    i2c_master_stop(c);
-    esp_err_t err = i2c_master_cmd_begin(I2C_PORT, c, pdMS_TO_TICKS(200));
-    i2c_cmd_link_delete(c);
-    return err;
+// ---- BH1750 ----
+static esp_err_t bh1750_cmd(uint8_t cmd) {
+    return i2c_bus_write(s_bh_dev, &cmd, 1);
 }
 
-// ---- BH1750 ----
 static esp_err_t bh1750_init(void) {
-    esp_err_t err = i2c_write_cmd(BH1750_ADDR, BH1750_PWR_ON);
+    esp_err_t err = bh1750_cmd(BH1750_PWR_ON);
     if (err != ESP_OK) return err;
-    err = i2c_write_cmd(BH1750_ADDR, BH1750_RESET);
+    err = bh1750_cmd(BH1750_RESET);
     if (err != ESP_OK) return err;
-    err = i2c_write_cmd(BH1750_ADDR, BH1750_CONT_HI);
-    vTaskDelay(pdMS_TO_TICKS(200));
-    return err;
+    // No wait here: the scheduler holds off the first read until the first
+    // conversion is done.
+    return bh1750_cmd(BH1750_CONT_HI);
 }
 
 static esp_err_t bh1750_read(float *lux) {
-    uint8_t data[2] = {0};
     // In continuous mode, just read 2 bytes
-    i2c_cmd_handle_t c = i2c_cmd_link_create();
-    i2c_master_start(c);
-    i2c_master_write_byte(c, (BH1750_ADDR<<1) | I2C_MASTER_READ, true);
-    i2c_master_read(c, data, 1, I2C_MASTER_ACK);
-    i2c_master_read_byte(c, data+1, I2C_MASTER_NACK);
-    i2c_master_stop(c);
-    esp_err_t err = i2c_master_cmd_begin(I2C_PORT, c, pdMS_TO_TICKS(200));
-    i2c_cmd_link_delete(c);
+    esp_err_t err = i2c_bus_read(s_bh_dev, s_rx, 2);
     if (err != ESP_OK) return err;
-    uint16_t raw = ((uint16_t)data[0] << 8) | data[1];
+    uint16_t raw = ((uint16_t)s_rx[0] << 8) | s_rx[1];
     float val = raw / 1.2f;
     if (lux) *lux = val;
     return ESP_OK;
@@ -144,8 +145,8 @@ static esp_err_t bh1750_read(float *lux) {
 
 // ---- BME280 (temperature) ----
 static esp_err_t bme280_read_calib(void) {
-    uint8_t buf[6];
-    esp_err_t err = i2c_read_bytes(BME280_ADDR, BME280_REG_CALIB00, buf, 6);
+    uint8_t *buf = s_rx;
+    esp_err_t err = i2c_bus_read_reg(s_bme_dev, BME280_REG_CALIB00, buf, 6);
     if (err != ESP_OK) return err;
     dig_T1 = (uint16_t)(buf[1]<<8 | buf[0]);
     dig_T2 = (int16_t)(buf[3]<<8 | buf[2]);
@@ -155,26 +156,26 @@ static esp_err_t bme280_read_calib(void) {
 
 static esp_err_t bme280_init(void) {
     uint8_t id = 0;
-    i2c_read_bytes(BME280_ADDR, BME280_REG_ID, &id, 1);
+    esp_err_t err = i2c_bus_read_reg(s_bme_dev, BME280_REG_ID, &id, 1);
+    if (err != ESP_OK) return err;
     ESP_LOGI(TAG, "BME280 ID=0x%02X", id);
-    ESP_ERROR_CHECK(bme280_read_calib());
+    err = bme280_read_calib();
+    if (err != ESP_OK) return err;
     // humidity oversampling register must be written before ctrl_meas if used; we ignore humidity.
-    // set standby/filter minimal in CONFIG
-    i2c_write_reg(BME280_ADDR, BME280_REG_CONFIG, 0x00);
-    return ESP_OK;
+    // CONFIG is only honoured in sleep mode, so write it before starting normal mode.
+    err = i2c_bus_write_reg(s_bme_dev, BME280_REG_CONFIG, BME280_CONFIG_VAL);
+    if (err != ESP_OK) return err;
+    return i2c_bus_write_reg(s_bme_dev, BME280_REG_CTRL_MEAS, BME280_OSRS_T_x1 | BME280_MODE_NORMAL);
 }
 
-// Returns degC in *t_c
+// Returns degC in *t_c (latest normal-mode conversion, IIR filtered). The
+// whole data block is read in one burst, which also guarantees press/temp/hum
+// come from the same conversion; only temperature is enabled and compensated.
 static esp_err_t bme280_read_temp(float *t_c) {
-    // set forced mode with temp oversampling x1
-    ESP_ERROR_CHECK(i2c_write_reg(BME280_ADDR, BME280_REG_CTRL_MEAS, BME280_OSRS_T_x1 | BME280_MODE_FORCED));
-    // wait for measurement, typically < 10ms
-    vTaskDelay(pdMS_TO_TICKS(10));
-
-    uint8_t buf[3];
-    esp_err_t err = i2c_read_bytes(BME280_ADDR, BME280_REG_TEMP_MSB, buf, 3);
+    esp_err_t err = i2c_bus_read_reg(s_bme_dev, BME280_REG_DATA, s_rx, BME280_DATA_LEN);
     if (err != ESP_OK) return err;
 
+    const uint8_t *buf = s_rx + 3;   // temp_msb, temp_lsb, temp_xlsb
     int32_t adc_T = ((int32_t)buf[0] << 12) | ((int32_t)buf[1] << 4) | ((buf[2] >> 4) & 0x0F);
 
     // compensation from datasheet
@@ -189,15 +190,20 @@ static esp_err_t bme280_read_temp(float *t_c) {
 
 // ---- PIR ----
 static void IRAM_ATTR pir_isr(void *arg) {
-    int level = gpio_get_level(PIR_GPIO);
-    bool motion = (level != 0);
-    s_motion_instant = motion;
-    if (motion) {
-        s_motion_latched = true;
+    int64_t t = esp_timer_get_time();
+    bool level = gpio_get_level(PIR_GPIO) != 0;
+    if (!pir_ring_push(&s_pir_ring, t, level)) s_pir_overflows++;
+
+    TaskHandle_t task = s_wake_task;
+    if (task) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(task, &woken);
+        portYIELD_FROM_ISR(woken);
     }
 }
 
-static void pir_init(void) {
+// Returns the pin level at the time the ISR was armed.
+static bool pir_init(void) {
     gpio_config_t io = {
         .pin_bit_mask = (1ULL << PIR_GPIO),
         .mode = GPIO_MODE_INPUT,
@@ -206,9 +212,6 @@ static void pir_init(void) {
         .intr_type = GPIO_INTR_ANYEDGE
     };
     ESP_ERROR_CHECK(gpio_config(&io));
-    int lvl = gpio_get_level(PIR_GPIO);
-    s_motion_instant = (lvl != 0);
-    s_motion_latched = s_motion_latched || s_motion_instant;
 
     static bool isr_installed = false;
     if (!isr_installed) {
@@ -216,56 +219,218 @@ static void pir_init(void) {
         isr_installed = true;
     }
     ESP_ERROR_CHECK(gpio_isr_handler_add(PIR_GPIO, pir_isr, NULL));
+    return gpio_get_level(PIR_GPIO) != 0;
+}
+
+static void slot_timer_cb(void *arg) {
+    (void)arg;
+    TaskHandle_t task = s_wake_task;
+    if (task) xTaskNotifyGive(task);
+}
+
+static void sched_started(sensor_sched_t *s, int64_t now, uint32_t first_ms) {
+    s->next_us = now + (int64_t)(s->present ? first_ms : SENSORS_RETRY_MS) * 1000;
+}
+
+// Brings up the bus and the device handles if a previous try failed; a
+// no-op once both handles exist. Called before every sensor probe, so a bus
+// that fails at boot is retried with the sensors every SENSORS_RETRY_MS.
+static void bus_attach(void) {
+    if (s_bh_dev && s_bme_dev) return;
+    if (i2c_bus_init(I2C_SDA, I2C_SCL) != ESP_OK) return;
+    if (!s_bh_dev)  s_bh_dev  = i2c_bus_device(BH1750_ADDR);
+    if (!s_bme_dev) s_bme_dev = i2c_bus_device(BME280_ADDR);
 }
 
 // ===== Public API =====
 void sensors_init(void) {
-    ESP_ERROR_CHECK(i2c_master_init());
+    // A bus that fails to come up leaves both sensors absent; bus and
+    // sensors are retried every SENSORS_RETRY_MS like a missing part.
+    bus_attach();
+    int64_t now = esp_timer_get_time();
     // try BH1750, don't fail hard
-    if (bh1750_init() != ESP_OK) {
+    s_bh1750.present = (bh1750_init() == ESP_OK);
+    if (!s_bh1750.present) {
         ESP_LOGW(TAG, "BH1750 init failed");
     }
-    if (bme280_init() != ESP_OK) {
+    s_bme280.present = (bme280_init() == ESP_OK);
+    if (!s_bme280.present) {
         ESP_LOGW(TAG, "BME280 init failed");
     }
-    pir_init();
+    sched_started(&s_bh1750, now, BH1750_FIRST_MS);
+    // first normal-mode conversion completes ~4 ms after ctrl_meas
+    sched_started(&s_bme280, now, 10);
+    bool level = pir_init();
+    const esp_timer_create_args_t timer = {
+        .callback = slot_timer_cb,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "sensor_slot",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer, &s_slot_timer));
+    window_stats_begin(&s_win, now);
+    motion_track_init(&s_motion, now, level, MOTION_DEBOUNCE_US);
+}
+
+// True if s is due at now. A present sensor's next slot stays on its period
+// grid; slots a late tick missed altogether are skipped, never read back to
+// back. An absent one is probed again SENSORS_RETRY_MS from now.
+static bool sched_due(sensor_sched_t *s, int64_t now) {
+    if (now < s->next_us) return false;
+    if (!s->present) {
+        s->next_us = now + (int64_t)SENSORS_RETRY_MS * 1000;
+        return true;
+    }
+    int64_t period = (int64_t)s->period_ms * 1000;
+    s->next_us += period;
+    if (s->next_us <= now) s->next_us += ((now - s->next_us) / period + 1) * period;
+    return true;
+}
+
+// Earliest read slot of the present sensors, INT64_MAX if none.
+static int64_t sched_slot(void) {
+    int64_t slot = INT64_MAX;
+    if (s_bh1750.present && s_bh1750.next_us < slot) slot = s_bh1750.next_us;
+    if (s_bme280.present && s_bme280.next_us < slot) slot = s_bme280.next_us;
+    return slot;
 }
 
-void sensors_sample_tick(void) {
+uint32_t sensors_sample_tick(void) {
+    int64_t now = esp_timer_get_time();
+    bool got_lux = false, got_temp = false;
+
+    // How late this tick runs behind the slot that woke it (none for a PIR
+    // wake-up between slots).
+    int64_t slot = sched_slot();
+    if (now >= slot) metrics_hist_add(METRIC_H_SAMPLE_LATE, (uint32_t)(now - slot));
+
     // --- BH1750 ---
-    float lux;
-    if (bh1750_read(&lux) == ESP_OK) {
-        s_latest_lux = lux;
+    if (sched_due(&s_bh1750, now)) {
+        float lux;
+        if (!s_bh1750.present) {
+            bus_attach();
+            s_bh1750.present = (bh1750_init() == ESP_OK);
+            if (s_bh1750.present) {
+                ESP_LOGI(TAG, "BH1750 detected");
+                sched_started(&s_bh1750, now, BH1750_FIRST_MS);
+            }
+        } else if (bh1750_read(&lux) == ESP_OK) {
+            s_latest_lux = lux;
+            s_lux_us = now;
+            s_stats.bh1750_reads++;
+            got_lux = true;
+        }
     }
 
     // --- BME280 temp ---
-    float t;
-    if (bme280_read_temp(&t) == ESP_OK) {
-        s_latest_temp_c = t;
+    if (sched_due(&s_bme280, now)) {
+        float t;
+        if (!s_bme280.present) {
+            bus_attach();
+            s_bme280.present = (bme280_init() == ESP_OK);
+            if (s_bme280.present) {
+                ESP_LOGI(TAG, "BME280 detected");
+                sched_started(&s_bme280, now, 10);
+            }
+        } else if (bme280_read_temp(&t) == ESP_OK) {
+            s_latest_temp_c = t;
+            s_temp_us = now;
+            s_stats.bme280_reads++;
+            got_temp = true;
+        }
     }
 
-    // --- PIR poll fallback ---
-    int lvl = gpio_get_level(PIR_GPIO);
-    bool now_motion = (lvl != 0);
-    static bool prev = false;
-    if (now_motion != prev) {
-        prev = now_motion;
-        s_motion_instant = now_motion;
-        if (now_motion) s_motion_latched = true;
-        ESP_LOGI(TAG, "PIR %s", now_motion ? "HIGH (motion)" : "LOW (no motion)");
+    // --- PIR edges queued by the ISR ---
+    pir_edge_t e;
+    uint32_t edges = 0;
+    portENTER_CRITICAL(&s_win_mux);
+    while (pir_ring_pop(&s_pir_ring, &e)) {
+        motion_track_edge(&s_motion, e.t_us, e.level);
+        edges++;
     }
+    motion_track_advance(&s_motion, now);
+    int64_t settle_us = motion_track_pending_us(&s_motion, now);
+    if (got_lux)  stat_acc_add(&s_win.lux, s_latest_lux);
+    if (got_temp) stat_acc_add(&s_win.temp, s_latest_temp_c);
+    portEXIT_CRITICAL(&s_win_mux);
+    s_stats.pir_edges += edges;
+
+    // Come back at the next slot, or when a pending PIR change has held for
+    // the debounce time. Absent sensors' retries count as slots too.
+    int64_t next = s_bh1750.next_us < s_bme280.next_us ? s_bh1750.next_us : s_bme280.next_us;
+    if (settle_us >= 0 && now + settle_us < next) next = now + settle_us;
+    int64_t t = esp_timer_get_time();   // the reads above took bus time
+    int64_t wait_us = next > t ? next - t : 1;
+    esp_timer_stop(s_slot_timer);       // ESP_ERR_INVALID_STATE once it has fired
+    esp_timer_start_once(s_slot_timer, (uint64_t)wait_us);
+    return (uint32_t)((wait_us + 999) / 1000);
 }
 
 void sensors_get_latest(float *t_c, float *lux, bool *motion_instant) {
     if (t_c) *t_c = s_latest_temp_c;
     if (lux) *lux = s_latest_lux;
-    if (motion_instant) *motion_instant = s_motion_instant;
+    if (motion_instant) *motion_instant = s_motion.level;
+}
+
+void sensors_get_snapshot(sensors_snapshot_t *out) {
+    out->temp_c  = s_latest_temp_c;
+    out->lux     = s_latest_lux;
+    out->motion  = s_motion.level;
+    out->temp_us = s_temp_us;
+    out->lux_us  = s_lux_us;
+}
+
+void sensors_get_stats(sensors_stats_t *out) {
+    i2c_bus_stats_t bus;
+    i2c_bus_get_stats(&bus);
+    *out = s_stats;
+    out->i2c_xfers  = bus.xfers;
+    out->i2c_errors = bus.errors;
+    out->i2c_resets = bus.resets;
+    out->pir_overflows = s_pir_overflows;
+}
+
+static void acc_out(const stat_acc_t *a, float latest, uint32_t *n,
+                    float *min, float *max, float *mean, float *var) {
+    *n = a->n;
+    if (a->n == 0) {
+        *min = *max = *mean = latest;
+        *var = 0.0f;
+        return;
+    }
+    *min  = a->min;
+    *max  = a->max;
+    *mean = a->mean;
+    *var  = stat_acc_var(a);
 }
 
-bool sensors_get_motion_latched(void) {
-    return s_motion_latched;
+void sensors_take_window(sensors_window_t *out) {
+    int64_t now = esp_timer_get_time();
+    window_stats_t w;
+    motion_window_t m;
+    int64_t start;
+
+    portENTER_CRITICAL(&s_win_mux);
+    w = s_win;
+    start = s_motion.win_start;
+    motion_track_take(&s_motion, now, &m);
+    window_stats_begin(&s_win, now);
+    portEXIT_CRITICAL(&s_win_mux);
+
+    acc_out(&w.temp, s_latest_temp_c, &out->temp_n,
+            &out->temp_min, &out->temp_max, &out->temp_mean, &out->temp_var);
+    acc_out(&w.lux, s_latest_lux, &out->lux_n,
+            &out->lux_min, &out->lux_max, &out->lux_mean, &out->lux_var);
+    out->end_us          = now;
+    out->motion          = m.motion;
+    out->motion_s        = (float)m.occupied_us / 1e6f;
+    out->motion_duty     = now > start ? (float)m.occupied_us / (float)(now - start)
+                                       : (m.motion ? 1.0f : 0.0f);
+    out->motion_first_us = m.first_us;
+    out->motion_last_us  = m.last_us;
+    out->motion_edges    = m.edges;
+    out->motion_glitches = m.glitches;
 }
 
-void sensors_clear_motion_latch(void) {
-    s_motion_latched = false;
+void sensors_set_wake_task(TaskHandle_t task) {
+    s_wake_task = task;
 }
@@ -2,6 +2,9 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -10,18 +13,66 @@ extern "C" {
 // Initialize I2C + all sensors (BH1750 + BME280 + PIR).
 void sensors_init(void);
 
-// Called periodically to keep readings fresh.
-void sensors_sample_tick(void);
+// Called to keep readings fresh. Each sensor is read on a fixed grid of its
+// conversion period, counted from init, so the read rate does not drift with
+// how late a call runs; calling this between slots costs no bus traffic.
+// Also drains the PIR edges queued by the ISR. Arms an esp_timer for the
+// next slot or PIR settle time and returns ms until then.
+uint32_t sensors_sample_tick(void);
 
-// Get latest instantaneous values (no latch here).
+// Task to notify (xTaskNotifyGive) when the next slot's timer fires and from
+// the PIR ISR when an edge is queued; it should call sensors_sample_tick()
+// on wake-up. NULL disables both.
+void sensors_set_wake_task(TaskHandle_t task);
+
+// Get latest values; motion is the debounced PIR level.
 // Any of the output pointers may be NULL if not needed.
 void sensors_get_latest(float *t_c, float *lux, bool *motion_instant);
 
-// --- Motion latch API ---
-// true if motion occurred at any time since last clear()
-// Reset after successful upload
-bool sensors_get_motion_latched(void);
-void sensors_clear_motion_latch(void);
+// Latest values with freshness: *_us is the esp_timer time (µs since boot)
+// of the read that produced the value, 0 if the sensor never answered.
+typedef struct {
+    float   temp_c;
+    float   lux;
+    bool    motion;
+    int64_t temp_us;
+    int64_t lux_us;
+} sensors_snapshot_t;
+
+void sensors_get_snapshot(sensors_snapshot_t *out);
+
+typedef struct {
+    uint32_t i2c_xfers;      // I2C transactions issued (incl. init)
+    uint32_t i2c_errors;     // transactions that failed
+    uint32_t i2c_resets;     // bus clears after a timeout or repeated errors
+    uint32_t pir_edges;      // raw PIR edges taken from the ISR queue
+    uint32_t pir_overflows;  // edges dropped because the ISR queue was full
+    uint32_t bh1750_reads;   // successful BH1750 reads
+    uint32_t bme280_reads;   // successful BME280 reads
+} sensors_stats_t;
+
+void sensors_get_stats(sensors_stats_t *out);
+
+// Statistics over every reading taken since the previous call; a new window
+// starts on return. *_n is 0 if the sensor produced nothing in the window,
+// in which case min/max/mean hold the latest cached value and var is 0.
+// Motion comes from debounced PIR edges timestamped in the ISR.
+typedef struct {
+    uint32_t temp_n;
+    float    temp_min, temp_max, temp_mean, temp_var;
+    uint32_t lux_n;
+    float    lux_min, lux_max, lux_mean, lux_var;
+    int64_t  end_us;          // esp_timer time the window closed
+    bool     motion;          // PIR high at any time in the window
+    float    motion_s;        // occupied seconds (PIR high)
+    float    motion_duty;     // motion_s over the window length, 0..1
+    int64_t  motion_first_us; // first instant with PIR high, -1 if none
+    int64_t  motion_last_us;  // last instant with PIR high, -1 if none
+    uint32_t motion_edges;    // debounced rising PIR edges
+    uint32_t motion_glitches; // PIR pulses shorter than MOTION_DEBOUNCE_US
+} sensors_window_t;
+
+void sensors_take_window(sensors_window_t *out);
 
 #ifdef __cplusplus
 }
@@ -1,13 +1,45 @@
 #include "time_sync.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "metrics.h"
 
 #include "lwip/apps/sntp.h"   // LWIP SNTP (works across IDF 5.x)
+#include "esp_sntp.h"         // sntp_set_time_sync_notification_cb
+#include <stdatomic.h>
+#include <sys/time.h>
 #include <time.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>   // for setenv()
 
 static const char *TAG = "TIME_SYNC";
 static bool s_started = false;
+static _Atomic uint32_t s_boot_s;
+static void (*s_on_set)(uint32_t boot_s);
+
+#define TIME_SYNC_VALID_S 1700000000   // ~2023-11-14; earlier = never set
+
+uint32_t time_sync_boot_s(void) { return s_boot_s; }
+
+void time_sync_on_set(void (*fn)(uint32_t boot_s))
+{
+    s_on_set = fn;
+    uint32_t b = s_boot_s;
+    if (fn && b) fn(b);
+}
+
+// The wall clock is valid: remember when, in its terms, the device booted.
+// SNTP task context (or time_sync_start()).
+static void on_sync(struct timeval *tv)
+{
+    int64_t boot_us = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec - esp_timer_get_time();
+    uint32_t b = (uint32_t)(boot_us / 1000000);
+    bool first = s_boot_s == 0;
+    s_boot_s = b;
+    metrics_boot_mark(METRIC_B_FIRST_SYNC);
+    if (first) ESP_LOGI(TAG, "Clock set: booted at unix %u", (unsigned)b);
+    if (s_on_set) s_on_set(b);
+}
 
 void time_sync_start(void)
 {
@@ -19,7 +51,11 @@ void time_sync_start(void)
     sntp_setservername(1, "time.google.com");
     sntp_setservername(2, "time.windows.com");
 
-    // Start SNTP (non-blocking; time will update asynchronously)
+    // Start SNTP (non-blocking; time will update asynchronously). A clock
+    // that survived a software reset is good until the first sync.
+    sntp_set_time_sync_notification_cb(on_sync);
+    struct timeval tv = { .tv_sec = time(NULL) };
+    if (tv.tv_sec >= TIME_SYNC_VALID_S) on_sync(&tv);
     sntp_init();
     s_started = true;
     ESP_LOGI(TAG, "SNTP started via LWIP");
@@ -42,7 +78,7 @@ void time_sync_fmt(char *out, size_t out_len)
     time(&now);
 
     // If not yet synced, time_t may be near 0
-    if (now < 1700000000) { // ~2023-11-14 epoch; simple "not synced yet" heuristic
+    if (now < TIME_SYNC_VALID_S) { // simple "not synced yet" heuristic
         snprintf(out, out_len, "UNSYNCED");
         return;
     }
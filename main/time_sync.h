@@ -1,6 +1,7 @@
 #pragma once
 #include <stdbool.h>
 #include <stddef.h>   // <-- needed for size_t
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -9,6 +10,14 @@ extern "C" {
 void time_sync_start(void);                    // start SNTP (non-blocking)
 void time_sync_fmt(char *buf, size_t n);       // "YYYY-MM-DD HH:MM:SS" UTC or "UNSYNCED"
 
+// Unix time at esp_timer 0 (boot), from the last SNTP sync or from a clock
+// already valid at time_sync_start(); 0 while the wall clock is unknown.
+uint32_t time_sync_boot_s(void);
+
+// Called with time_sync_boot_s() whenever it is set: from the SNTP task, or
+// at once if it is already known. One hook; keep it short.
+void time_sync_on_set(void (*fn)(uint32_t boot_s));
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,64 @@
+// main/transport.h — how uploader.c gets a batch to the server
+//
+// The uploader builds and encodes batches and releases them from the backlog
+// once acknowledged; a transport only moves bytes. Batches are submitted in
+// order and answered in the same order. Up to `window` may be in flight at
+// once, so a transport that can pipeline (MQTT) is not held to one round trip
+// per batch. Sender task only.
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "payload_json.h"   // payload_sink_t
+#include "flow_ctl.h"       // flow_directive_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    bool        cbor;       // application/cbor, else application/json
+    bool        gzip;
+    size_t      len;        // body bytes, exactly what write() produces
+    const char *health;     // base64 health record to send along, or NULL
+    // Produces the body; valid only during submit().
+    esp_err_t (*write)(payload_sink_t sink, void *ctx);
+} transport_batch_t;
+
+typedef struct {
+    int      status;        // HTTP-style: 2xx = accepted
+    bool     reused;        // went over a connection that was already open
+    uint32_t latency_us;    // submit → answer
+    flow_directive_t dir;   // server directives that came with the answer
+} transport_result_t;
+
+typedef struct transport {
+    const char *name;
+    int         window;     // batches in flight at once, >= 1
+    size_t      max_len;    // largest body it takes; 0 = no limit
+    bool        resends;    // keeps batches in flight across a lost
+                            // connection and sends them again itself
+
+    void      (*init)(const char *url);      // drops any connection
+    void      (*set_cert)(const char *pem);  // NULL = CA bundle
+    // ESP_OK: the batch is in flight. Anything else: it was not sent, and
+    // the ones already in flight are unaffected.
+    esp_err_t (*submit)(const transport_batch_t *b);
+    // Answer for the oldest batch in flight. ESP_ERR_TIMEOUT: none within
+    // wait_ms, nothing changed; with `resends` they are all still in flight.
+    // Any other error: the connection was lost and every batch in flight
+    // with it.
+    esp_err_t (*poll)(uint32_t wait_ms, transport_result_t *r);
+    // Forget every batch in flight (the uploader will send them again). A
+    // transport that resends makes sure it no longer will.
+    void      (*reset)(void);
+    uint32_t  (*connects)(void);             // handshakes so far
+} transport_t;
+
+extern const transport_t transport_http;     // HTTPS POST, one batch per request
+extern const transport_t transport_mqtt;     // MQTT over TLS, QoS1 (transport_mqtt.c)
+
+#ifdef __cplusplus
+}
+#endif
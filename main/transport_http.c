@@ -0,0 +1,245 @@
+// main/transport_http.c — batches as HTTPS POSTs (see transport.h)
+//
+// One POST per batch, so the window is 1: submit() runs the whole request and
+// poll() hands back its answer. Directives come from the response headers
+// and the start of the body.
+#include "transport.h"
+#include "metrics.h"
+#include "binlog.h"
+#include <string.h>
+#include <strings.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+#include "esp_timer.h"
+
+static const char *TAG = "UPLOADER";
+static char s_url[128] = {0};
+
+// One long-lived client: the TCP/TLS connection is kept open between batches
+// and, when it does drop, the saved TLS session makes the reconnect cheap.
+static esp_http_client_handle_t s_client = NULL;
+static const char *s_cert_pem = NULL;          // pinned cert; NULL = CA bundle
+static bool s_connected = false;               // a connection is open
+static bool s_conn_close = false;              // server asked to close
+// Headers as last set on s_client. The client copies every value it is
+// given to the heap, so they are only set when they change.
+static int8_t s_hdr_cbor = -1;                 // Content-Type; -1 = not set
+static int8_t s_hdr_gzip = -1;                 // Content-Encoding: gzip
+static bool   s_hdr_health = false;
+static uint32_t s_connects;
+// Answer of the last POST, until poll() takes it
+static transport_result_t s_res;
+static bool s_have_res = false;
+static char s_resp[FLOW_CTL_BODY_MAX];
+
+static void http_drop(void)
+{
+    if (s_client) {
+        esp_http_client_cleanup(s_client);
+        s_client = NULL;
+        s_connected = false;
+    }
+    s_hdr_cbor = s_hdr_gzip = -1;
+    s_hdr_health = false;
+}
+
+static esp_http_client_handle_t client_get(void);
+
+static void http_init(const char *url)
+{
+    http_drop();
+    s_have_res = false;
+    if (url) {
+        size_t n = strlen(url);
+        if (n >= sizeof(s_url)) n = sizeof(s_url)-1;
+        memcpy(s_url, url, n);
+        s_url[n] = '\0';
+    }
+    if (s_url[0]) client_get();   // now, while boot allocations are free
+}
+
+static void http_set_cert(const char *pem)
+{
+    s_cert_pem = pem;
+    http_drop();   // re-create with the new trust settings
+    if (s_url[0]) client_get();
+}
+
+// payload_sink_t that streams into the open HTTP connection.
+static esp_err_t http_sink(void *ctx, const char *data, size_t len)
+{
+    esp_http_client_handle_t h = (esp_http_client_handle_t)ctx;
+    while (len > 0) {
+        int w = esp_http_client_write(h, data, (int)len);
+        if (w <= 0) return ESP_FAIL;
+        data += w;
+        len  -= (size_t)w;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t http_event_handler(esp_http_client_event_t *evt)
+{
+    switch (evt->event_id) {
+        case HTTP_EVENT_ON_CONNECTED:
+            s_connects++;   // one per TCP + TLS handshake
+            metrics_count(METRIC_C_CONNECTS, 1);
+            s_connected = true;
+            break;
+        case HTTP_EVENT_DISCONNECTED:
+            s_connected = false;
+            break;
+        case HTTP_EVENT_ON_HEADER:
+            if (strcasecmp(evt->header_key, "Connection") == 0 &&
+                strcasecmp(evt->header_value, "close") == 0) {
+                s_conn_close = true;
+            } else {
+                // Retry-After, X-AulaSense-Accept: applied once the response is in
+                flow_ctl_header(&s_res.dir, evt->header_key, evt->header_value);
+            }
+            break;
+        default:
+            break;
+    }
+    return ESP_OK;
+}
+
+static esp_http_client_handle_t client_get(void)
+{
+    if (s_client) return s_client;
+
+    esp_http_client_config_t cfg = {
+        .url = s_url,
+        .method = HTTP_METHOD_POST,
+        .transport_type = HTTP_TRANSPORT_OVER_SSL,
+        .skip_cert_common_name_check = false,
+        .timeout_ms = 10000,
+        .event_handler = http_event_handler,
+        .keep_alive_enable = true,      // TCP keep-alive probes spot dead links
+        .keep_alive_idle = 30,
+        .keep_alive_interval = 5,
+        .keep_alive_count = 3,
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+        .save_client_session = true,    // resume TLS instead of a full handshake
+#endif
+    };
+    if (s_cert_pem) {
+        cfg.cert_pem = s_cert_pem;      // pinned: skip the CA bundle walk
+    } else {
+        cfg.crt_bundle_attach = esp_crt_bundle_attach; // use built-in CA bundle
+    }
+
+    s_client = esp_http_client_init(&cfg);
+    return s_client;
+}
+
+// One POST of the batch over the shared client; s_res.status is set when a
+// response was received.
+static esp_err_t post_batch(esp_http_client_handle_t h, const transport_batch_t *b)
+{
+    s_conn_close = false;
+    s_res.status = 0;
+    flow_directive_init(&s_res.dir);
+    if (s_hdr_cbor != b->cbor) {
+        esp_http_client_set_header(h, "Content-Type", b->cbor ? "application/cbor" : "application/json");
+        s_hdr_cbor = b->cbor;
+    }
+    if (s_hdr_gzip != b->gzip) {
+        if (b->gzip) {
+            esp_http_client_set_header(h, "Content-Encoding", "gzip");
+        } else {
+            esp_http_client_delete_header(h, "Content-Encoding");
+        }
+        s_hdr_gzip = b->gzip;
+    }
+    if (b->health) {
+        esp_http_client_set_header(h, "X-AulaSense-Health", b->health);
+    } else if (s_hdr_health) {
+        esp_http_client_delete_header(h, "X-AulaSense-Health");
+    }
+    s_hdr_health = b->health != NULL;
+
+    // Time the handshake (only when open has to connect) apart from the transfer.
+    uint32_t connects = s_connects;
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = esp_http_client_open(h, (int)b->len);
+    int64_t t1 = esp_timer_get_time();
+    if (s_connects != connects) {
+        metrics_hist_add(METRIC_H_UPLOAD_CONNECT, (uint32_t)(t1 - t0));
+    }
+    if (err == ESP_OK) {
+        // Stream the body straight from the batch; no full copy is ever built.
+        err = b->write(http_sink, h);
+    }
+    if (err == ESP_OK && esp_http_client_fetch_headers(h) < 0) {
+        err = ESP_FAIL;
+    }
+    if (err == ESP_OK) {
+        metrics_hist_add(METRIC_H_UPLOAD_XFER, (uint32_t)(esp_timer_get_time() - t1));
+        s_res.status = esp_http_client_get_status_code(h);
+        int len = (int)esp_http_client_get_content_length(h);
+        // The start of the body may hold directives; the rest is discarded
+        // to leave the connection reusable.
+        int got = 0, r;
+        while (got < (int)sizeof(s_resp) &&
+               (r = esp_http_client_read(h, s_resp + got, (int)sizeof(s_resp) - got)) > 0) {
+            got += r;
+        }
+        esp_http_client_flush_response(h, NULL);
+        flow_ctl_body(&s_res.dir, s_resp, (size_t)got);
+        BINLOG(UP_STATUS, s_res.status, len);
+    }
+    if (err != ESP_OK || s_conn_close) {
+        esp_http_client_close(h);   // keeps the handle and the TLS session
+        s_connected = false;
+    }
+    return err;
+}
+
+static esp_err_t http_submit(const transport_batch_t *b)
+{
+    if (s_url[0] == '\0') return ESP_ERR_INVALID_ARG;
+    esp_http_client_handle_t h = client_get();
+    if (!h) return ESP_ERR_NO_MEM;
+
+    int64_t t0 = esp_timer_get_time();
+    bool reused = s_connected;
+    uint32_t connects = s_connects;
+    esp_err_t err = post_batch(h, b);
+    if (err != ESP_OK && reused) {
+        // The kept-alive connection was stale (server idle timeout); retry once
+        // on a fresh one before calling it a failure.
+        ESP_LOGW(TAG, "Reused connection failed (%s) — reconnecting", esp_err_to_name(err));
+        err = post_batch(h, b);
+    }
+    s_res.latency_us = (uint32_t)(esp_timer_get_time() - t0);
+    s_res.reused = s_connects == connects;
+    s_have_res = err == ESP_OK;
+    return err;
+}
+
+static esp_err_t http_poll(uint32_t wait_ms, transport_result_t *r)
+{
+    if (!s_have_res) return ESP_ERR_INVALID_STATE;
+    *r = s_res;
+    s_have_res = false;
+    return ESP_OK;
+}
+
+static void http_reset(void) { s_have_res = false; }
+
+static uint32_t http_connects(void) { return s_connects; }
+
+const transport_t transport_http = {
+    .name     = "https",
+    .window   = 1,
+    .max_len  = 0,
+    .init     = http_init,
+    .set_cert = http_set_cert,
+    .submit   = http_submit,
+    .poll     = http_poll,
+    .reset    = http_reset,
+    .connects = http_connects,
+};
@@ -0,0 +1,378 @@
+// main/transport_mqtt.c — batches as MQTT publishes over one session (see transport.h)
+//
+// One long-lived MQTT-over-TLS session (esp-mqtt). Each batch is a QoS1
+// publish to aulasense/<building>/<room>/samples/<json|cbor>[.gz]; its
+// PUBACK is the acknowledgement, so up to TRANSPORT_MQTT_WINDOW batches are
+// in flight at once instead of one round trip each. The health record goes
+// ahead of its batch at QoS0 on .../health.
+//
+// The server pushes directives (flow_ctl.h JSON) on .../ctl at any time, not
+// only in answer to an upload; they are handed to the uploader with the next
+// acknowledgement. The session is persistent (clean session off), so the
+// broker keeps them while the device is away.
+//
+// The session is persistent, so esp-mqtt keeps each unacknowledged publish
+// in its outbox across a lost connection and sends it again, same msg_id,
+// when it reconnects. A batch in flight stays in flight until that PUBACK
+// comes; only once esp-mqtt gives it up (outbox expiry, MQTT_EVENT_DELETED)
+// and holds none of the others does poll() report the loss, so the
+// uploader's copy never goes out next to the outbox's. Delivery is still at
+// least once: a batch the broker took but whose PUBACK never came back is
+// sent again by the uploader, and the server may see it twice.
+#include "transport.h"
+#include "device_id.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_crt_bundle.h"
+#include "mqtt_client.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifndef TRANSPORT_MQTT_WINDOW
+#define TRANSPORT_MQTT_WINDOW      4      // publishes awaiting PUBACK at once
+#endif
+#ifndef TRANSPORT_MQTT_MAX_BODY
+#define TRANSPORT_MQTT_MAX_BODY    8192   // staging buffer; bigger batches are split
+#endif
+#ifndef TRANSPORT_MQTT_KEEPALIVE_S
+#define TRANSPORT_MQTT_KEEPALIVE_S 120
+#endif
+#ifndef TRANSPORT_MQTT_CONNECT_MS
+#define TRANSPORT_MQTT_CONNECT_MS  10000  // submit() waits this long for the session
+#endif
+
+#define STRAY_MAX 4
+
+static const char *TAG = "MQTT";
+static char s_url[128] = {0};
+static const char *s_cert_pem = NULL;          // pinned cert; NULL = CA bundle
+static char s_client_id[48];
+static char s_topic[64];                       // "aulasense/<building>/<room>"
+static char s_ctl_topic[72];
+static esp_mqtt_client_handle_t s_client = NULL;
+static char s_stage[TRANSPORT_MQTT_MAX_BODY];  // body of the batch being published
+
+// Shared with the esp-mqtt task, under s_mux. Publishes are acknowledged
+// in order, but any PUBACK is matched by msg_id.
+typedef struct {
+    int     msg_id;
+    int64_t sent_us;
+    int64_t acked_us;                          // 0 = not yet
+    bool    reused;
+    bool    gone;                              // expired from the outbox unacknowledged
+} flight_t;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static flight_t s_fly[TRANSPORT_MQTT_WINDOW];
+static int s_nfly;
+static int s_stray[STRAY_MAX];                 // PUBACKs that beat publish()'s return
+static bool s_connected;
+static bool s_lost;                            // a batch in s_fly is gone
+static int64_t s_connect_us;                   // start of the current attempt
+static uint32_t s_connects;
+static flow_directive_t s_dir;                 // from .../ctl, not handed out yet
+static TaskHandle_t s_waiter;
+
+static void wake(void)
+{
+    TaskHandle_t t = s_waiter;
+    if (t) xTaskNotifyGive(t);
+}
+
+static void on_acked(int msg_id)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_mux);
+    int i = 0;
+    while (i < s_nfly && s_fly[i].msg_id != msg_id) ++i;
+    if (i < s_nfly) {
+        s_fly[i].acked_us = now;
+    } else {
+        memmove(&s_stray[1], &s_stray[0], (STRAY_MAX - 1) * sizeof(s_stray[0]));
+        s_stray[0] = msg_id;
+    }
+    portEXIT_CRITICAL(&s_mux);
+}
+
+static void on_deleted(int msg_id)
+{
+    portENTER_CRITICAL(&s_mux);
+    for (int i = 0; i < s_nfly; ++i) {
+        if (s_fly[i].msg_id == msg_id && !s_fly[i].acked_us) {
+            s_fly[i].gone = true;
+            s_lost = true;
+        }
+    }
+    portEXIT_CRITICAL(&s_mux);
+}
+
+// Under s_mux: batches in flight that esp-mqtt still holds in its outbox.
+static int queued_locked(void)
+{
+    int n = 0;
+    for (int i = 0; i < s_nfly; ++i) n += !s_fly[i].acked_us && !s_fly[i].gone;
+    return n;
+}
+
+static void on_ctl(const char *data, int len)
+{
+    flow_directive_t d;
+    flow_directive_init(&d);
+    if (!flow_ctl_body(&d, data, (size_t)len)) {
+        ESP_LOGW(TAG, "Ignoring control message (%d bytes)", len);
+        return;
+    }
+    portENTER_CRITICAL(&s_mux);
+    // Later messages win field by field
+    if (d.fields & FLOW_F_RETRY) s_dir.retry_after_ms = d.retry_after_ms;
+    if (d.fields & FLOW_F_INTERVAL) s_dir.set.upload_interval_ms = d.set.upload_interval_ms;
+    if (d.fields & FLOW_F_PUBLISH) s_dir.set.publish_ms = d.set.publish_ms;
+    if (d.fields & FLOW_F_BATCH) s_dir.set.batch_max = d.set.batch_max;
+    if (d.fields & FLOW_F_ENCODING) s_dir.set.encoding = d.set.encoding;
+    s_dir.fields |= d.fields;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+static void mqtt_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    esp_mqtt_event_handle_t evt = data;
+    switch ((esp_mqtt_event_id_t)id) {
+        case MQTT_EVENT_BEFORE_CONNECT:
+            s_connect_us = esp_timer_get_time();
+            break;
+        case MQTT_EVENT_CONNECTED:
+            s_connects++;   // one per TCP + TLS + CONNECT handshake
+            metrics_count(METRIC_C_CONNECTS, 1);
+            metrics_hist_add(METRIC_H_UPLOAD_CONNECT,
+                             (uint32_t)(esp_timer_get_time() - s_connect_us));
+            if (!evt->session_present) esp_mqtt_client_subscribe(s_client, s_ctl_topic, 1);
+            portENTER_CRITICAL(&s_mux);
+            s_connected = true;
+            portEXIT_CRITICAL(&s_mux);
+            wake();
+            break;
+        case MQTT_EVENT_DISCONNECTED:
+            // s_fly stays: the outbox sends it again on reconnect
+            portENTER_CRITICAL(&s_mux);
+            s_connected = false;
+            portEXIT_CRITICAL(&s_mux);
+            wake();
+            break;
+        case MQTT_EVENT_PUBLISHED:
+            on_acked(evt->msg_id);
+            wake();
+            break;
+        case MQTT_EVENT_DELETED:
+            on_deleted(evt->msg_id);
+            wake();
+            break;
+        case MQTT_EVENT_DATA:
+            // Directives are small: a message split over several events is not one
+            if (evt->current_data_offset == 0 && evt->data_len == evt->total_data_len &&
+                evt->topic_len == (int)strlen(s_ctl_topic) &&
+                memcmp(evt->topic, s_ctl_topic, (size_t)evt->topic_len) == 0) {
+                on_ctl(evt->data, evt->data_len);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void mqtt_drop(void)
+{
+    if (s_client) {
+        esp_mqtt_client_destroy(s_client);
+        s_client = NULL;
+    }
+    portENTER_CRITICAL(&s_mux);
+    s_connected = false;
+    s_lost = false;
+    s_nfly = 0;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+static void mqtt_init(const char *url)
+{
+    mqtt_drop();
+    if (url) {
+        size_t n = strlen(url);
+        if (n >= sizeof(s_url)) n = sizeof(s_url)-1;
+        memcpy(s_url, url, n);
+        s_url[n] = '\0';
+    }
+    device_id_t id;
+    device_id_get(&id);
+    snprintf(s_client_id, sizeof(s_client_id), "aulasense-%s-%s", id.building, id.number);
+    snprintf(s_topic, sizeof(s_topic), "aulasense/%s/%s", id.building, id.number);
+    snprintf(s_ctl_topic, sizeof(s_ctl_topic), "%s/ctl", s_topic);
+    flow_directive_init(&s_dir);
+}
+
+static void mqtt_set_cert(const char *pem)
+{
+    s_cert_pem = pem;
+    mqtt_drop();   // re-create with the new trust settings on next send
+}
+
+static esp_mqtt_client_handle_t client_get(void)
+{
+    if (s_client) return s_client;
+
+    esp_mqtt_client_config_t cfg = {
+        .broker.address.uri = s_url,
+        .credentials.client_id = s_client_id,
+        .session = {
+            .keepalive = TRANSPORT_MQTT_KEEPALIVE_S,
+            .disable_clean_session = true,   // keep .../ctl queued while away
+        },
+        .network.timeout_ms = 10000,
+        .buffer.out_size = 2048,             // bigger publishes go out in pieces
+    };
+    if (s_cert_pem) {
+        cfg.broker.verification.certificate = s_cert_pem;        // pinned: skip the CA bundle walk
+    } else {
+        cfg.broker.verification.crt_bundle_attach = esp_crt_bundle_attach;
+    }
+
+    s_client = esp_mqtt_client_init(&cfg);
+    if (!s_client) return NULL;
+    esp_mqtt_client_register_event(s_client, MQTT_EVENT_ANY, mqtt_event_handler, NULL);
+    if (esp_mqtt_client_start(s_client) != ESP_OK) {
+        esp_mqtt_client_destroy(s_client);
+        s_client = NULL;
+    }
+    return s_client;
+}
+
+// Block the calling task until an event handler call or the deadline;
+// false once the deadline has passed.
+static bool wait_until(int64_t deadline_us)
+{
+    int64_t left = deadline_us - esp_timer_get_time();
+    if (left <= 0) return false;
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS((left + 999) / 1000) + 1);
+    return true;
+}
+
+// payload_sink_t into s_stage.
+static esp_err_t stage_sink(void *ctx, const char *data, size_t len)
+{
+    size_t *n = ctx;
+    if (len > sizeof(s_stage) - *n) return ESP_ERR_INVALID_SIZE;
+    memcpy(s_stage + *n, data, len);
+    *n += len;
+    return ESP_OK;
+}
+
+static esp_err_t mqtt_submit(const transport_batch_t *b)
+{
+    if (s_url[0] == '\0') return ESP_ERR_INVALID_ARG;
+    if (b->len > sizeof(s_stage)) return ESP_ERR_INVALID_SIZE;
+    if (s_nfly == TRANSPORT_MQTT_WINDOW) return ESP_ERR_INVALID_STATE;
+    esp_mqtt_client_handle_t c = client_get();
+    if (!c) return ESP_ERR_NO_MEM;
+
+    // The body first: no point in waiting for a session to send nothing.
+    size_t len = 0;
+    esp_err_t err = b->write(stage_sink, &len);
+    if (err != ESP_OK) return err;
+
+    s_waiter = xTaskGetCurrentTaskHandle();
+    int64_t t0 = esp_timer_get_time();
+    bool reused = s_connected;
+    int64_t deadline = t0 + (int64_t)TRANSPORT_MQTT_CONNECT_MS * 1000;
+    while (!s_connected) {
+        if (!wait_until(deadline)) return ESP_ERR_TIMEOUT;
+    }
+    if (s_lost) return ESP_FAIL;   // poll() reports it for those in flight
+
+    char topic[96];
+    if (b->health) {
+        snprintf(topic, sizeof(topic), "%s/health", s_topic);
+        esp_mqtt_client_publish(c, topic, b->health, 0, 0, 0);
+    }
+    snprintf(topic, sizeof(topic), "%s/samples/%s%s", s_topic,
+             b->cbor ? "cbor" : "json", b->gzip ? ".gz" : "");
+    int msg_id = esp_mqtt_client_publish(c, topic, s_stage, (int)len, 1, 0);
+    if (msg_id < 0) return ESP_FAIL;
+
+    portENTER_CRITICAL(&s_mux);
+    flight_t *f = &s_fly[s_nfly++];
+    *f = (flight_t){ .msg_id = msg_id, .sent_us = t0, .reused = reused };
+    for (int i = 0; i < STRAY_MAX; ++i) {
+        if (s_stray[i] == msg_id) {
+            f->acked_us = esp_timer_get_time();
+            s_stray[i] = 0;
+        }
+    }
+    portEXIT_CRITICAL(&s_mux);
+    return ESP_OK;
+}
+
+static esp_err_t mqtt_poll(uint32_t wait_ms, transport_result_t *r)
+{
+    s_waiter = xTaskGetCurrentTaskHandle();
+    int64_t deadline = esp_timer_get_time() + (int64_t)wait_ms * 1000;
+    for (;;) {
+        portENTER_CRITICAL(&s_mux);
+        if (s_nfly == 0) {
+            portEXIT_CRITICAL(&s_mux);
+            return ESP_ERR_INVALID_STATE;
+        }
+        // A lost batch is reported once the outbox holds none of s_fly:
+        // the uploader sends them all again after it.
+        if (!s_fly[0].acked_us && s_lost && queued_locked() == 0) {
+            portEXIT_CRITICAL(&s_mux);
+            return ESP_FAIL;
+        }
+        if (s_fly[0].acked_us) {
+            r->status = 200;
+            r->reused = s_fly[0].reused;
+            r->latency_us = (uint32_t)(s_fly[0].acked_us - s_fly[0].sent_us);
+            r->dir = s_dir;
+            flow_directive_init(&s_dir);
+            memmove(&s_fly[0], &s_fly[1], (size_t)--s_nfly * sizeof(s_fly[0]));
+            portEXIT_CRITICAL(&s_mux);
+            return ESP_OK;
+        }
+        portEXIT_CRITICAL(&s_mux);
+        if (!wait_until(deadline)) return ESP_ERR_TIMEOUT;
+    }
+}
+
+static void mqtt_reset(void)
+{
+    // Whatever the outbox still holds would go out beside the uploader's
+    // copy: drop the client, and its outbox with it.
+    portENTER_CRITICAL(&s_mux);
+    int queued = queued_locked();
+    portEXIT_CRITICAL(&s_mux);
+    if (queued) {
+        ESP_LOGW(TAG, "Dropping %d unacknowledged publish(es) from the outbox", queued);
+        mqtt_drop();
+    }
+    portENTER_CRITICAL(&s_mux);
+    s_nfly = 0;
+    s_lost = false;
+    memset(s_stray, 0, sizeof(s_stray));
+    portEXIT_CRITICAL(&s_mux);
+}
+
+static uint32_t mqtt_connects(void) { return s_connects; }
+
+const transport_t transport_mqtt = {
+    .name     = "mqtt",
+    .window   = TRANSPORT_MQTT_WINDOW,
+    .max_len  = TRANSPORT_MQTT_MAX_BODY,
+    .resends  = true,
+    .init     = mqtt_init,
+    .set_cert = mqtt_set_cert,
+    .submit   = mqtt_submit,
+    .poll     = mqtt_poll,
+    .reset    = mqtt_reset,
+    .connects = mqtt_connects,
+};
@@ -0,0 +1,104 @@
+// main/upload_sched.c — backlog-aware upload pacing
+//
+//  * failure      → exponential backoff with "equal jitter" (half fixed, half
+//                   random), so a fleet that lost the server does not retry
+//                   in lockstep
+//  * backlog high → back-to-back full batches, separated by a short gap
+//  * backlog low  → wait until a batch is worth a POST, bounded in latency
+//  * server pacing → interval_ms between POSTs and Retry-After (defer) hold
+//                   every node back, draining included
+//
+// Pure logic on a caller-supplied millisecond clock, so it runs unchanged
+// against a simulated clock on the host.
+#include "upload_sched.h"
+#include <stddef.h>
+
+static inline bool before(uint32_t a, uint32_t b) { return (int32_t)(a - b) < 0; }
+
+static uint32_t next_rand(upload_sched_t *s)
+{
+    uint32_t x = s->rng;   // xorshift32
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    s->rng = x;
+    return x;
+}
+
+void upload_sched_init(upload_sched_t *s, const upload_sched_cfg_t *cfg, uint32_t seed)
+{
+    if (cfg) {
+        s->cfg = *cfg;
+    } else {
+        s->cfg = (upload_sched_cfg_t){
+            .poll_ms         = UPLOAD_SCHED_POLL_MS,
+            .coalesce_min    = UPLOAD_SCHED_COALESCE_MIN,
+            .coalesce_max_ms = UPLOAD_SCHED_COALESCE_MAX_MS,
+            .drain_gap_ms    = UPLOAD_SCHED_DRAIN_GAP_MS,
+            .backoff_min_ms  = UPLOAD_SCHED_BACKOFF_MIN_MS,
+            .backoff_max_ms  = UPLOAD_SCHED_BACKOFF_MAX_MS,
+            .batch_max       = 1,
+            .interval_ms     = 0,
+        };
+    }
+    s->failures = 0;
+    s->not_before = 0;
+    s->pending_since = 0;
+    s->pending = false;
+    s->rng = seed ? seed : 0x9E3779B9u;
+}
+
+uint32_t upload_sched_due(upload_sched_t *s, uint32_t backlog, uint32_t now_ms)
+{
+    if (before(now_ms, s->not_before)) {
+        return s->not_before - now_ms;
+    }
+    if (backlog == 0) {
+        s->pending = false;
+        return s->cfg.poll_ms;
+    }
+    if (!s->pending) {
+        s->pending = true;
+        s->pending_since = now_ms;
+    }
+
+    // Retrying after a failure, or a full batch is waiting: go now.
+    if (s->failures > 0 || backlog >= s->cfg.batch_max) return 0;
+
+    // Coalesce: send once enough has piled up or the oldest has waited long enough.
+    uint32_t waited = now_ms - s->pending_since;
+    if (backlog >= s->cfg.coalesce_min || waited >= s->cfg.coalesce_max_ms) return 0;
+
+    uint32_t left = s->cfg.coalesce_max_ms - waited;
+    return left < s->cfg.poll_ms ? left : s->cfg.poll_ms;
+}
+
+void upload_sched_report(upload_sched_t *s, bool ok, uint32_t now_ms)
+{
+    if (ok) {
+        s->failures = 0;
+        s->pending = false;   // re-armed by the next due() that sees a backlog
+        s->not_before = now_ms + (s->cfg.interval_ms > s->cfg.drain_gap_ms ? s->cfg.interval_ms
+                                                                            : s->cfg.drain_gap_ms);
+        return;
+    }
+
+    if (s->failures < 31) s->failures++;
+    uint32_t cap = s->cfg.backoff_max_ms;
+    uint32_t backoff = s->cfg.backoff_min_ms;
+    for (uint32_t i = 1; i < s->failures && backoff < cap; ++i) {
+        backoff = backoff > cap / 2 ? cap : backoff * 2;
+    }
+    if (backoff > cap) backoff = cap;
+
+    uint32_t half = backoff / 2;
+    uint32_t delay = half + (half ? next_rand(s) % (half + 1) : 0);
+    s->not_before = now_ms + delay;
+}
+
+void upload_sched_defer(upload_sched_t *s, uint32_t delay_ms, uint32_t now_ms)
+{
+    uint32_t spread = delay_ms / 10;
+    uint32_t until = now_ms + delay_ms + (spread ? next_rand(s) % (spread + 1) : 0);
+    if (before(s->not_before, until)) s->not_before = until;
+}
@@ -0,0 +1,66 @@
+// main/upload_sched.h — decides when sender_task should attempt an upload
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Defaults (ms unless noted); override with -D or via upload_sched_cfg_t.
+#ifndef UPLOAD_SCHED_POLL_MS
+#define UPLOAD_SCHED_POLL_MS         1000     // re-check cadence while idle
+#endif
+#ifndef UPLOAD_SCHED_COALESCE_MIN
+#define UPLOAD_SCHED_COALESCE_MIN    6        // samples worth one POST
+#endif
+#ifndef UPLOAD_SCHED_COALESCE_MAX_MS
+#define UPLOAD_SCHED_COALESCE_MAX_MS 60000    // ...or the oldest waited this long
+#endif
+#ifndef UPLOAD_SCHED_DRAIN_GAP_MS
+#define UPLOAD_SCHED_DRAIN_GAP_MS    200      // pause between back-to-back full batches
+#endif
+#ifndef UPLOAD_SCHED_BACKOFF_MIN_MS
+#define UPLOAD_SCHED_BACKOFF_MIN_MS  10000
+#endif
+#ifndef UPLOAD_SCHED_BACKOFF_MAX_MS
+#define UPLOAD_SCHED_BACKOFF_MAX_MS  600000   // 10 min
+#endif
+
+typedef struct {
+    uint32_t poll_ms;
+    uint32_t coalesce_min;      // samples
+    uint32_t coalesce_max_ms;
+    uint32_t drain_gap_ms;
+    uint32_t backoff_min_ms;
+    uint32_t backoff_max_ms;
+    uint32_t batch_max;         // samples per POST; backlog >= this means drain
+    uint32_t interval_ms;       // server-set minimum gap between POSTs; 0 = none
+} upload_sched_cfg_t;
+
+typedef struct {
+    upload_sched_cfg_t cfg;
+    uint32_t failures;          // consecutive
+    uint32_t not_before;        // no attempt before this time (backoff / gap)
+    uint32_t pending_since;     // when the backlog last became non-empty
+    bool     pending;
+    uint32_t rng;
+} upload_sched_t;
+
+// cfg may be NULL for the defaults above (batch_max must then be set after).
+void     upload_sched_init(upload_sched_t *s, const upload_sched_cfg_t *cfg, uint32_t seed);
+
+// 0 = upload now; otherwise ms to wait before asking again.
+uint32_t upload_sched_due(upload_sched_t *s, uint32_t backlog, uint32_t now_ms);
+
+// Report the outcome of the attempt that upload_sched_due() allowed.
+void     upload_sched_report(upload_sched_t *s, bool ok, uint32_t now_ms);
+
+// The server asked for no attempt within delay_ms (Retry-After). Extends,
+// never shortens, the current wait; up to 10 % is added at random so a fleet
+// told the same delay does not come back at once.
+void     upload_sched_defer(upload_sched_t *s, uint32_t delay_ms, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,23 +1,224 @@
 // main/uploader.c
 #include "uploader.h"
+#include "sample_log.h"
+#include "sample_ring.h"
+#include "payload_json.h"
+#include "payload_cbor.h"
+#include "gzip_stream.h"
+#include "device_id.h"
+#include "metrics.h"
+#include "flow_ctl.h"
+#include "binlog.h"
+#include "transport.h"
+#include "alloc_trace.h"
+#include <stdatomic.h>
 #include <string.h>
+#include "sdkconfig.h"
 #include "esp_log.h"
-#include "esp_http_client.h"
-#include "esp_crt_bundle.h"
-#include "cJSON.h"
+#include "esp_timer.h"
+#include "nvs.h"
 
-#ifndef UPLOADER_MAX_SAMPLES
-#define UPLOADER_MAX_SAMPLES 20
+// Batches at least this large (uncompressed bytes) are sent gzip-compressed.
+// 0 disables compression.
+#ifndef UPLOADER_GZIP_THRESHOLD
+#ifdef CONFIG_UPLOADER_GZIP_THRESHOLD
+#define UPLOADER_GZIP_THRESHOLD CONFIG_UPLOADER_GZIP_THRESHOLD
+#else
+#define UPLOADER_GZIP_THRESHOLD 0
 #endif
+#endif
+
+// How long an answer may take before the batches in flight count as lost.
+#ifndef UPLOADER_ACK_TIMEOUT_MS
+#define UPLOADER_ACK_TIMEOUT_MS 15000
+#endif
+
+// Cap on the transport's window.
+#ifndef UPLOADER_MAX_INFLIGHT
+#define UPLOADER_MAX_INFLIGHT 8
+#endif
+
+#define UPLOADER_NVS_NS  "uploader"
+#define UPLOADER_NVS_KEY "flow"
+#define UPLOADER_NVS_CLOCK "clock"
 
 static const char *TAG = "UPLOADER";
-static sample_t s_buf[UPLOADER_MAX_SAMPLES];
-static int s_count = 0;
+// publisher_task → uploader_add() → s_ring → (sender_task) → sample_log →
+// transport. Only the sender task touches sample_log and s_buf, so neither
+// needs a lock.
+static sample_ring_t s_ring;
+static sample_t s_buf[UPLOADER_MAX_SAMPLES];   // batch being sent
+static uint32_t s_pos[UPLOADER_MAX_SAMPLES];   // their sample_log_flash_pos() numbers
+static device_id_t s_id;                       // identity of every batch
+static int s_count = 0;                        // samples in s_buf
+static int s_peeked = 0;                       // log samples s_buf was made from
+static int s_undated = 0;                      // of those, dropped as undatable
+static uploader_encoding_t s_enc;              // how s_buf is being sent
+static bool s_gzip;
 static char s_url[128] = {0};
 static bool s_log_json = false;
+static const transport_t *s_tp = &transport_http;
+
+// Batches in flight, oldest first. They are released from the log in that
+// order as their answers come in; each covers the `peeked` samples after
+// those of the batches before it.
+typedef struct {
+    int  peeked;
+    int  count;      // samples sent
+    int  undated;    // samples dropped as undatable
+    bool sent;       // false: all undated, nothing went out
+    bool health;     // carried the health record
+} flight_t;
+static flight_t s_fly[UPLOADER_MAX_INFLIGHT];
+static int s_nfly;
+static int s_fly_samples;                      // log samples s_fly covers
+#if CONFIG_UPLOADER_ENCODING_CBOR
+static uploader_encoding_t s_encoding = UPLOADER_ENC_CBOR;
+#else
+static uploader_encoding_t s_encoding = UPLOADER_ENC_JSON;
+#endif
+static uploader_stats_t s_stats;
+static gzip_stream_t s_gz;                     // ~10 KB compressor state
+static char s_health[(METRICS_HEALTH_MAX + 2) / 3 * 4 + 1];   // base64 record
+static uint32_t s_health_next_ms = METRICS_HEALTH_PERIOD_MS;
+// What the server has set through directives so far (and what NVS holds)
+static flow_ctl_t s_flow;
+// Samples taken before SNTP sync (SAMPLE_F_UNSYNCED) wait in the log until
+// s_boot_s dates them. The first s_boot_pending samples in the log at init
+// are a previous boot's. Their date died with that boot unless it synced:
+// then its clock record in NVS gives its boot time and the log numbers of
+// the unsynced samples it had flushed (saved once, at sync).
+typedef struct {
+    uint32_t boot_s;   // unix time that boot started at
+    uint32_t from;     // sample_log_flash_pos() range of its unsynced samples
+    uint32_t to;
+} boot_clock_t;
+static _Atomic uint32_t s_boot_s;              // unix time at boot; 0 = unknown
+static uint32_t s_boot_pending;
+static uint32_t s_held;                        // unsynced samples moved to the log
+static boot_clock_t s_prev_clock;              // previous boot's; boot_s 0 = none
+static uint32_t s_boot_pos;                    // flash_pos at init: this boot's from
+static bool s_clock_saved;
 
 void uploader_set_log_json(bool enable) { s_log_json = enable; }
 
+void uploader_set_server_cert(const char *pem) { s_tp->set_cert(pem); }
+
+void uploader_set_transport(const transport_t *t)
+{
+    if (t) s_tp = t;
+}
+
+void uploader_set_encoding(uploader_encoding_t enc)
+{
+    if (enc != s_encoding) {
+        ESP_LOGI(TAG, "Wire format -> %s", enc == UPLOADER_ENC_CBOR ? "CBOR" : "JSON");
+    }
+    s_encoding = enc;
+}
+
+void uploader_set_boot_time(uint32_t boot_unix_s) { s_boot_s = boot_unix_s; }
+
+void uploader_get_stats(uploader_stats_t *out)
+{
+    if (!out) return;
+    *out = s_stats;
+    out->connects = s_tp->connects();
+}
+
+void uploader_get_flow(flow_ctl_t *out)
+{
+    if (out) *out = s_flow;
+}
+
+// --- Server-set settings in NVS ---
+static void flow_load(flow_ctl_t *f)
+{
+    nvs_handle_t h;
+    memset(f, 0, sizeof(*f));
+    if (nvs_open(UPLOADER_NVS_NS, NVS_READONLY, &h) != ESP_OK) return;
+    size_t len = sizeof(*f);
+    if (nvs_get_blob(h, UPLOADER_NVS_KEY, f, &len) != ESP_OK || len != sizeof(*f)) {
+        memset(f, 0, sizeof(*f));   // none yet, or an older layout: defaults
+    }
+    nvs_close(h);
+}
+
+static void flow_save(const flow_ctl_t *f)
+{
+    nvs_handle_t h;
+    if (nvs_open(UPLOADER_NVS_NS, NVS_READWRITE, &h) != ESP_OK) return;
+    if (nvs_set_blob(h, UPLOADER_NVS_KEY, f, sizeof(*f)) == ESP_OK) nvs_commit(h);
+    nvs_close(h);
+}
+
+static uploader_encoding_t encoding(void)
+{
+    if (s_flow.encoding == FLOW_ENC_CBOR) return UPLOADER_ENC_CBOR;
+    if (s_flow.encoding == FLOW_ENC_JSON) return UPLOADER_ENC_JSON;
+    return s_encoding;
+}
+
+// Take in the directives of a received answer. Only changes reach NVS.
+static void flow_update(const flow_directive_t *dir)
+{
+    s_stats.retry_after_ms = (dir->fields & FLOW_F_RETRY) ? dir->retry_after_ms : 0;
+    if (s_stats.retry_after_ms) {
+        ESP_LOGW(TAG, "Server asks to retry after %u ms", (unsigned)s_stats.retry_after_ms);
+    }
+    uploader_encoding_t was = encoding();
+    if (!flow_ctl_apply(&s_flow, dir, UPLOADER_MAX_SAMPLES)) return;
+    ESP_LOGI(TAG, "Server settings: interval %u ms, batch %u, publish %u ms, encoding %u (0 = default)",
+             (unsigned)s_flow.upload_interval_ms, (unsigned)s_flow.batch_max,
+             (unsigned)s_flow.publish_ms, (unsigned)s_flow.encoding);
+    if (encoding() != was) {
+        ESP_LOGI(TAG, "Wire format -> %s", encoding() == UPLOADER_ENC_CBOR ? "CBOR" : "JSON");
+    }
+    flow_save(&s_flow);
+}
+
+// The previous boot's clock record, if it can still apply to this log: its
+// range lies before anything this boot writes (a fresh or re-formatted log
+// starts its numbers over).
+static void clock_load(void)
+{
+    nvs_handle_t h;
+    memset(&s_prev_clock, 0, sizeof(s_prev_clock));
+    if (nvs_open(UPLOADER_NVS_NS, NVS_READONLY, &h) != ESP_OK) return;
+    size_t len = sizeof(s_prev_clock);
+    if (nvs_get_blob(h, UPLOADER_NVS_CLOCK, &s_prev_clock, &len) != ESP_OK ||
+        len != sizeof(s_prev_clock) || s_prev_clock.from > s_prev_clock.to ||
+        s_prev_clock.to > s_boot_pos) {
+        memset(&s_prev_clock, 0, sizeof(s_prev_clock));
+    }
+    nvs_close(h);
+}
+
+// Once the clock is set: write out what this boot queued before it, so that
+// every unsynced sample it will ever have in flash is inside [from, to), and
+// record that range with the boot time. Sender task; one NVS write per boot.
+static void clock_save(uint32_t boot_s)
+{
+    sample_log_stats_t st;
+    sample_log_get_stats(&st);
+    s_clock_saved = true;
+    if (st.capacity == 0) return;   // RAM only: nothing outlives the boot
+    sample_log_flush();
+    boot_clock_t c = { boot_s, s_boot_pos, sample_log_flash_pos() };
+    nvs_handle_t h;
+    if (nvs_open(UPLOADER_NVS_NS, NVS_READWRITE, &h) != ESP_OK) return;
+    if (nvs_set_blob(h, UPLOADER_NVS_CLOCK, &c, sizeof(c)) == ESP_OK) nvs_commit(h);
+    nvs_close(h);
+}
+
+// s_boot_s, saving the clock record the first time it is seen set.
+static uint32_t boot_time(void)
+{
+    uint32_t boot_s = s_boot_s;
+    if (boot_s && !s_clock_saved) clock_save(boot_s);
+    return boot_s;
+}
+
 void uploader_init(const char *url)
 {
     if (url) {
@@ -25,103 +226,348 @@ void uploader_init(const char *url)
         if (n >= sizeof(s_url)) n = sizeof(s_url)-1;
         memcpy(s_url, url, n);
         s_url[n] = '\0';
+        ESP_LOGI(TAG, "Uploading to %s (%s)", s_url, s_tp->name);
     }
+    s_tp->init(url);
+    s_nfly = s_fly_samples = 0;
+    device_id_get(&s_id);
+    flow_load(&s_flow);
+    sample_ring_init(&s_ring);
+    sample_log_init();   // falls back to RAM-only if the partition is missing
+    sample_log_stats_t st;
+    sample_log_get_stats(&st);
+    s_boot_pending = sample_log_count() + st.consumed + st.dropped + st.corrupt;
+    s_held = 0;
+    s_boot_pos = sample_log_flash_pos();
+    s_clock_saved = false;
+    clock_load();
 }
 
 bool uploader_add(const sample_t *s)
 {
-    if (!s || s_count >= UPLOADER_MAX_SAMPLES) return false;
-    s_buf[s_count++] = *s;
-    return true;
+    if (!s) return false;
+    if (sample_ring_push(&s_ring, s)) return true;   // lock-free, never waits on the sender
+    metrics_count(METRIC_C_SAMPLES_DROPPED, 1);
+    return false;
 }
 
-int uploader_count(void) { return s_count; }
+int uploader_count(void)
+{
+    // sample_log_count() is read without a lock: exact on the sender task,
+    // a close snapshot elsewhere.
+    return (int)(sample_ring_count(&s_ring) + sample_log_count());
+}
 
-static cJSON* build_payload(void)
+// Move everything the publisher queued into the persistent log. A sample
+// leaves the ring only after the log has accepted it. Once the clock is
+// known, unsynced ones are dated on the way, so none lands in flash after
+// the clock record was saved.
+void uploader_drain_queue(void)
 {
-    cJSON *arr = cJSON_CreateArray();
-    if (!arr) return NULL;
+    uint32_t boot_s = boot_time();
+    int n;
+    while ((n = sample_ring_peek(&s_ring, s_buf, UPLOADER_MAX_SAMPLES)) > 0) {
+        int done = 0;
+        while (done < n) {
+            if (boot_s) sample_rebase(&s_buf[done], boot_s);
+            if (sample_log_append(&s_buf[done]) != ESP_OK) break;
+            if (s_buf[done].flags & SAMPLE_F_UNSYNCED) s_held++;
+            done++;
+        }
+        sample_ring_release(&s_ring, done);
+        if (done < n) {
+            ESP_LOGW(TAG, "Backlog full — %d sample(s) left queued in RAM", n - done);
+            break;
+        }
+    }
+}
 
-    for (int i = 0; i < s_count; ++i) {
-        const sample_t *p = &s_buf[i];
-        char date_str[16];   // YYYY-MM-DD
-        char time_str[16];   // HH:MM:SS
-        strftime(date_str, sizeof(date_str), "%Y-%m-%d", &p->tm_local);
-        strftime(time_str, sizeof(time_str), "%H:%M:%S", &p->tm_local);
+// Samples of the previous boot still in the log (they come first).
+static uint32_t prev_boot_left(void)
+{
+    sample_log_stats_t st;
+    sample_log_get_stats(&st);
+    uint32_t gone = st.consumed + st.dropped + st.corrupt;
+    return s_boot_pending > gone ? s_boot_pending - gone : 0;
+}
 
-        cJSON *obj = cJSON_CreateObject();
-        if (!obj) { cJSON_Delete(arr); return NULL; }
+int uploader_count_ready(void)
+{
+    if (s_boot_s) return uploader_count();
+    // Before sync everything this boot queued is undated, so what is ready
+    // is the log minus this boot's samples; the RAM queue is all this boot.
+    uint32_t n = sample_log_count();
+    return (int)(n > s_held ? n - s_held : 0);
+}
 
-        cJSON_AddStringToObject(obj, "date", date_str);
-        cJSON_AddStringToObject(obj, "time", time_str);
-        cJSON_AddNumberToObject(obj, "temp", p->temp_c);
-        cJSON_AddNumberToObject(obj, "lux",  p->lux);
-        cJSON_AddBoolToObject  (obj, "motion", p->motion);
-        cJSON_AddStringToObject(obj, "building", p->building);
-        cJSON_AddStringToObject(obj, "number",   p->number);
+// Fill s_buf from the oldest log samples not in flight: date this boot's
+// unsynced ones, and an earlier boot's from its clock record; drop (and
+// count) those of an earlier boot that has none, stop at any still undated.
+// Sets s_peeked to the log samples covered; s_count may be fewer.
+static void take_batch(int max)
+{
+    uint32_t boot_s = boot_time();
+    uint32_t prev = prev_boot_left();
+    int skip = s_fly_samples;
+    int n = sample_log_peek_pos(skip, s_buf, s_pos, max);
+    s_peeked = n;
+    s_undated = 0;
+    s_count = 0;
+    for (int i = 0; i < n; ++i) {
+        sample_t *x = &s_buf[i];
+        if (x->flags & SAMPLE_F_UNSYNCED) {
+            if ((uint32_t)(skip + i) < prev) {   // an earlier boot's
+                const boot_clock_t *c = &s_prev_clock;
+                if (!c->boot_s || s_pos[i] < c->from || s_pos[i] >= c->to) {
+                    s_undated++;                 // its boot time died with that boot
+                    continue;
+                }
+                sample_rebase(x, c->boot_s);
+                if (s_count != i) s_buf[s_count] = *x;
+                s_count++;
+                continue;
+            }
+            if (!boot_s) {              // this boot's, still waiting for SNTP
+                s_peeked = i;
+                break;
+            }
+            sample_rebase(x, boot_s);
+        }
+        if (s_count != i) s_buf[s_count] = *x;
+        s_count++;
+    }
+    if (boot_s) s_held = 0;
+}
 
-        cJSON_AddItemToArray(arr, obj);
+// The oldest batch in flight is done: release what it covered from the log.
+static void flight_done(void)
+{
+    const flight_t *f = &s_fly[0];
+    sample_log_consume(f->peeked);
+    if (f->undated) {
+        ESP_LOGW(TAG, "%d sample(s) from before a reboot had no date — dropped", f->undated);
+        metrics_count(METRIC_C_SAMPLES_UNDATED, (uint32_t)f->undated);
     }
-    return arr;
+    s_fly_samples -= f->peeked;
+    memmove(&s_fly[0], &s_fly[1], (size_t)--s_nfly * sizeof(s_fly[0]));
 }
 
-esp_err_t uploader_send(void)
+// Nothing in flight was released: it is all still in the log, to go again.
+static void flight_abandon(void)
 {
-    if (s_count == 0) return ESP_OK;
-    if (s_url[0] == '\0') {
-        ESP_LOGE(TAG, "No URL set");
-        return ESP_ERR_INVALID_ARG;
+    alloc_mod_t prev = alloc_trace_enter(ALLOC_MOD_TRANSPORT);
+    s_tp->reset();
+    alloc_trace_leave(prev);
+    s_nfly = s_fly_samples = 0;
+}
+
+// payload_sink_t that echoes the payload to UART, one log line per chunk.
+static esp_err_t log_sink(void *ctx, const char *data, size_t len)
+{
+    bool *first = (bool *)ctx;
+    if (*first) {
+        ESP_LOGI(TAG, "JSON payload: %.*s", (int)len, data);
+        *first = false;
+    } else {
+        ESP_LOGI(TAG, "%.*s", (int)len, data);
     }
+    return ESP_OK;
+}
 
-    esp_err_t err = ESP_OK;
-    cJSON *arr = build_payload();
-    if (!arr) return ESP_ERR_NO_MEM;
+static size_t body_size(uploader_encoding_t enc)
+{
+    return enc == UPLOADER_ENC_CBOR ? payload_cbor_size(&s_id, s_buf, s_count)
+                                    : payload_json_size(&s_id, s_buf, s_count);
+}
 
-    char *json = cJSON_PrintUnformatted(arr);
-    cJSON_Delete(arr);
-    if (!json) return ESP_ERR_NO_MEM;
+static esp_err_t body_write(uploader_encoding_t enc, payload_sink_t sink, void *ctx)
+{
+    return enc == UPLOADER_ENC_CBOR ? payload_cbor_write(&s_id, s_buf, s_count, sink, ctx)
+                                    : payload_json_write(&s_id, s_buf, s_count, sink, ctx);
+}
 
-    if (s_log_json) {
-        // Show exactly what will be sent
-        ESP_LOGI(TAG, "Preparing to POST %d sample(s) to %s", s_count, s_url);
-        ESP_LOGI(TAG, "JSON payload: %s", json);
+// Compressed size of the batch: a counting pass through the compressor.
+static size_t body_gzip_size(uploader_encoding_t enc)
+{
+    gzip_stream_begin(&s_gz, NULL, NULL);
+    body_write(enc, gzip_stream_sink, &s_gz);
+    gzip_stream_finish(&s_gz);
+    return s_gz.size_out;
+}
+
+// Bytes s_buf goes out as, gzip-compressed when that pays; sets s_gzip.
+static size_t batch_len(void)
+{
+    size_t raw_len = body_size(s_enc);
+    s_gzip = false;
+    if (UPLOADER_GZIP_THRESHOLD > 0 && raw_len >= UPLOADER_GZIP_THRESHOLD) {
+        size_t gz_len = body_gzip_size(s_enc);
+        if (gz_len < raw_len) {   // never send an expanded body
+            s_gzip = true;
+            return gz_len;
+        }
+    }
+    return raw_len;
+}
+
+// transport_batch_t.write: streams the body straight from s_buf, no full
+// copy is ever built here.
+static esp_err_t batch_write(payload_sink_t sink, void *ctx)
+{
+    alloc_mod_t prev = alloc_trace_enter(ALLOC_MOD_UPLOADER);   // called from the transport
+    esp_err_t err;
+    if (!s_gzip) {
+        err = body_write(s_enc, sink, ctx);
     } else {
-        ESP_LOGI(TAG, "Preparing to POST %d sample(s) to %s", s_count, s_url);
+        gzip_stream_begin(&s_gz, sink, ctx);
+        err = body_write(s_enc, gzip_stream_sink, &s_gz);
+        if (err == ESP_OK) err = gzip_stream_finish(&s_gz);
     }
+    alloc_trace_leave(prev);
+    return err;
+}
 
-    esp_http_client_config_t cfg = {
-        .url = s_url,
-        .method = HTTP_METHOD_POST,
-        .transport_type = HTTP_TRANSPORT_OVER_SSL,
-        .crt_bundle_attach = esp_crt_bundle_attach, // use built-in CA bundle
-        .skip_cert_common_name_check = false,
-        .timeout_ms = 10000,
-    };
+// The health record when one is due and no batch in flight carries it. It
+// goes with every attempt until a batch carrying it is acknowledged.
+static const char *health_due(void)
+{
+    for (int i = 0; i < s_nfly; ++i) {
+        if (s_fly[i].health) return NULL;
+    }
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    if ((int32_t)(now_ms - s_health_next_ms) >= 0 &&
+        metrics_health_encode(s_health, sizeof(s_health)) > 0) {
+        return s_health;
+    }
+    return NULL;
+}
 
-    esp_http_client_handle_t h = esp_http_client_init(&cfg);
-    if (!h) { free(json); return ESP_ERR_NO_MEM; }
+// Send s_buf[0..s_count); on success it joins s_fly.
+static esp_err_t submit_batch(void)
+{
+    s_enc = encoding();   // an answer may switch it
+    size_t body_len = batch_len();
+    BINLOG(UP_PREPARE, s_count, body_len, s_enc == UPLOADER_ENC_CBOR, s_gzip);
+    if (s_log_json && s_enc == UPLOADER_ENC_JSON) {
+        // Show exactly what will be sent
+        bool first = true;
+        payload_json_write(&s_id, s_buf, s_count, log_sink, &first);
+    }
 
-    esp_http_client_set_header(h, "Content-Type", "application/json");
-    esp_http_client_set_post_field(h, json, strlen(json));
+    transport_batch_t b = {
+        .cbor = s_enc == UPLOADER_ENC_CBOR, .gzip = s_gzip, .len = body_len,
+        .health = health_due(), .write = batch_write,
+    };
+    alloc_trace_batch();
+    alloc_mod_t prev = alloc_trace_enter(ALLOC_MOD_TRANSPORT);
+    esp_err_t err = s_tp->submit(&b);
+    alloc_trace_leave(prev);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Upload failed: %s — keeping %d sample(s) buffered",
+                 esp_err_to_name(err), s_count);
+        s_stats.uploads_failed++;
+        metrics_count(METRIC_C_UPLOAD_FAILS, 1);
+        return err;
+    }
+    s_fly[s_nfly++] = (flight_t){ s_peeked, s_count, s_undated, true, b.health != NULL };
+    s_fly_samples += s_peeked;
+    return ESP_OK;
+}
 
-    err = esp_http_client_perform(h);
-    if (err == ESP_OK) {
-        int status = esp_http_client_get_status_code(h);
-        int len    = esp_http_client_get_content_length(h);
-        ESP_LOGI(TAG, "HTTP status: %d, content-length: %d", status, len);
-        if (status >= 200 && status < 300) {
-            ESP_LOGI(TAG, "Upload OK — clearing %d buffered sample(s)", s_count);
-            s_count = 0; // clear buffer on success
+// Submit batches until the window is full or nothing more is ready.
+static esp_err_t fill_window(void)
+{
+    int window = s_tp->window < UPLOADER_MAX_INFLIGHT ? s_tp->window : UPLOADER_MAX_INFLIGHT;
+    int max = s_flow.batch_max ? s_flow.batch_max : UPLOADER_MAX_SAMPLES;
+    while (s_nfly < window) {
+        take_batch(max);
+        if (s_peeked == 0) break;
+        if (s_count > 0 && s_tp->max_len) {
+            // Halve until the body fits the transport
+            s_enc = encoding();
+            while (batch_len() > s_tp->max_len && s_peeked > 1) take_batch(s_peeked / 2);
+        }
+        if (s_count == 0) {   // all undated: released in turn, nothing to send
+            s_fly[s_nfly++] = (flight_t){ s_peeked, 0, s_undated, false, false };
+            s_fly_samples += s_peeked;
         } else {
-            ESP_LOGW(TAG, "Upload failed (status %d) — keeping %d sample(s) buffered", status, s_count);
-            err = ESP_FAIL;
+            esp_err_t err = submit_batch();
+            if (err != ESP_OK) return err;
         }
-    } else {
-        ESP_LOGE(TAG, "POST failed: %s — keeping %d sample(s) buffered",
-                 esp_err_to_name(err), s_count);
+        if (s_peeked < max) break;   // the log ran out, or the rest waits for a date
+    }
+    return ESP_OK;
+}
+
+// The answer for the oldest batch in flight. Anything but 2xx leaves it and
+// every later one in the log, so the backlog still goes out in order.
+static esp_err_t take_answer(const transport_result_t *r)
+{
+    const flight_t *f = &s_fly[0];
+    metrics_hist_add(METRIC_H_UPLOAD_TOTAL, r->latency_us);
+    s_stats.last_latency_ms = r->latency_us / 1000;
+    BINLOG(UP_TOOK, s_stats.last_latency_ms, r->reused, s_tp->connects());
+
+    flow_update(&r->dir);   // directives count on any status, 503 included
+    if (r->status < 200 || r->status >= 300) {
+        ESP_LOGW(TAG, "Upload failed (status %d) — keeping %d sample(s) buffered",
+                 r->status, f->count);
+        s_stats.uploads_failed++;
+        metrics_count(METRIC_C_UPLOAD_FAILS, 1);
+        flight_abandon();
+        return ESP_FAIL;
     }
+    BINLOG(UP_OK, f->count);
+    metrics_boot_mark(METRIC_B_FIRST_UPLOAD);
+    s_stats.uploads_ok++;
+    if (f->health) {
+        metrics_health_commit();
+        s_health_next_ms = (uint32_t)(esp_timer_get_time() / 1000) + METRICS_HEALTH_PERIOD_MS;
+    }
+    flight_done();
+    return ESP_OK;
+}
 
-    esp_http_client_cleanup(h);
-    free(json);
+esp_err_t uploader_send(void)
+{
+    if (s_url[0] == '\0') {
+        ESP_LOGE(TAG, "No URL set");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Claim the oldest batches; the publisher keeps appending to the ring
+    // meanwhile and nothing is released until the server acknowledges it.
+    uploader_drain_queue();
+    s_stats.retry_after_ms = 0;
+    esp_err_t err = fill_window();
+    bool more = uploader_count_ready() > s_fly_samples;
+
+    // Wait for the oldest answer. With more to send, take only the others
+    // already in and come back to top the window up; otherwise wait for all,
+    // so the backlog is released before the sender sleeps.
+    bool waited = false;
+    while (s_nfly > 0) {
+        if (!s_fly[0].sent) {
+            flight_done();
+            continue;
+        }
+        uint32_t wait = waited && more ? 0 : UPLOADER_ACK_TIMEOUT_MS;
+        transport_result_t r;
+        alloc_mod_t prev = alloc_trace_enter(ALLOC_MOD_TRANSPORT);
+        esp_err_t e = s_tp->poll(wait, &r);
+        alloc_trace_leave(prev);
+        if (e == ESP_ERR_TIMEOUT && wait == 0) break;
+        waited = true;
+        if (e != ESP_OK) {
+            ESP_LOGE(TAG, "%s — keeping %d sample(s) buffered",
+                     e == ESP_ERR_TIMEOUT ? "No answer" : "Connection lost", s_fly_samples);
+            s_stats.uploads_failed++;
+            metrics_count(METRIC_C_UPLOAD_FAILS, 1);
+            // A transport that resends still has them: its answer may yet come.
+            if (e != ESP_ERR_TIMEOUT || !s_tp->resends) flight_abandon();
+            return e;
+        }
+        if ((e = take_answer(&r)) != ESP_OK) return e;
+    }
     return err;
 }
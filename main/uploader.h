@@ -1,30 +1,80 @@
 // main/uploader.h
 #pragma once
 #include <stdbool.h>
-#include <time.h>
+#include <stdint.h>
 #include "esp_err.h"
+#include "sample.h"   // sample_t
+#include "flow_ctl.h" // flow_ctl_t
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Max samples per POST. The backlog itself lives in sample_log (flash).
+#ifndef UPLOADER_MAX_SAMPLES
+#define UPLOADER_MAX_SAMPLES 50
+#endif
+
+typedef enum {
+    UPLOADER_ENC_JSON = 0,   // JSON array, one object per sample
+    UPLOADER_ENC_CBOR,       // columnar CBOR batch (payload_cbor.h)
+} uploader_encoding_t;
+
 typedef struct {
-    struct tm tm_local;    // date/time split at send time
-    float temp_c;
-    float lux;
-    bool motion;
-    char building[16];
-    char number[16];
-} sample_t;
-
-void      uploader_init(const char *url);
-bool      uploader_add(const sample_t *s);  // returns false if buffer full
-esp_err_t uploader_send(void);              // POST accumulated samples as JSON array
-int       uploader_count(void);             // how many pending
-
-// Enable/disable echoing the JSON payload to UART logs before POSTing
+    uint32_t uploads_ok;
+    uint32_t uploads_failed;
+    uint32_t connects;          // TCP + TLS handshakes performed
+    uint32_t last_latency_ms;   // submit → answer of the last upload
+    uint32_t retry_after_ms;    // Retry-After of the last response; 0 = none
+} uploader_stats_t;
+
+void      uploader_init(const char *url);   // also mounts the flash backlog
+bool      uploader_add(const sample_t *s);  // lock-free; false if the queue is full
+esp_err_t uploader_send(void);              // send the oldest batch(es), see below
+int       uploader_count(void);             // how many pending (flash + RAM)
+
+// How batches travel (transport.h); transport_http unless set. Call before
+// uploader_init(), whose url is then the transport's. uploader_send() fills
+// the transport's window and waits for the oldest answer; with nothing more
+// ready it waits for all of them. Batches are released from the backlog in
+// order as they are acknowledged.
+typedef struct transport transport_t;
+void      uploader_set_transport(const transport_t *t);
+
+// Unix time the device booted at (time_sync_boot_s()). Until it is set,
+// samples flagged SAMPLE_F_UNSYNCED are held back; after, they are dated
+// (sample_rebase) as they are sent, and the next boot can date the ones
+// still in the log from a record kept in NVS. Any task.
+void      uploader_set_boot_time(uint32_t boot_unix_s);
+
+// Pending samples uploader_send() may send now: uploader_count() less the
+// ones held for a date. Sender task only.
+int       uploader_count_ready(void);
+
+// Move what uploader_add() queued in RAM into the flash backlog; uploader_send()
+// does this too. Sender task only: call it while waiting to send, so a long
+// backoff cannot overflow the RAM queue.
+void      uploader_drain_queue(void);
+
+// Enable/disable echoing the JSON payload to UART logs before POSTing. The
+// echo is printed by the sending task itself: for debugging only.
 void      uploader_set_log_json(bool enable);
 
+// Wire format for the next batches. Defaults to CONFIG_UPLOADER_ENCODING_*;
+// an encoding set by the server (flow_ctl.h) takes precedence.
+void      uploader_set_encoding(uploader_encoding_t enc);
+
+// Settings the server has set through response directives (flow_ctl.h),
+// loaded from NVS at uploader_init(). Every field is naturally aligned, no wider
+// than a word and written only by the sender task, so any task may read a copy.
+void      uploader_get_flow(flow_ctl_t *out);
+
+// Trust only this PEM certificate (server or its CA) instead of the full CA
+// bundle. The string must stay valid; pass NULL to go back to the bundle.
+void      uploader_set_server_cert(const char *pem);
+
+void      uploader_get_stats(uploader_stats_t *out);
+
 #ifdef __cplusplus
 }
 #endif
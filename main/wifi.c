@@ -1,12 +1,24 @@
+// main/wifi.c — Wi-Fi connection manager: runs wifi_fsm on its own task
+//
+// The default event loop handler only forwards events to the manager task,
+// so it never allocates or sleeps. The manager executes what the state
+// machine decides (connect, scan, RSSI poll) and keeps the last AP that gave
+// an IP in NVS, so the next boot or link loss reconnects without scanning.
 #include "wifi.h"
+#include "wifi_fsm.h"
+#include "metrics.h"
+#include "alloc_trace.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
 #include "nvs_flash.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
 #include <string.h>
-#include <stdlib.h>
 
 static const char *TAG = "WIFI_AUTO";
 
@@ -18,58 +30,41 @@ const int WIFI_CONNECTED_BIT = BIT0;
 #define WIFI_CLOSED_SSID "limor22"
 #define WIFI_CLOSED_PASS "26051960"
 
-// Forward declaration
-static esp_err_t try_connect_closed(const char *ssid, const char *pass);
+#define WIFI_NVS_NS  "wifi"
+#define WIFI_NVS_KEY "last_ap"
+
+#ifndef WIFI_TASK_STACK
+// Bytes. Not run on the host, so not measured there: its deepest calls are
+// ESP_LOGI's vprintf and the NVS write of cache_save(), which left little of
+// the 3 KB it had. Its high-water mark is in the health record.
+#define WIFI_TASK_STACK 4096
+#endif
+#define WIFI_EVQ_LEN    8
+
+static QueueHandle_t    s_evq;                       // wifi_fsm_event_kind_t
+static wifi_fsm_t       s_fsm;
+static wifi_ap_record_t s_recs[WIFI_FSM_MAX_APS];   // scan results, no malloc
+static wifi_fsm_ap_t    s_aps[WIFI_FSM_MAX_APS];
+static TaskHandle_t     s_task;                      // wifi_task, once started
+
+static inline uint32_t now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void post(wifi_fsm_event_kind_t kind) {
+    // Never block the event loop; a full queue only loses a duplicate.
+    if (xQueueSend(s_evq, &kind, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Event queue full — event %d dropped", (int)kind);
+    }
+}
 
 static void wifi_event_handler(void *arg, esp_event_base_t event_base,
                                int32_t event_id, void *event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        ESP_LOGI(TAG, "WiFi STA start → scanning for open networks...");
-        esp_wifi_scan_start(NULL, false);
+        post(WIFI_EV_START);
     }
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE) {
-        uint16_t ap_num = 0;
-        esp_wifi_scan_get_ap_num(&ap_num);
-
-        wifi_ap_record_t *ap_records = malloc(ap_num * sizeof(wifi_ap_record_t));
-        if (!ap_records) {
-            ESP_LOGE(TAG, "Failed to allocate memory for AP list");
-            return;
-        }
-
-        ESP_ERROR_CHECK(esp_wifi_scan_get_ap_records(&ap_num, ap_records));
-
-        int best_rssi = -127;
-        int best_index = -1;
-
-        for (int i = 0; i < ap_num; i++) {
-            if (ap_records[i].authmode == WIFI_AUTH_OPEN) {
-                ESP_LOGI(TAG, "Found OPEN SSID='%s' RSSI=%d",
-                         ap_records[i].ssid, ap_records[i].rssi);
-                if (ap_records[i].rssi > best_rssi) {
-                    best_rssi = ap_records[i].rssi;
-                    best_index = i;
-                }
-            }
-        }
-
-        if (best_index >= 0) {
-            wifi_config_t wifi_config = {0};
-            strncpy((char *)wifi_config.sta.ssid,
-                    (char *)ap_records[best_index].ssid,
-                    sizeof(wifi_config.sta.ssid));
-            ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-            ESP_ERROR_CHECK(esp_wifi_connect());
-
-            ESP_LOGI(TAG, "Connecting to OPEN SSID='%s' RSSI=%d",
-                     ap_records[best_index].ssid, ap_records[best_index].rssi);
-        } else {
-            ESP_LOGW(TAG, "No open networks found. Will retry in 5s...");
-            vTaskDelay(pdMS_TO_TICKS(5000));
-            esp_wifi_scan_start(NULL, false);
-        }
-
-        free(ap_records);
+        post(WIFI_EV_SCAN_DONE);
     }
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
         ESP_LOGI(TAG, "Connected to AP");
@@ -77,42 +72,141 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t *event = (ip_event_got_ip_t *) event_data;
         ESP_LOGI(TAG, "Got IP: " IPSTR, IP2STR(&event->ip_info.ip));
+        metrics_boot_mark(METRIC_B_FIRST_IP);
         xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
+        post(WIFI_EV_GOT_IP);
     }
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        ESP_LOGW(TAG, "Disconnected → retrying scan...");
-        esp_wifi_scan_start(NULL, false);
+        metrics_count(METRIC_C_WIFI_DISCONNECTS, 1);
+        xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT);
+        post(WIFI_EV_DISCONNECTED);
     }
 }
 
-// --- Closed Wi-Fi attempt ---
-static esp_err_t try_connect_closed(const char *ssid, const char *pass) {
-    ESP_LOGI(TAG, "Attempting CLOSED WiFi: SSID='%s'", ssid);
+// --- Last good AP in NVS ---
+static bool cache_load(wifi_fsm_ap_t *ap) {
+    nvs_handle_t h;
+    if (nvs_open(WIFI_NVS_NS, NVS_READONLY, &h) != ESP_OK) return false;
+    size_t len = sizeof(*ap);
+    esp_err_t err = nvs_get_blob(h, WIFI_NVS_KEY, ap, &len);
+    nvs_close(h);
+    return err == ESP_OK && len == sizeof(*ap);   // a layout change just rescans
+}
+
+static void cache_save(const wifi_fsm_ap_t *ap) {
+    nvs_handle_t h;
+    if (nvs_open(WIFI_NVS_NS, NVS_READWRITE, &h) != ESP_OK) return;
+    if (nvs_set_blob(h, WIFI_NVS_KEY, ap, sizeof(*ap)) == ESP_OK) nvs_commit(h);
+    nvs_close(h);
+}
 
+// --- Actions ---
+static void act_connect(const wifi_fsm_action_t *a) {
     wifi_config_t wifi_config = {0};
-    strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid));
-    strncpy((char *)wifi_config.sta.password, pass, sizeof(wifi_config.sta.password));
+    strncpy((char *)wifi_config.sta.ssid, a->ap.ssid, sizeof(wifi_config.sta.ssid));
+    if (!a->ap.open && strcmp(a->ap.ssid, WIFI_CLOSED_SSID) == 0) {
+        strncpy((char *)wifi_config.sta.password, WIFI_CLOSED_PASS,
+                sizeof(wifi_config.sta.password));
+    }
+    if (a->pin_bssid) {
+        // Known AP: the driver goes straight to it instead of scanning.
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, a->ap.bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.channel = a->ap.channel;
+    }
+    if (a->roam) esp_wifi_disconnect();
 
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-    ESP_ERROR_CHECK(esp_wifi_start());
-    ESP_ERROR_CHECK(esp_wifi_connect());
-
-    // Wait max **20s** for connection (to avoid false reset)
-    EventBits_t bits = xEventGroupWaitBits(
-        wifi_event_group,
-        WIFI_CONNECTED_BIT,
-        pdFALSE,
-        pdFALSE,
-        pdMS_TO_TICKS(20000)   // extended wait from 10s → 20s
-    );
-
-    if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "✅ Connected via CLOSED WiFi: '%s'", ssid);
-        return ESP_OK;
+    ESP_LOGI(TAG, "Connecting to %s SSID='%s' ch=%u%s",
+             a->ap.open ? "OPEN" : "CLOSED", a->ap.ssid, (unsigned)a->ap.channel,
+             a->pin_bssid ? " (known BSSID, no scan)" : "");
+    esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    if (err == ESP_OK) err = esp_wifi_connect();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Connect failed to start: %s", esp_err_to_name(err));
+        post(WIFI_EV_DISCONNECTED);
+    }
+}
+
+static void act_scan(const wifi_fsm_action_t *a, bool online) {
+    if (!online) esp_wifi_disconnect();   // stop a connect attempt still in progress
+    wifi_scan_config_t sc = {
+        .channel = a->channel,            // 0 = all channels
+        .show_hidden = false,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+    };
+    if (a->channel) {
+        ESP_LOGI(TAG, "Scanning channel %u...", (unsigned)a->channel);
     } else {
-        ESP_LOGW(TAG, "❌ Failed to connect CLOSED WiFi: '%s'", ssid);
-        return ESP_FAIL;
+        ESP_LOGI(TAG, "Scanning all channels...");
+    }
+    esp_err_t err = esp_wifi_scan_start(&sc, false);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Scan failed to start: %s", esp_err_to_name(err));
+        post(WIFI_EV_SCAN_DONE);   // empty result
+    }
+}
+
+static int scan_results(void) {
+    uint16_t n = WIFI_FSM_MAX_APS;
+    if (esp_wifi_scan_get_ap_records(&n, s_recs) != ESP_OK) return 0;
+    for (int i = 0; i < n; i++) {
+        wifi_fsm_ap_t *ap = &s_aps[i];
+        memset(ap, 0, sizeof(*ap));
+        strncpy(ap->ssid, (const char *)s_recs[i].ssid, sizeof(ap->ssid) - 1);
+        memcpy(ap->bssid, s_recs[i].bssid, sizeof(ap->bssid));
+        ap->channel = s_recs[i].primary;
+        ap->rssi = s_recs[i].rssi;
+        ap->open = (s_recs[i].authmode == WIFI_AUTH_OPEN);
+    }
+    return n;
+}
+
+// --- Manager task ---
+static void wifi_task(void *pv) {
+    (void)pv;
+    alloc_trace_task(ALLOC_MOD_WIFI);
+    wifi_fsm_state_t prev = s_fsm.state;
+
+    for (;;) {
+        // Next event: from the queue, or a timeout once the deadline passes.
+        wifi_fsm_event_kind_t kind;
+        TickType_t wait = portMAX_DELAY;
+        if (s_fsm.has_deadline) {
+            int32_t left = (int32_t)(s_fsm.deadline - now_ms());
+            wait = left > 0 ? pdMS_TO_TICKS(left) + 1 : 0;
+        }
+        if (xQueueReceive(s_evq, &kind, wait) != pdTRUE) kind = WIFI_EV_TIMEOUT;
+
+        wifi_fsm_event_t ev = { .kind = kind };
+        if (kind == WIFI_EV_SCAN_DONE) {
+            ev.aps = s_aps;
+            ev.n_aps = scan_results();
+        }
+
+        wifi_fsm_action_t act;
+        wifi_fsm_step(&s_fsm, &ev, now_ms(), &act);
+        if (act.kind == WIFI_ACT_POLL_RSSI) {
+            wifi_ap_record_t info;
+            if (esp_wifi_sta_get_ap_info(&info) == ESP_OK) {
+                ev = (wifi_fsm_event_t){ .kind = WIFI_EV_RSSI, .rssi = info.rssi };
+                wifi_fsm_step(&s_fsm, &ev, now_ms(), &act);
+            }
+        }
+
+        if (s_fsm.state != prev) {
+            ESP_LOGI(TAG, "%s -> %s", wifi_fsm_state_name(prev), wifi_fsm_state_name(s_fsm.state));
+            if (s_fsm.state == WIFI_ST_ONLINE && prev == WIFI_ST_CONNECTING) {
+                ESP_LOGI(TAG, "Online after %u ms", (unsigned)s_fsm.stats.last_outage_ms);
+            }
+            prev = s_fsm.state;
+        }
+
+        if (act.save) cache_save(&act.ap);
+        if (act.kind == WIFI_ACT_CONNECT) {
+            act_connect(&act);
+        } else if (act.kind == WIFI_ACT_SCAN) {
+            act_scan(&act, s_fsm.state == WIFI_ST_ROAM_SCAN);
+        }
     }
 }
 
@@ -129,7 +223,11 @@ static void wifi_common_init(void) {
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
-    wifi_event_group = xEventGroupCreate();
+    static StaticEventGroup_t group;
+    static StaticQueue_t      evq;
+    static uint8_t            evq_buf[WIFI_EVQ_LEN * sizeof(wifi_fsm_event_kind_t)];
+    wifi_event_group = xEventGroupCreateStatic(&group);
+    s_evq = xQueueCreateStatic(WIFI_EVQ_LEN, sizeof(wifi_fsm_event_kind_t), evq_buf, &evq);
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
                                                         ESP_EVENT_ANY_ID,
                                                         &wifi_event_handler,
@@ -143,23 +241,53 @@ static void wifi_common_init(void) {
     initialized = true;
 }
 
+// Start the manager; closed_ssid "" means open networks only.
+static void wifi_start(const char *closed_ssid) {
+    static bool started = false;
+    if (started) return;
+    started = true;
+
+    wifi_fsm_ap_t cache;
+    bool have = cache_load(&cache);
+    if (have) {
+        ESP_LOGI(TAG, "Last good AP: SSID='%s' ch=%u", cache.ssid, (unsigned)cache.channel);
+    }
+    wifi_fsm_init(&s_fsm, NULL, have ? &cache : NULL);
+    strncpy(s_fsm.cfg.ssid, closed_ssid, sizeof(s_fsm.cfg.ssid) - 1);
+
+    static StackType_t  stack[WIFI_TASK_STACK];
+    static StaticTask_t tcb;
+    // Core 0, with the Wi-Fi driver it talks to; core 1 is the sampler's.
+    s_task = xTaskCreateStaticPinnedToCore(wifi_task, "wifi_task", WIFI_TASK_STACK, NULL, 5,
+                                           stack, &tcb, 0);
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    ESP_ERROR_CHECK(esp_wifi_start());   // STA_START kicks off the state machine
+}
+
+TaskHandle_t wifi_task_handle(void) {
+    return s_task;
+}
+
 // --- Open Wi-Fi auto-scan ---
 void wifi_init_auto(void) {
     ESP_LOGI(TAG, "Initializing WiFi in auto-open mode...");
     wifi_common_init();
-
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_start());
-    esp_wifi_scan_start(NULL, false);
+    wifi_start("");
 }
 
 // --- Closed-first entry point ---
 void wifi_init_prefer_closed(void) {
     ESP_LOGI(TAG, "Initializing WiFi (closed-first fallback)...");
     wifi_common_init();
+    wifi_start(WIFI_CLOSED_SSID);
+}
 
-    if (try_connect_closed(WIFI_CLOSED_SSID, WIFI_CLOSED_PASS) != ESP_OK) {
-        ESP_LOGW(TAG, "Falling back to OPEN WiFi auto-connect...");
-        wifi_init_auto();
-    }
+bool wifi_wait_ip(uint32_t timeout_ms) {
+    EventBits_t bits = xEventGroupWaitBits(wifi_event_group, WIFI_CONNECTED_BIT,
+                                           pdFALSE, pdFALSE, pdMS_TO_TICKS(timeout_ms));
+    return (bits & WIFI_CONNECTED_BIT) != 0;
+}
+
+void wifi_get_stats(wifi_fsm_stats_t *out) {
+    *out = s_fsm.stats;
 }
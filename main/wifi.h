@@ -1,6 +1,11 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
+#include "wifi_fsm.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -9,23 +14,46 @@ extern "C" {
 /**
  * @brief Initialize WiFi in auto-open mode.
  *
- * This function sets up WiFi as a station, scans for available networks,
- * and connects automatically to the strongest **open (unencrypted)** network.
- * 
+ * This function sets up WiFi as a station and starts the connection manager
+ * task, which connects to the strongest **open (unencrypted)** network.
+ *
  * The connection runs in the background. Logs will indicate the SSID and status.
  */
 void wifi_init_auto(void);
 
 /**
- * @brief Initialize WiFi, trying closed WiFi first, then falling back to open.
+ * @brief Initialize WiFi, preferring the closed network, falling back to open.
  *
- * Attempts to connect to the configured closed Wi-Fi SSID with password.
- * If it fails, automatically falls back to scanning for open networks.
+ * Starts the connection manager (see wifi_fsm.h). The last AP that gave an
+ * IP is kept in NVS and, if it is the closed network, reconnected to
+ * directly, without a scan. Otherwise the configured closed SSID is used
+ * when visible, else the strongest open network. Link loss reconnects to
+ * the same BSSID first, and a weak signal triggers a roam to a stronger AP
+ * of the same SSID.
  *
- * Waits up to 20 seconds for a closed connection before failing.
+ * Returns at once; the connection comes up in the background (wifi_wait_ip).
  */
 void wifi_init_prefer_closed(void);
 
+/**
+ * @brief Wait up to timeout_ms for the station to have an IP.
+ *
+ * Call after one of the wifi_init_* functions. Returns true if it has one.
+ */
+bool wifi_wait_ip(uint32_t timeout_ms);
+
+/**
+ * @brief Connection manager counters (scans, connects, roams, last outage).
+ */
+void wifi_get_stats(wifi_fsm_stats_t *out);
+
+/**
+ * @brief The connection manager task, for its stack high-water mark.
+ *
+ * NULL until one of the wifi_init_* functions has started it.
+ */
+TaskHandle_t wifi_task_handle(void);
+
 #ifdef __cplusplus
 }
 #endif
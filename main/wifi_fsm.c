@@ -0,0 +1,273 @@
+// main/wifi_fsm.c — connect, reconnect and roam decisions
+//
+//  * start / link loss → connect straight to the last good BSSID on its
+//                        channel (no scan); at start only if it is the
+//                        configured closed SSID, else scan all first so an
+//                        open fallback does not stick across reboots
+//  * that fails        → scan only that channel for the same SSID
+//  * that fails        → scan all channels: the configured closed SSID if
+//                        visible, else the strongest open network
+//  * nothing usable    → rescan with exponential backoff
+//  * online            → poll RSSI; after a run of weak readings, scan for
+//                        an AP of the same SSID that is clearly stronger
+#include "wifi_fsm.h"
+#include <stddef.h>
+#include <string.h>
+
+enum {
+    PATH_PINNED = 0,   // known BSSID + channel, no scan
+    PATH_CHANNEL,      // found by the single-channel scan
+    PATH_FULL,         // found by the all-channel scan
+};
+
+const char *wifi_fsm_state_name(wifi_fsm_state_t st)
+{
+    switch (st) {
+    case WIFI_ST_IDLE:         return "IDLE";
+    case WIFI_ST_CONNECTING:   return "CONNECTING";
+    case WIFI_ST_SCAN_CHANNEL: return "SCAN_CHANNEL";
+    case WIFI_ST_SCAN_ALL:     return "SCAN_ALL";
+    case WIFI_ST_BACKOFF:      return "BACKOFF";
+    case WIFI_ST_ONLINE:       return "ONLINE";
+    case WIFI_ST_ROAM_SCAN:    return "ROAM_SCAN";
+    }
+    return "?";
+}
+
+void wifi_fsm_init(wifi_fsm_t *f, const wifi_fsm_cfg_t *cfg, const wifi_fsm_ap_t *cache)
+{
+    memset(f, 0, sizeof(*f));
+    if (cfg) {
+        f->cfg = *cfg;
+    } else {
+        f->cfg = (wifi_fsm_cfg_t){
+            .connect_timeout_ms = WIFI_FSM_CONNECT_TIMEOUT_MS,
+            .scan_timeout_ms    = WIFI_FSM_SCAN_TIMEOUT_MS,
+            .backoff_min_ms     = WIFI_FSM_BACKOFF_MIN_MS,
+            .backoff_max_ms     = WIFI_FSM_BACKOFF_MAX_MS,
+            .rssi_poll_ms       = WIFI_FSM_RSSI_POLL_MS,
+            .roam_rssi          = WIFI_FSM_ROAM_RSSI,
+            .roam_checks        = WIFI_FSM_ROAM_CHECKS,
+            .roam_margin        = WIFI_FSM_ROAM_MARGIN,
+        };
+    }
+    if (cache && cache->ssid[0] && cache->channel) {
+        f->cache = *cache;
+        f->cache_valid = true;
+    }
+    f->backoff_ms = f->cfg.backoff_min_ms;
+}
+
+static inline bool reached(uint32_t now, uint32_t t) { return (int32_t)(now - t) >= 0; }
+
+static void set_deadline(wifi_fsm_t *f, uint32_t now, uint32_t ms)
+{
+    f->deadline = now + ms;
+    f->has_deadline = true;
+}
+
+static bool same_ap(const wifi_fsm_ap_t *a, const wifi_fsm_ap_t *b)
+{
+    return strcmp(a->ssid, b->ssid) == 0 && a->channel == b->channel &&
+           memcmp(a->bssid, b->bssid, sizeof(a->bssid)) == 0;
+}
+
+// Strongest AP named ssid, or NULL.
+static const wifi_fsm_ap_t *strongest(const wifi_fsm_ap_t *aps, int n, const char *ssid)
+{
+    const wifi_fsm_ap_t *best = NULL;
+    for (int i = 0; i < n; ++i) {
+        if (strcmp(aps[i].ssid, ssid) != 0) continue;
+        if (!best || aps[i].rssi > best->rssi) best = &aps[i];
+    }
+    return best;
+}
+
+// The configured closed SSID wins whenever it is visible; otherwise the
+// strongest open network.
+static const wifi_fsm_ap_t *pick(const wifi_fsm_t *f, const wifi_fsm_ap_t *aps, int n)
+{
+    if (f->cfg.ssid[0]) {
+        const wifi_fsm_ap_t *ap = strongest(aps, n, f->cfg.ssid);
+        if (ap) return ap;
+    }
+    const wifi_fsm_ap_t *best = NULL;
+    for (int i = 0; i < n; ++i) {
+        if (!aps[i].open || aps[i].ssid[0] == '\0') continue;
+        if (!best || aps[i].rssi > best->rssi) best = &aps[i];
+    }
+    return best;
+}
+
+static void do_connect(wifi_fsm_t *f, const wifi_fsm_ap_t *ap, uint8_t path, uint32_t now,
+                       wifi_fsm_action_t *act)
+{
+    f->target = *ap;
+    f->path = path;
+    f->state = WIFI_ST_CONNECTING;
+    f->stats.connects++;
+    if (path == PATH_PINNED) f->stats.fast_connects++;
+    set_deadline(f, now, f->cfg.connect_timeout_ms);
+    act->kind = WIFI_ACT_CONNECT;
+    act->ap = *ap;
+    act->pin_bssid = ap->channel != 0;
+}
+
+static void do_scan(wifi_fsm_t *f, uint8_t channel, uint32_t now, wifi_fsm_action_t *act)
+{
+    f->state = channel ? WIFI_ST_SCAN_CHANNEL : WIFI_ST_SCAN_ALL;
+    if (channel) f->stats.scans_channel++; else f->stats.scans_all++;
+    set_deadline(f, now, f->cfg.scan_timeout_ms);
+    act->kind = WIFI_ACT_SCAN;
+    act->channel = channel;
+}
+
+static void do_backoff(wifi_fsm_t *f, uint32_t now)
+{
+    f->state = WIFI_ST_BACKOFF;
+    set_deadline(f, now, f->backoff_ms);
+    f->backoff_ms = f->backoff_ms >= f->cfg.backoff_max_ms / 2 ? f->cfg.backoff_max_ms
+                                                               : f->backoff_ms * 2;
+}
+
+static void go_online(wifi_fsm_t *f, uint32_t now)
+{
+    f->state = WIFI_ST_ONLINE;
+    f->weak = 0;
+    set_deadline(f, now, f->cfg.rssi_poll_ms);
+}
+
+// The link is gone: go back to the AP we just had, pinned, before scanning.
+static void link_lost(wifi_fsm_t *f, uint32_t now, wifi_fsm_action_t *act)
+{
+    f->stats.link_losses++;
+    f->down_since = now;
+    do_connect(f, &f->target, PATH_PINNED, now, act);
+}
+
+// A connect attempt failed: widen the search one step.
+static void connect_failed(wifi_fsm_t *f, uint32_t now, wifi_fsm_action_t *act)
+{
+    if (f->path == PATH_PINNED && f->target.channel) {
+        do_scan(f, f->target.channel, now, act);
+    } else if (f->path == PATH_CHANNEL) {
+        do_scan(f, 0, now, act);
+    } else {
+        do_backoff(f, now);   // visible but refused us (bad key, full AP, ...)
+    }
+}
+
+void wifi_fsm_step(wifi_fsm_t *f, const wifi_fsm_event_t *ev, uint32_t now_ms,
+                   wifi_fsm_action_t *act)
+{
+    memset(act, 0, sizeof(*act));
+
+    if (ev->kind == WIFI_EV_START) {
+        f->down_since = now_ms;
+        f->backoff_ms = f->cfg.backoff_min_ms;
+        // A cached open network was only the fallback: look for the closed
+        // SSID before going back to it (pick() still falls back to it).
+        bool preferred = !f->cfg.ssid[0] || strcmp(f->cache.ssid, f->cfg.ssid) == 0;
+        if (f->cache_valid && preferred) {
+            do_connect(f, &f->cache, PATH_PINNED, now_ms, act);
+        } else {
+            do_scan(f, 0, now_ms, act);
+        }
+        return;
+    }
+    // A timeout only counts once its deadline has really passed.
+    if (ev->kind == WIFI_EV_TIMEOUT && (!f->has_deadline || !reached(now_ms, f->deadline))) {
+        return;
+    }
+
+    switch (f->state) {
+    case WIFI_ST_IDLE:
+        break;
+
+    case WIFI_ST_CONNECTING:
+        if (ev->kind == WIFI_EV_GOT_IP) {
+            f->stats.last_outage_ms = now_ms - f->down_since;
+            f->backoff_ms = f->cfg.backoff_min_ms;
+            f->skip_disconnect = false;
+            if (!f->cache_valid || !same_ap(&f->cache, &f->target)) {
+                f->cache = f->target;
+                f->cache_valid = true;
+                act->save = true;
+                act->ap = f->cache;
+            }
+            go_online(f, now_ms);
+        } else if (ev->kind == WIFI_EV_DISCONNECTED && f->skip_disconnect) {
+            f->skip_disconnect = false;   // the old AP letting go during a roam
+        } else if (ev->kind == WIFI_EV_DISCONNECTED || ev->kind == WIFI_EV_TIMEOUT) {
+            connect_failed(f, now_ms, act);
+        }
+        break;
+
+    case WIFI_ST_SCAN_CHANNEL:
+        if (ev->kind == WIFI_EV_SCAN_DONE) {
+            const wifi_fsm_ap_t *ap = strongest(ev->aps, ev->n_aps, f->target.ssid);
+            if (ap) do_connect(f, ap, PATH_CHANNEL, now_ms, act);
+            else    do_scan(f, 0, now_ms, act);
+        } else if (ev->kind == WIFI_EV_TIMEOUT) {
+            do_scan(f, 0, now_ms, act);
+        }
+        break;
+
+    case WIFI_ST_SCAN_ALL:
+        if (ev->kind == WIFI_EV_SCAN_DONE) {
+            const wifi_fsm_ap_t *ap = pick(f, ev->aps, ev->n_aps);
+            if (ap) do_connect(f, ap, PATH_FULL, now_ms, act);
+            else    do_backoff(f, now_ms);
+        } else if (ev->kind == WIFI_EV_TIMEOUT) {
+            do_backoff(f, now_ms);
+        }
+        break;
+
+    case WIFI_ST_BACKOFF:
+        if (ev->kind == WIFI_EV_TIMEOUT) do_scan(f, 0, now_ms, act);
+        break;
+
+    case WIFI_ST_ONLINE:
+        if (ev->kind == WIFI_EV_DISCONNECTED) {
+            link_lost(f, now_ms, act);
+        } else if (ev->kind == WIFI_EV_TIMEOUT) {
+            set_deadline(f, now_ms, f->cfg.rssi_poll_ms);
+            act->kind = WIFI_ACT_POLL_RSSI;
+        } else if (ev->kind == WIFI_EV_RSSI) {
+            f->target.rssi = ev->rssi;
+            f->weak = ev->rssi < f->cfg.roam_rssi ? (uint8_t)(f->weak + 1) : 0;
+            if (f->weak >= f->cfg.roam_checks) {
+                f->weak = 0;
+                do_scan(f, 0, now_ms, act);
+                f->state = WIFI_ST_ROAM_SCAN;   // still online while it runs
+            }
+        }
+        break;
+
+    case WIFI_ST_ROAM_SCAN:
+        if (ev->kind == WIFI_EV_DISCONNECTED) {
+            link_lost(f, now_ms, act);
+        } else if (ev->kind == WIFI_EV_SCAN_DONE) {
+            const wifi_fsm_ap_t *best = NULL;
+            for (int i = 0; i < ev->n_aps; ++i) {
+                const wifi_fsm_ap_t *ap = &ev->aps[i];
+                if (strcmp(ap->ssid, f->target.ssid) != 0) continue;
+                if (same_ap(ap, &f->target)) continue;
+                if (ap->rssi < f->target.rssi + f->cfg.roam_margin) continue;
+                if (!best || ap->rssi > best->rssi) best = ap;
+            }
+            if (best) {
+                f->stats.roams++;
+                f->down_since = now_ms;
+                f->skip_disconnect = true;
+                do_connect(f, best, PATH_PINNED, now_ms, act);
+                act->roam = true;
+            } else {
+                go_online(f, now_ms);
+            }
+        } else if (ev->kind == WIFI_EV_TIMEOUT) {
+            go_online(f, now_ms);
+        }
+        break;
+    }
+}
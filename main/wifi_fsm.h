@@ -0,0 +1,143 @@
+// main/wifi_fsm.h — Wi-Fi connection state machine (no IDF calls)
+//
+// wifi.c feeds it driver events and executes the action it returns; the
+// machine itself only decides. Its clock is the caller's, so the same code
+// replays scripted event sequences on the host (host/wifi_replay.c).
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Defaults (ms unless noted); override with -D or via wifi_fsm_cfg_t.
+#ifndef WIFI_FSM_CONNECT_TIMEOUT_MS
+#define WIFI_FSM_CONNECT_TIMEOUT_MS  8000     // association + DHCP
+#endif
+#ifndef WIFI_FSM_SCAN_TIMEOUT_MS
+#define WIFI_FSM_SCAN_TIMEOUT_MS     6000     // a full scan takes ~2.5 s
+#endif
+#ifndef WIFI_FSM_BACKOFF_MIN_MS
+#define WIFI_FSM_BACKOFF_MIN_MS      5000     // nothing usable found: rescan after
+#endif
+#ifndef WIFI_FSM_BACKOFF_MAX_MS
+#define WIFI_FSM_BACKOFF_MAX_MS      60000
+#endif
+#ifndef WIFI_FSM_RSSI_POLL_MS
+#define WIFI_FSM_RSSI_POLL_MS        10000
+#endif
+#ifndef WIFI_FSM_ROAM_RSSI
+#define WIFI_FSM_ROAM_RSSI           (-75)    // dBm; below this, look for a better AP
+#endif
+#ifndef WIFI_FSM_ROAM_CHECKS
+#define WIFI_FSM_ROAM_CHECKS         3        // consecutive weak polls before a roam scan
+#endif
+#ifndef WIFI_FSM_ROAM_MARGIN
+#define WIFI_FSM_ROAM_MARGIN         8        // dB a candidate must beat the current AP by
+#endif
+
+#define WIFI_FSM_MAX_APS  16   // scan results considered per scan
+
+typedef struct {
+    char    ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;      // 0 = unknown
+    int8_t  rssi;
+    bool    open;         // no authentication
+} wifi_fsm_ap_t;
+
+typedef struct {
+    char     ssid[33];     // preferred closed network ("" = open networks only)
+    uint32_t connect_timeout_ms;
+    uint32_t scan_timeout_ms;
+    uint32_t backoff_min_ms;
+    uint32_t backoff_max_ms;
+    uint32_t rssi_poll_ms;
+    int8_t   roam_rssi;
+    uint8_t  roam_checks;
+    uint8_t  roam_margin;
+} wifi_fsm_cfg_t;
+
+typedef enum {
+    WIFI_ST_IDLE = 0,
+    WIFI_ST_CONNECTING,     // association + DHCP in progress
+    WIFI_ST_SCAN_CHANNEL,   // targeted scan of the last good channel
+    WIFI_ST_SCAN_ALL,       // all-channel scan
+    WIFI_ST_BACKOFF,        // nothing usable in range; rescan later
+    WIFI_ST_ONLINE,         // got an IP
+    WIFI_ST_ROAM_SCAN,      // online, scanning for a stronger AP of the same SSID
+} wifi_fsm_state_t;
+
+typedef enum {
+    WIFI_EV_START = 0,
+    WIFI_EV_GOT_IP,
+    WIFI_EV_DISCONNECTED,
+    WIFI_EV_SCAN_DONE,      // aps/n_aps hold the results
+    WIFI_EV_RSSI,           // answer to WIFI_ACT_POLL_RSSI
+    WIFI_EV_TIMEOUT,        // the deadline returned by the last step passed
+} wifi_fsm_event_kind_t;
+
+typedef struct {
+    wifi_fsm_event_kind_t kind;
+    const wifi_fsm_ap_t  *aps;
+    int                   n_aps;
+    int8_t                rssi;
+} wifi_fsm_event_t;
+
+typedef enum {
+    WIFI_ACT_NONE = 0,
+    WIFI_ACT_CONNECT,       // connect to ap (bssid/channel pinned when known)
+    WIFI_ACT_SCAN,          // scan channel (0 = all channels)
+    WIFI_ACT_POLL_RSSI,     // read the current AP's RSSI, answer with WIFI_EV_RSSI
+} wifi_fsm_action_kind_t;
+
+typedef struct {
+    wifi_fsm_action_kind_t kind;
+    wifi_fsm_ap_t          ap;         // CONNECT
+    bool                   pin_bssid;  // CONNECT: skip the driver's own scan
+    bool                   roam;       // CONNECT: drop the current link first
+    uint8_t                channel;    // SCAN
+    bool                   save;       // persist ap as the last good AP
+} wifi_fsm_action_t;
+
+typedef struct {
+    uint32_t scans_all;
+    uint32_t scans_channel;
+    uint32_t connects;          // connect attempts
+    uint32_t fast_connects;     // ...of which pinned to a known BSSID/channel
+    uint32_t link_losses;
+    uint32_t roams;
+    uint32_t last_outage_ms;    // link loss (or start) → IP, most recent
+} wifi_fsm_stats_t;
+
+typedef struct {
+    wifi_fsm_cfg_t   cfg;
+    wifi_fsm_state_t state;
+    wifi_fsm_ap_t    cache;       // last AP that gave us an IP
+    bool             cache_valid;
+    wifi_fsm_ap_t    target;      // AP being connected to / connected to
+    uint8_t          path;        // how target was chosen (wifi_fsm.c)
+    bool             skip_disconnect;   // roam: the old link's drop is expected
+    uint32_t         backoff_ms;
+    uint32_t         deadline;    // ms; meaningful while has_deadline
+    bool             has_deadline;
+    uint32_t         down_since;
+    uint8_t          weak;        // consecutive weak RSSI polls
+    wifi_fsm_stats_t stats;
+} wifi_fsm_t;
+
+// cfg may be NULL for the defaults above (ssid then empty). cache, if not
+// NULL, is the last good AP loaded from NVS.
+void wifi_fsm_init(wifi_fsm_t *f, const wifi_fsm_cfg_t *cfg, const wifi_fsm_ap_t *cache);
+
+// Feed one event; *act receives what to do next. Whenever f->has_deadline
+// and now_ms reaches f->deadline, the caller delivers WIFI_EV_TIMEOUT.
+void wifi_fsm_step(wifi_fsm_t *f, const wifi_fsm_event_t *ev, uint32_t now_ms,
+                   wifi_fsm_action_t *act);
+
+const char *wifi_fsm_state_name(wifi_fsm_state_t st);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,35 @@
+// main/window_stats.c — see window_stats.h
+#include "window_stats.h"
+
+void stat_acc_reset(stat_acc_t *a)
+{
+    a->n = 0;
+    a->min = a->max = 0.0f;
+    a->mean = a->m2 = 0.0f;
+}
+
+void stat_acc_add(stat_acc_t *a, float x)
+{
+    if (a->n == 0) {
+        a->min = a->max = x;
+    } else {
+        if (x < a->min) a->min = x;
+        if (x > a->max) a->max = x;
+    }
+    a->n++;
+    float d = x - a->mean;
+    a->mean += d / (float)a->n;
+    a->m2   += d * (x - a->mean);
+}
+
+float stat_acc_var(const stat_acc_t *a)
+{
+    return a->n > 1 ? a->m2 / (float)a->n : 0.0f;
+}
+
+void window_stats_begin(window_stats_t *w, int64_t now_us)
+{
+    stat_acc_reset(&w->temp);
+    stat_acc_reset(&w->lux);
+    w->start_us = now_us;
+}
@@ -0,0 +1,35 @@
+// main/window_stats.h — constant-memory per-window sensor statistics
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Running min/max/mean/variance (Welford). O(1) per value, no raw samples kept.
+typedef struct {
+    uint32_t n;
+    float    min, max;
+    float    mean;
+    float    m2;      // sum of squared deviations from the running mean
+} stat_acc_t;
+
+void  stat_acc_reset(stat_acc_t *a);
+void  stat_acc_add(stat_acc_t *a, float x);
+// Population variance of the values added so far (0 for n < 2).
+float stat_acc_var(const stat_acc_t *a);
+
+// One publish window of temperature and lux statistics. Motion is tracked
+// from PIR edges by motion_track.h.
+typedef struct {
+    stat_acc_t temp;
+    stat_acc_t lux;
+    int64_t    start_us;
+} window_stats_t;
+
+void  window_stats_begin(window_stats_t *w, int64_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,227 @@
+// tools/cbor_decode.c — reference decoder for CBOR upload batches (Linux)
+//
+// Reads one batch produced by main/payload_cbor.c and prints it as the same
+// JSON array the node sends in JSON mode (values at their fixed-point
+// resolution). Accepts format versions 1 to 5.
+//
+//   cc -O2 -o cbor_decode tools/cbor_decode.c
+//   ./cbor_decode batch.cbor        (or read from stdin)
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_SAMPLES 100000
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} rd_t;
+
+static void die(const char *msg)
+{
+    fprintf(stderr, "cbor_decode: %s\n", msg);
+    exit(1);
+}
+
+static uint64_t rd_head(rd_t *r, int *major)
+{
+    if (r->p >= r->end) die("truncated");
+    uint8_t b = *r->p++;
+    *major = b >> 5;
+    uint8_t ai = b & 0x1F;
+    if (ai < 24) return ai;
+
+    int n = ai == 24 ? 1 : ai == 25 ? 2 : ai == 26 ? 4 : ai == 27 ? 8 : 0;
+    if (n == 0) die("indefinite lengths not supported");
+    if (r->end - r->p < n) die("truncated");
+    uint64_t v = 0;
+    while (n--) v = v << 8 | *r->p++;
+    return v;
+}
+
+static int64_t rd_int(rd_t *r)
+{
+    int major;
+    uint64_t v = rd_head(r, &major);
+    if (major == 0) return (int64_t)v;
+    if (major == 1) return -1 - (int64_t)v;
+    die("expected integer");
+    return 0;
+}
+
+static size_t rd_string(rd_t *r, int want_major, const uint8_t **data)
+{
+    int major;
+    uint64_t len = rd_head(r, &major);
+    if (major != want_major) die("unexpected type");
+    if ((uint64_t)(r->end - r->p) < len) die("truncated");
+    *data = r->p;
+    r->p += len;
+    return (size_t)len;
+}
+
+static size_t rd_array(rd_t *r)
+{
+    int major;
+    uint64_t n = rd_head(r, &major);
+    if (major != 4) die("expected array");
+    if (n > MAX_SAMPLES) die("batch too large");
+    return (size_t)n;
+}
+
+static void print_json_string(const uint8_t *s, size_t len)
+{
+    putchar('"');
+    for (size_t i = 0; i < len; ++i) {
+        if (s[i] == '"' || s[i] == '\\') putchar('\\');
+        if (s[i] < 32) printf("\\u%04x", s[i]);
+        else putchar(s[i]);
+    }
+    putchar('"');
+}
+
+// Integer columns, in the order they are printed. Version 1 batches carry
+// only dt, t and l; version 2 stops at me, version 3 at mg, version 4 at u.
+// Version 5 adds the event columns e, ep and ed when the batch holds room
+// state events, and leaves out t..u when it holds nothing else.
+enum { C_DT, C_T, C_L, C_TN, C_TX, C_TV, C_LN, C_LX, C_LV, C_MD, C_ME,
+       C_MS, C_MF, C_ML, C_MG, C_U, C_E, C_EP, C_ED, C_COUNT };
+static const char *const k_cols[C_COUNT] = {
+    "dt", "t", "l", "tn", "tx", "tv", "ln", "lx", "lv", "md", "me",
+    "ms", "mf", "ml", "mg", "u", "e", "ep", "ed",
+};
+
+// Room states by their bits (main/occupancy.h).
+static const char *const k_states[8] = {
+    "empty", "occupied", "empty+lights", "occupied+lights",
+    "empty+ac", "occupied+ac", "empty+lights+ac", "occupied+lights+ac",
+};
+
+static const char *state_name(int64_t v)
+{
+    return v >= 0 && v < 8 ? k_states[v] : "unknown";
+}
+
+static int64_t col[C_COUNT][MAX_SAMPLES];
+static size_t  col_n[C_COUNT];
+static bool    col_seen[C_COUNT];
+
+// The rest of one row after date and time: a room state event...
+static void print_event(size_t i)
+{
+    printf(",\"state\":\"%s\"", state_name(col[C_E][i]));
+    if (col[C_EP][i] < 0) printf(",\"prev\":null");
+    else printf(",\"prev\":\"%s\"", state_name(col[C_EP][i]));
+    printf(",\"prev_s\":%lld", (long long)col[C_ED][i]);
+}
+
+// ...or a sample's window, t being its time.
+static void print_window(size_t i, int64_t t, int version, const uint8_t *motion)
+{
+    bool m = (motion[i / 8] >> (i % 8)) & 1;
+    printf(",\"temp\":%.2f,\"lux\":%.1f,\"motion\":%s",
+           col[C_T][i] / 100.0, col[C_L][i] / 10.0, m ? "true" : "false");
+    if (version >= 2) {
+        printf(",\"temp_min\":%.2f,\"temp_max\":%.2f,\"temp_var\":%.4f"
+               ",\"lux_min\":%.1f,\"lux_max\":%.1f,\"lux_var\":%.2f"
+               ",\"motion_duty\":%.3f,\"motion_edges\":%lld",
+               col[C_TN][i] / 100.0, col[C_TX][i] / 100.0, col[C_TV][i] / 10000.0,
+               col[C_LN][i] / 10.0, col[C_LX][i] / 10.0, col[C_LV][i] / 100.0,
+               col[C_MD][i] / 1000.0, (long long)col[C_ME][i]);
+    }
+    if (version >= 3) {
+        printf(",\"motion_s\":%.1f", col[C_MS][i] / 10.0);
+        if (col[C_MF][i] < 0) printf(",\"motion_first\":null");
+        else printf(",\"motion_first\":%.1f", col[C_MF][i] / 10.0);
+        if (col[C_ML][i] < 0) printf(",\"motion_last\":null");
+        else printf(",\"motion_last\":%.1f", col[C_ML][i] / 10.0);
+        printf(",\"motion_glitches\":%lld", (long long)col[C_MG][i]);
+    }
+    if (version >= 4 && col[C_U][i] != 0) {
+        time_t us = (time_t)(t - col[C_U][i]);
+        struct tm tm;
+        char since[32];
+        gmtime_r(&us, &tm);
+        strftime(since, sizeof(since), "%Y-%m-%d %H:%M:%S", &tm);
+        printf(",\"unchanged_since\":\"%s\"", since);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    FILE *f = argc > 1 ? fopen(argv[1], "rb") : stdin;
+    if (!f) die("cannot open input");
+
+    static uint8_t buf[4 * 1024 * 1024];
+    size_t len = fread(buf, 1, sizeof(buf), f);
+    rd_t r = { buf, buf + len };
+
+    const uint8_t *building = NULL, *number = NULL, *motion = NULL;
+    size_t building_len = 0, number_len = 0, motion_len = 0;
+    int64_t t0 = 0, version = -1;
+
+    int major;
+    uint64_t pairs = rd_head(&r, &major);
+    if (major != 5) die("expected map");
+    while (pairs--) {
+        const uint8_t *key;
+        size_t klen = rd_string(&r, 3, &key);
+        int c = -1;
+        for (int k = 0; k < C_COUNT; ++k) {
+            if (klen == strlen(k_cols[k]) && memcmp(key, k_cols[k], klen) == 0) c = k;
+        }
+        if (c >= 0) {
+            col_n[c] = rd_array(&r);
+            if (col_n[c] > MAX_SAMPLES) die("too many samples");
+            for (size_t i = 0; i < col_n[c]; ++i) col[c][i] = rd_int(&r);
+            col_seen[c] = true;
+        } else if (klen == 1 && key[0] == 'v') {
+            version = rd_int(&r);
+        } else if (klen == 1 && key[0] == 'b') {
+            building_len = rd_string(&r, 3, &building);
+        } else if (klen == 1 && key[0] == 'n') {
+            number_len = rd_string(&r, 3, &number);
+        } else if (klen == 2 && memcmp(key, "t0", 2) == 0) {
+            t0 = rd_int(&r);
+        } else if (klen == 1 && key[0] == 'm') {
+            motion_len = rd_string(&r, 2, &motion);
+        } else {
+            die("unknown key");
+        }
+    }
+    if (version < 1 || version > 5) die("unsupported version");
+    int ncols = version == 1 ? C_TN : version == 2 ? C_MS : version == 3 ? C_U : C_E;
+    size_t n = col_n[C_DT];
+    bool events = version >= 5 && col_seen[C_E], windows = !events;
+    for (size_t i = 0; events && i < col_n[C_E]; ++i) windows |= col[C_E][i] < 0;
+    for (int c = 0; c < C_COUNT; ++c) {
+        bool want = c == C_DT || (c < ncols ? windows : c >= C_E && events);
+        if (want && (!col_seen[c] || col_n[c] != n)) die("column length mismatch");
+    }
+    if (windows && motion_len != (n + 7) / 8) die("column length mismatch");
+
+    putchar('[');
+    int64_t t = t0;
+    for (size_t i = 0; i < n; ++i) {
+        t += col[C_DT][i];
+        time_t tt = (time_t)t;
+        struct tm tm;
+        gmtime_r(&tt, &tm);
+        char date[16], tod[16];
+        strftime(date, sizeof(date), "%Y-%m-%d", &tm);
+        strftime(tod, sizeof(tod), "%H:%M:%S", &tm);
+        printf("%s{\"date\":\"%s\",\"time\":\"%s\"", i ? "," : "", date, tod);
+        if (events && col[C_E][i] >= 0) print_event(i);
+        else print_window(i, t, (int)version, motion);
+        printf(",\"building\":");
+        print_json_string(building, building_len);
+        printf(",\"number\":");
+        print_json_string(number, number_len);
+        putchar('}');
+    }
+    printf("]\n");
+    return 0;
+}
@@ -0,0 +1,128 @@
+// tools/health_decode.c — decoder for the X-AulaSense-Health upload header
+//
+// Reads one base64 health record produced by main/metrics.c and prints it as
+// JSON. Histogram entries are log2 µs buckets, printed as their upper bound.
+//
+//   cc -O2 -o health_decode tools/health_decode.c
+//   ./health_decode AQMAAAAA...        (or read the base64 text from stdin)
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const k_counters[] = {
+    "samples_dropped", "log_dropped", "i2c_errors",
+    "wifi_disconnects", "connects", "upload_fails", // "http_connects" before 6
+    "i2c_resets",                                   // version 2
+    "samples_undated",                              // version 4
+};
+static const char *const k_hists[] = {
+    "i2c", "upload_connect", "upload_xfer", "upload_total",
+    "sample_late",                                  // version 3
+};
+static const char *const k_boot[] = {               // version 5
+    "first_sample_ms", "first_ip_ms", "first_sync_ms", "first_upload_ms",
+};
+#define N_COUNTERS (sizeof(k_counters) / sizeof(k_counters[0]))
+#define N_HISTS    (sizeof(k_hists) / sizeof(k_hists[0]))
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} rd_t;
+
+static void die(const char *msg)
+{
+    fprintf(stderr, "health_decode: %s\n", msg);
+    exit(1);
+}
+
+static uint32_t rd_le(rd_t *r, int n)
+{
+    if (r->end - r->p < n) die("truncated");
+    uint32_t v = 0;
+    for (int i = 0; i < n; ++i) v |= (uint32_t)*r->p++ << (8 * i);
+    return v;
+}
+
+static int b64_val(int c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+' || c == '-') return 62;
+    if (c == '/' || c == '_') return 63;
+    return -1;
+}
+
+static size_t unbase64(const char *in, uint8_t *out, size_t cap)
+{
+    uint32_t acc = 0;
+    int bits = 0;
+    size_t n = 0;
+    for (; *in && *in != '='; ++in) {
+        int v = b64_val((unsigned char)*in);
+        if (v < 0) continue;   // whitespace, "health=" prefixes, ...
+        acc = acc << 6 | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (n == cap) die("record too long");
+            out[n++] = (uint8_t)(acc >> bits);
+        }
+    }
+    return n;
+}
+
+static uint32_t bucket_us(uint32_t b)
+{
+    return b == 0 ? 0 : b >= 32 ? UINT32_MAX : (1u << b) - 1u;
+}
+
+int main(int argc, char **argv)
+{
+    static char text[4096];
+    if (argc > 1) {
+        snprintf(text, sizeof(text), "%s", argv[1]);
+    } else if (!fgets(text, sizeof(text), stdin)) {
+        die("no input");
+    }
+    const char *s = strstr(text, "health=");
+    s = s ? s + 7 : text;
+
+    uint8_t rec[256];
+    size_t len = unbase64(s, rec, sizeof(rec));
+    rd_t r = { rec, rec + len };
+
+    uint32_t version = rd_le(&r, 1);
+    if (version < 1 || version > 6) die("unsupported version");
+    size_t ncounters = version == 1 ? 6 : version < 4 ? 7 : N_COUNTERS;
+    size_t nhists = version < 3 ? 4 : N_HISTS;
+    uint32_t ntasks = rd_le(&r, 1);
+
+    printf("{\"version\":%u,\"uptime_s\":%u", version, rd_le(&r, 4));
+    printf(",\"free_heap\":%u", rd_le(&r, 4));
+    printf(",\"min_free_heap\":%u", rd_le(&r, 4));
+    for (size_t c = 0; c < ncounters; ++c) {
+        const char *name = c == 4 && version < 6 ? "http_connects" : k_counters[c];
+        printf(",\"%s\":%u", name, rd_le(&r, 4));
+    }
+    for (size_t h = 0; h < nhists; ++h) {
+        uint32_t n = rd_le(&r, 4);
+        uint32_t p50 = rd_le(&r, 1), p90 = rd_le(&r, 1), p99 = rd_le(&r, 1), max = rd_le(&r, 1);
+        printf(",\"%s\":{\"n\":%u,\"p50_us\":%u,\"p90_us\":%u,\"p99_us\":%u,\"max_us\":%u}",
+               k_hists[h], n, bucket_us(p50), bucket_us(p90), bucket_us(p99), bucket_us(max));
+    }
+    printf(",\"stack_hwm\":[");
+    for (uint32_t i = 0; i < ntasks; ++i) printf("%s%u", i ? "," : "", rd_le(&r, 2));
+    printf("]");
+    if (version >= 5) {
+        printf(",\"boot\":{");
+        for (size_t b = 0; b < sizeof(k_boot) / sizeof(k_boot[0]); ++b) {
+            printf("%s\"%s\":%u", b ? "," : "", k_boot[b], rd_le(&r, 4));
+        }
+        printf("}");
+    }
+    printf("}\n");
+    return 0;
+}
@@ -0,0 +1,141 @@
+// tools/log_decode.c — decoder for binary console logs (CONFIG_APP_LOG_BINARY)
+//
+// Reads a raw console capture in which main/binlog.c wrote records as
+// 0x7E-delimited frames between ordinary text lines, and prints it as text:
+// each frame becomes an "I (12345) TAG: message" line, everything else
+// passes through unchanged. A gap in the frames' sequence numbers is
+// reported as records lost on the device (ring full). Messages come from
+// main/binlog_fmt.h, so build this from the same tree as the firmware.
+//
+//   cc -O2 -Imain -o log_decode tools/log_decode.c main/binlog_fmt.c
+//   stty -F /dev/ttyUSB0 115200 raw && cat /dev/ttyUSB0 > console.bin
+//   ./log_decode console.bin           (or read the capture from stdin)
+#include "binlog_fmt.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    uint8_t  raw[BINLOG_FRAME_MAX];   // bytes since the opening flag, stuffed
+    size_t   len;
+    bool     in_frame;
+    bool     have_seq;
+    uint8_t  seq;                     // last one seen
+    uint32_t frames, bad, lost;
+} decoder_t;
+
+static uint32_t rd_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Unstuff and check d->raw; prints the record and returns true if it is one.
+static bool decode_frame(decoder_t *d)
+{
+    uint8_t b[BINLOG_REC_BYTES(BINLOG_MAX_ARGS) + 1];
+    size_t n = 0;
+    for (size_t i = 0; i < d->len; ++i) {
+        uint8_t c = d->raw[i];
+        if (c == BINLOG_ESC) {
+            if (++i == d->len) return false;
+            c = d->raw[i] ^ 0x20;
+        }
+        if (n == sizeof(b)) return false;
+        b[n++] = c;
+    }
+    if (n < BINLOG_REC_BYTES(0) + 1 || b[2] > BINLOG_MAX_ARGS ||
+        n != BINLOG_REC_BYTES(b[2]) + 1 || binlog_crc8(b, n - 1) != b[n - 1]) {
+        return false;
+    }
+
+    binlog_rec_t r = { .id = (uint16_t)(b[0] | b[1] << 8), .nargs = b[2], .seq = b[3],
+                       .t_ms = rd_le32(b + 4) };
+    for (unsigned i = 0; i < r.nargs; ++i) r.args[i] = rd_le32(b + 8 + 4 * i);
+
+    if (r.id != BL_LOST) {   // BL_LOST is made by the drain, outside the numbering
+        uint8_t gap = (uint8_t)(r.seq - d->seq - 1);
+        if (d->have_seq && gap) {
+            printf("--- %u record(s) lost ---\n", gap);
+            d->lost += gap;
+        }
+        d->seq = r.seq;
+        d->have_seq = true;
+    }
+    d->frames++;
+
+    const binlog_msg_t *m = binlog_msg(r.id);
+    if (!m) {
+        printf("? (%u) BINLOG: unknown message %u:", (unsigned)r.t_ms, (unsigned)r.id);
+        for (unsigned i = 0; i < r.nargs; ++i) printf(" %08x", (unsigned)r.args[i]);
+        printf("\n");
+        return true;
+    }
+    char line[512];
+    binlog_format(line, sizeof(line), m->fmt, r.args, r.nargs);
+    printf("%c (%u) %s: %s\n", m->level, (unsigned)r.t_ms, m->tag, line);
+    return true;
+}
+
+static void feed(decoder_t *d, uint8_t c)
+{
+    if (!d->in_frame) {
+        if (c == BINLOG_FLAG) {
+            d->in_frame = true;
+            d->len = 0;
+        } else {
+            putchar(c);
+        }
+        return;
+    }
+    if (c == BINLOG_FLAG) {
+        if (d->len == 0) return;   // back-to-back flags
+        if (decode_frame(d)) {
+            d->in_frame = false;
+            return;
+        }
+        // Not a frame: the text had a '~' in it. This flag may open a real one.
+        d->bad++;
+        putchar(BINLOG_FLAG);
+        fwrite(d->raw, 1, d->len, stdout);
+        d->len = 0;
+        return;
+    }
+    if (d->len == sizeof(d->raw) || c == '\n') {   // too long, or a text line
+        d->bad++;
+        putchar(BINLOG_FLAG);
+        fwrite(d->raw, 1, d->len, stdout);
+        putchar(c);
+        d->in_frame = false;
+        return;
+    }
+    d->raw[d->len++] = c;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-' && argv[1][1])) {
+        fprintf(stderr, "usage: %s [capture]\n", argv[0]);
+        return 2;
+    }
+    if (argc == 2 && strcmp(argv[1], "-") != 0) {
+        in = fopen(argv[1], "rb");
+        if (!in) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    decoder_t d = { 0 };
+    int c;
+    while ((c = getc(in)) != EOF) feed(&d, (uint8_t)c);
+    if (d.in_frame && d.len) {   // capture cut mid-frame
+        putchar(BINLOG_FLAG);
+        fwrite(d.raw, 1, d.len, stdout);
+    }
+    fprintf(stderr, "log_decode: %u records, %u lost, %u '~' sequences left as text\n",
+            (unsigned)d.frames, (unsigned)d.lost, (unsigned)d.bad);
+    return 0;
+}